@@ -26,6 +26,8 @@ AbstractContainer::AbstractContainer(iostream &stream, std::uint64_t startOffset
     , m_tracksAltered(false)
     , m_chaptersParsed(false)
     , m_attachmentsParsed(false)
+    , m_changesPlan(nullptr)
+    , m_planningChanges(false)
     , m_startOffset(startOffset)
     , m_stream(&stream)
     , m_reader(BinaryReader(m_stream))
@@ -160,7 +162,43 @@ void AbstractContainer::parseAttachments(Diagnostics &diag)
  */
 void AbstractContainer::makeFile(Diagnostics &diag, AbortableProgressFeedback &progress)
 {
-    internalMakeFile(diag, progress);
+    auto changes = ChangesPlan();
+    m_appliedChanges.reset();
+    m_changesPlan = &changes;
+    try {
+        internalMakeFile(diag, progress);
+    } catch (...) {
+        m_changesPlan = nullptr;
+        throw;
+    }
+    m_changesPlan = nullptr;
+}
+
+/*!
+ * \brief Determines how makeFile() would apply the changes without modifying the file.
+ *
+ * Only the size and layout calculation of makeFile() is done. Elements of the file might be parsed and
+ * buffered as part of that.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \throws Throws TagParser::Failure or a derived exception when a making
+ *                error occurs; throws TagParser::NotImplementedException if planning is not supported.
+ */
+ChangesPlan AbstractContainer::planChanges(Diagnostics &diag, AbortableProgressFeedback &progress)
+{
+    auto plan = ChangesPlan();
+    m_changesPlan = &plan;
+    m_planningChanges = true;
+    try {
+        internalMakeFile(diag, progress);
+    } catch (...) {
+        m_changesPlan = nullptr;
+        m_planningChanges = false;
+        throw;
+    }
+    m_changesPlan = nullptr;
+    m_planningChanges = false;
+    return plan;
 }
 
 /*!
@@ -259,7 +297,10 @@ void AbstractContainer::internalParseAttachments(Diagnostics &diag)
 /*!
  * \brief Internally called to make the file.
  *
- * Must be implemented when subclassing.
+ * Must be implemented when subclassing. If m_changesPlan is set, the implementation is supposed to fill it
+ * with the calculated layout. If m_planningChanges is set, it must return before modifying the file (see
+ * planChanges()). Implementations which re-parse the header of the new file after writing are supposed to
+ * assign the filled plan to m_appliedChanges (see appliedChanges()).
  *
  * \throws Throws Failure or a derived class when a parsing error occurs.
  * \throws Throws std::ios_base::failure when an IO error occurs.
@@ -492,6 +533,7 @@ void AbstractContainer::reset()
     m_doctypeReadVersion = 0;
     m_timeScale = 0;
     m_titles.clear();
+    m_appliedChanges.reset();
 }
 
 } // namespace TagParser
@@ -1,6 +1,7 @@
 #ifndef TAG_PARSER_ABSTRACTCONTAINER_H
 #define TAG_PARSER_ABSTRACTCONTAINER_H
 
+#include "./changesplan.h"
 #include "./exceptions.h"
 #include "./settings.h"
 #include "./tagtarget.h"
@@ -11,6 +12,7 @@
 #include <c++utilities/io/binarywriter.h>
 
 #include <iostream>
+#include <optional>
 
 namespace CppUtilities {
 class BinaryReader;
@@ -42,6 +44,8 @@ public:
     void parseChapters(Diagnostics &diag);
     void parseAttachments(Diagnostics &diag);
     void makeFile(Diagnostics &diag, AbortableProgressFeedback &progress);
+    ChangesPlan planChanges(Diagnostics &diag, AbortableProgressFeedback &progress);
+    const std::optional<ChangesPlan> &appliedChanges() const;
 
     bool isHeaderParsed() const;
     bool areTagsParsed() const;
@@ -113,6 +117,9 @@ protected:
     bool m_tracksAltered;
     bool m_chaptersParsed;
     bool m_attachmentsParsed;
+    ChangesPlan *m_changesPlan;
+    bool m_planningChanges;
+    std::optional<ChangesPlan> m_appliedChanges;
 
 private:
     std::uint64_t m_startOffset;
@@ -163,6 +170,20 @@ inline CppUtilities::BinaryWriter &AbstractContainer::writer()
     return m_writer;
 }
 
+/*!
+ * \brief Returns the layout of the file produced by the last call of makeFile().
+ *
+ * The value is only present if the implementation has re-parsed the header of the new file so the element
+ * tree, tracks and the positions of tags reflect the written file. Tags, chapters and attachments can then be
+ * parsed from the new file without parsing the header again. The value is cleared by reset().
+ *
+ * \remarks ChangesPlan::bytesToWrite is the same estimation planChanges() would have returned.
+ */
+inline const std::optional<ChangesPlan> &AbstractContainer::appliedChanges() const
+{
+    return m_appliedChanges;
+}
+
 /*!
  * \brief Returns an indication whether the header has been parsed yet.
  */
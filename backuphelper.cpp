@@ -1,6 +1,7 @@
 #include "./backuphelper.h"
 #include "./diagnostics.h"
 #include "./mediafileinfo.h"
+#include "./progressfeedback.h"
 
 #include <c++utilities/conversion/stringbuilder.h>
 #include <c++utilities/conversion/stringconversion.h>
@@ -8,11 +9,25 @@
 #ifdef PLATFORM_WINDOWS
 #include <windows.h>
 #else
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#ifdef TAG_PARSER_HAVE_FICLONE
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#ifdef TAG_PARSER_HAVE_XATTR
+#include <sys/xattr.h>
+#endif
 #endif
 
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
@@ -31,12 +46,264 @@ namespace TagParser {
 
 namespace BackupHelper {
 
+/// \cond
+namespace {
+
+/// \brief The max. number of bytes to copy via copy_file_range() at once (between progress updates).
+constexpr std::uint64_t copyChunkSize = 0x1000000;
+/// \brief The size of the buffer used when copying the data in user-space.
+constexpr std::size_t copyBufferSize = 0x100000;
+
+/*!
+ * \brief Updates the step percentage of \a progress and throws OperationAbortedException if aborted and \a abortable.
+ */
+void updateCopyProgress(AbortableProgressFeedback *progress, bool abortable, std::uint64_t bytesCopied, std::uint64_t totalBytes)
+{
+    if (!progress) {
+        return;
+    }
+    if (abortable) {
+        progress->stopIfAborted();
+    }
+    progress->updateStepPercentageFromFraction(totalBytes ? static_cast<double>(min(bytesCopied, totalBytes)) / static_cast<double>(totalBytes) : 1.0);
+}
+
+#ifndef PLATFORM_WINDOWS
+/*!
+ * \brief The FileDescriptor class closes the wrapped file descriptor on destruction.
+ */
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int fileDescriptor)
+        : m_fileDescriptor(fileDescriptor)
+    {
+    }
+    FileDescriptor(const FileDescriptor &) = delete;
+    FileDescriptor &operator=(const FileDescriptor &) = delete;
+    ~FileDescriptor()
+    {
+        if (m_fileDescriptor >= 0) {
+            ::close(m_fileDescriptor);
+        }
+    }
+    operator int() const
+    {
+        return m_fileDescriptor;
+    }
+    int close()
+    {
+        const auto res = ::close(m_fileDescriptor);
+        m_fileDescriptor = -1;
+        return res;
+    }
+
+private:
+    int m_fileDescriptor;
+};
+
+/*!
+ * \brief Throws an std::ios_base::failure containing \a message and the description of the current errno.
+ */
+[[noreturn]] void throwFailure(const char *message, const std::string &path)
+{
+    throw std::ios_base::failure(argsToString(message, " \"", path, "\": ", std::strerror(errno)));
+}
+
+/*!
+ * \brief Returns \a path with symlinks resolved so the file the symlink points to is replaced rather than the symlink itself.
+ */
+std::string resolvedPath(const std::string &path)
+{
+    const auto resolved = std::unique_ptr<char, decltype(&std::free)>(::realpath(BasicFileInfo::pathForOpen(path), nullptr), &std::free);
+    return resolved ? std::string(resolved.get()) : path;
+}
+
+#ifdef TAG_PARSER_HAVE_XATTR
+/*!
+ * \brief Copies the extended attributes of the file at \a sourcePath to the file at \a targetPath.
+ */
+void copyExtendedAttributes(const std::string &sourcePath, const std::string &targetPath, Diagnostics &diag, const std::string &context)
+{
+    const auto *const source = BasicFileInfo::pathForOpen(sourcePath), *const target = BasicFileInfo::pathForOpen(targetPath);
+    auto names = std::string();
+    auto namesSize = ::listxattr(source, nullptr, 0);
+    if (namesSize > 0) {
+        names.resize(static_cast<std::size_t>(namesSize));
+        namesSize = ::listxattr(source, names.data(), names.size());
+    }
+    if (namesSize < 0) {
+        if (errno != ENOTSUP) {
+            diag.emplace_back(DiagLevel::Warning, argsToString("Unable to read extended attributes of \"", sourcePath, "\": ", std::strerror(errno)), context);
+        }
+        return;
+    }
+    names.resize(static_cast<std::size_t>(namesSize));
+    auto value = std::string();
+    for (auto i = std::size_t(); i < names.size(); i += std::strlen(names.data() + i) + 1) {
+        const auto *const name = names.data() + i;
+        auto valueSize = ::getxattr(source, name, nullptr, 0);
+        if (valueSize >= 0) {
+            value.resize(static_cast<std::size_t>(valueSize));
+            valueSize = ::getxattr(source, name, value.data(), value.size());
+        }
+        if (valueSize < 0 || ::setxattr(target, name, value.data(), static_cast<std::size_t>(valueSize), 0)) {
+            diag.emplace_back(DiagLevel::Warning, argsToString("Unable to preserve extended attribute \"", name, "\": ", std::strerror(errno)), context);
+        }
+    }
+}
+#endif
+#endif
+
+/*!
+ * \brief Copies the file at \a sourcePath to \a targetPath using the most efficient method available.
+ * \remarks Only the step percentage of \a progress is updated if not \a abortable.
+ */
+FileCopyMethod copyFileContents(const std::string &sourcePath, const std::string &targetPath, AbortableProgressFeedback *progress, bool abortable)
+{
+#ifndef PLATFORM_WINDOWS
+    // open source and create target with the same permissions
+    const auto source = FileDescriptor(::open(BasicFileInfo::pathForOpen(sourcePath), O_RDONLY | O_CLOEXEC));
+    if (source < 0) {
+        throwFailure("Unable to open", sourcePath);
+    }
+    struct stat sourceStat;
+    if (::fstat(source, &sourceStat)) {
+        throwFailure("Unable to stat", sourcePath);
+    }
+    auto target = FileDescriptor(::open(BasicFileInfo::pathForOpen(targetPath), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, sourceStat.st_mode & 07777));
+    if (target < 0) {
+        throwFailure("Unable to create", targetPath);
+    }
+    const auto totalBytes = static_cast<std::uint64_t>(sourceStat.st_size);
+    auto bytesCopied = std::uint64_t();
+    auto method = FileCopyMethod::Buffered;
+    updateCopyProgress(progress, abortable, bytesCopied, totalBytes);
+
+#ifdef TAG_PARSER_HAVE_FICLONE
+    // try to clone the file which only works within the same copy-on-write file system (e.g. Btrfs, XFS)
+    if (!::ioctl(target, FICLONE, static_cast<int>(source))) {
+        method = FileCopyMethod::Reflink;
+        bytesCopied = totalBytes;
+    }
+#endif
+
+#ifdef TAG_PARSER_HAVE_COPY_FILE_RANGE
+    // try to copy the data within the kernel which might also be done server-side on network file systems
+    if (method == FileCopyMethod::Buffered) {
+        method = FileCopyMethod::CopyFileRange;
+        while (bytesCopied < totalBytes) {
+            const auto res = ::copy_file_range(source, nullptr, target, nullptr, static_cast<std::size_t>(min(copyChunkSize, totalBytes - bytesCopied)), 0);
+            if (res < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                // fall back to copying in user-space if not supported (for the given file systems)
+                if (!bytesCopied && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP || errno == EPERM)) {
+                    method = FileCopyMethod::Buffered;
+                    break;
+                }
+                throwFailure("Unable to copy data to", targetPath);
+            }
+            if (!res) {
+                break;
+            }
+            bytesCopied += static_cast<std::uint64_t>(res);
+            updateCopyProgress(progress, abortable, bytesCopied, totalBytes);
+        }
+    }
+#endif
+
+    // copy the data in user-space
+    if (method == FileCopyMethod::Buffered) {
+        const auto buffer = make_unique<char[]>(copyBufferSize);
+        for (;;) {
+            const auto bytesRead = ::read(source, buffer.get(), copyBufferSize);
+            if (bytesRead < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throwFailure("Unable to read", sourcePath);
+            }
+            if (!bytesRead) {
+                break;
+            }
+            for (auto bytesWritten = decltype(bytesRead)(); bytesWritten < bytesRead;) {
+                const auto res = ::write(target, buffer.get() + bytesWritten, static_cast<std::size_t>(bytesRead - bytesWritten));
+                if (res < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throwFailure("Unable to write", targetPath);
+                }
+                bytesWritten += res;
+            }
+            bytesCopied += static_cast<std::uint64_t>(bytesRead);
+            updateCopyProgress(progress, abortable, bytesCopied, totalBytes);
+        }
+    }
+
+    // close the target explicitly to catch deferred write errors
+    if (target.close()) {
+        throwFailure("Unable to write", targetPath);
+    }
+    updateCopyProgress(progress, abortable, totalBytes, totalBytes);
+    return method;
+#else
+    NativeFileStream source, target;
+    source.exceptions(ios_base::failbit | ios_base::badbit);
+    target.exceptions(ios_base::failbit | ios_base::badbit);
+    source.open(BasicFileInfo::pathForOpen(sourcePath), ios_base::in | ios_base::binary);
+    target.open(BasicFileInfo::pathForOpen(targetPath), ios_base::out | ios_base::binary | ios_base::trunc);
+    source.seekg(0, ios_base::end);
+    const auto totalBytes = static_cast<std::uint64_t>(source.tellg());
+    source.seekg(0, ios_base::beg);
+    const auto buffer = make_unique<char[]>(copyBufferSize);
+    for (auto bytesCopied = std::uint64_t(); bytesCopied < totalBytes;) {
+        updateCopyProgress(progress, abortable, bytesCopied, totalBytes);
+        const auto chunkSize = static_cast<std::streamsize>(min<std::uint64_t>(copyBufferSize, totalBytes - bytesCopied));
+        source.read(buffer.get(), chunkSize);
+        target.write(buffer.get(), chunkSize);
+        bytesCopied += static_cast<std::uint64_t>(chunkSize);
+    }
+    target.flush();
+    target.close();
+    updateCopyProgress(progress, abortable, totalBytes, totalBytes);
+    return FileCopyMethod::Buffered;
+#endif
+}
+
+} // namespace
+/// \endcond
+
+/*!
+ * \brief Copies the file at \a sourcePath to \a targetPath.
+ * \param sourcePath Specifies the path of the file to copy.
+ * \param targetPath Specifies the path of the copy; an existing file is overridden.
+ * \param progress Specifies the progress feedback to report the step percentage to and to check for abortion; might be nullptr.
+ * \returns Returns how the file has been copied.
+ *
+ * The following methods are tried in that order:
+ * 1. Cloning the file via FICLONE which takes constant time on copy-on-write file systems.
+ * 2. Copying the data within the kernel via copy_file_range() which avoids copying it to user-space.
+ * 3. Reading and writing the data using a large buffer.
+ *
+ * The first two methods are only available under Linux.
+ *
+ * \throws Throws std::ios_base::failure on failure.
+ * \throws Throws OperationAbortedException when aborted via \a progress; then \a targetPath is incomplete.
+ */
+FileCopyMethod copyFile(const std::string &sourcePath, const std::string &targetPath, AbortableProgressFeedback *progress)
+{
+    return copyFileContents(sourcePath, targetPath, progress, true);
+}
+
 /*!
  * \brief Restores the original file from the specified backup file.
  * \param originalPath Specifies the path to the original file.
  * \param backupPath Specifies the path to the backup file.
  * \param originalStream Specifies a std::fstream instance for the original file.
  * \param backupStream Specifies a std::fstream instance for the backup file.
+ * \param progress Specifies the progress feedback to report the progress of copying to; might be nullptr.
  *
  * This helper function is used by MediaFileInfo and container implementations
  * to restore the original file from the specified backup file in the case a Failure
@@ -44,13 +311,13 @@ namespace BackupHelper {
  * currently open.
  *
  * If moving isn't possible (eg. \a originalPath and \a backupPath refer to different partitions) the backup
- * file will be restored by copying.
+ * file will be restored by copying using copyFile(). Since restoring is usually required after the operation
+ * has been aborted, it is never aborted via \a progress.
  *
  * \throws Throws std::ios_base::failure on failure.
- * \todo Implement callback for progress updates (copy).
  */
-void restoreOriginalFileFromBackupFile(
-    const std::string &originalPath, const std::string &backupPath, NativeFileStream &originalStream, NativeFileStream &backupStream)
+void restoreOriginalFileFromBackupFile(const std::string &originalPath, const std::string &backupPath, NativeFileStream &originalStream,
+    NativeFileStream &backupStream, AbortableProgressFeedback *progress)
 {
     // ensure the orignal stream is closed
     if (originalStream.is_open()) {
@@ -73,14 +340,10 @@ void restoreOriginalFileFromBackupFile(
     }
     // can't rename/move the file (maybe backup dir on another partition) -> make a copy instead
     try {
-        // need to open all streams again
-        backupStream.exceptions(ios_base::failbit | ios_base::badbit);
-        originalStream.exceptions(ios_base::failbit | ios_base::badbit);
-        backupStream.open(backupPath, ios_base::in | ios_base::binary);
-        originalStream.open(originalPath, ios_base::out | ios_base::binary);
-        originalStream << backupStream.rdbuf();
-        originalStream.flush();
-        // TODO: callback for progress updates
+        if (progress) {
+            progress->updateStep("Restoring original file from backup ...");
+        }
+        copyFileContents(backupPath, originalPath, progress, false);
     } catch (const std::ios_base::failure &failure) {
         throw std::ios_base::failure("Unable to restore original file from backup file \"" % backupPath % "\" after failure: " + failure.what());
     }
@@ -95,38 +358,15 @@ static bool isRelative(const std::string &path)
 }
 
 /*!
- * \brief Creates a backup file for the specified file.
- * \param backupDir Specifies the directory to store backup files. If empty, the directory of the file
- *                  to be backuped is used.
- * \param originalPath Specifies the path of the file to be backuped.
- * \param backupPath Contains the path of the created backup file when this function returns.
- * \param originalStream Specifies a std::fstream for the original file.
- * \param backupStream Specifies a std::fstream for creating the backup file.
- *
- * This helper function is used by MediaFileInfo and container implementations to create a backup file
- * when applying changes. The specified \a backupPath is set to the path of the created backup file.
- * The specified \a backupStream will be closed if currently open. Then it is
- * used to open the backup file using the flags ios_base::in and ios_base::binary.
- *
- * The specified \a originalStream is closed before performing the move operation.
- *
- * If moving isn't possible (eg. \a originalPath and \a backupPath refer to different partitions) the backup
- * file will be created by copying.
- *
- * The original file can now be rewritten to apply changes. When this operation fails
- * the created backup file can be restored using restoreOriginalFileFromBackupFile().
- *
- * \throws Throws std::ios_base::failure on failure.
- * \todo Implement callback for progress updates (copy).
+ * \brief Returns a path within \a backupDir which is not used yet for a backup of the file at \a originalPath.
  */
-void createBackupFile(const std::string &backupDir, const std::string &originalPath, std::string &backupPath, NativeFileStream &originalStream,
-    NativeFileStream &backupStream)
+static std::string determineBackupPath(const std::string &backupDir, const std::string &originalPath)
 {
     // determine dirs
     const auto backupDirRelative(isRelative(backupDir));
     const auto originalDir(backupDirRelative ? BasicFileInfo::containingDirectory(originalPath) : string());
 
-    // determine the backup path
+    auto backupPath = std::string();
     for (unsigned int i = 0;; ++i) {
         if (backupDir.empty()) {
             if (i) {
@@ -159,9 +399,43 @@ void createBackupFile(const std::string &backupDir, const std::string &originalP
         struct stat backupStat;
         if (stat(BasicFileInfo::pathForOpen(backupPath), &backupStat)) {
 #endif
-            break;
+            return backupPath;
         }
     }
+}
+
+/*!
+ * \brief Creates a backup file for the specified file.
+ * \param backupDir Specifies the directory to store backup files. If empty, the directory of the file
+ *                  to be backuped is used.
+ * \param originalPath Specifies the path of the file to be backuped.
+ * \param backupPath Contains the path of the created backup file when this function returns.
+ * \param originalStream Specifies a std::fstream for the original file.
+ * \param backupStream Specifies a std::fstream for creating the backup file.
+ * \param progress Specifies the progress feedback to report the progress of copying to and to check for abortion; might be nullptr.
+ *
+ * This helper function is used by MediaFileInfo and container implementations to create a backup file
+ * when applying changes. The specified \a backupPath is set to the path of the created backup file.
+ * The specified \a backupStream will be closed if currently open. Then it is
+ * used to open the backup file using the flags ios_base::in and ios_base::binary.
+ *
+ * The specified \a originalStream is closed before performing the move operation.
+ *
+ * If moving isn't possible (eg. \a originalPath and \a backupPath refer to different partitions) the backup
+ * file will be created by copying using copyFile(). If copying fails or is aborted, the incomplete backup file
+ * is removed and \a backupPath is cleared.
+ *
+ * The original file can now be rewritten to apply changes. When this operation fails
+ * the created backup file can be restored using restoreOriginalFileFromBackupFile().
+ *
+ * \throws Throws std::ios_base::failure on failure.
+ * \throws Throws OperationAbortedException when aborted via \a progress.
+ */
+void createBackupFile(const std::string &backupDir, const std::string &originalPath, std::string &backupPath, NativeFileStream &originalStream,
+    NativeFileStream &backupStream, AbortableProgressFeedback *progress)
+{
+    // determine the backup path
+    backupPath = determineBackupPath(backupDir, originalPath);
 
     // ensure original file is closed
     if (originalStream.is_open()) {
@@ -172,22 +446,22 @@ void createBackupFile(const std::string &backupDir, const std::string &originalP
     if (std::rename(BasicFileInfo::pathForOpen(originalPath), BasicFileInfo::pathForOpen(backupPath))) {
         // can't rename/move the file (maybe backup dir on another partition) -> make a copy instead
         try {
-            backupStream.exceptions(ios_base::failbit | ios_base::badbit);
-            originalStream.exceptions(ios_base::failbit | ios_base::badbit);
-            // ensure backupStream is opened as write-only
             if (backupStream.is_open()) {
                 backupStream.close();
             }
-            backupStream.open(BasicFileInfo::pathForOpen(backupPath), ios_base::out | ios_base::binary);
-            // ensure originalStream is opened with read permissions
-            originalStream.open(BasicFileInfo::pathForOpen(originalPath), ios_base::in | ios_base::binary);
-            // do the actual copying
-            backupStream << originalStream.rdbuf();
-            backupStream.flush();
-            // streams are closed in the next try-block
-            // TODO: callback for progress updates
-        } catch (const std::ios_base::failure &failure) {
-            throw std::ios_base::failure(argsToString("Unable to rename original file before rewriting it: ", failure.what()));
+            if (progress) {
+                progress->updateStep("Copying original file to backup location ...");
+            }
+            copyFileContents(originalPath, backupPath, progress, true);
+        } catch (...) {
+            // don't leave an incomplete backup file behind which might be restored later
+            std::remove(BasicFileInfo::pathForOpen(backupPath));
+            backupPath.clear();
+            try {
+                throw;
+            } catch (const std::ios_base::failure &failure) {
+                throw std::ios_base::failure(argsToString("Unable to rename original file before rewriting it: ", failure.what()));
+            }
         }
     }
 
@@ -215,6 +489,215 @@ void createBackupFile(const std::string &backupDir, const std::string &originalP
     }
 }
 
+/*!
+ * \brief Creates a backup of the specified file leaving the original file in place.
+ * \param backupDir Specifies the directory to store backup files. If empty, the directory of the file
+ *                  to be backuped is used.
+ * \param originalPath Specifies the path of the file to be backuped.
+ * \param hardLink Specifies whether a hard link is sufficient because the original file is going to be replaced (rather
+ *                 than being modified in-place). If creating a hard link within \a backupDir is not possible (e.g. because
+ *                 it is on a different file system), the hard link is created next to the original file instead. Only if
+ *                 that is not possible either, the file is copied.
+ * \param progress Specifies the progress feedback to report the progress of copying to and to check for abortion; might be nullptr.
+ * \returns Returns the path of the created backup file.
+ *
+ * This helper function is used by BatchWriter to be able to roll back changes which have already been applied. The
+ * backup file is named like the backup files created by createBackupFile(). It is created via copyFile() so
+ * copying is cheap on file systems supporting reflinks. If copying fails or is aborted, the incomplete backup file is
+ * removed.
+ *
+ * \throws Throws std::ios_base::failure on failure.
+ * \throws Throws OperationAbortedException when aborted via \a progress.
+ */
+std::string createBackupCopy(const std::string &backupDir, const std::string &originalPath, bool hardLink, AbortableProgressFeedback *progress)
+{
+    auto backupPath = determineBackupPath(backupDir, originalPath);
+#ifndef PLATFORM_WINDOWS
+    if (hardLink) {
+        if (::link(BasicFileInfo::pathForOpen(originalPath), BasicFileInfo::pathForOpen(backupPath)) == 0) {
+            return backupPath;
+        }
+        if (!backupDir.empty()) {
+            auto linkPath = determineBackupPath(std::string(), originalPath);
+            if (::link(BasicFileInfo::pathForOpen(originalPath), BasicFileInfo::pathForOpen(linkPath)) == 0) {
+                return linkPath;
+            }
+        }
+    }
+#else
+    CPP_UTILITIES_UNUSED(hardLink);
+#endif
+    try {
+        if (progress) {
+            progress->updateStep("Copying original file to backup location ...");
+        }
+        copyFileContents(originalPath, backupPath, progress, true);
+    } catch (...) {
+        // don't leave an incomplete backup file behind which might be restored later
+        std::remove(BasicFileInfo::pathForOpen(backupPath));
+        try {
+            throw;
+        } catch (const std::ios_base::failure &failure) {
+            throw std::ios_base::failure(argsToString("Unable to create backup of original file: ", failure.what()));
+        }
+    }
+    return backupPath;
+}
+
+/*!
+ * \brief Creates a backup of the specified file by cloning it via FICLONE leaving the original file in place.
+ * \param backupDir Specifies the directory to store backup files. If empty, the directory of the file
+ *                  to be backuped is used.
+ * \param originalPath Specifies the path of the file to be backuped.
+ * \returns Returns the path of the created backup file or an empty string if cloning the file is not possible.
+ *
+ * Unlike createBackupCopy() this function never copies the data of the file. So it takes constant time but only
+ * succeeds on copy-on-write file systems (e.g. Btrfs, XFS) if \a backupDir is on the same file system as the original
+ * file. It is always unsuccessful on platforms other than Linux.
+ *
+ * \throws Throws std::ios_base::failure when the original file can not be opened.
+ */
+std::string createBackupClone(const std::string &backupDir, const std::string &originalPath)
+{
+#ifdef TAG_PARSER_HAVE_FICLONE
+    const auto source = FileDescriptor(::open(BasicFileInfo::pathForOpen(originalPath), O_RDONLY | O_CLOEXEC));
+    if (source < 0) {
+        throwFailure("Unable to open", originalPath);
+    }
+    struct stat sourceStat;
+    if (::fstat(source, &sourceStat)) {
+        throwFailure("Unable to stat", originalPath);
+    }
+    auto backupPath = determineBackupPath(backupDir, originalPath);
+    const auto target = FileDescriptor(
+        ::open(BasicFileInfo::pathForOpen(backupPath), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, sourceStat.st_mode & 07777));
+    if (target < 0) {
+        return std::string();
+    }
+    if (::ioctl(target, FICLONE, static_cast<int>(source))) {
+        std::remove(BasicFileInfo::pathForOpen(backupPath));
+        return std::string();
+    }
+    return backupPath;
+#else
+    CPP_UTILITIES_UNUSED(backupDir)
+    CPP_UTILITIES_UNUSED(originalPath)
+    return std::string();
+#endif
+}
+
+/*!
+ * \brief Creates an empty temporary file next to the file at \a originalPath to write the modified file to.
+ * \returns Returns the path of the temporary file.
+ *
+ * This helper function is used by MediaFileInfo::applyChanges() when using RewriteStrategy::TemporaryFile. The
+ * temporary file is created in the same directory (and thus on the same file system) as the original file so
+ * replaceOriginalFile() can replace the original file by simply renaming the temporary file. If \a originalPath is a
+ * symlink, the temporary file is created next to the file the symlink points to. The temporary file is only
+ * accessible by the current user until it replaces the original file.
+ *
+ * \throws Throws std::ios_base::failure on failure.
+ */
+std::string createTemporaryFile(const std::string &originalPath)
+{
+#ifndef PLATFORM_WINDOWS
+    const auto path = resolvedPath(originalPath);
+#else
+    const auto &path = originalPath;
+#endif
+    for (unsigned int i = 0;; ++i) {
+        auto temporaryPath = i ? path % '.' % i + ".tmp" : path + ".tmp";
+#ifndef PLATFORM_WINDOWS
+        // create the file exclusively so an existing file is never overridden
+        const auto temporaryFile = FileDescriptor(::open(BasicFileInfo::pathForOpen(temporaryPath), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600));
+        if (temporaryFile >= 0) {
+            return temporaryPath;
+        }
+        if (errno != EEXIST) {
+            throwFailure("Unable to create temporary file", temporaryPath);
+        }
+#else
+        if (GetFileAttributes(BasicFileInfo::pathForOpen(temporaryPath)) == INVALID_FILE_ATTRIBUTES) {
+            NativeFileStream temporaryFile;
+            temporaryFile.exceptions(ios_base::failbit | ios_base::badbit);
+            temporaryFile.open(BasicFileInfo::pathForOpen(temporaryPath), ios_base::out | ios_base::binary | ios_base::trunc);
+            return temporaryPath;
+        }
+#endif
+    }
+}
+
+/*!
+ * \brief Replaces the file at \a originalPath with the file at \a temporaryPath.
+ * \param originalPath Specifies the path of the file to be replaced.
+ * \param temporaryPath Specifies the path of the completely written temporary file created via createTemporaryFile().
+ * \param sync Specifies whether the temporary file should be flushed to the storage device before replacing the
+ *             original file. Otherwise the original file might end up empty if the system crashes shortly after.
+ * \param diag Specifies the container to add diagnostic messages to.
+ * \param context Specifies the context used to add diagnostic messages.
+ *
+ * The permissions, the ownership and the extended attributes of the original file are applied to the temporary file
+ * which is then renamed to \a originalPath. Not being able to preserve those is reported as warning. The rename
+ * is atomic so readers see either the complete original or the complete new file.
+ *
+ * \remarks Under Windows, the original file is removed before renaming the temporary file so replacing the file is
+ *          not atomic and the file attributes are not preserved.
+ * \throws Throws std::ios_base::failure on failure; the temporary file is left untouched in this case.
+ */
+void replaceOriginalFile(const std::string &originalPath, const std::string &temporaryPath, bool sync, Diagnostics &diag, const std::string &context)
+{
+#ifndef PLATFORM_WINDOWS
+    const auto path = resolvedPath(originalPath);
+    const auto *const temporaryPathForOpen = BasicFileInfo::pathForOpen(temporaryPath);
+
+    // preserve ownership and permissions (changing the ownership might clear the setuid/setgid bits so it is done first)
+    struct stat originalStat;
+    if (::stat(BasicFileInfo::pathForOpen(path), &originalStat)) {
+        throwFailure("Unable to stat", path);
+    }
+    if ((originalStat.st_uid != ::geteuid() || originalStat.st_gid != ::getegid())
+        && ::chown(temporaryPathForOpen, originalStat.st_uid, originalStat.st_gid)) {
+        diag.emplace_back(DiagLevel::Warning, argsToString("Unable to preserve ownership of \"", path, "\": ", std::strerror(errno)), context);
+    }
+    if (::chmod(temporaryPathForOpen, originalStat.st_mode & 07777)) {
+        diag.emplace_back(DiagLevel::Warning, argsToString("Unable to preserve permissions of \"", path, "\": ", std::strerror(errno)), context);
+    }
+#ifdef TAG_PARSER_HAVE_XATTR
+    copyExtendedAttributes(path, temporaryPath, diag, context);
+#endif
+
+    // ensure the data is on the storage device before it replaces the original file
+    if (sync) {
+        auto temporaryFile = FileDescriptor(::open(temporaryPathForOpen, O_WRONLY | O_CLOEXEC));
+        if (temporaryFile < 0 || ::fsync(temporaryFile) || temporaryFile.close()) {
+            throwFailure("Unable to sync", temporaryPath);
+        }
+    }
+
+    // replace the original file atomically
+    if (std::rename(temporaryPathForOpen, BasicFileInfo::pathForOpen(path))) {
+        throwFailure("Unable to replace", path);
+    }
+
+    // ensure the renaming is persisted as well
+    if (sync) {
+        const auto directory = BasicFileInfo::containingDirectory(path);
+        const auto directoryDescriptor = FileDescriptor(::open(directory.empty() ? "." : directory.data(), O_RDONLY | O_CLOEXEC));
+        if (directoryDescriptor < 0 || ::fsync(directoryDescriptor)) {
+            diag.emplace_back(DiagLevel::Warning, argsToString("Unable to sync directory \"", directory, "\": ", std::strerror(errno)), context);
+        }
+    }
+#else
+    CPP_UTILITIES_UNUSED(sync)
+    CPP_UTILITIES_UNUSED(diag)
+    CPP_UTILITIES_UNUSED(context)
+    std::remove(BasicFileInfo::pathForOpen(originalPath));
+    if (std::rename(BasicFileInfo::pathForOpen(temporaryPath), BasicFileInfo::pathForOpen(originalPath))) {
+        throw std::ios_base::failure("Unable to replace \"" % originalPath % "\" with temporary file \"" % temporaryPath + "\".");
+    }
+#endif
+}
+
 /*!
  * \brief Handles a failure/abort which occurred after the file has been modified.
  *
@@ -236,6 +719,17 @@ void createBackupFile(const std::string &backupDir, const std::string &originalP
  */
 void handleFailureAfterFileModified(MediaFileInfo &fileInfo, const std::string &backupPath, NativeFileStream &outputStream,
     NativeFileStream &backupStream, Diagnostics &diag, const std::string &context)
+{
+    handleFailureAfterFileModified(fileInfo, backupPath, outputStream, backupStream, diag, nullptr, context);
+}
+
+/*!
+ * \brief Handles a failure/abort which occurred after the file has been modified.
+ *
+ * Same as the overload without \a progress but reports the progress of restoring the backup file to \a progress.
+ */
+void handleFailureAfterFileModified(MediaFileInfo &fileInfo, const std::string &backupPath, NativeFileStream &outputStream,
+    NativeFileStream &backupStream, Diagnostics &diag, AbortableProgressFeedback *progress, const std::string &context)
 {
     // reset the associated container in any case
     if (fileInfo.container()) {
@@ -250,7 +744,7 @@ void handleFailureAfterFileModified(MediaFileInfo &fileInfo, const std::string &
             // a temp/backup file has been created -> restore original file
             diag.emplace_back(DiagLevel::Information, "Rewriting the file to apply changed tag information has been aborted.", context);
             try {
-                restoreOriginalFileFromBackupFile(fileInfo.path(), backupPath, outputStream, backupStream);
+                restoreOriginalFileFromBackupFile(fileInfo.path(), backupPath, outputStream, backupStream, progress);
                 diag.emplace_back(DiagLevel::Information, "The original file has been restored.", context);
             } catch (const std::ios_base::failure &failure) {
                 diag.emplace_back(DiagLevel::Critical, failure.what(), context);
@@ -265,7 +759,7 @@ void handleFailureAfterFileModified(MediaFileInfo &fileInfo, const std::string &
             // a temp/backup file has been created -> restore original file
             diag.emplace_back(DiagLevel::Critical, "Rewriting the file to apply changed tag information failed.", context);
             try {
-                restoreOriginalFileFromBackupFile(fileInfo.path(), backupPath, outputStream, backupStream);
+                restoreOriginalFileFromBackupFile(fileInfo.path(), backupPath, outputStream, backupStream, progress);
                 diag.emplace_back(DiagLevel::Information, "The original file has been restored.", context);
             } catch (const std::ios_base::failure &failure) {
                 diag.emplace_back(DiagLevel::Critical, failure.what(), context);
@@ -280,7 +774,7 @@ void handleFailureAfterFileModified(MediaFileInfo &fileInfo, const std::string &
             // a temp/backup file has been created -> restore original file
             diag.emplace_back(DiagLevel::Critical, "An IO error occurred when rewriting the file to apply changed tag information.", context);
             try {
-                restoreOriginalFileFromBackupFile(fileInfo.path(), backupPath, outputStream, backupStream);
+                restoreOriginalFileFromBackupFile(fileInfo.path(), backupPath, outputStream, backupStream, progress);
                 diag.emplace_back(DiagLevel::Information, "The original file has been restored.", context);
             } catch (const std::ios_base::failure &failure) {
                 diag.emplace_back(DiagLevel::Critical, failure.what(), context);
@@ -9,16 +9,37 @@ namespace TagParser {
 
 class MediaFileInfo;
 class Diagnostics;
+class AbortableProgressFeedback;
 
 namespace BackupHelper {
 
+/*!
+ * \brief The FileCopyMethod enum specifies how copyFile() has copied a file.
+ */
+enum class FileCopyMethod {
+    Reflink, /**< the file has been cloned via FICLONE (copy-on-write) so no data has been copied */
+    CopyFileRange, /**< the data has been copied within the kernel via copy_file_range() */
+    Buffered, /**< the data has been copied by reading and writing it using a large buffer */
+};
+
+TAG_PARSER_EXPORT FileCopyMethod copyFile(
+    const std::string &sourcePath, const std::string &targetPath, AbortableProgressFeedback *progress = nullptr);
 TAG_PARSER_EXPORT void restoreOriginalFileFromBackupFile(const std::string &originalPath, const std::string &backupPath,
-    CppUtilities::NativeFileStream &originalStream, CppUtilities::NativeFileStream &backupStream);
+    CppUtilities::NativeFileStream &originalStream, CppUtilities::NativeFileStream &backupStream, AbortableProgressFeedback *progress = nullptr);
 TAG_PARSER_EXPORT void createBackupFile(const std::string &backupDir, const std::string &originalPath, std::string &backupPath,
-    CppUtilities::NativeFileStream &originalStream, CppUtilities::NativeFileStream &backupStream);
+    CppUtilities::NativeFileStream &originalStream, CppUtilities::NativeFileStream &backupStream, AbortableProgressFeedback *progress = nullptr);
+TAG_PARSER_EXPORT std::string createBackupCopy(
+    const std::string &backupDir, const std::string &originalPath, bool hardLink = false, AbortableProgressFeedback *progress = nullptr);
+TAG_PARSER_EXPORT std::string createBackupClone(const std::string &backupDir, const std::string &originalPath);
+TAG_PARSER_EXPORT std::string createTemporaryFile(const std::string &originalPath);
+TAG_PARSER_EXPORT void replaceOriginalFile(const std::string &originalPath, const std::string &temporaryPath, bool sync, Diagnostics &diag,
+    const std::string &context = "making file");
 TAG_PARSER_EXPORT void handleFailureAfterFileModified(MediaFileInfo &mediaFileInfo, const std::string &backupPath,
     CppUtilities::NativeFileStream &outputStream, CppUtilities::NativeFileStream &backupStream, Diagnostics &diag,
     const std::string &context = "making file");
+TAG_PARSER_EXPORT void handleFailureAfterFileModified(MediaFileInfo &mediaFileInfo, const std::string &backupPath,
+    CppUtilities::NativeFileStream &outputStream, CppUtilities::NativeFileStream &backupStream, Diagnostics &diag,
+    AbortableProgressFeedback *progress, const std::string &context = "making file");
 
 } // namespace BackupHelper
 
@@ -1,4 +1,5 @@
 #include "./basicfileinfo.h"
+#include "./countingstreambuffer.h"
 
 #include <c++utilities/conversion/stringconversion.h>
 
@@ -23,7 +24,10 @@ namespace TagParser {
 BasicFileInfo::BasicFileInfo(const std::string &path)
     : m_path(path)
     , m_size(0)
+    , m_ioStatistics(nullptr)
     , m_readOnly(false)
+    , m_readCacheEnabled(false)
+    , m_readCacheSuspended(false)
 {
     m_file.exceptions(ios_base::failbit | ios_base::badbit);
 }
@@ -59,7 +63,28 @@ void BasicFileInfo::open(bool readOnly)
 void BasicFileInfo::reopen(bool readOnly)
 {
     invalidated();
+    reopenStream(readOnly);
+}
+
+/*!
+ * \brief Opens the stream() for the current file like reopen() but without invalidating the parsing results.
+ *
+ * Subclasses use this when the file has been replaced by a file they know the structure of, e.g. after applying
+ * changes via a temporary file. The stream buffers for counting I/O operations and caching reads are installed
+ * again and the size() is updated.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void BasicFileInfo::reopenStream(bool readOnly)
+{
+    uninstallStreamBuffers();
+    if (isOpen()) {
+        m_file.close();
+    }
+    m_file.clear();
     m_file.open(pathForOpen(path()), (m_readOnly = readOnly) ? ios_base::in | ios_base::binary : ios_base::in | ios_base::out | ios_base::binary);
+    m_readCacheSuspended = false;
+    installStreamBuffers();
     m_file.seekg(0, ios_base::end);
     m_size = static_cast<std::uint64_t>(m_file.tellg());
     m_file.seekg(0, ios_base::beg);
@@ -70,12 +95,128 @@ void BasicFileInfo::reopen(bool readOnly)
  */
 void BasicFileInfo::close()
 {
+    uninstallStreamBuffers();
     if (isOpen()) {
         m_file.close();
     }
     m_file.clear();
 }
 
+/*!
+ * \brief Sets the IoStatistics the I/O operations on the stream() are counted in.
+ *
+ * Counting takes place while the file is opened via open()/reopen(). Pass nullptr to stop counting which
+ * is the default. When not counting, the stream() is used directly so there is no overhead at all.
+ *
+ * \remarks
+ * - The \a ioStatistics must be valid until counting is stopped or the BasicFileInfo is destroyed.
+ * - Operations on a stream which is opened by other means than open()/reopen() might not be counted.
+ * - If the read cache is enabled, only reads which are not served from the cache are counted.
+ */
+void BasicFileInfo::setIoStatistics(IoStatistics *ioStatistics)
+{
+    m_ioStatistics = ioStatistics;
+    if (isOpen()) {
+        installStreamBuffers();
+    }
+}
+
+/*!
+ * \brief Sets whether reading from the stream() should be cached.
+ *
+ * When enabled, the stream() uses a CachingStreamBuffer configured via setReadCacheSettings() while the file is
+ * opened via open()/reopen(). This reduces the number of reads and seeks on the actual file which is useful
+ * for slow storage (e.g. network file systems and HDDs). The read cache is disabled by default.
+ *
+ * \remarks
+ * - Writes to the stream() are passed through to the file immediately.
+ * - The stream() must not be reopened by other means than open()/reopen() while the read cache is enabled.
+ *   Subclasses which need to do that must call suspendReadCache() before.
+ */
+void BasicFileInfo::setReadCacheEnabled(bool readCacheEnabled)
+{
+    if (m_readCacheEnabled == readCacheEnabled) {
+        return;
+    }
+    m_readCacheEnabled = readCacheEnabled;
+    if (isOpen()) {
+        installStreamBuffers();
+    }
+}
+
+/*!
+ * \brief Sets the configuration of the read cache.
+ * \remarks Discards currently cached data.
+ * \sa setReadCacheEnabled()
+ */
+void BasicFileInfo::setReadCacheSettings(const ReadCacheSettings &readCacheSettings)
+{
+    m_readCacheSettings = readCacheSettings;
+    if (m_cachingStreamBuffer) {
+        installStreamBuffers();
+    }
+}
+
+/*!
+ * \brief Stops using the read cache until the file is reopened via open()/reopen().
+ * \remarks Needs to be called before the stream() is reopened by other means than open()/reopen(), e.g. when
+ *          the file is going to be rewritten.
+ */
+void BasicFileInfo::suspendReadCache()
+{
+    m_readCacheSuspended = true;
+    if (m_cachingStreamBuffer) {
+        installStreamBuffers();
+    }
+}
+
+/*!
+ * \brief Makes the stream() use the stream buffers for counting I/O operations and caching reads as configured.
+ *
+ * The stream buffers are stacked on top of the file buffer: the stream reads from the CachingStreamBuffer which
+ * reads from the CountingStreamBuffer which reads from the file buffer. This way only I/O operations which actually
+ * reach the file are counted.
+ */
+void BasicFileInfo::installStreamBuffers()
+{
+    uninstallStreamBuffers();
+    auto &ios = static_cast<std::ios &>(m_file);
+    auto *buffer = ios.rdbuf();
+    if (m_ioStatistics) {
+        m_countingStreamBuffer = make_unique<CountingStreamBuffer>(buffer, *m_ioStatistics);
+        buffer = m_countingStreamBuffer.get();
+    }
+    if (m_readCacheEnabled && !m_readCacheSuspended) {
+        m_cachingStreamBuffer = make_unique<CachingStreamBuffer>(buffer, m_readCacheSettings, m_readCacheStatistics);
+        buffer = m_cachingStreamBuffer.get();
+    }
+    if (buffer != ios.rdbuf()) {
+        ios.rdbuf(buffer);
+    }
+}
+
+/*!
+ * \brief Makes the stream() use its file buffer directly again.
+ * \remarks The position of the file buffer is updated to the position the stream() had.
+ */
+void BasicFileInfo::uninstallStreamBuffers()
+{
+    auto *const fileBuffer = m_countingStreamBuffer ? m_countingStreamBuffer->underlyingBuffer()
+        : m_cachingStreamBuffer                     ? m_cachingStreamBuffer->underlyingBuffer()
+                                                    : nullptr;
+    if (!fileBuffer) {
+        return;
+    }
+    auto *const topBuffer = m_cachingStreamBuffer ? static_cast<std::streambuf *>(m_cachingStreamBuffer.get()) : m_countingStreamBuffer.get();
+    auto &ios = static_cast<std::ios &>(m_file);
+    if (ios.rdbuf() == topBuffer) {
+        topBuffer->pubsync();
+        ios.rdbuf(fileBuffer);
+    }
+    m_cachingStreamBuffer.reset();
+    m_countingStreamBuffer.reset();
+}
+
 /*!
  * \brief Invalidates the file info manually.
  */
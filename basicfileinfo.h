@@ -1,16 +1,21 @@
 #ifndef TAG_PARSER_BASICFILEINFO_H
 #define TAG_PARSER_BASICFILEINFO_H
 
+#include "./cachingstreambuffer.h"
 #include "./global.h"
 
 #include <c++utilities/conversion/stringconversion.h>
 #include <c++utilities/io/nativefilestream.h>
 
 #include <cstdint>
+#include <memory>
 #include <string>
 
 namespace TagParser {
 
+class CountingStreamBuffer;
+struct IoStatistics;
+
 class TAG_PARSER_EXPORT BasicFileInfo {
 public:
     // constructor, destructor
@@ -28,6 +33,14 @@ public:
     void invalidate();
     CppUtilities::NativeFileStream &stream();
     const CppUtilities::NativeFileStream &stream() const;
+    IoStatistics *ioStatistics() const;
+    void setIoStatistics(IoStatistics *ioStatistics);
+    bool isReadCacheEnabled() const;
+    void setReadCacheEnabled(bool readCacheEnabled);
+    const ReadCacheSettings &readCacheSettings() const;
+    void setReadCacheSettings(const ReadCacheSettings &readCacheSettings);
+    const ReadCacheStatistics &readCacheStatistics() const;
+    void resetReadCacheStatistics();
 
     // methods to get, set path (components)
     const std::string &path() const;
@@ -49,12 +62,24 @@ public:
 
 protected:
     virtual void invalidated();
+    void suspendReadCache();
+    void reopenStream(bool readOnly);
 
 private:
+    void installStreamBuffers();
+    void uninstallStreamBuffers();
+
     std::string m_path;
     CppUtilities::NativeFileStream m_file;
     std::uint64_t m_size;
+    IoStatistics *m_ioStatistics;
+    std::unique_ptr<CountingStreamBuffer> m_countingStreamBuffer;
+    ReadCacheSettings m_readCacheSettings;
+    ReadCacheStatistics m_readCacheStatistics;
+    std::unique_ptr<CachingStreamBuffer> m_cachingStreamBuffer;
     bool m_readOnly;
+    bool m_readCacheEnabled;
+    bool m_readCacheSuspended;
 };
 
 /*!
@@ -91,6 +116,50 @@ inline const CppUtilities::NativeFileStream &BasicFileInfo::stream() const
     return m_file;
 }
 
+/*!
+ * \brief Returns the IoStatistics the I/O operations on the stream() are counted in or nullptr if not counting.
+ * \sa setIoStatistics()
+ */
+inline IoStatistics *BasicFileInfo::ioStatistics() const
+{
+    return m_ioStatistics;
+}
+
+/*!
+ * \brief Returns whether reading from the stream() is cached.
+ * \sa setReadCacheEnabled()
+ */
+inline bool BasicFileInfo::isReadCacheEnabled() const
+{
+    return m_readCacheEnabled;
+}
+
+/*!
+ * \brief Returns the configuration of the read cache.
+ * \sa setReadCacheSettings()
+ */
+inline const ReadCacheSettings &BasicFileInfo::readCacheSettings() const
+{
+    return m_readCacheSettings;
+}
+
+/*!
+ * \brief Returns statistics about the read cache, e.g. to tune the readCacheSettings().
+ * \remarks The statistics are accumulated over all files opened with the read cache enabled until reset.
+ */
+inline const ReadCacheStatistics &BasicFileInfo::readCacheStatistics() const
+{
+    return m_readCacheStatistics;
+}
+
+/*!
+ * \brief Resets the readCacheStatistics().
+ */
+inline void BasicFileInfo::resetReadCacheStatistics()
+{
+    m_readCacheStatistics = ReadCacheStatistics();
+}
+
 /*!
  * \brief Returns the path of the current file.
  *
@@ -0,0 +1,305 @@
+#include "./batchwriter.h"
+#include "./backuphelper.h"
+#include "./diagnostics.h"
+#include "./exceptions.h"
+#include "./mediafileinfo.h"
+#include "./progressfeedback.h"
+
+#include <c++utilities/conversion/stringbuilder.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+using namespace CppUtilities;
+
+namespace TagParser {
+
+/*!
+ * \class TagParser::BatchWriter
+ * \brief The BatchWriter class applies changes to multiple files concurrently as a single transaction.
+ *
+ * The files are supposed to be prepared as for MediaFileInfo::applyChanges() (parsed and modified). When applying
+ * the changes via applyChanges(), it is first determined via MediaFileInfo::planChanges() which files need to be
+ * rewritten and which can be updated in-place. Then the files are written concurrently; the number of files being
+ * rewritten and the number of files being updated in-place at the same time are limited separately (see
+ * setMaxConcurrentRewrites() and setMaxConcurrentInPlaceUpdates()).
+ *
+ * Either the changes are applied to all files or to none of them:
+ * - Files to be rewritten are written to a temporary file (see BackupHelper::createTemporaryFile()). Only when
+ *   all files have been written successfully, the original files are replaced. A hard link to each original file
+ *   is kept until all of them have been replaced.
+ * - Before a file is updated in-place, a backup is created by cloning the file via BackupHelper::createBackupClone().
+ *   This only takes constant time on file systems supporting reflinks. Where cloning is not possible, a full copy
+ *   of the file would take longer than rewriting it so such files are rewritten to a temporary file as well.
+ *
+ * If writing a file fails or the operation is aborted, all files are restored from these backups and the temporary
+ * files are removed. The backups are removed when the changes have been committed or rolled back.
+ *
+ * \remarks
+ * - Each MediaFileInfo must refer to a different file.
+ * - A MediaFileInfo::paddingPolicy() shared by multiple files must be thread-safe (AdaptivePaddingPolicy is).
+ */
+
+/// \cond
+namespace {
+
+/*!
+ * \brief The BatchJob struct holds the state of applying changes to one file.
+ */
+struct BatchJob {
+    explicit BatchJob(MediaFileInfo &file, DiagLevel minimumLevel);
+
+    MediaFileInfo &file;
+    Diagnostics diag;
+    unique_ptr<AbortableProgressFeedback> progress;
+    string originalPath;
+    string temporaryPath;
+    string backupPath;
+    exception_ptr failure;
+    std::uint8_t percentage;
+    bool rewrite;
+    bool committed;
+};
+
+BatchJob::BatchJob(MediaFileInfo &file, DiagLevel minimumLevel)
+    : file(file)
+    , diag(minimumLevel)
+    , originalPath(file.path())
+    , percentage(0)
+    , rewrite(false)
+    , committed(false)
+{
+}
+
+/*!
+ * \brief Writes the file of the specified \a job to a temporary file or updates it in-place after creating a backup.
+ * \remarks Falls back to writing to a temporary file if no backup can be created by cloning the file.
+ */
+void writeFile(BatchJob &job, const string &context)
+{
+    job.progress->stopIfAborted();
+    if (!job.rewrite) {
+        // keep a clone of the original file to be able to roll back the in-place update
+        job.backupPath = BackupHelper::createBackupClone(job.file.backupDirectory(), job.originalPath);
+        if (job.backupPath.empty()) {
+            job.rewrite = true;
+            job.diag.emplace_back(DiagLevel::Information,
+                argsToString("Unable to clone \"", job.originalPath, "\" to be able to roll back updating it in-place; rewriting it instead."),
+                context);
+        }
+    }
+    if (job.rewrite) {
+        // write to a temporary file; the original file is only replaced when committing
+        job.temporaryPath = BackupHelper::createTemporaryFile(job.originalPath);
+        job.file.setSaveFilePath(job.temporaryPath);
+    }
+    job.file.applyChanges(job.diag, *job.progress);
+}
+
+/*!
+ * \brief Restores the original file of the specified \a job.
+ */
+void rollBack(BatchJob &job, Diagnostics &diag, const string &context)
+{
+    job.file.close();
+    job.file.clearParsingResults();
+    try {
+        if (job.rewrite) {
+            if (job.committed) {
+                // the original file has already been replaced -> move the backup back in place
+                CppUtilities::NativeFileStream originalStream, backupStream;
+                BackupHelper::restoreOriginalFileFromBackupFile(job.originalPath, job.backupPath, originalStream, backupStream);
+                job.backupPath.clear();
+            } else if (!job.temporaryPath.empty()) {
+                std::remove(BasicFileInfo::pathForOpen(job.temporaryPath));
+            }
+            job.file.setSaveFilePath(string());
+            job.file.reportPathChanged(job.originalPath);
+        } else if (!job.backupPath.empty()) {
+            // the file might have been modified in-place -> copy the original contents back (keeping the file's attributes)
+            BackupHelper::copyFile(job.backupPath, job.originalPath);
+        }
+    } catch (const std::ios_base::failure &failure) {
+        diag.emplace_back(DiagLevel::Critical,
+            argsToString("Unable to roll back changes of \"", job.originalPath, "\": ", failure.what(), " The original file is kept at \"",
+                job.backupPath, "\"."),
+            context);
+        return;
+    }
+    if (!job.backupPath.empty()) {
+        std::remove(BasicFileInfo::pathForOpen(job.backupPath));
+    }
+}
+
+} // namespace
+/// \endcond
+
+/*!
+ * \brief Constructs a new batch writer for the specified \a files.
+ * \remarks The \a files are not owned by the BatchWriter and must be valid as long as they are assigned.
+ */
+BatchWriter::BatchWriter(const std::vector<MediaFileInfo *> &files)
+    : m_files(files)
+    , m_maxConcurrentRewrites(2)
+    , m_maxConcurrentInPlaceUpdates(8)
+{
+}
+
+/*!
+ * \brief Applies the changes to all files or, if that is not possible, to none of them.
+ *
+ * The progress of all files is aggregated into \a progress. Its callbacks are invoked from the threads writing the
+ * files but never concurrently. Aborting via \a progress aborts writing all files and rolls back the changes.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \throws Throws TagParser::Failure or a derived exception when a making error occurs.
+ *
+ * \remarks
+ * - Tags and tracks of all files need to be parsed without errors before this method can be called.
+ * - The parsing results of files updated in-place are kept as by MediaFileInfo::applyChanges(). The parsing results
+ *   of rewritten files (which are closed when replacing the original file) and of all files on failure are cleared.
+ * - When an exception is thrown, the changes have been rolled back for all files. Files which could not be restored
+ *   are reported as critical diagnostic messages.
+ * - Writing to a MediaFileInfo::saveFilePath() is not supported.
+ */
+void BatchWriter::applyChanges(Diagnostics &diag, AbortableProgressFeedback &progress)
+{
+    static const string context("applying changes to multiple files");
+
+    // determine which files need to be rewritten
+    progress.updateStep("Planning changes ...");
+    auto jobs = vector<unique_ptr<BatchJob>>();
+    auto rewriteJobs = vector<BatchJob *>(), inPlaceJobs = vector<BatchJob *>();
+    jobs.reserve(m_files.size());
+    for (auto *const file : m_files) {
+        if (!file->saveFilePath().empty()) {
+            diag.emplace_back(DiagLevel::Critical,
+                argsToString("Writing \"", file->path(), "\" to a different file is not supported when applying changes to multiple files."), context);
+            throw NotImplementedException();
+        }
+        auto &job = *jobs.emplace_back(make_unique<BatchJob>(*file, diag.minimumLevel()));
+        job.rewrite = file->planChanges(diag, progress).rewriteRequired;
+        (job.rewrite ? rewriteJobs : inPlaceJobs).emplace_back(&job);
+    }
+
+    // define function to aggregate the progress of all files
+    auto mutex = std::mutex();
+    auto failed = atomic_bool(false);
+    auto filesDone = std::size_t();
+    const auto reportProgress = [&](BatchJob &job, AbortableProgressFeedback &jobProgress, bool done) {
+        if (failed || progress.isAborted()) {
+            jobProgress.tryToAbort();
+        }
+        const auto lock = std::lock_guard<std::mutex>(mutex);
+        job.percentage = done ? 100 : jobProgress.stepPercentage();
+        auto percentageSum = std::size_t();
+        for (const auto &otherJob : jobs) {
+            percentageSum += otherJob->percentage;
+        }
+        filesDone += done;
+        progress.updateStep(argsToString("Writing files (", filesDone, " of ", jobs.size(), " done) ..."));
+        progress.updateOverallPercentage(static_cast<std::uint8_t>(percentageSum / jobs.size()));
+    };
+    for (auto &job : jobs) {
+        const auto update = [&reportProgress, &job = *job](AbortableProgressFeedback &jobProgress) { reportProgress(job, jobProgress, false); };
+        job->progress = make_unique<AbortableProgressFeedback>(update, update);
+    }
+
+    // write files concurrently
+    const auto processJobs = [&](const vector<BatchJob *> &jobsToProcess, atomic_size_t &nextJob) {
+        for (auto index = nextJob++; index < jobsToProcess.size(); index = nextJob++) {
+            auto &job = *jobsToProcess[index];
+            if (!failed && !progress.isAborted()) {
+                try {
+                    writeFile(job, context);
+                } catch (...) {
+                    job.failure = current_exception();
+                    failed = true;
+                }
+            }
+            reportProgress(job, *job.progress, true);
+        }
+    };
+    auto nextRewriteJob = atomic_size_t(0), nextInPlaceJob = atomic_size_t(0);
+    auto failure = exception_ptr();
+    auto workers = vector<thread>();
+    try {
+        for (auto i = max<std::size_t>(min(m_maxConcurrentRewrites, rewriteJobs.size()), rewriteJobs.empty() ? 0 : 1); i; --i) {
+            workers.emplace_back(processJobs, cref(rewriteJobs), ref(nextRewriteJob));
+        }
+        for (auto i = max<std::size_t>(min(m_maxConcurrentInPlaceUpdates, inPlaceJobs.size()), inPlaceJobs.empty() ? 0 : 1); i; --i) {
+            workers.emplace_back(processJobs, cref(inPlaceJobs), ref(nextInPlaceJob));
+        }
+    } catch (const std::system_error &) {
+        failure = current_exception();
+        failed = true;
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    for (auto &job : jobs) {
+        // the messages of the job might not all have been added via emplace_back() so filter them by the caller's minimum level
+        copy_if(job->diag.cbegin(), job->diag.cend(), back_inserter(diag),
+            [&diag](const DiagMessage &message) { return diag.isRelevant(message.level()); });
+        if (!failure && job->failure) {
+            failure = job->failure;
+            diag.emplace_back(
+                DiagLevel::Critical, argsToString("Applying changes to \"", job->originalPath, "\" failed; rolling back all changes."), context);
+        }
+    }
+
+    // replace the original files of rewritten files keeping a link to the original file until all have been replaced
+    if (!failure && !progress.isAborted()) {
+        progress.updateStep("Committing changes ...");
+        for (auto &job : jobs) {
+            if (!job->rewrite) {
+                continue;
+            }
+            try {
+                job->file.close();
+                job->backupPath = BackupHelper::createBackupCopy(job->file.backupDirectory(), job->originalPath, true);
+                BackupHelper::replaceOriginalFile(
+                    job->originalPath, job->temporaryPath, job->file.rewriteStrategy() == RewriteStrategy::TemporaryFileWithSync, diag, context);
+                job->committed = true;
+                job->file.reportPathChanged(job->originalPath);
+                job->file.clearParsingResults();
+            } catch (const std::ios_base::failure &ioFailure) {
+                diag.emplace_back(DiagLevel::Critical,
+                    argsToString("Unable to replace \"", job->originalPath, "\" with the rewritten file: ", ioFailure.what(), " Rolling back all changes."),
+                    context);
+                failure = current_exception();
+                break;
+            }
+        }
+    }
+
+    // roll back all changes on failure
+    if (failure || progress.isAborted()) {
+        progress.updateStep("Rolling back changes ...");
+        for (auto &job : jobs) {
+            rollBack(*job, diag, context);
+        }
+        if (failure) {
+            rethrow_exception(failure);
+        }
+        diag.emplace_back(DiagLevel::Information, "Applying changes to multiple files has been aborted.", context);
+        throw OperationAbortedException();
+    }
+
+    // remove backups
+    for (auto &job : jobs) {
+        if (!job->backupPath.empty()) {
+            std::remove(BasicFileInfo::pathForOpen(job->backupPath));
+        }
+    }
+    progress.updateStep("All changes have been applied.", 100);
+}
+
+} // namespace TagParser
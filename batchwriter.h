@@ -0,0 +1,103 @@
+#ifndef TAG_PARSER_BATCHWRITER_H
+#define TAG_PARSER_BATCHWRITER_H
+
+#include "./global.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace TagParser {
+
+class MediaFileInfo;
+class Diagnostics;
+class AbortableProgressFeedback;
+
+class TAG_PARSER_EXPORT BatchWriter {
+public:
+    explicit BatchWriter(const std::vector<MediaFileInfo *> &files = std::vector<MediaFileInfo *>());
+
+    const std::vector<MediaFileInfo *> &files() const;
+    void addFile(MediaFileInfo &file);
+    void clearFiles();
+    std::size_t maxConcurrentRewrites() const;
+    void setMaxConcurrentRewrites(std::size_t maxConcurrentRewrites);
+    std::size_t maxConcurrentInPlaceUpdates() const;
+    void setMaxConcurrentInPlaceUpdates(std::size_t maxConcurrentInPlaceUpdates);
+    void applyChanges(Diagnostics &diag, AbortableProgressFeedback &progress);
+
+private:
+    std::vector<MediaFileInfo *> m_files;
+    std::size_t m_maxConcurrentRewrites;
+    std::size_t m_maxConcurrentInPlaceUpdates;
+};
+
+/*!
+ * \brief Returns the files to apply changes to.
+ */
+inline const std::vector<MediaFileInfo *> &BatchWriter::files() const
+{
+    return m_files;
+}
+
+/*!
+ * \brief Adds the specified \a file to the files to apply changes to.
+ * \remarks The \a file is not owned by the BatchWriter and must be valid as long as it is assigned.
+ */
+inline void BatchWriter::addFile(MediaFileInfo &file)
+{
+    m_files.emplace_back(&file);
+}
+
+/*!
+ * \brief Removes all files.
+ */
+inline void BatchWriter::clearFiles()
+{
+    m_files.clear();
+}
+
+/*!
+ * \brief Returns the max. number of files which are rewritten at the same time.
+ *
+ * Rewriting a file copies all of its data. So only a few files should be rewritten at the same time to
+ * avoid competing for the I/O bandwidth. The default value is 2.
+ */
+inline std::size_t BatchWriter::maxConcurrentRewrites() const
+{
+    return m_maxConcurrentRewrites;
+}
+
+/*!
+ * \brief Sets the max. number of files which are rewritten at the same time.
+ * \remarks A value of 0 is treated as 1.
+ * \sa maxConcurrentRewrites()
+ */
+inline void BatchWriter::setMaxConcurrentRewrites(std::size_t maxConcurrentRewrites)
+{
+    m_maxConcurrentRewrites = maxConcurrentRewrites;
+}
+
+/*!
+ * \brief Returns the max. number of files which are updated in-place at the same time.
+ *
+ * Updating a file in-place only writes a small part of it so the time is mostly spent waiting for the
+ * storage. Hence more files can be updated at the same time. The default value is 8.
+ */
+inline std::size_t BatchWriter::maxConcurrentInPlaceUpdates() const
+{
+    return m_maxConcurrentInPlaceUpdates;
+}
+
+/*!
+ * \brief Sets the max. number of files which are updated in-place at the same time.
+ * \remarks A value of 0 is treated as 1.
+ * \sa maxConcurrentInPlaceUpdates()
+ */
+inline void BatchWriter::setMaxConcurrentInPlaceUpdates(std::size_t maxConcurrentInPlaceUpdates)
+{
+    m_maxConcurrentInPlaceUpdates = maxConcurrentInPlaceUpdates;
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_BATCHWRITER_H
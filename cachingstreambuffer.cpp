@@ -0,0 +1,295 @@
+#include "./cachingstreambuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace TagParser {
+
+/*!
+ * \class TagParser::CachingStreamBuffer
+ * \brief The CachingStreamBuffer class caches reads from another stream buffer in fixed-size blocks.
+ *
+ * The parsers issue many small reads (element/atom/page/frame headers) which are mostly forward but interleaved
+ * with seeks. This buffer serves those reads from a least-recently-used cache of blocks and exposes the current
+ * block as get area so single-character reads do not even require a virtual call. A block is only read from the
+ * underlying buffer on a cache miss. When consecutive blocks are missed, the number of blocks read at once is
+ * doubled (up to ReadCacheSettings::maxReadAhead) to take advantage of sequential access; on random access
+ * only the requested block is read.
+ *
+ * Writes are passed through to the underlying buffer immediately and discard the affected blocks.
+ *
+ * \remarks
+ * - The underlying buffer must not be modified by other means while it is used by this buffer. Call invalidate()
+ *   if this can not be avoided.
+ * - The position of the underlying buffer is only updated on sync().
+ *
+ * \sa BasicFileInfo::setReadCacheEnabled()
+ */
+
+/*!
+ * \brief Constructs a new buffer reading from \a underlyingBuffer according to \a settings and recording \a statistics.
+ * \remarks Starts at the current position of \a underlyingBuffer.
+ */
+CachingStreamBuffer::CachingStreamBuffer(std::streambuf *underlyingBuffer, const ReadCacheSettings &settings, ReadCacheStatistics &statistics)
+    : m_underlyingBuffer(underlyingBuffer)
+    , m_blockSize(max<size_t>(settings.blockSize, 1))
+    , m_capacity(max<size_t>(settings.capacity, 1))
+    , m_maxReadAhead(max<size_t>(min(settings.maxReadAhead, m_capacity / 2), 1))
+    , m_statistics(statistics)
+    , m_position(0)
+    , m_areaOffset(0)
+    , m_useCounter(0)
+    , m_nextSequentialBlock(0)
+    , m_readAhead(1)
+{
+    const auto position = m_underlyingBuffer->pubseekoff(0, ios_base::cur, ios_base::in);
+    if (position != pos_type(off_type(-1))) {
+        m_position = static_cast<std::uint64_t>(static_cast<off_type>(position));
+    }
+    m_blocks.reserve(m_capacity);
+}
+
+/*!
+ * \brief Discards all cached blocks.
+ */
+void CachingStreamBuffer::invalidate()
+{
+    m_position = position();
+    setg(nullptr, nullptr, nullptr);
+    for (auto &block : m_blocks) {
+        block.valid = false;
+    }
+    m_blockIndex.clear();
+}
+
+/*!
+ * \brief Returns the current position.
+ */
+std::uint64_t CachingStreamBuffer::position() const
+{
+    return eback() ? m_areaOffset + static_cast<std::uint64_t>(gptr() - eback()) : m_position;
+}
+
+/*!
+ * \brief Sets the current position to \a position.
+ * \remarks Keeps the get area if \a position is within it.
+ */
+void CachingStreamBuffer::setPosition(std::uint64_t position)
+{
+    if (eback() && position >= m_areaOffset && position < m_areaOffset + static_cast<std::uint64_t>(egptr() - eback())) {
+        setg(eback(), eback() + (position - m_areaOffset), egptr());
+        return;
+    }
+    setg(nullptr, nullptr, nullptr);
+    m_position = position;
+}
+
+/*!
+ * \brief Returns a block for caching new data; evicts the least-recently used block if the capacity is exhausted.
+ */
+CachingStreamBuffer::Block &CachingStreamBuffer::freeBlock()
+{
+    if (m_blocks.size() < m_capacity) {
+        auto &block = m_blocks.emplace_back();
+        block.data = make_unique<char[]>(m_blockSize);
+        return block;
+    }
+    auto &block = *min_element(m_blocks.begin(), m_blocks.end(), [](const Block &lhs, const Block &rhs) {
+        return lhs.valid == rhs.valid ? lhs.lastUsed < rhs.lastUsed : !lhs.valid;
+    });
+    if (block.valid) {
+        m_blockIndex.erase(block.index);
+        block.valid = false;
+        ++m_statistics.blocksEvicted;
+    }
+    return block;
+}
+
+/*!
+ * \brief Returns the block with the specified \a index reading it (and possibly subsequent blocks) if not cached yet.
+ * \returns Returns the block or nullptr if it could not be read.
+ */
+CachingStreamBuffer::Block *CachingStreamBuffer::block(std::uint64_t index)
+{
+    // serve block from cache
+    if (const auto cached = m_blockIndex.find(index); cached != m_blockIndex.end()) {
+        auto &block = m_blocks[cached->second];
+        block.lastUsed = ++m_useCounter;
+        ++m_statistics.hits;
+        return &block;
+    }
+    ++m_statistics.misses;
+
+    // determine the number of blocks to read: increase it when reading sequentially, reset it otherwise
+    m_readAhead = index == m_nextSequentialBlock ? min(m_readAhead * 2, m_maxReadAhead) : 1;
+
+    // read the requested block and the blocks to read ahead
+    const auto offset = static_cast<off_type>(index * m_blockSize);
+    if (m_underlyingBuffer->pubseekpos(pos_type(offset), ios_base::in) != pos_type(offset)) {
+        return nullptr;
+    }
+    Block *requestedBlock = nullptr;
+    for (auto currentIndex = index, endIndex = index + m_readAhead; currentIndex != endIndex; ++currentIndex) {
+        if (currentIndex != index && m_blockIndex.find(currentIndex) != m_blockIndex.end()) {
+            break; // the remaining blocks are already cached
+        }
+        auto &block = freeBlock();
+        block.size = static_cast<size_t>(max<streamsize>(m_underlyingBuffer->sgetn(block.data.get(), static_cast<streamsize>(m_blockSize)), 0));
+        block.index = currentIndex;
+        block.lastUsed = ++m_useCounter;
+        block.valid = true;
+        m_blockIndex[currentIndex] = static_cast<size_t>(&block - m_blocks.data());
+        m_nextSequentialBlock = currentIndex + 1;
+        ++m_statistics.blocksFetched;
+        if (!requestedBlock) {
+            requestedBlock = &block;
+        }
+        if (block.size < m_blockSize) {
+            break; // end of file reached
+        }
+    }
+    return requestedBlock;
+}
+
+/*!
+ * \brief Discards cached blocks overlapping with the specified range as well as incomplete blocks.
+ * \remarks Incomplete blocks are discarded as well because the file might have been extended.
+ */
+void CachingStreamBuffer::invalidate(std::uint64_t offset, std::uint64_t size)
+{
+    const auto firstIndex = offset / m_blockSize, lastIndex = (offset + size) / m_blockSize;
+    for (auto &block : m_blocks) {
+        if (block.valid && ((block.index >= firstIndex && block.index <= lastIndex) || block.size < m_blockSize)) {
+            m_blockIndex.erase(block.index);
+            block.valid = false;
+            ++m_statistics.blocksInvalidated;
+        }
+    }
+}
+
+CachingStreamBuffer::int_type CachingStreamBuffer::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    const auto currentPosition = position();
+    const auto index = currentPosition / m_blockSize;
+    const auto offsetInBlock = static_cast<size_t>(currentPosition % m_blockSize);
+    const auto *const block = this->block(index);
+    if (!block || offsetInBlock >= block->size) {
+        setg(nullptr, nullptr, nullptr);
+        m_position = currentPosition;
+        return traits_type::eof();
+    }
+    m_areaOffset = index * m_blockSize;
+    setg(block->data.get(), block->data.get() + offsetInBlock, block->data.get() + block->size);
+    return traits_type::to_int_type(*gptr());
+}
+
+streamsize CachingStreamBuffer::xsgetn(char_type *buffer, streamsize count)
+{
+    auto bytesRead = streamsize(0);
+    while (bytesRead < count) {
+        if (gptr() == egptr() && traits_type::eq_int_type(underflow(), traits_type::eof())) {
+            break;
+        }
+        const auto chunkSize = min<streamsize>(count - bytesRead, egptr() - gptr());
+        memcpy(buffer + bytesRead, gptr(), static_cast<size_t>(chunkSize));
+        setg(eback(), gptr() + chunkSize, egptr());
+        bytesRead += chunkSize;
+    }
+    return bytesRead;
+}
+
+streamsize CachingStreamBuffer::showmanyc()
+{
+    return 0;
+}
+
+CachingStreamBuffer::int_type CachingStreamBuffer::pbackfail(int_type c)
+{
+    const auto currentPosition = position();
+    if (!currentPosition) {
+        return traits_type::eof();
+    }
+    setPosition(currentPosition - 1);
+    if (traits_type::eq_int_type(underflow(), traits_type::eof())
+        || (!traits_type::eq_int_type(c, traits_type::eof()) && !traits_type::eq(traits_type::to_char_type(c), *gptr()))) {
+        // putting back a different character is not supported (the file is not supposed to be modified this way)
+        setPosition(currentPosition);
+        return traits_type::eof();
+    }
+    return traits_type::to_int_type(*gptr());
+}
+
+CachingStreamBuffer::int_type CachingStreamBuffer::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    const auto character = traits_type::to_char_type(c);
+    return xsputn(&character, 1) == 1 ? c : traits_type::eof();
+}
+
+streamsize CachingStreamBuffer::xsputn(const char_type *buffer, streamsize count)
+{
+    const auto currentPosition = position();
+    const auto offset = static_cast<off_type>(currentPosition);
+    if (m_underlyingBuffer->pubseekpos(pos_type(offset), ios_base::out) != pos_type(offset)) {
+        return 0;
+    }
+    const auto bytesWritten = max<streamsize>(m_underlyingBuffer->sputn(buffer, count), 0);
+    invalidate(currentPosition, static_cast<std::uint64_t>(bytesWritten));
+    setg(nullptr, nullptr, nullptr);
+    m_position = currentPosition + static_cast<std::uint64_t>(bytesWritten);
+    return bytesWritten;
+}
+
+CachingStreamBuffer::pos_type CachingStreamBuffer::seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which)
+{
+    auto target = off_type();
+    switch (dir) {
+    case ios_base::beg:
+        target = off;
+        break;
+    case ios_base::cur:
+        target = static_cast<off_type>(position()) + off;
+        break;
+    case ios_base::end: {
+        const auto end = m_underlyingBuffer->pubseekoff(off, ios_base::end, which);
+        if (end == pos_type(off_type(-1))) {
+            return end;
+        }
+        target = static_cast<off_type>(end);
+        break;
+    }
+    default:
+        return pos_type(off_type(-1));
+    }
+    if (target < 0) {
+        return pos_type(off_type(-1));
+    }
+    setPosition(static_cast<std::uint64_t>(target));
+    return pos_type(target);
+}
+
+CachingStreamBuffer::pos_type CachingStreamBuffer::seekpos(pos_type pos, ios_base::openmode which)
+{
+    return seekoff(static_cast<off_type>(pos), ios_base::beg, which);
+}
+
+/*!
+ * \brief Sets the position of the underlying buffer to the current position and syncs the underlying buffer.
+ */
+int CachingStreamBuffer::sync()
+{
+    const auto offset = static_cast<off_type>(position());
+    if (m_underlyingBuffer->pubseekpos(pos_type(offset)) != pos_type(offset)) {
+        return -1;
+    }
+    return m_underlyingBuffer->pubsync();
+}
+
+} // namespace TagParser
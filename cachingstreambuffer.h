@@ -0,0 +1,93 @@
+#ifndef TAG_PARSER_CACHINGSTREAMBUFFER_H
+#define TAG_PARSER_CACHINGSTREAMBUFFER_H
+
+#include "./global.h"
+
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+#include <unordered_map>
+#include <vector>
+
+namespace TagParser {
+
+/*!
+ * \brief The ReadCacheSettings struct specifies the configuration of a CachingStreamBuffer.
+ * \sa BasicFileInfo::setReadCacheSettings()
+ */
+struct TAG_PARSER_EXPORT ReadCacheSettings {
+    std::size_t blockSize = 0x10000; /**< the size of a single cached block in bytes */
+    std::size_t capacity = 64; /**< the max. number of blocks to be cached (least-recently used blocks are evicted first) */
+    std::size_t maxReadAhead = 16; /**< the max. number of blocks to fetch at once when reading sequentially */
+};
+
+/*!
+ * \brief The ReadCacheStatistics struct holds counters to evaluate the effectiveness of a CachingStreamBuffer.
+ * \sa BasicFileInfo::readCacheStatistics()
+ */
+struct TAG_PARSER_EXPORT ReadCacheStatistics {
+    std::uint64_t hits = 0; /**< the number of block lookups which could be served from the cache */
+    std::uint64_t misses = 0; /**< the number of block lookups which required reading from the underlying buffer */
+    std::uint64_t blocksFetched = 0; /**< the number of blocks read from the underlying buffer (including read-ahead) */
+    std::uint64_t blocksEvicted = 0; /**< the number of cached blocks which have been discarded to make room for other blocks */
+    std::uint64_t blocksInvalidated = 0; /**< the number of cached blocks which have been discarded because they have been written to */
+};
+
+class TAG_PARSER_EXPORT CachingStreamBuffer : public std::streambuf {
+public:
+    explicit CachingStreamBuffer(std::streambuf *underlyingBuffer, const ReadCacheSettings &settings, ReadCacheStatistics &statistics);
+
+    std::streambuf *underlyingBuffer() const;
+    void invalidate();
+
+protected:
+    int_type underflow() override;
+    std::streamsize xsgetn(char_type *buffer, std::streamsize count) override;
+    std::streamsize showmanyc() override;
+    int_type pbackfail(int_type c) override;
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char_type *buffer, std::streamsize count) override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+    int sync() override;
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        std::uint64_t index = 0;
+        std::uint64_t lastUsed = 0;
+        std::size_t size = 0;
+        bool valid = false;
+    };
+
+    std::uint64_t position() const;
+    void setPosition(std::uint64_t position);
+    Block *block(std::uint64_t index);
+    Block &freeBlock();
+    void invalidate(std::uint64_t offset, std::uint64_t size);
+
+    std::streambuf *const m_underlyingBuffer;
+    const std::size_t m_blockSize;
+    const std::size_t m_capacity;
+    const std::size_t m_maxReadAhead;
+    ReadCacheStatistics &m_statistics;
+    std::vector<Block> m_blocks;
+    std::unordered_map<std::uint64_t, std::size_t> m_blockIndex;
+    std::uint64_t m_position;
+    std::uint64_t m_areaOffset;
+    std::uint64_t m_useCounter;
+    std::uint64_t m_nextSequentialBlock;
+    std::size_t m_readAhead;
+};
+
+/*!
+ * \brief Returns the buffer the data is read from and written to.
+ */
+inline std::streambuf *CachingStreamBuffer::underlyingBuffer() const
+{
+    return m_underlyingBuffer;
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_CACHINGSTREAMBUFFER_H
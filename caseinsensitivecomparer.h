@@ -3,6 +3,7 @@
 
 #include "./global.h"
 
+#include <algorithm>
 #include <string>
 
 #include <iostream>
@@ -34,6 +35,35 @@ struct TAG_PARSER_EXPORT CaseInsensitiveStringComparer {
     }
 };
 
+/*!
+ * \brief The CaseInsensitiveStringNormalizer struct defines a method to normalize strings for case-insensitive lookups.
+ * \remarks
+ * - Ordering normalized strings via std::less leads to the same order as using CaseInsensitiveStringComparer.
+ * - compare() compares a normalized string with a string which is not normalized without allocating a normalized copy.
+ */
+struct TAG_PARSER_EXPORT CaseInsensitiveStringNormalizer {
+    static std::string normalize(const std::string &str)
+    {
+        auto normalized = std::string(str);
+        for (auto &c : normalized) {
+            c = static_cast<char>(CaseInsensitiveCharComparer::toLower(static_cast<unsigned char>(c)));
+        }
+        return normalized;
+    }
+    static int compare(const std::string &normalizedStr, const std::string &str)
+    {
+        const auto size = std::min(normalizedStr.size(), str.size());
+        for (std::string::size_type i = 0; i != size; ++i) {
+            const auto lhs = static_cast<unsigned char>(normalizedStr[i]);
+            const auto rhs = CaseInsensitiveCharComparer::toLower(static_cast<unsigned char>(str[i]));
+            if (lhs != rhs) {
+                return lhs < rhs ? -1 : 1;
+            }
+        }
+        return normalizedStr.size() < str.size() ? -1 : (normalizedStr.size() > str.size() ? 1 : 0);
+    }
+};
+
 } // namespace TagParser
 
 #endif // TAG_PARSER_CASEINSENSITIVECOMPARER
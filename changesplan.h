@@ -0,0 +1,30 @@
+#ifndef TAG_PARSER_CHANGESPLAN_H
+#define TAG_PARSER_CHANGESPLAN_H
+
+#include "./settings.h"
+
+#include <cstdint>
+
+namespace TagParser {
+
+/*!
+ * \brief The ChangesPlan struct holds the outcome of MediaFileInfo::planChanges().
+ *
+ * It describes what MediaFileInfo::applyChanges() would do with the current settings and tag/track information
+ * without actually modifying the file. After applying the changes, it describes the layout of the new file (see
+ * AbstractContainer::appliedChanges()).
+ *
+ * \remarks The number of bytes to be written is an estimation. It does not account for voiding obsolete elements
+ *          and is less precise for formats where the size of the new structures is only known when writing (Ogg).
+ */
+struct TAG_PARSER_EXPORT ChangesPlan {
+    bool rewriteRequired = false; /**< whether the file would be rewritten entirely (rather than being modified in-place) */
+    std::uint64_t newPadding = 0; /**< the padding (in bytes) the new file would have before the media data */
+    ElementPosition tagPosition = ElementPosition::Keep; /**< the position the tags would be placed at (Keep if not applicable) */
+    ElementPosition indexPosition = ElementPosition::Keep; /**< the position the index would be placed at (Keep if not applicable) */
+    std::uint64_t bytesToWrite = 0; /**< the number of bytes which would be written */
+};
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_CHANGESPLAN_H
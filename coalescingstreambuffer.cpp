@@ -0,0 +1,255 @@
+#include "./coalescingstreambuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace TagParser {
+
+/*!
+ * \class TagParser::CoalescingStreamBuffer
+ * \brief The CoalescingStreamBuffer class stages writes to another stream buffer in a large buffer.
+ *
+ * The makers write elements piece by piece: an ID, a size denotation, then the payload, often only a few bytes
+ * each. This buffer collects those writes so they reach the underlying buffer (and eventually the file) as a few
+ * large writes. Staged data is passed to the underlying buffer when the buffer is full, before reading, before
+ * seeking and on sync(). Writes which are bigger than the buffer itself are passed through directly.
+ *
+ * Querying the current position does not pass staged data to the underlying buffer so tellp() can be used freely
+ * to determine offsets while writing.
+ *
+ * When updating a file in-place, the buffer can compare staged data with the data already present and skip writing
+ * it (see setSkipUnchangedData()). So applying unchanged tags leaves the file untouched.
+ *
+ * \remarks
+ * - The underlying buffer must not be used directly while data is staged. Use CoalescingWriteScope to install
+ *   the buffer on a stream temporarily.
+ * - Staged data is not written on destruction; call pubsync() before.
+ */
+
+/*!
+ * \brief Constructs a new buffer writing to \a underlyingBuffer staging up to \a bufferSize bytes.
+ */
+CoalescingStreamBuffer::CoalescingStreamBuffer(std::streambuf *underlyingBuffer, std::size_t bufferSize)
+    : m_underlyingBuffer(underlyingBuffer)
+    , m_bufferSize(max<std::size_t>(bufferSize, 1))
+    , m_buffer(make_unique<char[]>(m_bufferSize))
+    , m_bytesWritten(0)
+    , m_bytesSkipped(0)
+    , m_skipUnchangedData(false)
+{
+    setp(m_buffer.get(), m_buffer.get() + m_bufferSize);
+}
+
+/*!
+ * \brief Passes the staged data to the underlying buffer.
+ * \returns Returns whether all staged data could be passed.
+ */
+bool CoalescingStreamBuffer::flushBuffer()
+{
+    const auto stagedBytes = static_cast<streamsize>(pptr() - pbase());
+    if (!stagedBytes) {
+        return true;
+    }
+    const auto bytesWritten = passToUnderlyingBuffer(pbase(), stagedBytes);
+    setp(m_buffer.get(), m_buffer.get() + m_bufferSize);
+    return bytesWritten == stagedBytes;
+}
+
+/*!
+ * \brief Writes \a count bytes from \a buffer to the underlying buffer skipping data which is already present if enabled.
+ * \returns Returns the number of bytes written or skipped.
+ */
+streamsize CoalescingStreamBuffer::passToUnderlyingBuffer(const char_type *buffer, streamsize count)
+{
+    const auto bytesSkipped = m_skipUnchangedData ? skipUnchangedData(buffer, count) : streamsize();
+    if (bytesSkipped == count) {
+        return count;
+    }
+    const auto bytesWritten = m_underlyingBuffer->sputn(buffer + bytesSkipped, count - bytesSkipped);
+    m_bytesWritten += static_cast<std::uint64_t>(bytesWritten);
+    return bytesSkipped + bytesWritten;
+}
+
+/*!
+ * \brief Compares the data at the current position of the underlying buffer with \a count bytes from \a buffer.
+ * \returns Returns the number of leading bytes which are already present; the position is advanced accordingly.
+ */
+streamsize CoalescingStreamBuffer::skipUnchangedData(const char_type *buffer, streamsize count)
+{
+    const auto failed = pos_type(off_type(-1));
+    const auto position = m_underlyingBuffer->pubseekoff(0, ios_base::cur, ios_base::out);
+    if (position == failed || m_underlyingBuffer->pubseekpos(position, ios_base::in) == failed) {
+        return 0;
+    }
+    if (!m_existingData) {
+        m_existingData = make_unique<char[]>(m_bufferSize);
+    }
+    auto bytesSkipped = streamsize();
+    while (bytesSkipped < count) {
+        const auto bytesRead = m_underlyingBuffer->sgetn(m_existingData.get(), min(count - bytesSkipped, static_cast<streamsize>(m_bufferSize)));
+        const auto *const data = buffer + bytesSkipped;
+        const auto bytesEqual = mismatch(data, data + bytesRead, m_existingData.get()).first - data;
+        bytesSkipped += bytesEqual;
+        if (!bytesRead || bytesEqual != bytesRead) {
+            break;
+        }
+    }
+    m_bytesSkipped += static_cast<std::uint64_t>(bytesSkipped);
+    // continue writing after the skipped data (reading and writing must be separated by seeking anyways)
+    return m_underlyingBuffer->pubseekpos(position + static_cast<off_type>(bytesSkipped), ios_base::in | ios_base::out) == failed ? 0 : bytesSkipped;
+}
+
+CoalescingStreamBuffer::int_type CoalescingStreamBuffer::underflow()
+{
+    return flushBuffer() ? m_underlyingBuffer->sgetc() : traits_type::eof();
+}
+
+CoalescingStreamBuffer::int_type CoalescingStreamBuffer::uflow()
+{
+    return flushBuffer() ? m_underlyingBuffer->sbumpc() : traits_type::eof();
+}
+
+streamsize CoalescingStreamBuffer::xsgetn(char_type *buffer, streamsize count)
+{
+    return flushBuffer() ? m_underlyingBuffer->sgetn(buffer, count) : 0;
+}
+
+streamsize CoalescingStreamBuffer::showmanyc()
+{
+    return flushBuffer() ? m_underlyingBuffer->in_avail() : -1;
+}
+
+CoalescingStreamBuffer::int_type CoalescingStreamBuffer::pbackfail(int_type c)
+{
+    if (!flushBuffer()) {
+        return traits_type::eof();
+    }
+    return traits_type::eq_int_type(c, traits_type::eof()) ? m_underlyingBuffer->sungetc()
+                                                           : m_underlyingBuffer->sputbackc(traits_type::to_char_type(c));
+}
+
+CoalescingStreamBuffer::int_type CoalescingStreamBuffer::overflow(int_type c)
+{
+    if (!flushBuffer()) {
+        return traits_type::eof();
+    }
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+}
+
+streamsize CoalescingStreamBuffer::xsputn(const char_type *buffer, streamsize count)
+{
+    // stage the data if it fits into the buffer
+    if (count <= epptr() - pptr()) {
+        memcpy(pptr(), buffer, static_cast<size_t>(count));
+        pbump(static_cast<int>(count));
+        return count;
+    }
+    if (!flushBuffer()) {
+        return 0;
+    }
+    if (static_cast<size_t>(count) < m_bufferSize) {
+        memcpy(pptr(), buffer, static_cast<size_t>(count));
+        pbump(static_cast<int>(count));
+        return count;
+    }
+    // pass big chunks through directly
+    return passToUnderlyingBuffer(buffer, count);
+}
+
+CoalescingStreamBuffer::pos_type CoalescingStreamBuffer::seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which)
+{
+    // determine the current position without passing staged data (tellp()/tellg())
+    if (!off && dir == ios_base::cur) {
+        const auto position = m_underlyingBuffer->pubseekoff(0, ios_base::cur, which);
+        return position == pos_type(off_type(-1)) ? position : position + static_cast<off_type>(pptr() - pbase());
+    }
+    return flushBuffer() ? m_underlyingBuffer->pubseekoff(off, dir, which) : pos_type(off_type(-1));
+}
+
+CoalescingStreamBuffer::pos_type CoalescingStreamBuffer::seekpos(pos_type pos, ios_base::openmode which)
+{
+    return flushBuffer() ? m_underlyingBuffer->pubseekpos(pos, which) : pos_type(off_type(-1));
+}
+
+int CoalescingStreamBuffer::sync()
+{
+    return flushBuffer() ? m_underlyingBuffer->pubsync() : -1;
+}
+
+/*!
+ * \class TagParser::CoalescingWriteScope
+ * \brief The CoalescingWriteScope class makes a stream write via a CoalescingStreamBuffer while it is alive.
+ *
+ * The makers use this class around the part writing the new file. The staged data is written on flush() and
+ * finish() which are supposed to be called at the points where errors should be detected. The destructor writes
+ * remaining data as well but can not report errors (besides setting the badbit of the stream).
+ *
+ * \remarks The stream must not be closed or reopened while the scope is active.
+ */
+
+/*!
+ * \brief Makes \a stream write via a CoalescingStreamBuffer with the specified \a bufferSize.
+ */
+CoalescingWriteScope::CoalescingWriteScope(std::ios &stream, std::size_t bufferSize)
+    : m_stream(stream)
+    , m_buffer(stream.rdbuf(), bufferSize)
+    , m_installed(true)
+{
+    const auto state = m_stream.rdstate();
+    m_stream.rdbuf(&m_buffer);
+    m_stream.clear(state);
+}
+
+/*!
+ * \brief Writes remaining data and makes the stream use its previous buffer again if not done yet via finish().
+ */
+CoalescingWriteScope::~CoalescingWriteScope()
+{
+    if (!m_installed) {
+        return;
+    }
+    const auto synced = m_buffer.pubsync() == 0;
+    const auto state = m_stream.rdstate();
+    m_stream.rdbuf(m_buffer.underlyingBuffer());
+    try {
+        m_stream.setstate(synced ? state : (state | ios_base::badbit));
+    } catch (const std::ios_base::failure &) {
+        // the state is set anyways; don't throw from the destructor
+    }
+}
+
+/*!
+ * \brief Writes the staged data.
+ * \throws Throws std::ios_base::failure if writing fails and the stream is configured to throw exceptions.
+ */
+void CoalescingWriteScope::flush()
+{
+    if (m_installed && m_buffer.pubsync()) {
+        m_stream.setstate(ios_base::badbit);
+    }
+}
+
+/*!
+ * \brief Writes the staged data and makes the stream use its previous buffer again.
+ * \throws Throws std::ios_base::failure if writing fails and the stream is configured to throw exceptions.
+ */
+void CoalescingWriteScope::finish()
+{
+    if (!m_installed) {
+        return;
+    }
+    const auto synced = m_buffer.pubsync() == 0;
+    const auto state = m_stream.rdstate();
+    m_installed = false;
+    m_stream.rdbuf(m_buffer.underlyingBuffer());
+    m_stream.clear(synced ? state : (state | ios_base::badbit));
+}
+
+} // namespace TagParser
@@ -0,0 +1,144 @@
+#ifndef TAG_PARSER_COALESCINGSTREAMBUFFER_H
+#define TAG_PARSER_COALESCINGSTREAMBUFFER_H
+
+#include "./global.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <memory>
+#include <streambuf>
+
+namespace TagParser {
+
+class TAG_PARSER_EXPORT CoalescingStreamBuffer : public std::streambuf {
+public:
+    static constexpr std::size_t defaultBufferSize = 0x100000;
+
+    explicit CoalescingStreamBuffer(std::streambuf *underlyingBuffer, std::size_t bufferSize = defaultBufferSize);
+
+    std::streambuf *underlyingBuffer() const;
+    std::size_t bufferSize() const;
+    bool skipsUnchangedData() const;
+    void setSkipUnchangedData(bool skipUnchangedData);
+    std::uint64_t bytesWritten() const;
+    std::uint64_t bytesSkipped() const;
+
+protected:
+    int_type underflow() override;
+    int_type uflow() override;
+    std::streamsize xsgetn(char_type *buffer, std::streamsize count) override;
+    std::streamsize showmanyc() override;
+    int_type pbackfail(int_type c) override;
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char_type *buffer, std::streamsize count) override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+    int sync() override;
+
+private:
+    bool flushBuffer();
+    std::streamsize passToUnderlyingBuffer(const char_type *buffer, std::streamsize count);
+    std::streamsize skipUnchangedData(const char_type *buffer, std::streamsize count);
+
+    std::streambuf *const m_underlyingBuffer;
+    const std::size_t m_bufferSize;
+    std::unique_ptr<char[]> m_buffer;
+    std::unique_ptr<char[]> m_existingData;
+    std::uint64_t m_bytesWritten;
+    std::uint64_t m_bytesSkipped;
+    bool m_skipUnchangedData;
+};
+
+/*!
+ * \brief Returns the buffer the data is eventually written to.
+ */
+inline std::streambuf *CoalescingStreamBuffer::underlyingBuffer() const
+{
+    return m_underlyingBuffer;
+}
+
+/*!
+ * \brief Returns the max. number of bytes which are staged before they are passed to the underlying buffer.
+ */
+inline std::size_t CoalescingStreamBuffer::bufferSize() const
+{
+    return m_bufferSize;
+}
+
+/*!
+ * \brief Returns whether data which is already present in the underlying buffer is skipped instead of written again.
+ * \sa setSkipUnchangedData()
+ */
+inline bool CoalescingStreamBuffer::skipsUnchangedData() const
+{
+    return m_skipUnchangedData;
+}
+
+/*!
+ * \brief Sets whether data which is already present in the underlying buffer is skipped instead of written again.
+ *
+ * When enabled, the data at the current position of the underlying buffer is read before passing staged data and only
+ * the data from the first differing byte on is written. This way updating a file in-place with identical data does not
+ * write anything. The underlying buffer must be opened for reading and writing in that case.
+ */
+inline void CoalescingStreamBuffer::setSkipUnchangedData(bool skipUnchangedData)
+{
+    m_skipUnchangedData = skipUnchangedData;
+}
+
+/*!
+ * \brief Returns the number of bytes which have been passed to the underlying buffer so far.
+ */
+inline std::uint64_t CoalescingStreamBuffer::bytesWritten() const
+{
+    return m_bytesWritten;
+}
+
+/*!
+ * \brief Returns the number of bytes which have not been written because they were already present.
+ * \sa setSkipUnchangedData()
+ */
+inline std::uint64_t CoalescingStreamBuffer::bytesSkipped() const
+{
+    return m_bytesSkipped;
+}
+
+class TAG_PARSER_EXPORT CoalescingWriteScope {
+public:
+    explicit CoalescingWriteScope(std::ios &stream, std::size_t bufferSize = CoalescingStreamBuffer::defaultBufferSize);
+    CoalescingWriteScope(const CoalescingWriteScope &) = delete;
+    CoalescingWriteScope &operator=(const CoalescingWriteScope &) = delete;
+    ~CoalescingWriteScope();
+
+    void flush();
+    void finish();
+    void setSkipUnchangedData(bool skipUnchangedData);
+    std::uint64_t bytesWritten() const;
+
+private:
+    std::ios &m_stream;
+    CoalescingStreamBuffer m_buffer;
+    bool m_installed;
+};
+
+/*!
+ * \brief Sets whether data which is already present in the stream is skipped instead of written again.
+ * \sa CoalescingStreamBuffer::setSkipUnchangedData()
+ */
+inline void CoalescingWriteScope::setSkipUnchangedData(bool skipUnchangedData)
+{
+    m_buffer.setSkipUnchangedData(skipUnchangedData);
+}
+
+/*!
+ * \brief Returns the number of bytes which have actually been written to the stream within the scope so far.
+ */
+inline std::uint64_t CoalescingWriteScope::bytesWritten() const
+{
+    return m_buffer.bytesWritten();
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_COALESCINGSTREAMBUFFER_H
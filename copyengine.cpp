@@ -0,0 +1,590 @@
+#include "./copyengine.h"
+#include "./basicfileinfo.h"
+#include "./progressfeedback.h"
+
+#include <c++utilities/conversion/stringbuilder.h>
+#include <c++utilities/io/nativefilestream.h>
+
+#ifdef TAG_PARSER_HAVE_IO_URING
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ios>
+#include <ostream>
+
+using namespace std;
+using namespace CppUtilities;
+
+namespace TagParser {
+
+/*!
+ * \class TagParser::CopyEngine
+ * \brief The CopyEngine class copies ranges of one file to another file asynchronously.
+ *
+ * Rewriting a file mostly means copying the media data from the original file. Copying it via the streams the
+ * makers write to alternates between reading and writing on one thread. Instead, the makers can submit the ranges
+ * to be copied (source offset, length and target offset) to this engine and continue writing while the data is
+ * copied in the background. Before the written file is read again, finish() must be called.
+ *
+ * Ranges which are adjacent in both files (e.g. the blocks of a Matroska cluster or the pages of an Ogg file) are
+ * merged when submitted so the data is copied in big chunks. The chunks are copied by worker threads:
+ * - On Linux, a single worker thread keeps up to queueDepth reads and writes in flight via io_uring. The buffers
+ *   are registered so the kernel does not need to map them for each operation.
+ * - Otherwise, two worker threads read and write chunks via regular streams.
+ *
+ * \remarks
+ * - The target regions must not be written via other streams. The makers skip them via submit(std::ostream &, ...).
+ * - Errors are reported by finish() which throws std::ios_base::failure in that case.
+ */
+
+#ifdef TAG_PARSER_HAVE_IO_URING
+/*!
+ * \brief The IoUring struct holds the rings and registered buffers used by the io_uring backend.
+ */
+struct CopyEngine::IoUring {
+    explicit IoUring(std::size_t entries);
+    ~IoUring();
+
+    io_uring_sqe &nextSubmissionQueueEntry();
+    int submitAndWait(unsigned int submissions, unsigned int completions);
+
+    int fd;
+    void *submissionRing;
+    void *completionRing;
+    io_uring_sqe *submissionQueueEntries;
+    std::size_t submissionRingSize;
+    std::size_t completionRingSize;
+    std::size_t submissionQueueEntriesSize;
+    unsigned int *submissionHead;
+    unsigned int *submissionTail;
+    unsigned int *submissionMask;
+    unsigned int *submissionArray;
+    unsigned int *completionHead;
+    unsigned int *completionTail;
+    unsigned int *completionMask;
+    io_uring_cqe *completionQueueEntries;
+    std::unique_ptr<char[]> buffers;
+    bool buffersRegistered;
+};
+
+/*!
+ * \brief Sets up a ring with the specified number of \a entries and registers a buffer for each entry.
+ * \remarks Check fd to determine whether the setup was successful.
+ */
+CopyEngine::IoUring::IoUring(std::size_t entries)
+    : fd(-1)
+    , submissionRing(MAP_FAILED)
+    , completionRing(MAP_FAILED)
+    , submissionQueueEntries(static_cast<io_uring_sqe *>(MAP_FAILED))
+    , submissionRingSize(0)
+    , completionRingSize(0)
+    , submissionQueueEntriesSize(0)
+    , buffersRegistered(false)
+{
+    auto params = io_uring_params();
+    const auto ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, static_cast<unsigned int>(entries), &params));
+    if (ringFd < 0) {
+        return;
+    }
+    fd = ringFd;
+
+    // map submission and completion ring (which might be done with a single mapping) and submission queue entries
+    submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        submissionRingSize = completionRingSize = max(submissionRingSize, completionRingSize);
+    }
+    submissionRing = ::mmap(nullptr, submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (submissionRing == MAP_FAILED) {
+        return;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        completionRing = submissionRing;
+    } else {
+        completionRing = ::mmap(nullptr, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (completionRing == MAP_FAILED) {
+            return;
+        }
+    }
+    submissionQueueEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+    submissionQueueEntries = static_cast<io_uring_sqe *>(
+        ::mmap(nullptr, submissionQueueEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (submissionQueueEntries == MAP_FAILED) {
+        return;
+    }
+    auto *const submissionBase = static_cast<char *>(submissionRing);
+    auto *const completionBase = static_cast<char *>(completionRing);
+    submissionHead = reinterpret_cast<unsigned int *>(submissionBase + params.sq_off.head);
+    submissionTail = reinterpret_cast<unsigned int *>(submissionBase + params.sq_off.tail);
+    submissionMask = reinterpret_cast<unsigned int *>(submissionBase + params.sq_off.ring_mask);
+    submissionArray = reinterpret_cast<unsigned int *>(submissionBase + params.sq_off.array);
+    completionHead = reinterpret_cast<unsigned int *>(completionBase + params.cq_off.head);
+    completionTail = reinterpret_cast<unsigned int *>(completionBase + params.cq_off.tail);
+    completionMask = reinterpret_cast<unsigned int *>(completionBase + params.cq_off.ring_mask);
+    completionQueueEntries = reinterpret_cast<io_uring_cqe *>(completionBase + params.cq_off.cqes);
+
+    // register the buffers; reading and writing without registered buffers works as well (e.g. when exceeding the limit of locked memory)
+    buffers = make_unique<char[]>(entries * bufferSize);
+    auto bufferVectors = vector<iovec>(entries);
+    for (auto i = std::size_t(); i != entries; ++i) {
+        bufferVectors[i].iov_base = buffers.get() + i * bufferSize;
+        bufferVectors[i].iov_len = bufferSize;
+    }
+    buffersRegistered
+        = !::syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, bufferVectors.data(), static_cast<unsigned int>(bufferVectors.size()));
+    return;
+}
+
+/*!
+ * \brief Unmaps the rings and closes the ring file descriptor (which unregisters the buffers as well).
+ */
+CopyEngine::IoUring::~IoUring()
+{
+    if (submissionQueueEntries != MAP_FAILED) {
+        ::munmap(submissionQueueEntries, submissionQueueEntriesSize);
+    }
+    if (completionRing != MAP_FAILED && completionRing != submissionRing) {
+        ::munmap(completionRing, completionRingSize);
+    }
+    if (submissionRing != MAP_FAILED) {
+        ::munmap(submissionRing, submissionRingSize);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+/*!
+ * \brief Returns the next submission queue entry and adds it to the submission queue.
+ * \remarks The entry is only passed to the kernel via submitAndWait(). The caller must ensure not to exceed the queue depth.
+ */
+io_uring_sqe &CopyEngine::IoUring::nextSubmissionQueueEntry()
+{
+    const auto tail = *submissionTail;
+    const auto index = tail & *submissionMask;
+    auto &entry = submissionQueueEntries[index];
+    std::memset(&entry, 0, sizeof(entry));
+    submissionArray[index] = index;
+    __atomic_store_n(submissionTail, tail + 1, __ATOMIC_RELEASE);
+    return entry;
+}
+
+/*!
+ * \brief Passes \a submissions entries to the kernel and waits for at least the specified number of \a completions.
+ * \returns Returns 0 on success and the error number otherwise.
+ */
+int CopyEngine::IoUring::submitAndWait(unsigned int submissions, unsigned int completions)
+{
+    for (;;) {
+        const auto res = ::syscall(__NR_io_uring_enter, fd, submissions, completions, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (res >= 0) {
+            return 0;
+        }
+        if (errno != EINTR) {
+            return errno;
+        }
+    }
+}
+#else
+/// \cond
+struct CopyEngine::IoUring {};
+/// \endcond
+#endif
+
+/*!
+ * \brief Constructs a new engine copying from the file at \a sourcePath to the file at \a targetPath.
+ *
+ * Both files must exist. The \a preferredBackend is used if available; otherwise CopyBackend::Threads is used.
+ * The worker threads are started immediately.
+ *
+ * \throws Throws std::system_error if the worker threads can not be started.
+ */
+CopyEngine::CopyEngine(const std::string &sourcePath, const std::string &targetPath, CopyBackend preferredBackend)
+    : m_sourcePath(sourcePath)
+    , m_targetPath(targetPath)
+    , m_backend(CopyBackend::Threads)
+    , m_chunksInProgress(0)
+    , m_bytesSubmitted(0)
+    , m_bytesCopied(0)
+    , m_stopping(false)
+{
+#ifdef TAG_PARSER_HAVE_IO_URING
+    if (preferredBackend == CopyBackend::IoUring) {
+        m_ring = make_unique<IoUring>(queueDepth);
+        if (m_ring->fd >= 0 && m_ring->submissionQueueEntries != MAP_FAILED) {
+            m_backend = CopyBackend::IoUring;
+        } else {
+            m_ring.reset();
+        }
+    }
+#else
+    CPP_UTILITIES_UNUSED(preferredBackend)
+#endif
+    try {
+        if (m_backend == CopyBackend::IoUring) {
+            m_workers.emplace_back(&CopyEngine::copyViaIoUring, this);
+        } else {
+            m_workers.emplace_back(&CopyEngine::copyViaStreams, this);
+            m_workers.emplace_back(&CopyEngine::copyViaStreams, this);
+        }
+    } catch (...) {
+        {
+            const auto lock = std::lock_guard<std::mutex>(m_mutex);
+            m_stopping = true;
+        }
+        m_workAvailable.notify_all();
+        for (auto &worker : m_workers) {
+            worker.join();
+        }
+        throw;
+    }
+}
+
+/*!
+ * \brief Stops the worker threads; copies which have not been started yet are discarded.
+ * \remarks Waits for reads and writes which are in flight.
+ */
+CopyEngine::~CopyEngine()
+{
+    {
+        const auto lock = std::lock_guard<std::mutex>(m_mutex);
+        m_stopping = true;
+        m_ranges.clear();
+    }
+    m_workAvailable.notify_all();
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+/*!
+ * \brief Submits copying the specified \a range.
+ * \remarks The range is merged with the previously submitted range if both are adjacent in the source and target file.
+ */
+void CopyEngine::submit(const CopyRange &range)
+{
+    if (!range.length) {
+        return;
+    }
+    {
+        const auto lock = std::lock_guard<std::mutex>(m_mutex);
+        if (!m_error.empty()) {
+            return;
+        }
+        m_bytesSubmitted += range.length;
+        if (!m_ranges.empty()) {
+            auto &previous = m_ranges.back();
+            if (previous.sourceOffset + previous.length == range.sourceOffset && previous.targetOffset + previous.length == range.targetOffset) {
+                previous.length += range.length;
+                return;
+            }
+        }
+        m_ranges.emplace_back(range);
+    }
+    m_workAvailable.notify_one();
+}
+
+/*!
+ * \brief Submits copying \a length bytes from \a sourceOffset to the current position of \a targetStream and skips them in \a targetStream.
+ *
+ * So the makers can continue writing via \a targetStream after the copied data. The \a targetStream must write
+ * to the target file of the engine.
+ */
+void CopyEngine::submit(ostream &targetStream, std::uint64_t sourceOffset, std::uint64_t length)
+{
+    submit(CopyRange{ sourceOffset, length, static_cast<std::uint64_t>(targetStream.tellp()) });
+    targetStream.seekp(static_cast<ostream::off_type>(length), ios_base::cur);
+}
+
+/*!
+ * \brief Waits until all submitted ranges have been copied.
+ *
+ * If \a progress is specified, its step percentage is updated while waiting and the operation is stopped if aborted
+ * (throwing OperationAbortedException; the remaining copies are discarded when the engine is destroyed).
+ *
+ * \throws Throws std::ios_base::failure if a copy could not be performed.
+ */
+void CopyEngine::finish(AbortableProgressFeedback *progress)
+{
+    auto lock = std::unique_lock<std::mutex>(m_mutex);
+    const auto isDone = [this] { return m_ranges.empty() && !m_chunksInProgress; };
+    while (!m_workDone.wait_for(lock, std::chrono::milliseconds(100), isDone)) {
+        if (progress) {
+            lock.unlock();
+            progress->stopIfAborted();
+            progress->updateStepPercentageFromFraction(
+                m_bytesSubmitted ? static_cast<double>(m_bytesCopied.load()) / static_cast<double>(m_bytesSubmitted) : 1.0);
+            lock.lock();
+        }
+    }
+    if (!m_error.empty()) {
+        throw std::ios_base::failure(m_error);
+    }
+}
+
+/*!
+ * \brief Returns whether io_uring is supported on the current platform.
+ * \remarks The kernel might still not support it (or it might be disabled). Then CopyBackend::Threads is used.
+ */
+bool CopyEngine::isIoUringSupported()
+{
+#ifdef TAG_PARSER_HAVE_IO_URING
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*!
+ * \brief Takes up to bufferSize bytes from the front of the submitted ranges.
+ * \returns Returns whether a \a chunk could be taken; returns false if there is nothing to do (after waiting if \a wait is set).
+ */
+bool CopyEngine::takeChunk(CopyRange &chunk, bool wait)
+{
+    auto lock = std::unique_lock<std::mutex>(m_mutex);
+    if (wait) {
+        m_workAvailable.wait(lock, [this] { return m_stopping || !m_ranges.empty(); });
+    }
+    if (m_ranges.empty()) {
+        return false;
+    }
+    auto &range = m_ranges.front();
+    chunk.sourceOffset = range.sourceOffset;
+    chunk.targetOffset = range.targetOffset;
+    chunk.length = min<std::uint64_t>(range.length, bufferSize);
+    if (!(range.length -= chunk.length)) {
+        m_ranges.pop_front();
+    } else {
+        range.sourceOffset += chunk.length;
+        range.targetOffset += chunk.length;
+    }
+    ++m_chunksInProgress;
+    return true;
+}
+
+/*!
+ * \brief Marks a chunk taken via takeChunk() as done after \a bytesCopied bytes have been copied.
+ */
+void CopyEngine::completeChunk(std::uint64_t bytesCopied)
+{
+    m_bytesCopied += bytesCopied;
+    auto done = false;
+    {
+        const auto lock = std::lock_guard<std::mutex>(m_mutex);
+        done = !--m_chunksInProgress && m_ranges.empty();
+    }
+    if (done) {
+        m_workDone.notify_all();
+    }
+}
+
+/*!
+ * \brief Records an error which occurred when copying \a chunk and discards the remaining ranges.
+ * \remarks Only the first error is recorded. An \a errorNumber of ENODATA denotes unexpected end of the source file.
+ */
+void CopyEngine::reportError(const CopyRange &chunk, int errorNumber)
+{
+    const auto lock = std::lock_guard<std::mutex>(m_mutex);
+    if (m_error.empty()) {
+        m_error = argsToString("Unable to copy ", chunk.length, " bytes from offset ", chunk.sourceOffset, " of \"", m_sourcePath, "\" to offset ",
+            chunk.targetOffset, " of \"", m_targetPath, "\": ", errorNumber != ENODATA ? std::strerror(errorNumber) : "unexpected end of file");
+    }
+    m_ranges.clear();
+}
+
+/*!
+ * \brief Copies chunks via regular streams until the engine is stopped.
+ */
+void CopyEngine::copyViaStreams()
+{
+    auto source = NativeFileStream(), target = NativeFileStream();
+    auto streamsOpen = true;
+    try {
+        source.exceptions(ios_base::badbit | ios_base::failbit);
+        target.exceptions(ios_base::badbit | ios_base::failbit);
+        source.open(BasicFileInfo::pathForOpen(m_sourcePath), ios_base::in | ios_base::binary);
+        target.open(BasicFileInfo::pathForOpen(m_targetPath), ios_base::in | ios_base::out | ios_base::binary);
+    } catch (const std::ios_base::failure &) {
+        streamsOpen = false;
+    }
+    const auto buffer = make_unique<char[]>(bufferSize);
+    for (auto chunk = CopyRange(); takeChunk(chunk, true);) {
+        try {
+            if (!streamsOpen) {
+                throw std::ios_base::failure("unable to open files");
+            }
+            source.seekg(static_cast<streamoff>(chunk.sourceOffset));
+            source.read(buffer.get(), static_cast<streamsize>(chunk.length));
+            target.seekp(static_cast<streamoff>(chunk.targetOffset));
+            target.write(buffer.get(), static_cast<streamsize>(chunk.length));
+            target.flush();
+            completeChunk(chunk.length);
+        } catch (const std::ios_base::failure &) {
+            reportError(chunk, source.eof() ? ENODATA : (errno ? errno : EIO));
+            completeChunk(0);
+            source.clear();
+            target.clear();
+        }
+    }
+}
+
+/*!
+ * \brief Copies chunks via io_uring until the engine is stopped.
+ *
+ * Each entry of the queue has its own buffer. An entry is used to read a chunk into its buffer and then to write it
+ * from there; short reads and writes are continued. New chunks are taken whenever an entry is free.
+ */
+void CopyEngine::copyViaIoUring()
+{
+#ifdef TAG_PARSER_HAVE_IO_URING
+    struct Slot {
+        CopyRange chunk; // the chunk being copied
+        std::uint64_t bytesDone = 0; // the number of bytes of the chunk which have been written
+        std::uint64_t bytesBuffered = 0; // the number of bytes read into the buffer
+        std::uint64_t bytesWritten = 0; // the number of bytes of the buffer which have been written
+        bool busy = false;
+        bool writing = false;
+    };
+    auto &ring = *m_ring;
+    const auto sourceFd = ::open(BasicFileInfo::pathForOpen(m_sourcePath), O_RDONLY | O_CLOEXEC);
+    const auto targetFd = ::open(BasicFileInfo::pathForOpen(m_targetPath), O_WRONLY | O_CLOEXEC);
+    const auto openError = sourceFd < 0 || targetFd < 0 ? errno : 0;
+    auto ringError = 0;
+    Slot slots[queueDepth];
+    auto slotsBusy = std::size_t();
+    auto submissions = 0u;
+    const auto submitRead = [&](std::size_t index) {
+        auto &slot = slots[index];
+        auto &entry = ring.nextSubmissionQueueEntry();
+        entry.opcode = ring.buffersRegistered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        entry.fd = sourceFd;
+        entry.addr = reinterpret_cast<std::uintptr_t>(ring.buffers.get() + index * bufferSize + slot.bytesBuffered);
+        entry.len = static_cast<std::uint32_t>(slot.chunk.length - slot.bytesDone - slot.bytesBuffered);
+        entry.off = slot.chunk.sourceOffset + slot.bytesDone + slot.bytesBuffered;
+        entry.buf_index = static_cast<std::uint16_t>(index);
+        entry.user_data = index;
+        slot.writing = false;
+        ++submissions;
+    };
+    const auto submitWrite = [&](std::size_t index) {
+        auto &slot = slots[index];
+        auto &entry = ring.nextSubmissionQueueEntry();
+        entry.opcode = ring.buffersRegistered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        entry.fd = targetFd;
+        entry.addr = reinterpret_cast<std::uintptr_t>(ring.buffers.get() + index * bufferSize + slot.bytesWritten);
+        entry.len = static_cast<std::uint32_t>(slot.bytesBuffered - slot.bytesWritten);
+        entry.off = slot.chunk.targetOffset + slot.bytesDone + slot.bytesWritten;
+        entry.buf_index = static_cast<std::uint16_t>(index);
+        entry.user_data = index;
+        slot.writing = true;
+        ++submissions;
+    };
+    const auto releaseSlot = [&](Slot &slot, std::uint64_t bytesCopied) {
+        slot.busy = false;
+        --slotsBusy;
+        completeChunk(bytesCopied);
+    };
+
+    for (;;) {
+        // start reading new chunks into free slots; only block when idle
+        for (auto index = std::size_t(); index != queueDepth; ++index) {
+            auto &slot = slots[index];
+            if (slot.busy || !takeChunk(slot.chunk, !slotsBusy && !submissions)) {
+                continue;
+            }
+            if (const auto error = openError ? openError : ringError) {
+                reportError(slot.chunk, error);
+                completeChunk(0);
+                continue;
+            }
+            slot.busy = true;
+            slot.bytesDone = slot.bytesBuffered = slot.bytesWritten = 0;
+            ++slotsBusy;
+            submitRead(index);
+        }
+        if (!slotsBusy) {
+            // takeChunk() has returned false while waiting; so the engine is stopping
+            const auto lock = std::lock_guard<std::mutex>(m_mutex);
+            if (m_stopping && m_ranges.empty()) {
+                break;
+            }
+            continue;
+        }
+
+        // pass new entries to the kernel and wait for at least one completion
+        if (const auto error = ring.submitAndWait(submissions, 1)) {
+            // the ring itself is unusable; entries not consumed by the kernel are never passed to it but the others
+            // might still be in flight so wait for their completion before releasing the slots and their buffers
+            auto inFlight = slotsBusy - (*ring.submissionTail - __atomic_load_n(ring.submissionHead, __ATOMIC_ACQUIRE));
+            for (;;) {
+                const auto tail = __atomic_load_n(ring.completionTail, __ATOMIC_ACQUIRE);
+                inFlight -= min<std::size_t>(inFlight, tail - *ring.completionHead);
+                __atomic_store_n(ring.completionHead, tail, __ATOMIC_RELEASE);
+                if (!inFlight) {
+                    break;
+                }
+                if (ring.submitAndWait(0, 1)) {
+                    // unable to wait for the remaining operations; keep the ring and its buffers alive as the kernel might still access them
+                    static_cast<void>(m_ring.release());
+                    break;
+                }
+            }
+            ringError = error;
+            for (auto &slot : slots) {
+                if (slot.busy) {
+                    reportError(slot.chunk, error);
+                    releaseSlot(slot, 0);
+                }
+            }
+            submissions = 0;
+            continue;
+        }
+        submissions = 0;
+
+        // process completions
+        auto head = *ring.completionHead;
+        const auto tail = __atomic_load_n(ring.completionTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const auto &completion = ring.completionQueueEntries[head & *ring.completionMask];
+            const auto index = static_cast<std::size_t>(completion.user_data);
+            const auto res = completion.res;
+            auto &slot = slots[index];
+            if (res == -EINTR || res == -EAGAIN) {
+                slot.writing ? submitWrite(index) : submitRead(index);
+            } else if (res <= 0) {
+                // a read returning nothing means the source file ends prematurely; a write returning nothing would never progress
+                reportError(slot.chunk, res ? -res : (slot.writing ? EIO : ENODATA));
+                releaseSlot(slot, slot.bytesDone);
+            } else if (!slot.writing) {
+                slot.bytesBuffered += static_cast<std::uint64_t>(res);
+                submitWrite(index);
+            } else if ((slot.bytesWritten += static_cast<std::uint64_t>(res)) < slot.bytesBuffered) {
+                submitWrite(index);
+            } else if ((slot.bytesDone += slot.bytesBuffered) < slot.chunk.length) {
+                slot.bytesBuffered = slot.bytesWritten = 0;
+                submitRead(index);
+            } else {
+                releaseSlot(slot, slot.bytesDone);
+            }
+        }
+        __atomic_store_n(ring.completionHead, head, __ATOMIC_RELEASE);
+    }
+    if (sourceFd >= 0) {
+        ::close(sourceFd);
+    }
+    if (targetFd >= 0) {
+        ::close(targetFd);
+    }
+#endif
+}
+
+} // namespace TagParser
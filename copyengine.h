@@ -0,0 +1,110 @@
+#ifndef TAG_PARSER_COPYENGINE_H
+#define TAG_PARSER_COPYENGINE_H
+
+#include "./global.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace TagParser {
+
+class AbortableProgressFeedback;
+
+/*!
+ * \brief The CopyBackend enum specifies how a CopyEngine performs the copies.
+ */
+enum class CopyBackend {
+    Threads, /**< worker threads read and write the data using regular streams (available on all platforms) */
+    IoUring, /**< a single worker thread keeps several reads and writes in flight via io_uring using registered buffers (Linux only) */
+};
+
+/*!
+ * \brief The CopyRange struct describes a range of data to be copied by a CopyEngine.
+ */
+struct TAG_PARSER_EXPORT CopyRange {
+    std::uint64_t sourceOffset = 0; /**< the offset of the data within the source file */
+    std::uint64_t length = 0; /**< the number of bytes to copy */
+    std::uint64_t targetOffset = 0; /**< the offset the data is copied to within the target file */
+};
+
+class TAG_PARSER_EXPORT CopyEngine {
+public:
+    static constexpr std::size_t queueDepth = 8;
+    static constexpr std::size_t bufferSize = 0x80000;
+
+    explicit CopyEngine(const std::string &sourcePath, const std::string &targetPath, CopyBackend preferredBackend = CopyBackend::IoUring);
+    CopyEngine(const CopyEngine &) = delete;
+    CopyEngine &operator=(const CopyEngine &) = delete;
+    ~CopyEngine();
+
+    CopyBackend backend() const;
+    std::uint64_t bytesSubmitted() const;
+    std::uint64_t bytesCopied() const;
+    void submit(const CopyRange &range);
+    void submit(std::ostream &targetStream, std::uint64_t sourceOffset, std::uint64_t length);
+    void finish(AbortableProgressFeedback *progress = nullptr);
+
+    static bool isIoUringSupported();
+
+private:
+    struct IoUring;
+
+    bool takeChunk(CopyRange &chunk, bool wait);
+    void completeChunk(std::uint64_t bytesCopied);
+    void reportError(const CopyRange &chunk, int errorNumber);
+    void copyViaStreams();
+    void copyViaIoUring();
+
+    const std::string m_sourcePath;
+    const std::string m_targetPath;
+    CopyBackend m_backend;
+    std::unique_ptr<IoUring> m_ring;
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_workDone;
+    std::deque<CopyRange> m_ranges;
+    std::size_t m_chunksInProgress;
+    std::uint64_t m_bytesSubmitted;
+    std::atomic<std::uint64_t> m_bytesCopied;
+    std::string m_error;
+    bool m_stopping;
+    std::vector<std::thread> m_workers;
+};
+
+/*!
+ * \brief Returns the backend actually used.
+ * \remarks Falls back to CopyBackend::Threads if the preferred backend is not available.
+ */
+inline CopyBackend CopyEngine::backend() const
+{
+    return m_backend;
+}
+
+/*!
+ * \brief Returns the number of bytes submitted so far.
+ */
+inline std::uint64_t CopyEngine::bytesSubmitted() const
+{
+    return m_bytesSubmitted;
+}
+
+/*!
+ * \brief Returns the number of bytes copied so far.
+ */
+inline std::uint64_t CopyEngine::bytesCopied() const
+{
+    return m_bytesCopied.load();
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_COPYENGINE_H
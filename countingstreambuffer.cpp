@@ -0,0 +1,104 @@
+#include "./countingstreambuffer.h"
+#include "./mediafilestatistics.h"
+
+using namespace std;
+
+namespace TagParser {
+
+/*!
+ * \class TagParser::CountingStreamBuffer
+ * \brief The CountingStreamBuffer class forwards all operations to another stream buffer and counts them.
+ *
+ * The buffer has no get or put area on its own. So each read, write and seek reaches the underlying buffer
+ * and the counters in the specified IoStatistics reflect the operations the parsers and makers actually do.
+ * Since the buffer does not hold any state besides the counters, the underlying buffer can still be used
+ * directly without getting out of sync.
+ *
+ * \sa BasicFileInfo::setIoStatistics()
+ */
+
+/*!
+ * \brief Constructs a new buffer forwarding to \a underlyingBuffer and counting operations in \a statistics.
+ */
+CountingStreamBuffer::CountingStreamBuffer(std::streambuf *underlyingBuffer, IoStatistics &statistics)
+    : m_underlyingBuffer(underlyingBuffer)
+    , m_statistics(statistics)
+{
+}
+
+CountingStreamBuffer::int_type CountingStreamBuffer::underflow()
+{
+    return m_underlyingBuffer->sgetc();
+}
+
+CountingStreamBuffer::int_type CountingStreamBuffer::uflow()
+{
+    const auto c = m_underlyingBuffer->sbumpc();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        ++m_statistics.readOperations;
+        ++m_statistics.bytesRead;
+    }
+    return c;
+}
+
+streamsize CountingStreamBuffer::xsgetn(char_type *buffer, streamsize count)
+{
+    const auto bytesRead = m_underlyingBuffer->sgetn(buffer, count);
+    ++m_statistics.readOperations;
+    m_statistics.bytesRead += static_cast<std::uint64_t>(bytesRead);
+    return bytesRead;
+}
+
+streamsize CountingStreamBuffer::showmanyc()
+{
+    return m_underlyingBuffer->in_avail();
+}
+
+CountingStreamBuffer::int_type CountingStreamBuffer::pbackfail(int_type c)
+{
+    return traits_type::eq_int_type(c, traits_type::eof()) ? m_underlyingBuffer->sungetc()
+                                                           : m_underlyingBuffer->sputbackc(traits_type::to_char_type(c));
+}
+
+CountingStreamBuffer::int_type CountingStreamBuffer::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    const auto res = m_underlyingBuffer->sputc(traits_type::to_char_type(c));
+    if (!traits_type::eq_int_type(res, traits_type::eof())) {
+        ++m_statistics.writeOperations;
+        ++m_statistics.bytesWritten;
+    }
+    return res;
+}
+
+streamsize CountingStreamBuffer::xsputn(const char_type *buffer, streamsize count)
+{
+    const auto bytesWritten = m_underlyingBuffer->sputn(buffer, count);
+    ++m_statistics.writeOperations;
+    m_statistics.bytesWritten += static_cast<std::uint64_t>(bytesWritten);
+    return bytesWritten;
+}
+
+CountingStreamBuffer::pos_type CountingStreamBuffer::seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which)
+{
+    // don't count querying the current position (tellg()/tellp()) as seek
+    if (off || dir != ios_base::cur) {
+        ++m_statistics.seekOperations;
+    }
+    return m_underlyingBuffer->pubseekoff(off, dir, which);
+}
+
+CountingStreamBuffer::pos_type CountingStreamBuffer::seekpos(pos_type pos, ios_base::openmode which)
+{
+    ++m_statistics.seekOperations;
+    return m_underlyingBuffer->pubseekpos(pos, which);
+}
+
+int CountingStreamBuffer::sync()
+{
+    return m_underlyingBuffer->pubsync();
+}
+
+} // namespace TagParser
@@ -0,0 +1,45 @@
+#ifndef TAG_PARSER_COUNTINGSTREAMBUFFER_H
+#define TAG_PARSER_COUNTINGSTREAMBUFFER_H
+
+#include "./global.h"
+
+#include <streambuf>
+
+namespace TagParser {
+
+struct IoStatistics;
+
+class TAG_PARSER_EXPORT CountingStreamBuffer : public std::streambuf {
+public:
+    explicit CountingStreamBuffer(std::streambuf *underlyingBuffer, IoStatistics &statistics);
+
+    std::streambuf *underlyingBuffer() const;
+
+protected:
+    int_type underflow() override;
+    int_type uflow() override;
+    std::streamsize xsgetn(char_type *buffer, std::streamsize count) override;
+    std::streamsize showmanyc() override;
+    int_type pbackfail(int_type c) override;
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char_type *buffer, std::streamsize count) override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+    int sync() override;
+
+private:
+    std::streambuf *const m_underlyingBuffer;
+    IoStatistics &m_statistics;
+};
+
+/*!
+ * \brief Returns the buffer all operations are forwarded to.
+ */
+inline std::streambuf *CountingStreamBuffer::underlyingBuffer() const
+{
+    return m_underlyingBuffer;
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_COUNTINGSTREAMBUFFER_H
@@ -13,7 +13,7 @@ namespace TagParser {
  * \class Diagnostics
  * \brief The Diagnostics class is a container for DiagMessage.
  * \remarks A lot of methods in this library take such a container as argument. The method will add additional
- *          information, warnings or errors to it.
+ *          information, warnings or errors to it. Use setMinimumLevel() to discard messages which are not of interest.
  */
 
 /*!
@@ -6,6 +6,8 @@
 #include <c++utilities/chrono/datetime.h>
 
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace TagParser {
@@ -153,15 +155,47 @@ inline bool DiagMessage::operator==(const DiagMessage &other) const
     return m_level == other.m_level && m_message == other.m_message && m_context == other.m_context;
 }
 
+/// \cond
+namespace Detail {
+/*!
+ * \brief Returns the specified \a value or the result of invoking it if it is a callable (to format messages/contexts lazily).
+ */
+template <typename ValueType> inline decltype(auto) evaluateDiagString(ValueType &&value)
+{
+    if constexpr (std::is_invocable_v<ValueType>) {
+        return std::forward<ValueType>(value)();
+    } else {
+        return std::forward<ValueType>(value);
+    }
+}
+} // namespace Detail
+/// \endcond
+
 class TAG_PARSER_EXPORT Diagnostics : public std::vector<DiagMessage> {
 public:
     Diagnostics() = default;
+    explicit Diagnostics(DiagLevel minimumLevel);
     Diagnostics(std::initializer_list<DiagMessage> list);
 
+    DiagLevel minimumLevel() const;
+    void setMinimumLevel(DiagLevel minimumLevel);
+    bool isRelevant(DiagLevel level) const;
+    template <typename MessageType, typename ContextType> void emplace_back(DiagLevel level, MessageType &&message, ContextType &&context);
     bool has(DiagLevel level) const;
     DiagLevel level() const;
+
+private:
+    DiagLevel m_minimumLevel = DiagLevel::None;
 };
 
+/*!
+ * \brief Constructs a new container which only takes messages of at least the specified \a minimumLevel.
+ */
+inline Diagnostics::Diagnostics(DiagLevel minimumLevel)
+    : m_minimumLevel(minimumLevel)
+{
+}
+
 /*!
  * \brief Constructs a new container with the specified messages.
  */
@@ -170,6 +204,49 @@ inline Diagnostics::Diagnostics(std::initializer_list<DiagMessage> list)
 {
 }
 
+/*!
+ * \brief Returns the minimum level of messages to be added.
+ * \remarks Messages of a lower level are discarded by emplace_back(). By default, all messages are added.
+ */
+inline DiagLevel Diagnostics::minimumLevel() const
+{
+    return m_minimumLevel;
+}
+
+/*!
+ * \brief Sets the minimum level of messages to be added.
+ * \remarks Does not affect messages which have already been added.
+ */
+inline void Diagnostics::setMinimumLevel(DiagLevel minimumLevel)
+{
+    m_minimumLevel = minimumLevel;
+}
+
+/*!
+ * \brief Returns whether messages of the specified \a level would be added (and not be discarded by emplace_back()).
+ * \remarks Can be used to avoid computations which are only required to compose a message.
+ */
+inline bool Diagnostics::isRelevant(DiagLevel level) const
+{
+    return level >= m_minimumLevel;
+}
+
+/*!
+ * \brief Adds a new DiagMessage with the specified \a level, \a message and \a context unless \a level is below minimumLevel().
+ * \remarks
+ * - The \a message and the \a context might be specified as callables returning the actual string. These are only invoked
+ *   when the message is actually added so no formatting and allocations take place for discarded messages.
+ * - Hides std::vector::emplace_back() so the minimum level is taken into account for all messages added by this library.
+ */
+template <typename MessageType, typename ContextType>
+inline void Diagnostics::emplace_back(DiagLevel level, MessageType &&message, ContextType &&context)
+{
+    if (isRelevant(level)) {
+        std::vector<DiagMessage>::emplace_back(level, Detail::evaluateDiagString(std::forward<MessageType>(message)),
+            Detail::evaluateDiagString(std::forward<ContextType>(context)));
+    }
+}
+
 } // namespace TagParser
 
 #endif // TAGPARSER_DIAGNOSTICS_H
@@ -5,6 +5,7 @@
 
 #include <functional>
 #include <map>
+#include <type_traits>
 
 namespace TagParser {
 
@@ -12,15 +13,33 @@ namespace TagParser {
  * \class TagParser::FieldMapBasedTagTraits
  * \brief Defines traits for the specified \a ImplementationType.
  *
- * A template specialization for each FieldMapBasedTag subclass must be provided.
+ * A template specialization for each FieldMapBasedTag subclass must be provided. It must define the
+ * FieldType and the Compare function for the field IDs. It might define Storage to use a container other
+ * than std::multimap (e.g. FlatFieldMap) for storing the fields.
  */
 template <typename ImplementationType> class FieldMapBasedTagTraits {
 };
 
+namespace Detail {
+/*!
+ * \brief Determines the container used by FieldMapBasedTag to store fields; defaults to std::multimap.
+ */
+template <typename Traits, typename = void> struct FieldMapBasedTagStorage {
+    using type = std::multimap<typename Traits::FieldType::IdentifierType, typename Traits::FieldType, typename Traits::Compare>;
+};
+
+/*!
+ * \brief Uses the container specified via FieldMapBasedTagTraits::Storage.
+ */
+template <typename Traits> struct FieldMapBasedTagStorage<Traits, std::void_t<typename Traits::Storage>> {
+    using type = typename Traits::Storage;
+};
+} // namespace Detail
+
 /*!
  * \class TagParser::FieldMapBasedTag
  * \brief The FieldMapBasedTag provides a generic implementation of Tag which stores
- *        the tag fields using std::multimap.
+ *        the tag fields using std::multimap (or the storage specified via FieldMapBasedTagTraits).
  *
  * The FieldMapBasedTag class only provides the interface and common functionality.
  * It is meant to be subclassed using CRTP pattern.
@@ -35,6 +54,7 @@ public:
     using FieldType = typename FieldMapBasedTagTraits<ImplementationType>::FieldType;
     using IdentifierType = typename FieldMapBasedTagTraits<ImplementationType>::FieldType::IdentifierType;
     using Compare = typename FieldMapBasedTagTraits<ImplementationType>::Compare;
+    using Storage = typename Detail::FieldMapBasedTagStorage<FieldMapBasedTagTraits<ImplementationType>>::type;
 
     FieldMapBasedTag();
 
@@ -52,8 +72,8 @@ public:
     bool hasField(KnownField field) const;
     bool hasField(const IdentifierType &id) const;
     void removeAllFields();
-    const std::multimap<IdentifierType, FieldType, Compare> &fields() const;
-    std::multimap<IdentifierType, FieldType, Compare> &fields();
+    const Storage &fields() const;
+    Storage &fields();
     unsigned int fieldCount() const;
     IdentifierType fieldId(KnownField value) const;
     KnownField knownField(const IdentifierType &id) const;
@@ -77,7 +97,7 @@ protected:
     TagDataType internallyGetProposedDataType(const IdentifierType &id) const;
 
 private:
-    std::multimap<IdentifierType, FieldType, Compare> m_fields;
+    Storage m_fields;
 };
 
 /*!
@@ -210,14 +230,15 @@ bool FieldMapBasedTag<ImplementationType>::internallySetValues(const FieldMapBas
             ++range.first;
         }
     }
-    // add remaining specified values (there are more specified values than existing ones)
-    for (; valuesIterator != values.cend(); ++valuesIterator) {
-        m_fields.insert(std::make_pair(id, FieldType(id, *valuesIterator)));
-    }
     // remove remaining existing values (there are more existing values than specified ones)
+    // note: This needs to happen before inserting as inserting might invalidate the range (depending on the storage).
     for (; range.first != range.second; ++range.first) {
         range.first->second.setValue(TagValue());
     }
+    // add remaining specified values (there are more specified values than existing ones)
+    for (; valuesIterator != values.cend(); ++valuesIterator) {
+        m_fields.insert(std::make_pair(id, FieldType(id, *valuesIterator)));
+    }
     return true;
 }
 
@@ -287,17 +308,23 @@ template <class ImplementationType> inline void FieldMapBasedTag<ImplementationT
 
 /*!
  * \brief Returns the fields of the tag by providing direct access to the field map of the tag.
+ * \remarks
+ * - The field map is a std::multimap unless FieldMapBasedTagTraits specifies a different Storage. Note that this
+ *   is the case for VorbisComment which uses FlatFieldMap since version 10. This changed the return type of this
+ *   function for VorbisComment (breaking API and ABI compatibility).
+ * - Unlike with std::multimap, inserting or erasing fields invalidates all iterators of a FlatFieldMap.
  */
 template <class ImplementationType>
-inline auto FieldMapBasedTag<ImplementationType>::fields() const -> const std::multimap<IdentifierType, FieldType, Compare> &
+inline auto FieldMapBasedTag<ImplementationType>::fields() const -> const Storage &
 {
     return m_fields;
 }
 
 /*!
  * \brief Returns the fields of the tag by providing direct access to the field map of the tag.
+ * \remarks See the const overload for remarks about the type of the field map.
  */
-template <class ImplementationType> inline auto FieldMapBasedTag<ImplementationType>::fields() -> std::multimap<IdentifierType, FieldType, Compare> &
+template <class ImplementationType> inline auto FieldMapBasedTag<ImplementationType>::fields() -> Storage &
 {
     return m_fields;
 }
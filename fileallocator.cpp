@@ -0,0 +1,177 @@
+#include "./fileallocator.h"
+#include "./basicfileinfo.h"
+
+#ifdef TAG_PARSER_HAVE_FALLOCATE
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <ostream>
+
+using namespace std;
+
+namespace TagParser {
+
+/*!
+ * \class TagParser::FileAllocator
+ * \brief The FileAllocator class manages the disk space of a file being rewritten.
+ *
+ * Rewriting a file extends it through many appends which fragments large files. The makers know the size of
+ * the new file from their size calculation (see ChangesPlan::bytesToWrite) and use preallocate() to reserve
+ * the space upfront. When done, releaseUnusedSpace() frees what has been reserved but not used.
+ *
+ * The makers write padding via writeZeroes(). Zeroes exceeding the sparseThreshold() are not written at all;
+ * the region is left as a hole instead. So multi-MB padding costs neither write bandwidth nor disk blocks.
+ * Holes read as zeroes so the contents of the file are the same.
+ *
+ * \remarks
+ * - Only use the allocator for files which have been newly created (truncated) before writing. Within existing
+ *   data, skipped zeroes would leave the previous data in place.
+ * - Preallocating and punching holes is only implemented on platforms supporting fallocate(). Elsewhere the
+ *   functions have no effect (and zeroes are written as usual).
+ */
+
+/*!
+ * \brief Constructs a new allocator for the file at the specified \a path.
+ * \remarks If \a path is empty, the allocator is disabled; writeZeroes() will then write all zeroes.
+ */
+FileAllocator::FileAllocator(const string &path, std::uint64_t sparseThreshold)
+    : m_path(path)
+    , m_sparseThreshold(path.empty() ? 0 : sparseThreshold)
+    , m_preallocatedSize(0)
+    , m_sparseBytes(0)
+{
+}
+
+/*!
+ * \brief Reserves disk space for a file of the specified \a size without changing the size of the file.
+ * \returns Returns whether the space could be reserved.
+ */
+bool FileAllocator::preallocate(std::uint64_t size)
+{
+    if (m_path.empty() || !preallocate(m_path, size)) {
+        return false;
+    }
+    m_preallocatedSize = max(m_preallocatedSize, size);
+    return true;
+}
+
+/*!
+ * \brief Writes \a count zero bytes to the specified \a stream leaving them as hole if at least sparseThreshold().
+ *
+ * When leaving a hole, the stream is seeked behind it and only the last byte is written (so the file is extended
+ * if the hole is at the end). Disk space reserved via preallocate() is freed for the hole by releaseUnusedSpace().
+ */
+void FileAllocator::writeZeroes(ostream &stream, std::uint64_t count)
+{
+    if (m_sparseThreshold && count >= m_sparseThreshold) {
+        const auto offset = static_cast<std::uint64_t>(stream.tellp());
+        if (offset < m_preallocatedSize) {
+            // punching is only possible when the region is within the file so it is deferred
+            m_holes.emplace_back(offset, count - 1);
+        }
+        stream.seekp(static_cast<ostream::off_type>(count - 1), ios_base::cur);
+        stream.put(0);
+        m_sparseBytes += count - 1;
+        return;
+    }
+    static constexpr char zeroes[0x1000] = {};
+    for (; count > sizeof(zeroes); count -= sizeof(zeroes)) {
+        stream.write(zeroes, sizeof(zeroes));
+    }
+    stream.write(zeroes, static_cast<streamsize>(count));
+}
+
+/*!
+ * \brief Frees disk space reserved via preallocate() for holes and beyond the specified \a size of the file.
+ * \remarks The stream writing the file must have been flushed or closed before.
+ */
+void FileAllocator::releaseUnusedSpace(std::uint64_t size)
+{
+    for (const auto &[offset, holeSize] : m_holes) {
+        punchHole(m_path, offset, holeSize);
+    }
+    m_holes.clear();
+#ifdef TAG_PARSER_HAVE_FALLOCATE
+    // truncating to the current size frees blocks reserved beyond the end of the file
+    if (m_preallocatedSize > size && ::truncate(BasicFileInfo::pathForOpen(m_path), static_cast<off_t>(size)) == 0) {
+        m_preallocatedSize = size;
+    }
+#else
+    CPP_UTILITIES_UNUSED(size)
+#endif
+}
+
+/*!
+ * \brief Returns whether preallocating and punching holes is supported on the current platform.
+ * \remarks The file system might still not support it.
+ */
+bool FileAllocator::isSupported()
+{
+#ifdef TAG_PARSER_HAVE_FALLOCATE
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*!
+ * \brief Reserves disk space for the file at the specified \a path to have the specified \a size.
+ * \returns Returns whether the space could be reserved; this fails if not supported by the platform or file system.
+ * \remarks The size of the file is not changed.
+ */
+bool FileAllocator::preallocate(const string &path, std::uint64_t size)
+{
+#ifdef TAG_PARSER_HAVE_FALLOCATE
+    if (!size) {
+        return true;
+    }
+    const auto fileDescriptor = ::open(BasicFileInfo::pathForOpen(path), O_WRONLY | O_CLOEXEC);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+    auto res = int();
+    do {
+        res = ::fallocate(fileDescriptor, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+    } while (res && errno == EINTR);
+    ::close(fileDescriptor);
+    return !res;
+#else
+    CPP_UTILITIES_UNUSED(path)
+    CPP_UTILITIES_UNUSED(size)
+    return false;
+#endif
+}
+
+/*!
+ * \brief Frees the disk space of the specified region of the file at the specified \a path.
+ * \returns Returns whether the region could be turned into a hole; this fails if not supported by the platform or file system.
+ * \remarks The region reads as zeroes afterwards. The size of the file is not changed.
+ */
+bool FileAllocator::punchHole(const string &path, std::uint64_t offset, std::uint64_t size)
+{
+#ifdef TAG_PARSER_HAVE_FALLOCATE
+    if (!size) {
+        return true;
+    }
+    const auto fileDescriptor = ::open(BasicFileInfo::pathForOpen(path), O_WRONLY | O_CLOEXEC);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+    auto res = int();
+    do {
+        res = ::fallocate(fileDescriptor, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset), static_cast<off_t>(size));
+    } while (res && errno == EINTR);
+    ::close(fileDescriptor);
+    return !res;
+#else
+    CPP_UTILITIES_UNUSED(path)
+    CPP_UTILITIES_UNUSED(offset)
+    CPP_UTILITIES_UNUSED(size)
+    return false;
+#endif
+}
+
+} // namespace TagParser
@@ -0,0 +1,72 @@
+#ifndef TAG_PARSER_FILEALLOCATOR_H
+#define TAG_PARSER_FILEALLOCATOR_H
+
+#include "./global.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace TagParser {
+
+class TAG_PARSER_EXPORT FileAllocator {
+public:
+    explicit FileAllocator(const std::string &path = std::string(), std::uint64_t sparseThreshold = 0);
+
+    const std::string &path() const;
+    std::uint64_t sparseThreshold() const;
+    std::uint64_t preallocatedSize() const;
+    std::uint64_t sparseBytes() const;
+    bool preallocate(std::uint64_t size);
+    void writeZeroes(std::ostream &stream, std::uint64_t count);
+    void releaseUnusedSpace(std::uint64_t size);
+
+    static bool isSupported();
+    static bool preallocate(const std::string &path, std::uint64_t size);
+    static bool punchHole(const std::string &path, std::uint64_t offset, std::uint64_t size);
+
+private:
+    std::string m_path;
+    std::uint64_t m_sparseThreshold;
+    std::uint64_t m_preallocatedSize;
+    std::uint64_t m_sparseBytes;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> m_holes;
+};
+
+/*!
+ * \brief Returns the path of the file being written or an empty string if the allocator is disabled.
+ */
+inline const std::string &FileAllocator::path() const
+{
+    return m_path;
+}
+
+/*!
+ * \brief Returns the min. number of zero bytes which are left as hole rather than being written (0 means never).
+ */
+inline std::uint64_t FileAllocator::sparseThreshold() const
+{
+    return m_sparseThreshold;
+}
+
+/*!
+ * \brief Returns the number of bytes which have been preallocated via preallocate().
+ */
+inline std::uint64_t FileAllocator::preallocatedSize() const
+{
+    return m_preallocatedSize;
+}
+
+/*!
+ * \brief Returns the number of zero bytes which have been left as hole rather than being written.
+ */
+inline std::uint64_t FileAllocator::sparseBytes() const
+{
+    return m_sparseBytes;
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_FILEALLOCATOR_H
@@ -4,6 +4,7 @@
 #include "../vorbis/vorbiscomment.h"
 
 #include "../exceptions.h"
+#include "../fileallocator.h"
 #include "../mediafileinfo.h"
 #include "../mediaformat.h"
 
@@ -291,9 +292,11 @@ std::streamoff FlacStream::makeHeader(ostream &outputStream, Diagnostics &diag)
 
 /*!
  * \brief Writes padding of the specified \a size to the specified \a stream.
- * \remarks Size must be at least 4 bytes.
+ * \remarks
+ * - Size must be at least 4 bytes.
+ * - If an \a allocator is specified, the zeroes are written via FileAllocator::writeZeroes().
  */
-void FlacStream::makePadding(ostream &stream, std::uint32_t size, bool isLast, Diagnostics &diag)
+void FlacStream::makePadding(ostream &stream, std::uint32_t size, bool isLast, Diagnostics &diag, FileAllocator *allocator)
 {
     CPP_UTILITIES_UNUSED(diag)
 
@@ -305,6 +308,10 @@ void FlacStream::makePadding(ostream &stream, std::uint32_t size, bool isLast, D
     header.makeHeader(stream);
 
     // write zeroes
+    if (allocator) {
+        allocator->writeZeroes(stream, size);
+        return;
+    }
     for (; size; --size) {
         stream.put(0);
     }
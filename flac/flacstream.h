@@ -8,6 +8,7 @@
 
 namespace TagParser {
 
+class FileAllocator;
 class MediaFileInfo;
 class VorbisComment;
 
@@ -24,7 +25,7 @@ public:
     std::uint32_t streamOffset() const;
 
     std::streamoff makeHeader(std::ostream &stream, Diagnostics &diag);
-    static void makePadding(std::ostream &stream, std::uint32_t size, bool isLast, Diagnostics &diag);
+    static void makePadding(std::ostream &stream, std::uint32_t size, bool isLast, Diagnostics &diag, FileAllocator *allocator = nullptr);
 
 protected:
     void internalParseHeader(Diagnostics &diag) override;
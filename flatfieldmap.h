@@ -0,0 +1,360 @@
+#ifndef TAG_PARSER_FLATFIELDMAP_H
+#define TAG_PARSER_FLATFIELDMAP_H
+
+#include "./global.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace TagParser {
+
+/*!
+ * \brief The IdentityKeyNormalizer struct uses keys as-is for the lookup in a FlatFieldMap.
+ */
+struct TAG_PARSER_EXPORT IdentityKeyNormalizer {
+    template <typename KeyType> static const KeyType &normalize(const KeyType &key)
+    {
+        return key;
+    }
+    template <typename KeyType> static int compare(const KeyType &normalizedKey, const KeyType &key)
+    {
+        return normalizedKey < key ? -1 : (key < normalizedKey ? 1 : 0);
+    }
+};
+
+/*!
+ * \class TagParser::FlatFieldMap
+ * \brief The FlatFieldMap class is a multimap-like container which stores its entries in contiguous memory.
+ *
+ * Entries are kept sorted by their normalized key in a std::vector. The normalized keys are stored separately
+ * in a second std::vector so lookups are binary searches over a compact key array. The key to look up is compared
+ * against the stored normalized keys via KeyNormalizer::compare() so it does not need to be normalized (which might
+ * require an allocation, e.g. when lower-casing a string).
+ *
+ * Inserting a single entry takes linear time. So when adding many entries at once (e.g. when parsing a tag) the
+ * overload of insert() taking a range should be used which appends all entries and sorts them only once.
+ *
+ * The interface mimics the subset of std::multimap used by FieldMapBasedTag and its subclasses. Like with
+ * std::multimap, new entries are inserted after existing entries with an equivalent key so the order of
+ * multiple values for the same key is preserved.
+ *
+ * \remarks
+ * - Unlike with std::multimap, inserting and erasing entries invalidates all iterators.
+ * - KeyNormalizer must provide a static normalize() function returning the normalized key and a static compare()
+ *   function comparing a normalized key with a key which is not normalized (returning a value less than, equal to
+ *   or greater than zero).
+ * - The key of an entry must not be modified via an iterator.
+ * - Can be selected as storage for a FieldMapBasedTag by specifying it as FieldMapBasedTagTraits::Storage.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer = IdentityKeyNormalizer> class FlatFieldMap {
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<KeyType, ValueType>;
+    using size_type = std::size_t;
+    using NormalizedKeyType = std::decay_t<decltype(KeyNormalizer::normalize(std::declval<const KeyType &>()))>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    iterator begin();
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end();
+    const_iterator end() const;
+    const_iterator cend() const;
+    size_type size() const;
+    bool empty() const;
+    void clear();
+    void reserve(size_type capacity);
+
+    iterator find(const KeyType &key);
+    const_iterator find(const KeyType &key) const;
+    std::pair<iterator, iterator> equal_range(const KeyType &key);
+    std::pair<const_iterator, const_iterator> equal_range(const KeyType &key) const;
+    size_type count(const KeyType &key) const;
+
+    iterator insert(const value_type &value);
+    iterator insert(value_type &&value);
+    template <typename InputIterator> void insert(InputIterator first, InputIterator last);
+    template <typename... Args> iterator emplace(Args &&...args);
+    iterator erase(const_iterator pos);
+    iterator erase(const_iterator first, const_iterator last);
+    size_type erase(const KeyType &key);
+
+private:
+    std::pair<size_type, size_type> indexRange(const KeyType &key) const;
+    static bool isLess(const NormalizedKeyType &normalizedKey, const KeyType &key);
+    static bool isGreater(const NormalizedKeyType &normalizedKey, const KeyType &key);
+
+    std::vector<NormalizedKeyType> m_keys;
+    std::vector<value_type> m_entries;
+};
+
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::begin() -> iterator
+{
+    return m_entries.begin();
+}
+
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::begin() const -> const_iterator
+{
+    return m_entries.begin();
+}
+
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::cbegin() const -> const_iterator
+{
+    return m_entries.cbegin();
+}
+
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::end() -> iterator
+{
+    return m_entries.end();
+}
+
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::end() const -> const_iterator
+{
+    return m_entries.end();
+}
+
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::cend() const -> const_iterator
+{
+    return m_entries.cend();
+}
+
+/*!
+ * \brief Returns the number of entries.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::size() const -> size_type
+{
+    return m_entries.size();
+}
+
+/*!
+ * \brief Returns whether there are no entries.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer> inline bool FlatFieldMap<KeyType, ValueType, KeyNormalizer>::empty() const
+{
+    return m_entries.empty();
+}
+
+/*!
+ * \brief Removes all entries.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer> inline void FlatFieldMap<KeyType, ValueType, KeyNormalizer>::clear()
+{
+    m_keys.clear();
+    m_entries.clear();
+}
+
+/*!
+ * \brief Reserves memory for at least the specified number of entries.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline void FlatFieldMap<KeyType, ValueType, KeyNormalizer>::reserve(size_type capacity)
+{
+    m_keys.reserve(capacity);
+    m_entries.reserve(capacity);
+}
+
+/*!
+ * \brief Returns whether the stored \a normalizedKey is ordered before the specified \a key.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline bool FlatFieldMap<KeyType, ValueType, KeyNormalizer>::isLess(const NormalizedKeyType &normalizedKey, const KeyType &key)
+{
+    return KeyNormalizer::compare(normalizedKey, key) < 0;
+}
+
+/*!
+ * \brief Returns whether the stored \a normalizedKey is ordered after the specified \a key.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline bool FlatFieldMap<KeyType, ValueType, KeyNormalizer>::isGreater(const NormalizedKeyType &normalizedKey, const KeyType &key)
+{
+    return KeyNormalizer::compare(normalizedKey, key) > 0;
+}
+
+/*!
+ * \brief Returns the index range of the entries with the specified \a key.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::indexRange(const KeyType &key) const -> std::pair<size_type, size_type>
+{
+    const auto first = std::lower_bound(m_keys.cbegin(), m_keys.cend(), key, &isLess);
+    const auto last = std::upper_bound(first, m_keys.cend(), key, [](const KeyType &value, const NormalizedKeyType &normalizedKey) {
+        return isGreater(normalizedKey, value);
+    });
+    return std::make_pair(static_cast<size_type>(first - m_keys.cbegin()), static_cast<size_type>(last - m_keys.cbegin()));
+}
+
+/*!
+ * \brief Returns an iterator to the first entry with the specified \a key or end() if there is no such entry.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::find(const KeyType &key) -> iterator
+{
+    const auto i = std::lower_bound(m_keys.cbegin(), m_keys.cend(), key, &isLess);
+    return i != m_keys.cend() && !isGreater(*i, key) ? m_entries.begin() + (i - m_keys.cbegin()) : m_entries.end();
+}
+
+/*!
+ * \brief Returns an iterator to the first entry with the specified \a key or end() if there is no such entry.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::find(const KeyType &key) const -> const_iterator
+{
+    const auto i = std::lower_bound(m_keys.cbegin(), m_keys.cend(), key, &isLess);
+    return i != m_keys.cend() && !isGreater(*i, key) ? m_entries.cbegin() + (i - m_keys.cbegin()) : m_entries.cend();
+}
+
+/*!
+ * \brief Returns the range of entries with the specified \a key.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::equal_range(const KeyType &key) -> std::pair<iterator, iterator>
+{
+    const auto range = indexRange(key);
+    return std::make_pair(m_entries.begin() + static_cast<std::ptrdiff_t>(range.first), m_entries.begin() + static_cast<std::ptrdiff_t>(range.second));
+}
+
+/*!
+ * \brief Returns the range of entries with the specified \a key.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::equal_range(const KeyType &key) const -> std::pair<const_iterator, const_iterator>
+{
+    const auto range = indexRange(key);
+    return std::make_pair(
+        m_entries.cbegin() + static_cast<std::ptrdiff_t>(range.first), m_entries.cbegin() + static_cast<std::ptrdiff_t>(range.second));
+}
+
+/*!
+ * \brief Returns the number of entries with the specified \a key.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::count(const KeyType &key) const -> size_type
+{
+    const auto range = indexRange(key);
+    return range.second - range.first;
+}
+
+/*!
+ * \brief Inserts the specified \a value after all entries with an equivalent key.
+ * \returns Returns an iterator to the inserted entry.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::insert(const value_type &value) -> iterator
+{
+    return insert(value_type(value));
+}
+
+/*!
+ * \brief Inserts the specified \a value after all entries with an equivalent key.
+ * \returns Returns an iterator to the inserted entry.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::insert(value_type &&value) -> iterator
+{
+    auto normalizedKey = NormalizedKeyType(KeyNormalizer::normalize(value.first));
+    const auto keyIterator = std::upper_bound(m_keys.cbegin(), m_keys.cend(), normalizedKey);
+    const auto index = keyIterator - m_keys.cbegin();
+    m_keys.insert(keyIterator, std::move(normalizedKey));
+    return m_entries.insert(m_entries.cbegin() + index, std::move(value));
+}
+
+/*!
+ * \brief Inserts the entries within the specified range after all entries with an equivalent key.
+ * \remarks
+ * - The entries are appended and sorted afterwards so inserting n entries into a map of m entries takes
+ *   O((n + m) log(n + m)) time rather than O(n * m) when inserting them one by one.
+ * - The order of entries with an equivalent key is preserved (existing entries first, then the inserted entries
+ *   in the order of the range).
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+template <typename InputIterator>
+void FlatFieldMap<KeyType, ValueType, KeyNormalizer>::insert(InputIterator first, InputIterator last)
+{
+    const auto previousSize = m_entries.size();
+    for (; first != last; ++first) {
+        m_entries.emplace_back(*first);
+        m_keys.emplace_back(KeyNormalizer::normalize(m_entries.back().first));
+    }
+    if (m_entries.size() == previousSize) {
+        return;
+    }
+
+    // determine the order of all entries by their key and move them into place
+    auto order = std::vector<size_type>(m_entries.size());
+    for (size_type index = 0, size = order.size(); index != size; ++index) {
+        order[index] = index;
+    }
+    std::stable_sort(order.begin(), order.end(), [this](size_type lhs, size_type rhs) { return m_keys[lhs] < m_keys[rhs]; });
+    auto keys = std::vector<NormalizedKeyType>();
+    auto entries = std::vector<value_type>();
+    keys.reserve(m_keys.capacity());
+    entries.reserve(m_entries.capacity());
+    for (const auto index : order) {
+        keys.emplace_back(std::move(m_keys[index]));
+        entries.emplace_back(std::move(m_entries[index]));
+    }
+    m_keys.swap(keys);
+    m_entries.swap(entries);
+}
+
+/*!
+ * \brief Constructs a new entry from the specified \a args and inserts it after all entries with an equivalent key.
+ * \returns Returns an iterator to the inserted entry.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+template <typename... Args>
+inline auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::emplace(Args &&...args) -> iterator
+{
+    return insert(value_type(std::forward<Args>(args)...));
+}
+
+/*!
+ * \brief Removes the entry at the specified \a pos.
+ * \returns Returns an iterator to the entry following the removed entry.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+inline auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::erase(const_iterator pos) -> iterator
+{
+    return erase(pos, pos + 1);
+}
+
+/*!
+ * \brief Removes the entries within the specified range.
+ * \returns Returns an iterator to the entry following the last removed entry.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::erase(const_iterator first, const_iterator last) -> iterator
+{
+    const auto firstKey = m_keys.cbegin() + (first - m_entries.cbegin());
+    m_keys.erase(firstKey, firstKey + (last - first));
+    return m_entries.erase(first, last);
+}
+
+/*!
+ * \brief Removes all entries with the specified \a key.
+ * \returns Returns the number of removed entries.
+ */
+template <typename KeyType, typename ValueType, typename KeyNormalizer>
+auto FlatFieldMap<KeyType, ValueType, KeyNormalizer>::erase(const KeyType &key) -> size_type
+{
+    const auto range = indexRange(key);
+    m_keys.erase(m_keys.cbegin() + static_cast<std::ptrdiff_t>(range.first), m_keys.cbegin() + static_cast<std::ptrdiff_t>(range.second));
+    m_entries.erase(
+        m_entries.cbegin() + static_cast<std::ptrdiff_t>(range.first), m_entries.cbegin() + static_cast<std::ptrdiff_t>(range.second));
+    return range.second - range.first;
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_FLATFIELDMAP_H
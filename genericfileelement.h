@@ -1,6 +1,7 @@
 #ifndef TAG_PARSER_GENERICFILEELEMENT_H
 #define TAG_PARSER_GENERICFILEELEMENT_H
 
+#include "./copyengine.h"
 #include "./exceptions.h"
 #include "./progressfeedback.h"
 
@@ -120,6 +121,7 @@ public:
     void copyHeader(std::ostream &targetStream, Diagnostics &diag, AbortableProgressFeedback *progress);
     void copyWithoutChilds(std::ostream &targetStream, Diagnostics &diag, AbortableProgressFeedback *progress);
     void copyEntirely(std::ostream &targetStream, Diagnostics &diag, AbortableProgressFeedback *progress);
+    void copyEntirely(CopyEngine &copyEngine, std::ostream &targetStream, Diagnostics &diag);
     void makeBuffer();
     void discardBuffer();
     void copyBuffer(std::ostream &targetStream);
@@ -864,6 +866,22 @@ void GenericFileElement<ImplementationType>::copyEntirely(std::ostream &targetSt
     copyInternal(targetStream, startOffset(), totalSize(), diag, progress);
 }
 
+/*!
+ * \brief Submits copying the entire element including all children to the current position of \a targetStream via the specified \a copyEngine.
+ * \remarks The \a targetStream is seeked behind the element; the data is only written after CopyEngine::finish() returned.
+ */
+template <class ImplementationType>
+void GenericFileElement<ImplementationType>::copyEntirely(CopyEngine &copyEngine, std::ostream &targetStream, Diagnostics &diag)
+{
+    // ensure the header has been parsed correctly
+    try {
+        parse(diag);
+    } catch (const Failure &) {
+        throw InvalidDataException();
+    }
+    copyEngine.submit(targetStream, startOffset(), totalSize());
+}
+
 /*!
  * \brief Buffers the element (header and data).
  * \remarks The element must have been parsed.
@@ -24,8 +24,12 @@ template <typename ImplementationType> class TagFieldTraits {
  * particular tag implementation.
  *
  * \tparam ImplementationType Specifies the type of the actual implementation.
- * \remarks This template class is intended to be subclassed using
- *          with the "Curiously recurring template pattern".
+ * \remarks
+ * - This template class is intended to be subclassed using
+ *   with the "Curiously recurring template pattern".
+ * - An implementation might decode the value, the default flag and the nested fields lazily by providing
+ *   internallyDecode(). It is invoked by all accessors of these (and before changing the ID). So accessing
+ *   them concurrently is not thread-safe, even via a const reference.
  */
 template <class ImplementationType> class TAG_PARSER_EXPORT TagField {
     friend class TagFieldTraits<ImplementationType>;
@@ -64,16 +68,20 @@ public:
     std::vector<ImplementationType> &nestedFields();
     bool supportsNestedFields() const;
 
+protected:
+    void internallyDecode(TagValue &value, bool &isDefault, std::vector<ImplementationType> &nestedFields) const;
+
 private:
     void cleared();
+    void ensureDecoded() const;
 
 private:
     IdentifierType m_id;
-    TagValue m_value;
+    mutable TagValue m_value;
     TypeInfoType m_typeInfo;
     bool m_typeInfoAssigned;
-    bool m_default;
-    std::vector<ImplementationType> m_nestedFields;
+    mutable bool m_default;
+    mutable std::vector<ImplementationType> m_nestedFields;
 };
 
 /*!
@@ -127,6 +135,7 @@ template <class ImplementationType> inline std::string TagField<ImplementationTy
  */
 template <class ImplementationType> inline void TagField<ImplementationType>::setId(const IdentifierType &id)
 {
+    ensureDecoded();
     m_id = id;
 }
 
@@ -135,6 +144,7 @@ template <class ImplementationType> inline void TagField<ImplementationType>::se
  */
 template <class ImplementationType> inline void TagField<ImplementationType>::clearId()
 {
+    ensureDecoded();
     m_id = IdentifierType();
 }
 
@@ -143,6 +153,7 @@ template <class ImplementationType> inline void TagField<ImplementationType>::cl
  */
 template <class ImplementationType> inline TagValue &TagField<ImplementationType>::value()
 {
+    ensureDecoded();
     return m_value;
 }
 
@@ -151,6 +162,7 @@ template <class ImplementationType> inline TagValue &TagField<ImplementationType
  */
 template <class ImplementationType> inline const TagValue &TagField<ImplementationType>::value() const
 {
+    ensureDecoded();
     return m_value;
 }
 
@@ -159,6 +171,7 @@ template <class ImplementationType> inline const TagValue &TagField<Implementati
  */
 template <class ImplementationType> inline void TagField<ImplementationType>::setValue(const TagValue &value)
 {
+    ensureDecoded();
     m_value = value;
 }
 
@@ -167,6 +180,7 @@ template <class ImplementationType> inline void TagField<ImplementationType>::se
  */
 template <class ImplementationType> inline void TagField<ImplementationType>::clearValue()
 {
+    ensureDecoded();
     m_value.clearDataAndMetadata();
 }
 
@@ -209,6 +223,7 @@ template <class ImplementationType> inline bool TagField<ImplementationType>::is
  */
 template <class ImplementationType> inline bool TagField<ImplementationType>::isDefault() const
 {
+    ensureDecoded();
     return m_default;
 }
 
@@ -217,6 +232,7 @@ template <class ImplementationType> inline bool TagField<ImplementationType>::is
  */
 template <class ImplementationType> inline void TagField<ImplementationType>::setDefault(bool isDefault)
 {
+    ensureDecoded();
     m_default = isDefault;
 }
 
@@ -225,12 +241,13 @@ template <class ImplementationType> inline void TagField<ImplementationType>::se
  */
 template <class ImplementationType> void TagField<ImplementationType>::clear()
 {
+    // reset implementation specific values first so there's nothing left to be decoded
+    static_cast<ImplementationType *>(this)->reset();
     clearId();
     clearValue();
     m_typeInfo = TypeInfoType();
     m_typeInfoAssigned = false;
     m_default = true;
-    static_cast<ImplementationType *>(this)->reset();
 }
 
 /*!
@@ -249,6 +266,7 @@ template <class ImplementationType> inline bool TagField<ImplementationType>::is
  */
 template <class ImplementationType> const std::vector<ImplementationType> &TagField<ImplementationType>::nestedFields() const
 {
+    ensureDecoded();
     return m_nestedFields;
 }
 
@@ -259,6 +277,7 @@ template <class ImplementationType> const std::vector<ImplementationType> &TagFi
  */
 template <class ImplementationType> inline std::vector<ImplementationType> &TagField<ImplementationType>::nestedFields()
 {
+    ensureDecoded();
     return m_nestedFields;
 }
 
@@ -270,6 +289,17 @@ template <class ImplementationType> inline bool TagField<ImplementationType>::su
     return static_cast<ImplementationType *>(this)->supportsNestedFields();
 }
 
+/*!
+ * \brief Decodes the value, the default flag and the nested fields into the specified references if not done yet.
+ *
+ * The default implementation does nothing. The method might be hidden by implementations decoding lazily. It must
+ * only assign the specified values and must not call accessors of the field.
+ */
+template <class ImplementationType>
+inline void TagField<ImplementationType>::internallyDecode(TagValue &, bool &, std::vector<ImplementationType> &) const
+{
+}
+
 /*!
  * \brief Called when the field is cleared.
  */
@@ -277,6 +307,14 @@ template <class ImplementationType> inline void TagField<ImplementationType>::cl
 {
 }
 
+/*!
+ * \brief Lets the implementation decode the value, the default flag and the nested fields if not done yet.
+ */
+template <class ImplementationType> inline void TagField<ImplementationType>::ensureDecoded() const
+{
+    static_cast<const ImplementationType *>(this)->internallyDecode(m_value, m_default, m_nestedFields);
+}
+
 } // namespace TagParser
 
 #endif // TAG_PARSER_TAGFIELD_H
@@ -133,8 +133,8 @@ u16string wideStringFromSubstring(tuple<const char *, size_t, const char *> subs
  */
 void Id3v2Frame::parse(BinaryReader &reader, std::uint32_t version, std::uint32_t maximalSize, Diagnostics &diag)
 {
-    static const string defaultContext("parsing ID3v2 frame");
-    string context;
+    // format the context only when a message is actually added (the ID is determined before the first message might be added)
+    const auto context = [this] { return "parsing " % idToString() + " frame"; };
 
     // parse header
     if (version < 3) {
@@ -149,9 +149,6 @@ void Id3v2Frame::parse(BinaryReader &reader, std::uint32_t version, std::uint32_
             throw NoDataFoundException();
         }
 
-        // -> update context
-        context = "parsing " % idToString() + " frame";
-
         // -> read size, check whether frame is truncated
         m_dataSize = reader.readUInt24BE();
         m_totalSize = m_dataSize + 6;
@@ -176,9 +173,6 @@ void Id3v2Frame::parse(BinaryReader &reader, std::uint32_t version, std::uint32_
             throw NoDataFoundException();
         }
 
-        // -> update context
-        context = "parsing " % idToString() + " frame";
-
         // -> read size, check whether frame is truncated
         m_dataSize = version >= 4 ? reader.readSynchsafeUInt32BE() : reader.readUInt32BE();
         m_totalSize = m_dataSize + 10;
@@ -438,7 +432,7 @@ Id3v2FrameMaker::Id3v2FrameMaker(Id3v2Frame &frame, std::uint8_t version, Diagno
     , m_frameId(m_frame.id())
     , m_version(version)
 {
-    const string context("making " % m_frame.idToString() + " frame");
+    const auto context = [this] { return "making " % m_frame.idToString() + " frame"; };
 
     // validate frame's configuration
     if (m_frame.isEncrypted()) {
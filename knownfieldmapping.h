@@ -0,0 +1,254 @@
+#ifndef TAG_PARSER_KNOWNFIELDMAPPING_H
+#define TAG_PARSER_KNOWNFIELDMAPPING_H
+
+#include "./caseinsensitivecomparer.h"
+#include "./tag.h"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace TagParser {
+
+/*!
+ * \brief The FieldMappingDirection enum specifies in which direction a FieldIdMapping is used.
+ */
+enum class FieldMappingDirection : std::uint8_t {
+    Both, /**< the mapping is used to determine the ID for a KnownField and vice versa */
+    ToIdOnly, /**< the mapping is only used to determine the ID for a KnownField (e.g. for a deprecated KnownField like KnownField::Year) */
+    ToKnownFieldOnly, /**< the mapping is only used to determine the KnownField for an ID (e.g. for an inofficial ID) */
+};
+
+/*!
+ * \brief The FieldIdMapping struct is an entry of the table a KnownFieldMapping is constructed from.
+ */
+template <typename IdentifierType> struct FieldIdMapping {
+    IdentifierType id;
+    KnownField field;
+    FieldMappingDirection direction = FieldMappingDirection::Both;
+};
+
+/*!
+ * \brief The FieldIdHash struct defines hashing and comparison of string IDs for a KnownFieldMapping.
+ */
+struct TAG_PARSER_EXPORT FieldIdHash {
+    using IdentifierType = std::string_view;
+
+    static constexpr std::uint32_t hash(IdentifierType id, std::uint32_t seed)
+    {
+        auto hash = static_cast<std::uint32_t>(2166136261u ^ seed);
+        for (const auto c : id) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        return hash ^ (hash >> 15);
+    }
+    static constexpr bool equals(IdentifierType lhs, IdentifierType rhs)
+    {
+        return lhs == rhs;
+    }
+};
+
+/*!
+ * \brief The CaseInsensitiveFieldIdHash struct defines case-insensitive hashing and comparison of string IDs for a KnownFieldMapping.
+ */
+struct TAG_PARSER_EXPORT CaseInsensitiveFieldIdHash {
+    using IdentifierType = std::string_view;
+
+    static constexpr std::uint32_t hash(IdentifierType id, std::uint32_t seed)
+    {
+        auto hash = static_cast<std::uint32_t>(2166136261u ^ seed);
+        for (const auto c : id) {
+            hash = (hash ^ CaseInsensitiveCharComparer::toLower(static_cast<unsigned char>(c))) * 16777619u;
+        }
+        return hash ^ (hash >> 15);
+    }
+    static constexpr bool equals(IdentifierType lhs, IdentifierType rhs)
+    {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        for (std::size_t i = 0, size = lhs.size(); i != size; ++i) {
+            if (CaseInsensitiveCharComparer::toLower(static_cast<unsigned char>(lhs[i]))
+                != CaseInsensitiveCharComparer::toLower(static_cast<unsigned char>(rhs[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/*!
+ * \brief The IntegerFieldIdHash struct defines hashing and comparison of integral IDs (e.g. MP4 atom IDs) for a KnownFieldMapping.
+ */
+struct TAG_PARSER_EXPORT IntegerFieldIdHash {
+    using IdentifierType = std::uint32_t;
+
+    static constexpr std::uint32_t hash(IdentifierType id, std::uint32_t seed)
+    {
+        // use finalizer of MurmurHash3 so all bits of the ID affect the lower bits used as slot index
+        auto hash = static_cast<std::uint32_t>(id ^ seed);
+        hash = (hash ^ (hash >> 16)) * 0x85EBCA6Bu;
+        hash = (hash ^ (hash >> 13)) * 0xC2B2AE35u;
+        return hash ^ (hash >> 16);
+    }
+    static constexpr bool equals(IdentifierType lhs, IdentifierType rhs)
+    {
+        return lhs == rhs;
+    }
+};
+
+/*!
+ * \class TagParser::KnownFieldMapping
+ * \brief The KnownFieldMapping class maps format-specific field IDs to KnownField values and vice versa.
+ *
+ * The mapping is constructed at compile-time from a single table of FieldIdMapping entries. Mapping a KnownField
+ * to its ID is a plain array access. Mapping an ID to a KnownField uses a perfect hash table: the constructor
+ * searches for a seed which makes the specified \a Hash place all IDs in distinct slots. So a lookup takes only
+ * one hash computation and one comparison and never allocates.
+ *
+ * \remarks
+ * - Use makeKnownFieldMapping() to create an instance and check isValid() via static_assert. A mapping is not valid
+ *   if the table contains conflicting entries (e.g. the same ID twice) or no seed could be found.
+ * - Use the FieldMappingDirection to add aliases which should only be considered in one direction.
+ */
+template <typename Hash, std::size_t entryCount> class KnownFieldMapping {
+public:
+    using IdentifierType = typename Hash::IdentifierType;
+
+    constexpr explicit KnownFieldMapping(const FieldIdMapping<IdentifierType> (&entries)[entryCount]);
+
+    constexpr bool isValid() const;
+    constexpr IdentifierType id(KnownField field) const;
+    constexpr KnownField knownField(IdentifierType id) const;
+
+private:
+    struct Slot {
+        IdentifierType id = IdentifierType();
+        KnownField field = KnownField::Invalid;
+    };
+    static constexpr std::size_t computeSlotCount();
+    static constexpr std::size_t slotCount = computeSlotCount();
+    static constexpr std::uint32_t maxSeed = 0x10000;
+
+    std::array<IdentifierType, knownFieldArraySize> m_ids;
+    std::array<bool, knownFieldArraySize> m_idAssigned;
+    std::array<Slot, slotCount> m_slots;
+    std::uint32_t m_seed;
+    bool m_valid;
+};
+
+/*!
+ * \brief Returns the number of slots used for the perfect hash table: at least four times the number of entries, rounded up
+ *        to the next power of two so the slot index can be computed via masking.
+ */
+template <typename Hash, std::size_t entryCount> constexpr std::size_t KnownFieldMapping<Hash, entryCount>::computeSlotCount()
+{
+    std::size_t count = 1;
+    while (count < entryCount * 4) {
+        count <<= 1;
+    }
+    return count;
+}
+
+/*!
+ * \brief Constructs the mapping from the specified \a entries.
+ */
+template <typename Hash, std::size_t entryCount>
+constexpr KnownFieldMapping<Hash, entryCount>::KnownFieldMapping(const FieldIdMapping<IdentifierType> (&entries)[entryCount])
+    : m_ids()
+    , m_idAssigned()
+    , m_slots()
+    , m_seed(0)
+    , m_valid(true)
+{
+    // populate array for mapping KnownField to ID
+    for (const auto &entry : entries) {
+        if (entry.direction == FieldMappingDirection::ToKnownFieldOnly) {
+            continue;
+        }
+        const auto index = static_cast<std::size_t>(entry.field);
+        if (index >= knownFieldArraySize || m_idAssigned[index]) {
+            m_valid = false; // invalid field or field mapped twice
+            return;
+        }
+        m_ids[index] = entry.id;
+        m_idAssigned[index] = true;
+    }
+
+    // ensure each ID is only mapped to one KnownField (otherwise no seed could be found)
+    for (std::size_t i = 0; i != entryCount; ++i) {
+        if (entries[i].direction == FieldMappingDirection::ToIdOnly) {
+            continue;
+        }
+        for (std::size_t j = i + 1; j != entryCount; ++j) {
+            if (entries[j].direction != FieldMappingDirection::ToIdOnly && Hash::equals(entries[i].id, entries[j].id)) {
+                m_valid = false;
+                return;
+            }
+        }
+    }
+
+    // search for a seed which maps all IDs to distinct slots
+    for (; m_seed != maxSeed; ++m_seed) {
+        auto collision = false;
+        for (auto &slot : m_slots) {
+            slot = Slot();
+        }
+        for (const auto &entry : entries) {
+            if (entry.direction == FieldMappingDirection::ToIdOnly) {
+                continue;
+            }
+            auto &slot = m_slots[Hash::hash(entry.id, m_seed) & (slotCount - 1)];
+            if (slot.field != KnownField::Invalid) {
+                collision = true;
+                break;
+            }
+            slot.id = entry.id;
+            slot.field = entry.field;
+        }
+        if (!collision) {
+            return;
+        }
+    }
+    m_valid = false;
+}
+
+/*!
+ * \brief Returns whether the mapping could be constructed without conflicts.
+ */
+template <typename Hash, std::size_t entryCount> constexpr bool KnownFieldMapping<Hash, entryCount>::isValid() const
+{
+    return m_valid;
+}
+
+/*!
+ * \brief Returns the ID for the specified \a field or a default-constructed ID if there is no mapping for \a field.
+ */
+template <typename Hash, std::size_t entryCount>
+constexpr auto KnownFieldMapping<Hash, entryCount>::id(KnownField field) const -> IdentifierType
+{
+    const auto index = static_cast<std::size_t>(field);
+    return index < knownFieldArraySize ? m_ids[index] : IdentifierType();
+}
+
+/*!
+ * \brief Returns the KnownField for the specified \a id or KnownField::Invalid if there is no mapping for \a id.
+ */
+template <typename Hash, std::size_t entryCount> constexpr KnownField KnownFieldMapping<Hash, entryCount>::knownField(IdentifierType id) const
+{
+    const auto &slot = m_slots[Hash::hash(id, m_seed) & (slotCount - 1)];
+    return slot.field != KnownField::Invalid && Hash::equals(slot.id, id) ? slot.field : KnownField::Invalid;
+}
+
+/*!
+ * \brief Constructs a KnownFieldMapping from the specified \a entries using the specified \a Hash.
+ */
+template <typename Hash, std::size_t entryCount>
+constexpr KnownFieldMapping<Hash, entryCount> makeKnownFieldMapping(const FieldIdMapping<typename Hash::IdentifierType> (&entries)[entryCount])
+{
+    return KnownFieldMapping<Hash, entryCount>(entries);
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_KNOWNFIELDMAPPING_H
@@ -0,0 +1,247 @@
+#include "./ebmlcrc32.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <istream>
+#include <memory>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TAG_PARSER_EBML_CRC32_PCLMUL
+#include <immintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#define TAG_PARSER_EBML_CRC32_ARM
+#include <arm_acle.h>
+#endif
+
+using namespace std;
+
+namespace TagParser {
+
+/*!
+ * \class TagParser::EbmlCrc32
+ * \brief The EbmlCrc32 class computes the checksums stored in "CRC-32"-elements.
+ *
+ * EBML uses the CRC-32 defined by IEEE 802.3 (reflected polynomial 0xEDB88320, initial value and final XOR 0xFFFFFFFF)
+ * which is also used by zlib. Note that this is not the CRC-32 used by Ogg (see OggPage::computeChecksum()).
+ *
+ * The data is processed by the fastest implementation available:
+ * - On x86 CPUs supporting PCLMULQDQ (and SSE 4.1) blocks of 64 byte are folded via carry-less multiplication. The
+ *   support is detected at runtime.
+ * - On ARMv8 CPUs with the CRC extension (if enabled at compile time) the CRC32 instructions are used.
+ * - Otherwise, the slicing-by-16 algorithm is used which processes 16 byte per iteration using 16 lookup tables.
+ *
+ * All implementations yield the same result so the data might be passed in chunks of arbitrary size.
+ */
+
+/// \cond
+namespace {
+
+using Crc32Tables = array<array<std::uint32_t, 256>, 16>;
+
+/*!
+ * \brief Computes the lookup tables for the slicing-by-16 algorithm.
+ * \remarks The 1st table is the regular byte-wise table; each subsequent table advances the previous one by a zero byte.
+ */
+constexpr Crc32Tables makeTables()
+{
+    auto tables = Crc32Tables();
+    for (std::uint32_t i = 0; i != 256; ++i) {
+        auto crc = i;
+        for (auto bit = 0; bit != 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+        tables[0][i] = crc;
+    }
+    for (std::size_t table = 1; table != tables.size(); ++table) {
+        for (std::size_t i = 0; i != 256; ++i) {
+            const auto previous = tables[table - 1][i];
+            tables[table][i] = (previous >> 8) ^ tables[0][previous & 0xFF];
+        }
+    }
+    return tables;
+}
+
+#if !defined(TAG_PARSER_EBML_CRC32_ARM)
+constexpr auto tables = makeTables();
+
+std::uint32_t updateBytewise(std::uint32_t crc, const unsigned char *data, std::size_t size)
+{
+    for (const auto *const end = data + size; data != end; ++data) {
+        crc = (crc >> 8) ^ tables[0][(crc ^ *data) & 0xFF];
+    }
+    return crc;
+}
+
+std::uint32_t updateSlicingBy16(std::uint32_t crc, const unsigned char *data, std::size_t size)
+{
+    for (; size >= 16; data += 16, size -= 16) {
+        crc ^= static_cast<std::uint32_t>(data[0]) | (static_cast<std::uint32_t>(data[1]) << 8) | (static_cast<std::uint32_t>(data[2]) << 16)
+            | (static_cast<std::uint32_t>(data[3]) << 24);
+        crc = tables[15][crc & 0xFF] ^ tables[14][(crc >> 8) & 0xFF] ^ tables[13][(crc >> 16) & 0xFF] ^ tables[12][crc >> 24] ^ tables[11][data[4]]
+            ^ tables[10][data[5]] ^ tables[9][data[6]] ^ tables[8][data[7]] ^ tables[7][data[8]] ^ tables[6][data[9]] ^ tables[5][data[10]]
+            ^ tables[4][data[11]] ^ tables[3][data[12]] ^ tables[2][data[13]] ^ tables[1][data[14]] ^ tables[0][data[15]];
+    }
+    return updateBytewise(crc, data, size);
+}
+#endif
+
+#if defined(TAG_PARSER_EBML_CRC32_PCLMUL)
+/*!
+ * \brief Returns whether the CPU supports the instructions used by updatePclmul().
+ */
+bool hasPclmul()
+{
+    static const auto supported = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    return supported;
+}
+
+__attribute__((target("pclmul,sse4.1"))) inline __m128i load(const unsigned char *block)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+}
+
+/*!
+ * \brief Folds the 128 bit \a value forward using the specified \a constants and adds the \a next block.
+ */
+__attribute__((target("pclmul,sse4.1"))) inline __m128i fold(__m128i value, __m128i constants, __m128i next)
+{
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(value, constants, 0x11), _mm_clmulepi64_si128(value, constants, 0x00)), next);
+}
+
+/*!
+ * \brief Folds the specified \a data into \a crc via carry-less multiplication.
+ * \remarks
+ * - \a size must be at least 64 and a multiple of 16.
+ * - The constants are the powers of x modulo the polynomial as described in Intel's paper "Fast CRC Computation for
+ *   Generic Polynomials Using PCLMULQDQ Instruction" (for the bit-reflected domain).
+ */
+__attribute__((target("pclmul,sse4.1"))) std::uint32_t updatePclmul(std::uint32_t crc, const unsigned char *data, std::size_t size)
+{
+    const auto k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+    const auto k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+    const auto k5k0 = _mm_set_epi64x(0x0000000000, 0x0163CD6124);
+    const auto poly = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+    const auto lowerMask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    // fold four blocks of 16 byte in parallel
+    auto x1 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(crc)));
+    auto x2 = load(data + 16), x3 = load(data + 32), x4 = load(data + 48);
+    for (data += 64, size -= 64; size >= 64; data += 64, size -= 64) {
+        x1 = fold(x1, k1k2, load(data));
+        x2 = fold(x2, k1k2, load(data + 16));
+        x3 = fold(x3, k1k2, load(data + 32));
+        x4 = fold(x4, k1k2, load(data + 48));
+    }
+
+    // fold the four blocks into one and then fold the remaining blocks of 16 byte
+    x1 = fold(x1, k3k4, x2);
+    x1 = fold(x1, k3k4, x3);
+    x1 = fold(x1, k3k4, x4);
+    for (; size >= 16; data += 16, size -= 16) {
+        x1 = fold(x1, k3k4, load(data));
+    }
+
+    // fold 128 bit to 64 bit
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, lowerMask), k5k0, 0x00), x2);
+
+    // reduce to 32 bit via Barrett reduction
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, lowerMask), poly, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, lowerMask), poly, 0x00);
+    return static_cast<std::uint32_t>(_mm_extract_epi32(_mm_xor_si128(x1, x2), 1));
+}
+#elif defined(TAG_PARSER_EBML_CRC32_ARM)
+std::uint32_t updateArm(std::uint32_t crc, const unsigned char *data, std::size_t size)
+{
+    for (; size >= 8; data += 8, size -= 8) {
+        std::uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        crc = __crc32d(crc, value);
+    }
+    for (; size; ++data, --size) {
+        crc = __crc32b(crc, *data);
+    }
+    return crc;
+}
+#endif
+
+} // namespace
+/// \endcond
+
+/*!
+ * \brief Processes the \a size bytes at \a data.
+ */
+void EbmlCrc32::update(const char *data, std::size_t size)
+{
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+#if defined(TAG_PARSER_EBML_CRC32_PCLMUL)
+    if (size >= 64 && hasPclmul()) {
+        const auto foldedSize = size & ~static_cast<std::size_t>(15);
+        m_state = updatePclmul(m_state, bytes, foldedSize);
+        bytes += foldedSize;
+        size -= foldedSize;
+    }
+    m_state = updateSlicingBy16(m_state, bytes, size);
+#elif defined(TAG_PARSER_EBML_CRC32_ARM)
+    m_state = updateArm(m_state, bytes, size);
+#else
+    m_state = updateSlicingBy16(m_state, bytes, size);
+#endif
+}
+
+/*!
+ * \brief Reads and processes \a size bytes from the current read position of the specified \a stream.
+ * \remarks The data is read in chunks of at most EbmlCrc32::bufferSize bytes.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void EbmlCrc32::update(std::istream &stream, std::uint64_t size)
+{
+    const auto buffer = make_unique<char[]>(static_cast<std::size_t>(min<std::uint64_t>(size, bufferSize)));
+    while (size) {
+        const auto chunkSize = static_cast<std::size_t>(min<std::uint64_t>(size, bufferSize));
+        stream.read(buffer.get(), static_cast<streamsize>(chunkSize));
+        update(buffer.get(), chunkSize);
+        size -= chunkSize;
+    }
+}
+
+/*!
+ * \brief Returns the checksum of the \a size bytes at \a data.
+ */
+std::uint32_t EbmlCrc32::compute(const char *data, std::size_t size)
+{
+    auto crc = EbmlCrc32();
+    crc.update(data, size);
+    return crc.value();
+}
+
+/*!
+ * \brief Returns the checksum of \a size bytes read from the current read position of the specified \a stream.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+std::uint32_t EbmlCrc32::compute(std::istream &stream, std::uint64_t size)
+{
+    auto crc = EbmlCrc32();
+    crc.update(stream, size);
+    return crc.value();
+}
+
+/*!
+ * \brief Returns the name of the implementation used on the current CPU, e.g. for debugging output.
+ */
+const char *EbmlCrc32::implementation()
+{
+#if defined(TAG_PARSER_EBML_CRC32_PCLMUL)
+    if (hasPclmul()) {
+        return "PCLMULQDQ";
+    }
+#elif defined(TAG_PARSER_EBML_CRC32_ARM)
+    return "ARMv8 CRC32";
+#endif
+    return "slicing-by-16";
+}
+
+} // namespace TagParser
@@ -0,0 +1,58 @@
+#ifndef TAG_PARSER_EBMLCRC32_H
+#define TAG_PARSER_EBMLCRC32_H
+
+#include "../global.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+namespace TagParser {
+
+class TAG_PARSER_EXPORT EbmlCrc32 {
+public:
+    static constexpr std::size_t bufferSize = 0x40000;
+
+    constexpr EbmlCrc32();
+
+    void update(const char *data, std::size_t size);
+    void update(std::istream &stream, std::uint64_t size);
+    constexpr std::uint32_t value() const;
+    constexpr void reset();
+
+    static std::uint32_t compute(const char *data, std::size_t size);
+    static std::uint32_t compute(std::istream &stream, std::uint64_t size);
+    static const char *implementation();
+
+private:
+    std::uint32_t m_state;
+};
+
+/*!
+ * \brief Constructs a new engine; value() returns the checksum of no data (which is zero).
+ */
+constexpr EbmlCrc32::EbmlCrc32()
+    : m_state(0xFFFFFFFF)
+{
+}
+
+/*!
+ * \brief Returns the checksum of the data passed to update() so far.
+ * \remarks The value is stored in little-endian byte order within "CRC-32"-elements.
+ */
+constexpr std::uint32_t EbmlCrc32::value() const
+{
+    return m_state ^ 0xFFFFFFFF;
+}
+
+/*!
+ * \brief Discards the data passed to update() so far.
+ */
+constexpr void EbmlCrc32::reset()
+{
+    m_state = 0xFFFFFFFF;
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_EBMLCRC32_H
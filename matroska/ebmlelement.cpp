@@ -1,10 +1,13 @@
 #include "./ebmlelement.h"
+#include "./ebmlheaderdecoder.h"
+#include "./ebmlresyncscanner.h"
 #include "./ebmlid.h"
 #include "./matroskacontainer.h"
 #include "./matroskaid.h"
 
 #include "../exceptions.h"
 #include "../mediafileinfo.h"
+#include "../mediafilestatistics.h"
 
 #include <c++utilities/conversion/binaryconversion.h>
 #include <c++utilities/io/binaryreader.h>
@@ -24,10 +27,15 @@ namespace TagParser {
 /*!
  * \class TagParser::EbmlElement
  * \brief The EbmlElement class helps to parse EBML files such as Matroska files.
+ *
+ * The header is decoded via EbmlHeaderDecoder from a small window of the file which is read at once. The window
+ * covers the data of elements up to 8 bytes as well so readUInteger(), readFloat() and readString() do not need to
+ * access the stream again for those.
  */
 
 /*!
  * \brief Specifies the number of bytes to be skipped till a valid EBML element is found in the stream.
+ * \remarks Top-level and level 1 elements are found via EbmlResyncScanner instead which is not limited by this value.
  */
 std::uint64_t EbmlElement::bytesToBeSkipped = 0x4000;
 
@@ -36,6 +44,8 @@ std::uint64_t EbmlElement::bytesToBeSkipped = 0x4000;
  */
 EbmlElement::EbmlElement(MatroskaContainer &container, std::uint64_t startOffset)
     : GenericFileElement<EbmlElement>(container, startOffset)
+    , m_bufferedValue(0)
+    , m_valueBuffered(false)
 {
 }
 
@@ -44,6 +54,8 @@ EbmlElement::EbmlElement(MatroskaContainer &container, std::uint64_t startOffset
  */
 EbmlElement::EbmlElement(MatroskaContainer &container, std::uint64_t startOffset, std::uint64_t maxSize)
     : GenericFileElement<EbmlElement>(container, startOffset, maxSize)
+    , m_bufferedValue(0)
+    , m_valueBuffered(false)
 {
 }
 
@@ -52,6 +64,8 @@ EbmlElement::EbmlElement(MatroskaContainer &container, std::uint64_t startOffset
  */
 EbmlElement::EbmlElement(EbmlElement &parent, std::uint64_t startOffset)
     : GenericFileElement<EbmlElement>(parent, startOffset)
+    , m_bufferedValue(0)
+    , m_valueBuffered(false)
 {
 }
 
@@ -69,38 +83,72 @@ string EbmlElement::parsingContext() const
 void EbmlElement::internalParse(Diagnostics &diag)
 {
     static const string context("parsing EBML element header");
+    if (auto *const statistics = container().statistics()) {
+        ++statistics->elementsParsed;
+    }
 
+    m_valueBuffered = false;
+    // top-level and level 1 elements (e.g. "Cluster") can be found via the resync scanner when the header is invalid
+    const auto resyncLevel = !m_parent ? MatroskaElementLevel::TopLevel
+                                       : (m_parent->id() == MatroskaIds::Segment ? MatroskaElementLevel::Level1 : MatroskaElementLevel::Unknown);
     for (std::uint64_t skipped = 0; skipped < bytesToBeSkipped; ++m_startOffset, --m_maxSize, ++skipped) {
         // check whether max size is valid
         if (maxTotalSize() < 2) {
             diag.emplace_back(DiagLevel::Critical, argsToString("The EBML element at ", startOffset(), " is truncated or does not exist."), context);
             throw TruncatedDataException();
         }
-        stream().seekg(static_cast<streamoff>(startOffset()));
 
-        // read ID
-        char buf[maximumIdLengthSupported() > maximumSizeLengthSupported() ? maximumIdLengthSupported() : maximumSizeLengthSupported()] = { 0 };
-        std::uint8_t beg = static_cast<std::uint8_t>(stream().peek()), mask = 0x80;
-        m_idLength = 1;
-        while (m_idLength <= maximumIdLengthSupported() && (beg & mask) == 0) {
-            ++m_idLength;
-            mask >>= 1;
+        // find the next plausible element in one pass instead of trying byte by byte (not limited by bytesToBeSkipped)
+        if (skipped == 1 && resyncLevel != MatroskaElementLevel::Unknown) {
+            auto scanner = EbmlResyncScanner(stream(), static_cast<std::uint8_t>(min<std::uint64_t>(container().maxIdLength(), 4)),
+                static_cast<std::uint8_t>(min<std::uint64_t>(container().maxSizeLength(), 8)));
+            const auto elementOffset = scanner.findElement(startOffset(), startOffset() + maxTotalSize(), resyncLevel);
+            if (!elementOffset) {
+                diag.emplace_back(DiagLevel::Critical,
+                    argsToString("Unable to find a valid element after the invalid EBML header at ", startOffset() - 1, '.'), context);
+                break;
+            }
+            const auto distance = *elementOffset - startOffset();
+            m_startOffset += distance;
+            m_maxSize -= distance;
+            skipped += distance;
         }
-        if (m_idLength > maximumIdLengthSupported()) {
+
+        // read the header and the data of small elements at once and decode the header
+        char window[EbmlHeaderDecoder::maxHeaderSize + sizeof(m_bufferedValue)];
+        const auto windowSize = static_cast<std::size_t>(min<std::uint64_t>(maxTotalSize(), sizeof(window)));
+        stream().seekg(static_cast<streamoff>(startOffset()));
+        stream().read(window, static_cast<streamsize>(windowSize));
+        auto header = EbmlHeader();
+        const auto status = EbmlHeaderDecoder::decode(window, windowSize, header, maximumIdLengthSupported(), maximumSizeLengthSupported());
+        switch (status) {
+        case EbmlHeaderStatus::Ok:
+            break;
+        case EbmlHeaderStatus::InvalidIdLength:
             if (!skipped) {
                 diag.emplace_back(
                     DiagLevel::Critical, argsToString("EBML ID length at ", startOffset(), " is not supported, trying to skip."), context);
             }
             continue; // try again
+        case EbmlHeaderStatus::InvalidSizeLength:
+            if (!skipped) {
+                diag.emplace_back(DiagLevel::Critical, "EBML size length is not supported.", parsingContext());
+            }
+            continue; // try again
+        case EbmlHeaderStatus::Truncated:
+            if (!skipped) {
+                diag.emplace_back(DiagLevel::Critical, "EBML header seems to be truncated.", parsingContext());
+            }
+            continue; // try again
         }
+        m_idLength = header.idLength;
         if (m_idLength > container().maxIdLength()) {
             if (!skipped) {
                 diag.emplace_back(DiagLevel::Critical, argsToString("EBML ID length at ", startOffset(), " is invalid, trying to skip."), context);
             }
             continue; // try again
         }
-        reader().read(buf + (maximumIdLengthSupported() - m_idLength), m_idLength);
-        m_id = BE::toUInt32(buf);
+        m_id = header.id;
 
         // check whether this element is actually a sibling of one of its parents rather then a child
         // (might be the case if the parent's size is unknown and hence assumed to be the max file size)
@@ -142,52 +190,36 @@ void EbmlElement::internalParse(Diagnostics &diag)
             }
         }
 
-        // read size
-        beg = static_cast<std::uint8_t>(stream().peek());
-        mask = 0x80;
-        m_sizeLength = 1;
-        if ((m_sizeUnknown = (beg == 0xFF))) {
+        // take over size
+        m_sizeLength = header.sizeLength;
+        if ((m_sizeUnknown = header.sizeUnknown)) {
             // this indicates that the element size is unknown
             // -> just assume the element takes the maximum available size
             m_dataSize = maxTotalSize() - headerSize();
         } else {
-            while (m_sizeLength <= maximumSizeLengthSupported() && (beg & mask) == 0) {
-                ++m_sizeLength;
-                mask >>= 1;
-            }
-            if (m_sizeLength > maximumSizeLengthSupported()) {
-                if (!skipped) {
-                    diag.emplace_back(DiagLevel::Critical, "EBML size length is not supported.", parsingContext());
-                }
-                continue; // try again
-            }
             if (m_sizeLength > container().maxSizeLength()) {
                 if (!skipped) {
                     diag.emplace_back(DiagLevel::Critical, "EBML size length is invalid.", parsingContext());
                 }
                 continue; // try again
             }
-            // read size into buffer
-            memset(buf, 0, sizeof(DataSizeType)); // reset buffer
-            reader().read(buf + (maximumSizeLengthSupported() - m_sizeLength), m_sizeLength);
-            // xor the first byte in buffer which has been read from the file with mask
-            *(buf + (maximumSizeLengthSupported() - m_sizeLength)) ^= mask;
-            m_dataSize = BE::toUInt64(buf);
-            // check if element is truncated
+            m_dataSize = header.dataSize;
+            // check if element is truncated (the header itself can not be truncated as it has been decoded from data within the max size)
             if (totalSize() > maxTotalSize()) {
-                if (m_idLength + m_sizeLength > maxTotalSize()) { // header truncated
-                    if (!skipped) {
-                        diag.emplace_back(DiagLevel::Critical, "EBML header seems to be truncated.", parsingContext());
-                    }
-                    continue; // try again
-                } else { // data truncated
-                    diag.emplace_back(DiagLevel::Warning, "Data of EBML element seems to be truncated; unable to parse siblings of that element.",
-                        parsingContext());
-                    m_dataSize = maxTotalSize() - m_idLength - m_sizeLength; // using max size instead
-                }
+                diag.emplace_back(
+                    DiagLevel::Warning, "Data of EBML element seems to be truncated; unable to parse siblings of that element.", parsingContext());
+                m_dataSize = maxTotalSize() - m_idLength - m_sizeLength; // using max size instead
             }
         }
 
+        // keep the value of small elements so the simple-value readers don't need to access the stream again
+        if (!m_sizeUnknown && m_dataSize <= sizeof(m_bufferedValue) && headerSize() + m_dataSize <= windowSize && !isParent()) {
+            m_bufferedValue = m_dataSize
+                ? EbmlHeaderDecoder::loadBigEndian(window + headerSize(), static_cast<std::size_t>(m_dataSize)) >> (64 - 8 * m_dataSize)
+                : 0;
+            m_valueBuffered = true;
+        }
+
         // check if there's a first child
         const std::uint64_t firstChildOffset = this->firstChildOffset();
         if (firstChildOffset && firstChildOffset < totalSize()) {
@@ -225,6 +257,13 @@ void EbmlElement::internalParse(Diagnostics &diag)
  */
 std::string EbmlElement::readString()
 {
+    if (m_valueBuffered) {
+        auto value = std::string(static_cast<std::size_t>(dataSize()), '\0');
+        for (auto i = std::size_t(), shift = static_cast<std::size_t>(dataSize()) * 8; i != value.size(); ++i) {
+            value[i] = static_cast<char>(m_bufferedValue >> (shift -= 8));
+        }
+        return value;
+    }
     stream().seekg(static_cast<streamoff>(dataOffset()));
     return reader().readString(dataSize());
 }
@@ -237,6 +276,9 @@ std::string EbmlElement::readString()
  */
 std::uint64_t EbmlElement::readUInteger()
 {
+    if (m_valueBuffered) {
+        return m_bufferedValue;
+    }
     constexpr DataSizeType maxBytesToRead = 8;
     char buff[maxBytesToRead] = { 0 };
     const auto bytesToSkip = maxBytesToRead - min(dataSize(), maxBytesToRead);
@@ -251,6 +293,23 @@ std::uint64_t EbmlElement::readUInteger()
  */
 double EbmlElement::readFloat()
 {
+    if (m_valueBuffered) {
+        switch (dataSize()) {
+        case sizeof(float): {
+            const auto bits = static_cast<std::uint32_t>(m_bufferedValue);
+            auto value = float();
+            memcpy(&value, &bits, sizeof(value));
+            return static_cast<double>(value);
+        }
+        case sizeof(double): {
+            auto value = double();
+            memcpy(&value, &m_bufferedValue, sizeof(value));
+            return value;
+        }
+        default:
+            return 0.0;
+        }
+    }
     stream().seekg(static_cast<streamoff>(dataOffset()));
     switch (dataSize()) {
     case sizeof(float):
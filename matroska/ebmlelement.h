@@ -42,6 +42,7 @@ public:
     std::uint64_t readUInteger();
     double readFloat();
 
+    static std::string idToString(IdentifierType id);
     static std::uint8_t calculateIdLength(IdentifierType id);
     static std::uint8_t calculateSizeDenotationLength(std::uint64_t size);
     static std::uint8_t makeId(IdentifierType id, char *buff);
@@ -63,19 +64,30 @@ protected:
 
 private:
     std::string parsingContext() const;
+
+    std::uint64_t m_bufferedValue;
+    bool m_valueBuffered;
 };
 
 /*!
- * \brief Converts the specified EBML \a ID to a printable string.
+ * \brief Converts the EBML ID of the element to a printable string.
  */
 inline std::string EbmlElement::idToString() const
+{
+    return idToString(id());
+}
+
+/*!
+ * \brief Converts the specified EBML \a id to a printable string.
+ */
+inline std::string EbmlElement::idToString(IdentifierType id)
 {
     using namespace CppUtilities;
-    const char *const name = matroskaIdName(id());
+    const char *const name = matroskaIdName(id);
     if (*name) {
-        return argsToString('0', 'x', numberToString(id(), 16), ' ', '\"', name, '\"');
+        return argsToString('0', 'x', numberToString(id, 16), ' ', '\"', name, '\"');
     } else {
-        return "0x" + numberToString(id(), 16);
+        return "0x" + numberToString(id, 16);
     }
 }
 
@@ -0,0 +1,264 @@
+#ifndef TAG_PARSER_EBMLHEADERDECODER_H
+#define TAG_PARSER_EBMLHEADERDECODER_H
+
+#include "../global.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace TagParser {
+
+/*!
+ * \brief The EbmlHeaderStatus enum specifies the result of decoding an EBML element header.
+ */
+enum class EbmlHeaderStatus : std::uint8_t {
+    Ok, /**< the header has been decoded */
+    Truncated, /**< the data ends within the header */
+    InvalidIdLength, /**< the length of the ID exceeds the max. ID length */
+    InvalidSizeLength, /**< the length of the size denotation exceeds the max. size length */
+};
+
+/*!
+ * \brief The EbmlHeader struct holds the decoded header of an EBML element.
+ */
+struct TAG_PARSER_EXPORT EbmlHeader {
+    constexpr std::uint8_t headerSize() const;
+
+    std::uint32_t id = 0; /**< the ID including its length marker (as used by EbmlIds and MatroskaIds) */
+    std::uint64_t dataSize = 0; /**< the size of the data; 0 if sizeUnknown is set */
+    std::uint8_t idLength = 0; /**< the length of the ID in byte */
+    std::uint8_t sizeLength = 0; /**< the length of the size denotation in byte */
+    bool sizeUnknown = false; /**< whether the size denotation is 0xFF which denotes an unknown size */
+};
+
+/*!
+ * \brief Returns the size of the header (ID and size denotation) in byte.
+ */
+constexpr std::uint8_t EbmlHeader::headerSize() const
+{
+    return static_cast<std::uint8_t>(idLength + sizeLength);
+}
+
+/*!
+ * \brief The MatroskaBlockHeader struct holds the decoded header of a Matroska "SimpleBlock"- or "Block"-element.
+ * \remarks The lacing header (if any) is not part of it.
+ */
+struct TAG_PARSER_EXPORT MatroskaBlockHeader {
+    constexpr std::uint8_t headerSize() const;
+
+    std::uint64_t trackNumber = 0; /**< the number of the track the block belongs to */
+    std::int16_t timestamp = 0; /**< the timestamp relative to the timestamp of the cluster */
+    std::uint8_t flags = 0; /**< the flags (e.g. 0x80 for keyframes of "SimpleBlock"-elements and the lacing in bits 1 and 2) */
+    std::uint8_t trackNumberLength = 0; /**< the length of the track number in byte */
+};
+
+/*!
+ * \brief Returns the size of the header (track number, timestamp and flags) in byte.
+ */
+constexpr std::uint8_t MatroskaBlockHeader::headerSize() const
+{
+    return static_cast<std::uint8_t>(trackNumberLength + 3);
+}
+
+class TAG_PARSER_EXPORT EbmlHeaderDecoder {
+public:
+    static constexpr std::size_t maxHeaderSize = 12;
+
+    explicit EbmlHeaderDecoder(const char *data, std::size_t size, std::uint8_t maxIdLength = 4, std::uint8_t maxSizeLength = 8);
+
+    std::size_t offset() const;
+    EbmlHeaderStatus status() const;
+    bool next(EbmlHeader &header);
+
+    static std::uint8_t vintLength(std::uint8_t firstByte);
+    static std::uint64_t loadBigEndian(const char *data, std::size_t size);
+    static EbmlHeaderStatus decode(
+        const char *data, std::size_t size, EbmlHeader &header, std::uint8_t maxIdLength = 4, std::uint8_t maxSizeLength = 8);
+    static std::uint64_t decodeUInteger(const char *data, std::size_t size);
+    static bool decodeBlockHeader(const char *data, std::size_t size, MatroskaBlockHeader &header);
+
+private:
+    const char *m_data;
+    std::size_t m_size;
+    std::size_t m_offset;
+    std::uint8_t m_maxIdLength;
+    std::uint8_t m_maxSizeLength;
+    EbmlHeaderStatus m_status;
+};
+
+/*!
+ * \class TagParser::EbmlHeaderDecoder
+ * \brief The EbmlHeaderDecoder class decodes EBML element headers from a buffer.
+ *
+ * The static decode() function decodes a single header. It determines the lengths of the ID and the size denotation
+ * by counting the leading zeroes of their first byte and extracts both values via a single unaligned big-endian load
+ * each; so it does not branch on the individual bits. EbmlElement uses it to parse its header from a small window of
+ * the file which is read at once.
+ *
+ * An instance iterates through consecutive elements (e.g. the children of a buffered parent element) via next():
+ * \code
+ * auto decoder = EbmlHeaderDecoder(buffer, bufferSize);
+ * for (auto header = EbmlHeader(); decoder.next(header);) {
+ *     // the element has the ID header.id and its data has the size header.dataSize
+ * }
+ * \endcode
+ */
+
+/*!
+ * \brief Constructs a decoder for the \a size bytes at \a data.
+ * \remarks Headers with an ID longer than \a maxIdLength or a size denotation longer than \a maxSizeLength are considered invalid.
+ */
+inline EbmlHeaderDecoder::EbmlHeaderDecoder(const char *data, std::size_t size, std::uint8_t maxIdLength, std::uint8_t maxSizeLength)
+    : m_data(data)
+    , m_size(size)
+    , m_offset(0)
+    , m_maxIdLength(maxIdLength)
+    , m_maxSizeLength(maxSizeLength)
+    , m_status(EbmlHeaderStatus::Ok)
+{
+}
+
+/*!
+ * \brief Returns the offset of the next header to be decoded (relative to the beginning of the buffer).
+ */
+inline std::size_t EbmlHeaderDecoder::offset() const
+{
+    return m_offset;
+}
+
+/*!
+ * \brief Returns the status of decoding the last header.
+ * \remarks If next() returns false although offset() is not at the end of the buffer, this tells why.
+ */
+inline EbmlHeaderStatus EbmlHeaderDecoder::status() const
+{
+    return m_status;
+}
+
+/*!
+ * \brief Decodes the header at offset() and advances behind the element.
+ * \returns Returns whether a \a header could be decoded; returns false at the end of the buffer and if the header is invalid or truncated.
+ * \remarks Elements of unknown size are assumed to take the rest of the buffer.
+ */
+inline bool EbmlHeaderDecoder::next(EbmlHeader &header)
+{
+    if (m_offset >= m_size || m_status != EbmlHeaderStatus::Ok) {
+        return false;
+    }
+    const auto available = m_size - m_offset;
+    if ((m_status = decode(m_data + m_offset, available, header, m_maxIdLength, m_maxSizeLength)) != EbmlHeaderStatus::Ok) {
+        return false;
+    }
+    const auto dataAvailable = available - header.headerSize();
+    m_offset += header.headerSize() + (header.sizeUnknown || header.dataSize > dataAvailable ? dataAvailable : header.dataSize);
+    return true;
+}
+
+/*!
+ * \brief Returns the length of the variable size integer (ID or size denotation) starting with \a firstByte.
+ * \remarks Returns 9 if \a firstByte is zero (which is not valid).
+ */
+inline std::uint8_t EbmlHeaderDecoder::vintLength(std::uint8_t firstByte)
+{
+    // the appended 1 bit ends the count for a zero byte
+    const auto value = (static_cast<unsigned int>(firstByte) << 1) | 1u;
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<std::uint8_t>(__builtin_clz(value) - (sizeof(unsigned int) * 8 - 9) + 1);
+#else
+    auto length = std::uint8_t(1);
+    for (auto mask = 0x100u; !(value & mask); mask >>= 1) {
+        ++length;
+    }
+    return length;
+#endif
+}
+
+/*!
+ * \brief Returns the first (up to) 8 bytes at \a data as big-endian integer; missing bytes are zero.
+ * \remarks So the byte at \a data is always the most significant byte.
+ */
+inline std::uint64_t EbmlHeaderDecoder::loadBigEndian(const char *data, std::size_t size)
+{
+    if (size >= sizeof(std::uint64_t)) {
+        return CppUtilities::BE::toUInt64(data);
+    }
+    char buffer[sizeof(std::uint64_t)] = { 0 };
+    std::memcpy(buffer, data, size);
+    return CppUtilities::BE::toUInt64(buffer);
+}
+
+/*!
+ * \brief Decodes the EBML element header at the beginning of the \a size bytes at \a data into \a header.
+ * \remarks
+ * - \a maxIdLength must not exceed 4 and \a maxSizeLength must not exceed 8.
+ * - Only the 1-byte size denotation 0xFF denotes an unknown size (as considered by the parser so far).
+ */
+inline EbmlHeaderStatus EbmlHeaderDecoder::decode(
+    const char *data, std::size_t size, EbmlHeader &header, std::uint8_t maxIdLength, std::uint8_t maxSizeLength)
+{
+    if (!size) {
+        return EbmlHeaderStatus::Truncated;
+    }
+    const auto idBytes = loadBigEndian(data, size);
+    const auto idLength = vintLength(static_cast<std::uint8_t>(idBytes >> 56));
+    if (idLength > maxIdLength) {
+        return EbmlHeaderStatus::InvalidIdLength;
+    }
+    if (size <= idLength) {
+        return EbmlHeaderStatus::Truncated;
+    }
+    const auto sizeBytes = loadBigEndian(data + idLength, size - idLength);
+    const auto firstSizeByte = static_cast<std::uint8_t>(sizeBytes >> 56);
+    const auto sizeLength = vintLength(firstSizeByte);
+    if (firstSizeByte != 0xFF) {
+        if (sizeLength > maxSizeLength) {
+            return EbmlHeaderStatus::InvalidSizeLength;
+        }
+        if (size < static_cast<std::size_t>(idLength + sizeLength)) {
+            return EbmlHeaderStatus::Truncated;
+        }
+    }
+    header.id = static_cast<std::uint32_t>(idBytes >> (64 - 8 * idLength));
+    header.idLength = idLength;
+    header.sizeLength = sizeLength;
+    header.sizeUnknown = firstSizeByte == 0xFF;
+    // drop the bytes following the size denotation and the length marker
+    header.dataSize = header.sizeUnknown ? 0 : (sizeBytes >> (64 - 8 * sizeLength)) & ((std::uint64_t(1) << (7 * sizeLength)) - 1);
+    return EbmlHeaderStatus::Ok;
+}
+
+/*!
+ * \brief Returns the unsigned integer stored in the \a size bytes at \a data.
+ * \remarks Only the first 8 bytes are considered (like EbmlElement::readUInteger() does).
+ */
+inline std::uint64_t EbmlHeaderDecoder::decodeUInteger(const char *data, std::size_t size)
+{
+    size = size < sizeof(std::uint64_t) ? size : sizeof(std::uint64_t);
+    return size ? loadBigEndian(data, size) >> (64 - 8 * size) : 0;
+}
+
+/*!
+ * \brief Decodes the header of the Matroska "SimpleBlock"- or "Block"-element at the beginning of the \a size bytes at \a data into \a header.
+ * \returns Returns whether the header could be decoded; returns false if it is truncated or the track number is invalid.
+ */
+inline bool EbmlHeaderDecoder::decodeBlockHeader(const char *data, std::size_t size, MatroskaBlockHeader &header)
+{
+    // the track number is a variable size integer followed by the 2 byte timestamp and the flags
+    const auto trackNumberLength = size ? vintLength(static_cast<std::uint8_t>(*data)) : std::uint8_t(9);
+    if (trackNumberLength > 8 || size < trackNumberLength + 3u) {
+        return false;
+    }
+    header.trackNumber = (loadBigEndian(data, trackNumberLength) >> (64 - 8 * trackNumberLength)) & ((std::uint64_t(1) << (7 * trackNumberLength)) - 1);
+    header.timestamp = static_cast<std::int16_t>(
+        (static_cast<std::uint8_t>(data[trackNumberLength]) << 8) | static_cast<std::uint8_t>(data[trackNumberLength + 1]));
+    header.flags = static_cast<std::uint8_t>(data[trackNumberLength + 2]);
+    header.trackNumberLength = trackNumberLength;
+    return true;
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_EBMLHEADERDECODER_H
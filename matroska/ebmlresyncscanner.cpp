@@ -0,0 +1,167 @@
+#include "./ebmlresyncscanner.h"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+
+using namespace std;
+
+namespace TagParser {
+
+/*!
+ * \class TagParser::EbmlResyncScanner
+ * \brief The EbmlResyncScanner class finds the next valid top-level or level 1 element (e.g. "Cluster") in damaged EBML data.
+ *
+ * When the header of an element is invalid, the parser needs to find the next element it can continue with. Trying
+ * each byte as start of an element is slow and might lock onto random data. Instead, this class reads the data in big
+ * chunks and scans them for the first byte of the IDs of top-level and level 1 elements (which are all 4 bytes long
+ * and start with 0x1?). The scan checks 8 bytes at once via bit operations on a 64-bit word.
+ *
+ * A candidate is only considered plausible if
+ * - its ID is known to be at the requested level,
+ * - the element fits into the available space,
+ * - its first child is an element of the next level (or a global element like "Void") which fits into the element and
+ * - the element is followed by the end of the available space or another element of the same level (or a global element).
+ *
+ * So parsing can resume at the next valid element after one pass over the damaged bytes.
+ */
+
+/*!
+ * \brief Constructs a new scanner for the specified \a stream.
+ * \remarks Headers with an ID longer than \a maxIdLength or a size denotation longer than \a maxSizeLength are considered invalid.
+ */
+EbmlResyncScanner::EbmlResyncScanner(std::istream &stream, std::uint8_t maxIdLength, std::uint8_t maxSizeLength)
+    : m_stream(stream)
+    , m_buffer(make_unique<char[]>(bufferSize))
+    , m_bufferOffset(0)
+    , m_bufferedBytes(0)
+    , m_bytesScanned(0)
+    , m_candidatesChecked(0)
+    , m_maxIdLength(min<std::uint8_t>(maxIdLength, 4))
+    , m_maxSizeLength(min<std::uint8_t>(maxSizeLength, 8))
+{
+}
+
+/*!
+ * \brief Returns the offset of the first plausible element of the specified \a level within [\a startOffset, \a endOffset).
+ * \remarks The data must be readable up to \a endOffset. Only TopLevel and Level1 are supported as \a level.
+ */
+std::optional<std::uint64_t> EbmlResyncScanner::findElement(std::uint64_t startOffset, std::uint64_t endOffset, MatroskaElementLevel level)
+{
+    for (auto offset = startOffset; offset < endOffset;) {
+        // read the next chunk; only scan the part where a complete header fits so headers crossing the end are found in the next chunk
+        const auto chunkSize = static_cast<std::size_t>(min<std::uint64_t>(endOffset - offset, bufferSize));
+        m_stream.seekg(static_cast<streamoff>(offset));
+        m_stream.read(m_buffer.get(), static_cast<streamsize>(chunkSize));
+        m_bufferOffset = offset;
+        m_bufferedBytes = chunkSize;
+        const auto scanSize = offset + chunkSize == endOffset ? chunkSize : chunkSize - (EbmlHeaderDecoder::maxHeaderSize - 1);
+
+        // validate the candidates
+        const auto *const data = m_buffer.get();
+        for (auto position = findCandidate(data, scanSize); position < scanSize;
+             position += 1 + findCandidate(data + position + 1, scanSize - position - 1)) {
+            if (isPlausible(offset + position, endOffset, level)) {
+                m_bytesScanned += position;
+                return offset + position;
+            }
+        }
+        m_bytesScanned += scanSize;
+        offset += scanSize;
+    }
+    return std::nullopt;
+}
+
+/*!
+ * \brief Returns the position of the first byte within the \a size bytes at \a data which might start the ID of a top-level or level 1 element.
+ * \returns Returns \a size if there is no such byte.
+ */
+std::size_t EbmlResyncScanner::findCandidate(const char *data, std::size_t size)
+{
+    // check 8 bytes at once whether one of them has the high nibble 0x1 (the nibble is zero after the xor)
+    constexpr auto ones = std::uint64_t(0x0101010101010101), highBits = std::uint64_t(0x8080808080808080);
+    auto position = std::size_t();
+    for (std::uint64_t word; position + sizeof(word) <= size; position += sizeof(word)) {
+        memcpy(&word, data + position, sizeof(word));
+        const auto nibbles = (word & (ones * 0xF0)) ^ (ones * 0x10);
+        if ((nibbles - ones) & ~nibbles & highBits) {
+            break;
+        }
+    }
+    for (; position < size; ++position) {
+        if ((static_cast<std::uint8_t>(data[position]) & 0xF0) == 0x10) {
+            return position;
+        }
+    }
+    return size;
+}
+
+/*!
+ * \brief Decodes the header at \a offset; the header must end before \a endOffset.
+ * \remarks Uses the buffered data if possible.
+ */
+bool EbmlResyncScanner::readHeader(std::uint64_t offset, std::uint64_t endOffset, EbmlHeader &header)
+{
+    if (offset >= endOffset) {
+        return false;
+    }
+    const auto available = static_cast<std::size_t>(min<std::uint64_t>(endOffset - offset, EbmlHeaderDecoder::maxHeaderSize));
+    const char *data;
+    char buffer[EbmlHeaderDecoder::maxHeaderSize];
+    if (offset >= m_bufferOffset && offset + available <= m_bufferOffset + m_bufferedBytes) {
+        data = m_buffer.get() + (offset - m_bufferOffset);
+    } else {
+        m_stream.seekg(static_cast<streamoff>(offset));
+        m_stream.read(buffer, static_cast<streamsize>(available));
+        data = buffer;
+    }
+    return EbmlHeaderDecoder::decode(data, available, header, m_maxIdLength, m_maxSizeLength) == EbmlHeaderStatus::Ok;
+}
+
+/*!
+ * \brief Returns whether the element at \a offset is a plausible element of the specified \a level.
+ */
+bool EbmlResyncScanner::isPlausible(std::uint64_t offset, std::uint64_t endOffset, MatroskaElementLevel level)
+{
+    // check the ID
+    auto header = EbmlHeader();
+    if (!readHeader(offset, endOffset, header) || header.idLength != 4 || matroskaIdLevel(header.id) != level) {
+        return false;
+    }
+    ++m_candidatesChecked;
+
+    // check whether the element fits
+    const auto dataOffset = offset + header.headerSize();
+    const auto elementEnd = header.sizeUnknown ? endOffset : dataOffset + header.dataSize;
+    if (elementEnd > endOffset) {
+        return false;
+    }
+
+    // check the first child
+    if (dataOffset < elementEnd) {
+        auto child = EbmlHeader();
+        if (!readHeader(dataOffset, elementEnd, child)) {
+            return false;
+        }
+        if (!child.sizeUnknown && child.headerSize() + child.dataSize > elementEnd - dataOffset) {
+            return false;
+        }
+        const auto childLevel = matroskaIdLevel(child.id);
+        if (childLevel != MatroskaElementLevel::Global && static_cast<std::uint8_t>(childLevel) != static_cast<std::uint8_t>(level) + 1) {
+            return false;
+        }
+    }
+
+    // check the next sibling
+    if (!header.sizeUnknown && elementEnd < endOffset) {
+        auto sibling = EbmlHeader();
+        if (!readHeader(elementEnd, endOffset, sibling)) {
+            return false;
+        }
+        const auto siblingLevel = matroskaIdLevel(sibling.id);
+        return siblingLevel == level || siblingLevel == MatroskaElementLevel::Global;
+    }
+    return true;
+}
+
+} // namespace TagParser
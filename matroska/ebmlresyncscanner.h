@@ -0,0 +1,59 @@
+#ifndef TAG_PARSER_EBMLRESYNCSCANNER_H
+#define TAG_PARSER_EBMLRESYNCSCANNER_H
+
+#include "./ebmlheaderdecoder.h"
+#include "./matroskaid.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+
+namespace TagParser {
+
+class TAG_PARSER_EXPORT EbmlResyncScanner {
+public:
+    static constexpr std::size_t bufferSize = 0x10000;
+
+    explicit EbmlResyncScanner(std::istream &stream, std::uint8_t maxIdLength = 4, std::uint8_t maxSizeLength = 8);
+
+    std::uint64_t bytesScanned() const;
+    std::uint64_t candidatesChecked() const;
+    std::optional<std::uint64_t> findElement(std::uint64_t startOffset, std::uint64_t endOffset, MatroskaElementLevel level);
+
+    static std::size_t findCandidate(const char *data, std::size_t size);
+
+private:
+    bool readHeader(std::uint64_t offset, std::uint64_t endOffset, EbmlHeader &header);
+    bool isPlausible(std::uint64_t offset, std::uint64_t endOffset, MatroskaElementLevel level);
+
+    std::istream &m_stream;
+    std::unique_ptr<char[]> m_buffer;
+    std::uint64_t m_bufferOffset;
+    std::size_t m_bufferedBytes;
+    std::uint64_t m_bytesScanned;
+    std::uint64_t m_candidatesChecked;
+    std::uint8_t m_maxIdLength;
+    std::uint8_t m_maxSizeLength;
+};
+
+/*!
+ * \brief Returns the number of bytes scanned so far.
+ */
+inline std::uint64_t EbmlResyncScanner::bytesScanned() const
+{
+    return m_bytesScanned;
+}
+
+/*!
+ * \brief Returns the number of candidates which have been validated so far.
+ */
+inline std::uint64_t EbmlResyncScanner::candidatesChecked() const
+{
+    return m_candidatesChecked;
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_EBMLRESYNCSCANNER_H
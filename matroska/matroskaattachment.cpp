@@ -112,6 +112,7 @@ void MatroskaAttachment::make(std::ostream &stream, Diagnostics &diag)
  */
 MatroskaAttachmentMaker::MatroskaAttachmentMaker(MatroskaAttachment &attachment, Diagnostics &diag)
     : m_attachment(attachment)
+    , m_dataInPlace(false)
 {
     m_attachedFileElementSize = 2 + EbmlElement::calculateSizeDenotationLength(attachment.name().size()) + attachment.name().size() + 2
         + EbmlElement::calculateSizeDenotationLength(attachment.mimeType().size()) + attachment.mimeType().size() + 2 + 1
@@ -135,6 +136,15 @@ MatroskaAttachmentMaker::MatroskaAttachmentMaker(MatroskaAttachment &attachment,
     m_totalSize = 2 + EbmlElement::calculateSizeDenotationLength(m_attachedFileElementSize) + m_attachedFileElementSize;
 }
 
+/*!
+ * \brief Returns the offset of the attachment data within the "AttachedFile"-element written by make().
+ * \remarks The "FileData"-element is always written last so the data is at the very end of the element.
+ */
+std::uint64_t MatroskaAttachmentMaker::dataOffset() const
+{
+    return m_totalSize - (attachment().data() ? static_cast<std::uint64_t>(attachment().data()->size()) : 0u);
+}
+
 /*!
  * \brief Saves the attachment (specified when constructing the object) to the
  *        specified \a stream (makes an "AttachedFile"-element).
@@ -174,11 +184,20 @@ void MatroskaAttachmentMaker::make(ostream &stream, Diagnostics &diag) const
         stream.write(buff, 2);
         len = EbmlElement::makeSizeDenotation(static_cast<std::uint64_t>(attachment().data()->size()), buff);
         stream.write(buff, len);
-        attachment().data()->copyTo(stream);
+        if (m_dataInPlace) {
+            stream.seekp(static_cast<streamoff>(attachment().data()->size()), ios_base::cur);
+        } else {
+            attachment().data()->copyTo(stream);
+        }
     }
 }
 
-void MatroskaAttachmentMaker::bufferCurrentAttachments(Diagnostics &diag)
+/*!
+ * \brief Buffers the children of the "AttachedFile"-element read from the original file so make() does not depend on them anymore.
+ * \remarks The attachment data is only buffered if \a includingData is set. Otherwise it must be moved via
+ *          MatroskaAttachmentWritePlan when updating the file in-place.
+ */
+void MatroskaAttachmentMaker::bufferCurrentAttachments(Diagnostics &diag, bool includingData)
 {
     EbmlElement *child;
     if (attachment().attachedFileElement()) {
@@ -189,7 +208,7 @@ void MatroskaAttachmentMaker::bufferCurrentAttachments(Diagnostics &diag)
             }
         }
     }
-    if (attachment().data() && attachment().data()->size() && !attachment().isDataFromFile()) {
+    if (includingData && attachment().data() && attachment().data()->size() && !attachment().isDataFromFile()) {
         attachment().data()->makeBuffer();
     }
 }
@@ -15,7 +15,10 @@ public:
     void make(std::ostream &stream, Diagnostics &diag) const;
     const MatroskaAttachment &attachment() const;
     std::uint64_t requiredSize() const;
-    void bufferCurrentAttachments(Diagnostics &diag);
+    std::uint64_t dataOffset() const;
+    bool isDataInPlace() const;
+    void setDataInPlace(bool dataInPlace);
+    void bufferCurrentAttachments(Diagnostics &diag, bool includingData = true);
 
 private:
     MatroskaAttachmentMaker(MatroskaAttachment &attachment, Diagnostics &diag);
@@ -23,6 +26,7 @@ private:
     MatroskaAttachment &m_attachment;
     std::uint64_t m_attachedFileElementSize;
     std::uint64_t m_totalSize;
+    bool m_dataInPlace;
 };
 
 /*!
@@ -41,6 +45,23 @@ inline std::uint64_t MatroskaAttachmentMaker::requiredSize() const
     return m_totalSize;
 }
 
+/*!
+ * \brief Returns whether the attachment data is already present at the right place so make() just skips it.
+ */
+inline bool MatroskaAttachmentMaker::isDataInPlace() const
+{
+    return m_dataInPlace;
+}
+
+/*!
+ * \brief Sets whether the attachment data is already present at the right place so make() just skips it.
+ * \remarks This is used when updating a file in-place after the data has been moved via MatroskaAttachmentWritePlan.
+ */
+inline void MatroskaAttachmentMaker::setDataInPlace(bool dataInPlace)
+{
+    m_dataInPlace = dataInPlace;
+}
+
 class TAG_PARSER_EXPORT MatroskaAttachment final : public AbstractAttachment {
 public:
     MatroskaAttachment();
@@ -0,0 +1,145 @@
+#include "./matroskaattachmentwriteplan.h"
+
+#include "../diagnostics.h"
+#include "../progressfeedback.h"
+
+#include <c++utilities/conversion/stringbuilder.h>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+using namespace CppUtilities;
+
+namespace TagParser {
+
+/*!
+ * \class TagParser::MatroskaAttachmentWritePlan
+ * \brief The MatroskaAttachmentWritePlan class moves the payloads of existing attachments when a Matroska file is
+ *        updated in-place.
+ *
+ * When the file is not rewritten the "Attachments"-element might be shifted (e.g. because the tags in front of it grew).
+ * Instead of reading all payloads into memory before writing anything, each payload is added to the plan with its offset
+ * in the original file and its offset in the new file. The plan then moves the payloads within the file using a buffer of
+ * at most MatroskaAttachmentWritePlan::bufferSize bytes. Afterwards MatroskaAttachmentMaker::make() just skips the payloads.
+ *
+ * Payloads moved towards the start of the file are moved first (in ascending order), followed by the payloads moved towards
+ * the end of the file (in descending order). Each payload is copied chunk-wise in the direction of the move so it may
+ * overlap with its own original location. As long as the order of the attachments is preserved this never overwrites data
+ * which has not been moved yet. Otherwise the affected payloads are detected up front and read into memory before
+ * anything is moved.
+ *
+ * \remarks The copy_file_range() syscall used by the BackupHelper is not used here because it refuses to copy between
+ *          overlapping ranges of the same file.
+ */
+
+/*!
+ * \brief Adds the payload of \a size bytes at \a sourceOffset which shall be moved to \a targetOffset.
+ * \remarks Both offsets are absolute. The ranges of payloads added to the same plan must not overlap each other.
+ */
+void MatroskaAttachmentWritePlan::add(std::uint64_t sourceOffset, std::uint64_t targetOffset, std::uint64_t size)
+{
+    m_moves.emplace_back(Move{ sourceOffset, targetOffset, size, nullptr });
+}
+
+/*!
+ * \brief Moves the payloads within the specified \a stream.
+ * \remarks The \a stream must be opened for reading and writing and must not be wrapped by a CoalescingWriteScope.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void MatroskaAttachmentWritePlan::execute(std::iostream &stream, Diagnostics &diag, AbortableProgressFeedback *progress)
+{
+    static const auto context = std::string("moving Matroska attachments");
+    const auto moves = order();
+    if (moves.empty()) {
+        return;
+    }
+
+    // read payloads which would be overwritten by a preceding move into memory first
+    m_bufferedSize = 0;
+    for (auto i = moves.cbegin(), end = moves.cend(); i != end; ++i) {
+        const auto &preceding = m_moves[*i];
+        for (auto j = i + 1; j != end; ++j) {
+            auto &subsequent = m_moves[*j];
+            if (subsequent.data || preceding.targetOffset >= subsequent.sourceOffset + subsequent.size
+                || subsequent.sourceOffset >= preceding.targetOffset + preceding.size) {
+                continue;
+            }
+            subsequent.data = make_unique<char[]>(static_cast<std::size_t>(subsequent.size));
+            stream.seekg(static_cast<streamoff>(subsequent.sourceOffset));
+            stream.read(subsequent.data.get(), static_cast<streamsize>(subsequent.size));
+            m_bufferedSize += subsequent.size;
+        }
+    }
+    if (m_bufferedSize) {
+        diag.emplace_back(DiagLevel::Debug,
+            argsToString("The order of the attachments changed; ", m_bufferedSize, " bytes of attachment data need to be buffered."), context);
+    }
+
+    // move the payloads
+    auto totalSize = std::uint64_t(), maxSize = std::uint64_t();
+    for (const auto index : moves) {
+        totalSize += m_moves[index].size;
+        maxSize = max(maxSize, m_moves[index].size);
+    }
+    const auto buffer = make_unique<char[]>(static_cast<std::size_t>(min<std::uint64_t>(maxSize, bufferSize)));
+    auto bytesMoved = std::uint64_t();
+    for (const auto index : moves) {
+        auto &payload = m_moves[index];
+        if (payload.data) {
+            stream.seekp(static_cast<streamoff>(payload.targetOffset));
+            stream.write(payload.data.get(), static_cast<streamsize>(payload.size));
+            payload.data.reset();
+        } else {
+            move(stream, payload, buffer.get());
+        }
+        if (progress) {
+            progress->updateStepPercentage(static_cast<std::uint8_t>((bytesMoved += payload.size) * 100 / totalSize));
+        }
+    }
+    stream.flush();
+}
+
+/*!
+ * \brief Returns the indices of the payloads which need to be moved in the order they are moved.
+ */
+std::vector<std::size_t> MatroskaAttachmentWritePlan::order() const
+{
+    auto moves = std::vector<std::size_t>();
+    moves.reserve(m_moves.size());
+    for (std::size_t index = 0, count = m_moves.size(); index != count; ++index) {
+        if (m_moves[index].size && m_moves[index].sourceOffset != m_moves[index].targetOffset) {
+            moves.emplace_back(index);
+        }
+    }
+    sort(moves.begin(), moves.end(), [this](std::size_t lhsIndex, std::size_t rhsIndex) {
+        const auto &lhs = m_moves[lhsIndex], &rhs = m_moves[rhsIndex];
+        const auto lhsDown = lhs.targetOffset < lhs.sourceOffset, rhsDown = rhs.targetOffset < rhs.sourceOffset;
+        if (lhsDown != rhsDown) {
+            return lhsDown;
+        }
+        return lhsDown ? lhs.targetOffset < rhs.targetOffset : lhs.targetOffset > rhs.targetOffset;
+    });
+    return moves;
+}
+
+/*!
+ * \brief Moves a single payload chunk-wise using the specified \a buffer of MatroskaAttachmentWritePlan::bufferSize bytes.
+ * \remarks The chunks are copied from the front when moving towards the start of the file and from the back otherwise so
+ *          the source and target range may overlap.
+ */
+void MatroskaAttachmentWritePlan::move(std::iostream &stream, const Move &move, char *buffer)
+{
+    const auto down = move.targetOffset < move.sourceOffset;
+    for (auto remaining = move.size; remaining;) {
+        const auto chunkSize = min<std::uint64_t>(remaining, bufferSize);
+        const auto chunkOffset = down ? move.size - remaining : remaining - chunkSize;
+        stream.seekg(static_cast<streamoff>(move.sourceOffset + chunkOffset));
+        stream.read(buffer, static_cast<streamsize>(chunkSize));
+        stream.seekp(static_cast<streamoff>(move.targetOffset + chunkOffset));
+        stream.write(buffer, static_cast<streamsize>(chunkSize));
+        remaining -= chunkSize;
+    }
+}
+
+} // namespace TagParser
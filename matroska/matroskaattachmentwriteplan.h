@@ -0,0 +1,61 @@
+#ifndef TAG_PARSER_MATROSKAATTACHMENTWRITEPLAN_H
+#define TAG_PARSER_MATROSKAATTACHMENTWRITEPLAN_H
+
+#include "../global.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+namespace TagParser {
+
+class AbortableProgressFeedback;
+class Diagnostics;
+
+class TAG_PARSER_EXPORT MatroskaAttachmentWritePlan {
+public:
+    static constexpr std::size_t bufferSize = 0x100000;
+
+    void add(std::uint64_t sourceOffset, std::uint64_t targetOffset, std::uint64_t size);
+    std::size_t moveCount() const;
+    std::uint64_t bufferedSize() const;
+    void execute(std::iostream &stream, Diagnostics &diag, AbortableProgressFeedback *progress = nullptr);
+
+private:
+    /// \brief The Move struct denotes an attachment payload to be moved within the file.
+    struct Move {
+        std::uint64_t sourceOffset; /**< the offset of the payload in the original file */
+        std::uint64_t targetOffset; /**< the offset of the payload in the new file */
+        std::uint64_t size; /**< the size of the payload */
+        std::unique_ptr<char[]> data; /**< the payload if it must be read before moving anything else */
+    };
+
+    std::vector<std::size_t> order() const;
+    static void move(std::iostream &stream, const Move &move, char *buffer);
+
+    std::vector<Move> m_moves;
+    std::uint64_t m_bufferedSize = 0;
+};
+
+/*!
+ * \brief Returns the number of payloads added via add().
+ */
+inline std::size_t MatroskaAttachmentWritePlan::moveCount() const
+{
+    return m_moves.size();
+}
+
+/*!
+ * \brief Returns the number of bytes which had to be buffered in memory by the last execute() call.
+ * \remarks This is only non-zero if the payloads have been reordered so moving them in place is not possible.
+ */
+inline std::uint64_t MatroskaAttachmentWritePlan::bufferedSize() const
+{
+    return m_bufferedSize;
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_MATROSKAATTACHMENTWRITEPLAN_H
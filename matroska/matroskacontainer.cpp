@@ -1,27 +1,39 @@
 #include "./matroskacontainer.h"
+#include "./ebmlcrc32.h"
 #include "./ebmlid.h"
 #include "./matroskacues.h"
 #include "./matroskaeditionentry.h"
+#include "./matroskaattachmentwriteplan.h"
 #include "./matroskaid.h"
+#include "./matroskalayoutplanner.h"
 #include "./matroskaseekinfo.h"
+#include "./matroskastatisticsengine.h"
 
 #include "../backuphelper.h"
+#include "../coalescingstreambuffer.h"
 #include "../exceptions.h"
+#include "../copyengine.h"
+#include "../fileallocator.h"
 #include "../mediafileinfo.h"
+#include "../mediafilestatistics.h"
 
 #include "resources/config.h"
 
 #include <c++utilities/conversion/stringbuilder.h>
 #include <c++utilities/conversion/stringconversion.h>
+#include <c++utilities/io/nativefilestream.h>
 
 #include <unistd.h>
 
+#include <atomic>
 #include <chrono>
+#include <exception>
 #include <functional>
 #include <initializer_list>
 #include <limits>
 #include <memory>
 #include <random>
+#include <thread>
 #include <unordered_set>
 
 using namespace std;
@@ -75,9 +87,20 @@ void MatroskaContainer::reset()
     m_seekInfos.clear();
     m_editionEntries.clear();
     m_attachments.clear();
+    m_segmentContainers.clear();
     m_segmentCount = 0;
 }
 
+/*!
+ * \brief Returns the statistics elements parsed via the container are counted in or nullptr if recording statistics is not enabled.
+ * \remarks The containers created when parsing segments concurrently count in statistics of their own which are added to the
+ *          statistics of the file when merging the results.
+ */
+MediaFileStatistics *MatroskaContainer::statistics() const
+{
+    return m_segmentStatistics ? m_segmentStatistics.get() : fileInfo().statistics();
+}
+
 /*!
  * \brief Validates the file index (cue entries).
  * \remarks Checks only for cluster positions and missing, unknown or surplus elements.
@@ -294,6 +317,56 @@ void MatroskaContainer::validateIndex(Diagnostics &diag)
     }
 }
 
+/*!
+ * \brief Validates the checksums denoted by the "CRC-32"-elements.
+ * \remarks
+ * - A "CRC-32"-element is the first child of its parent and covers the data of all subsequent children of the parent.
+ * - The entire data covered by the checksums is read so this is only done when a full parse is forced.
+ */
+void MatroskaContainer::validateChecksums(Diagnostics &diag)
+{
+    static const string context("validating Matroska CRC-32 checksums");
+    for (EbmlElement *element = m_firstElement.get(); element;) {
+        EbmlElement *child = nullptr;
+        try {
+            element->parse(diag);
+            if (auto *const firstChild = element->firstChild()) {
+                firstChild->parse(diag);
+                child = firstChild;
+            }
+        } catch (const Failure &) {
+            // the structural error has already been reported when validating the element structure
+        }
+        if (child && child->id() == EbmlIds::Crc32) {
+            if (child->dataSize() != 4) {
+                diag.emplace_back(DiagLevel::Warning,
+                    argsToString("The \"CRC-32\"-element at ", child->startOffset(), " has an invalid size and is therefore ignored."), context);
+            } else {
+                stream().seekg(static_cast<streamoff>(child->dataOffset()));
+                const auto denotedChecksum = reader().readUInt32LE();
+                const auto coveredEndOffset = min<std::uint64_t>(element->endOffset(), fileInfo().size());
+                const auto computedChecksum = EbmlCrc32::compute(stream(), coveredEndOffset - min(child->endOffset(), coveredEndOffset));
+                if (denotedChecksum != computedChecksum) {
+                    diag.emplace_back(DiagLevel::Warning,
+                        argsToString("The denoted checksum of the \"", element->idToString(), "\"-element at ", element->startOffset(),
+                            " does not match the computed checksum."),
+                        context);
+                }
+            }
+        }
+        // continue with the next element in document order
+        if (child) {
+            element = child;
+            continue;
+        }
+        for (; element && !element->nextSibling(); element = element->parent()) {
+        }
+        if (element) {
+            element = element->nextSibling();
+        }
+    }
+}
+
 /*!
  * \brief Returns an indication whether \a offset equals the start offset of \a element.
  */
@@ -311,6 +384,18 @@ inline bool excludesOffset(const vector<EbmlElement *> &elements, std::uint64_t
     return find_if(elements.cbegin(), elements.cend(), std::bind(sameOffset, offset, _1)) == elements.cend();
 }
 
+/*!
+ * \brief Moves the specified \a objects to the end of \a target.
+ * \remarks This function is used to take the objects which have been parsed when parsing segments concurrently.
+ */
+template <typename ObjectType> inline void moveObjects(vector<unique_ptr<ObjectType>> &objects, vector<unique_ptr<ObjectType>> &target)
+{
+    for (auto &object : objects) {
+        target.emplace_back(move(object));
+    }
+    objects.clear();
+}
+
 MatroskaChapter *MatroskaContainer::chapter(std::size_t index)
 {
     for (const auto &entry : m_editionEntries) {
@@ -410,7 +495,9 @@ void MatroskaContainer::internalParseHeader(Diagnostics &diag)
     m_seekInfos.clear();
     m_segmentCount = 0;
     std::uint64_t currentOffset = 0;
-    vector<MatroskaSeekInfo>::difference_type seekInfosIndex = 0;
+    std::size_t seekInfosIndex = 0;
+    const auto concurrently = fileInfo().isParsingSegmentsConcurrently();
+    auto segments = vector<pair<EbmlElement *, std::uint64_t>>();
 
     // loop through all top level elements
     for (EbmlElement *topLevelElement = m_firstElement.get(); topLevelElement; topLevelElement = topLevelElement->nextSibling()) {
@@ -466,110 +553,11 @@ void MatroskaContainer::internalParseHeader(Diagnostics &diag)
                 break;
             case MatroskaIds::Segment:
                 ++m_segmentCount;
-                for (EbmlElement *subElement = topLevelElement->firstChild(); subElement; subElement = subElement->nextSibling()) {
-                    try {
-                        subElement->parse(diag);
-                        switch (subElement->id()) {
-                        case MatroskaIds::SeekHead:
-                            m_seekInfos.emplace_back(make_unique<MatroskaSeekInfo>());
-                            m_seekInfos.back()->parse(subElement, diag);
-                            break;
-                        case MatroskaIds::Tracks:
-                            if (excludesOffset(m_tracksElements, subElement->startOffset())) {
-                                m_tracksElements.push_back(subElement);
-                            }
-                            break;
-                        case MatroskaIds::SegmentInfo:
-                            if (excludesOffset(m_segmentInfoElements, subElement->startOffset())) {
-                                m_segmentInfoElements.push_back(subElement);
-                            }
-                            break;
-                        case MatroskaIds::Tags:
-                            if (excludesOffset(m_tagsElements, subElement->startOffset())) {
-                                m_tagsElements.push_back(subElement);
-                            }
-                            break;
-                        case MatroskaIds::Chapters:
-                            if (excludesOffset(m_chaptersElements, subElement->startOffset())) {
-                                m_chaptersElements.push_back(subElement);
-                            }
-                            break;
-                        case MatroskaIds::Attachments:
-                            if (excludesOffset(m_attachmentsElements, subElement->startOffset())) {
-                                m_attachmentsElements.push_back(subElement);
-                            }
-                            break;
-                        case MatroskaIds::Cluster:
-                            // stop as soon as the first cluster has been reached if all relevant information has been gathered
-                            // -> take elements from seek tables within this segment into account
-                            for (auto i = m_seekInfos.cbegin() + seekInfosIndex, end = m_seekInfos.cend(); i != end; ++i, ++seekInfosIndex) {
-                                for (const auto &infoPair : (*i)->info()) {
-                                    std::uint64_t offset = currentOffset + topLevelElement->dataOffset() + infoPair.second;
-                                    if (offset >= fileInfo().size()) {
-                                        diag.emplace_back(DiagLevel::Critical,
-                                            argsToString("Offset (", offset, ") denoted by \"SeekHead\" element is invalid."), context);
-                                    } else {
-                                        auto element = make_unique<EbmlElement>(*this, offset);
-                                        try {
-                                            element->parse(diag);
-                                            if (element->id() != infoPair.first) {
-                                                diag.emplace_back(DiagLevel::Critical,
-                                                    argsToString("ID of element ", element->idToString(), " at ", offset,
-                                                        " does not match the ID denoted in the \"SeekHead\" element (0x",
-                                                        numberToString(infoPair.first, 16), ")."),
-                                                    context);
-                                            }
-                                            switch (element->id()) {
-                                            case MatroskaIds::SegmentInfo:
-                                                if (excludesOffset(m_segmentInfoElements, offset)) {
-                                                    m_additionalElements.emplace_back(move(element));
-                                                    m_segmentInfoElements.emplace_back(m_additionalElements.back().get());
-                                                }
-                                                break;
-                                            case MatroskaIds::Tracks:
-                                                if (excludesOffset(m_tracksElements, offset)) {
-                                                    m_additionalElements.emplace_back(move(element));
-                                                    m_tracksElements.emplace_back(m_additionalElements.back().get());
-                                                }
-                                                break;
-                                            case MatroskaIds::Tags:
-                                                if (excludesOffset(m_tagsElements, offset)) {
-                                                    m_additionalElements.emplace_back(move(element));
-                                                    m_tagsElements.emplace_back(m_additionalElements.back().get());
-                                                }
-                                                break;
-                                            case MatroskaIds::Chapters:
-                                                if (excludesOffset(m_chaptersElements, offset)) {
-                                                    m_additionalElements.emplace_back(move(element));
-                                                    m_chaptersElements.emplace_back(m_additionalElements.back().get());
-                                                }
-                                                break;
-                                            case MatroskaIds::Attachments:
-                                                if (excludesOffset(m_attachmentsElements, offset)) {
-                                                    m_additionalElements.emplace_back(move(element));
-                                                    m_attachmentsElements.emplace_back(m_additionalElements.back().get());
-                                                }
-                                                break;
-                                            default:;
-                                            }
-                                        } catch (const Failure &) {
-                                            diag.emplace_back(DiagLevel::Critical,
-                                                argsToString("Can not parse element at ", offset, " (denoted using \"SeekHead\" element)."), context);
-                                        }
-                                    }
-                                }
-                            }
-                            // -> stop if tracks and tags have been found or the file exceeds the max. size to fully process
-                            if (((!m_tracksElements.empty() && !m_tagsElements.empty()) || fileInfo().size() > m_maxFullParseSize)
-                                && !m_segmentInfoElements.empty()) {
-                                goto finish;
-                            }
-                            break;
-                        }
-                    } catch (const Failure &) {
-                        diag.emplace_back(DiagLevel::Critical, "Unable to parse all children of \"Segment\"-element.", context);
-                        break;
-                    }
+                if (concurrently) {
+                    // only record the segment; the children of all segments are walked after the segments have been found
+                    segments.emplace_back(topLevelElement, currentOffset + topLevelElement->dataOffset());
+                } else if (parseSegment(*topLevelElement, currentOffset + topLevelElement->dataOffset(), seekInfosIndex, diag)) {
+                    goto finish;
                 }
                 currentOffset += topLevelElement->totalSize();
                 break;
@@ -582,6 +570,13 @@ void MatroskaContainer::internalParseHeader(Diagnostics &diag)
         }
     }
 
+    // walk the children of the segments if only their boundaries have been determined so far
+    if (segments.size() > 1) {
+        parseSegmentsConcurrently(segments, diag);
+    } else if (segments.size() == 1) {
+        parseSegment(*segments.front().first, segments.front().second, seekInfosIndex, diag);
+    }
+
     // finally parse the "Info"-element and fetch "EditionEntry"-elements
 finish:
     try {
@@ -591,6 +586,278 @@ finish:
     }
 }
 
+/*!
+ * \brief Walks the children of the specified \a segmentElement gathering the level 1 elements.
+ * \returns Returns whether all relevant information has been gathered so parsing further segments is not required.
+ *
+ * This private method is called when parsing the header. The positions of the seek information are relative to \a segmentOffset.
+ */
+bool MatroskaContainer::parseSegment(EbmlElement &segmentElement, std::uint64_t segmentOffset, std::size_t &seekInfosIndex, Diagnostics &diag)
+{
+    static const string context("parsing header of Matroska container");
+    for (EbmlElement *subElement = segmentElement.firstChild(); subElement; subElement = subElement->nextSibling()) {
+        try {
+            subElement->parse(diag);
+            switch (subElement->id()) {
+            case MatroskaIds::SeekHead:
+                m_seekInfos.emplace_back(make_unique<MatroskaSeekInfo>());
+                m_seekInfos.back()->parse(subElement, diag);
+                break;
+            case MatroskaIds::Tracks:
+                if (excludesOffset(m_tracksElements, subElement->startOffset())) {
+                    m_tracksElements.push_back(subElement);
+                }
+                break;
+            case MatroskaIds::SegmentInfo:
+                if (excludesOffset(m_segmentInfoElements, subElement->startOffset())) {
+                    m_segmentInfoElements.push_back(subElement);
+                }
+                break;
+            case MatroskaIds::Tags:
+                if (excludesOffset(m_tagsElements, subElement->startOffset())) {
+                    m_tagsElements.push_back(subElement);
+                }
+                break;
+            case MatroskaIds::Chapters:
+                if (excludesOffset(m_chaptersElements, subElement->startOffset())) {
+                    m_chaptersElements.push_back(subElement);
+                }
+                break;
+            case MatroskaIds::Attachments:
+                if (excludesOffset(m_attachmentsElements, subElement->startOffset())) {
+                    m_attachmentsElements.push_back(subElement);
+                }
+                break;
+            case MatroskaIds::Cluster:
+                // stop as soon as the first cluster has been reached if all relevant information has been gathered
+                // -> take elements from seek tables within this segment into account
+                addElementsFromSeekInfos(segmentOffset, seekInfosIndex, diag);
+                // -> stop if tracks and tags have been found or the file exceeds the max. size to fully process
+                if (((!m_tracksElements.empty() && !m_tagsElements.empty()) || fileInfo().size() > m_maxFullParseSize)
+                    && !m_segmentInfoElements.empty()) {
+                    return true;
+                }
+                break;
+            }
+        } catch (const Failure &) {
+            diag.emplace_back(DiagLevel::Critical, "Unable to parse all children of \"Segment\"-element.", context);
+            break;
+        }
+    }
+
+    return false;
+}
+
+/*!
+ * \brief Parses the specified \a segments concurrently.
+ *
+ * This private method is called when parsing the header if parsing segments concurrently is enabled and multiple segments
+ * have been found. The \a segments are specified as pairs of the "Segment"-element and the offset the positions of its seek
+ * information are relative to.
+ *
+ * A container is created for each segment. It uses its own stream and element tree to walk the children of the segment and
+ * to parse the tracks, tags, chapters and attachments within it; see parseSegmentUsingOwnStream(). The gathered level 1
+ * elements and the messages are merged in the order of the segments. The tracks, tags, chapters and attachments are taken
+ * from the containers when they are parsed via internalParseTracks(), internalParseTags(), internalParseChapters() and
+ * internalParseAttachments(). The containers are kept as the elements are owned by them.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void MatroskaContainer::parseSegmentsConcurrently(const std::vector<std::pair<EbmlElement *, std::uint64_t>> &segments, Diagnostics &diag)
+{
+    struct SegmentResult {
+        std::unique_ptr<MatroskaContainer> container;
+        Diagnostics diag;
+        std::exception_ptr failure;
+    };
+    auto results = vector<SegmentResult>(segments.size());
+    for (auto index = std::size_t(); index != segments.size(); ++index) {
+        auto &result = results[index];
+        result.container = make_unique<MatroskaContainer>(fileInfo(), segments[index].first->startOffset());
+        result.container->m_maxIdLength = m_maxIdLength;
+        result.container->m_maxSizeLength = m_maxSizeLength;
+        if (fileInfo().statistics()) {
+            result.container->m_segmentStatistics = make_unique<MediaFileStatistics>();
+        }
+        // drop messages the caller is not interested in right away; the results are merged into diag unfiltered
+        result.diag.setMinimumLevel(diag.minimumLevel());
+    }
+
+    // parse the segments concurrently
+    auto nextSegment = atomic_size_t(0);
+    const auto parseSegments = [&] {
+        for (auto index = nextSegment++; index < segments.size(); index = nextSegment++) {
+            auto &result = results[index];
+            try {
+                result.container->parseSegmentUsingOwnStream(segments[index].second, result.diag);
+            } catch (...) {
+                result.failure = current_exception();
+            }
+        }
+    };
+    const auto threadCount = min<std::size_t>(max(std::thread::hardware_concurrency(), 1u), segments.size());
+    auto workers = vector<thread>();
+    try {
+        for (auto i = threadCount; i > 1; --i) {
+            workers.emplace_back(parseSegments);
+        }
+    } catch (const std::system_error &) {
+        // parse the remaining segments on the current thread
+    }
+    parseSegments();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    // combine the results
+    auto failure = exception_ptr();
+    for (auto &result : results) {
+        diag.insert(diag.end(), result.diag.begin(), result.diag.end());
+        if (!failure && result.failure) {
+            failure = result.failure;
+        }
+        for (const auto id : { MatroskaIds::SegmentInfo, MatroskaIds::Tracks, MatroskaIds::Tags, MatroskaIds::Chapters, MatroskaIds::Attachments }) {
+            auto &elements = *level1Elements(id);
+            const auto &segmentElements = *result.container->level1Elements(id);
+            elements.insert(elements.end(), segmentElements.cbegin(), segmentElements.cend());
+        }
+        if (auto *const statistics = fileInfo().statistics()) {
+            statistics->elementsParsed += result.container->m_segmentStatistics->elementsParsed;
+            result.container->m_segmentStatistics.reset();
+        }
+        for (auto &seekInfo : result.container->m_seekInfos) {
+            m_seekInfos.emplace_back(move(seekInfo));
+        }
+        result.container->m_seekInfos.clear();
+        m_segmentContainers.emplace_back(move(result.container));
+    }
+    if (failure) {
+        rethrow_exception(failure);
+    }
+}
+
+/*!
+ * \brief Parses the segment the container has been created for via a stream of its own.
+ *
+ * This private method is invoked concurrently by parseSegmentsConcurrently() on the containers created for the segments. It
+ * walks the children of the segment and parses the tracks, tags, chapters and attachments within it. Afterwards the container
+ * (and the tracks) use the stream of the file again.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void MatroskaContainer::parseSegmentUsingOwnStream(std::uint64_t segmentOffset, Diagnostics &diag)
+{
+    static const string context("parsing header of Matroska container");
+    auto &fileStream = stream();
+    const auto restoreStream = [&] {
+        setStream(fileStream);
+        for (auto &track : m_tracks) {
+            track->setInputStream(fileStream);
+        }
+    };
+    auto segmentStream = NativeFileStream();
+    segmentStream.exceptions(ios_base::badbit | ios_base::failbit);
+    try {
+        segmentStream.open(BasicFileInfo::pathForOpen(fileInfo().path()), ios_base::in | ios_base::binary);
+        setStream(segmentStream);
+        m_firstElement = make_unique<EbmlElement>(*this, startOffset());
+        try {
+            auto seekInfosIndex = std::size_t();
+            // the "Segment"-element itself has already been parsed (and counted) by the file's container
+            auto segmentElementDiag = Diagnostics();
+            m_firstElement->parse(segmentElementDiag);
+            if (m_segmentStatistics) {
+                --m_segmentStatistics->elementsParsed;
+            }
+            parseSegment(*m_firstElement, segmentOffset, seekInfosIndex, diag);
+        } catch (const Failure &) {
+            diag.emplace_back(DiagLevel::Critical, argsToString("Unable to parse top-level element at ", startOffset(), '.'), context);
+        }
+        for (const auto parse : { &MatroskaContainer::internalParseTracks, &MatroskaContainer::internalParseTags,
+                 &MatroskaContainer::internalParseChapters, &MatroskaContainer::internalParseAttachments }) {
+            try {
+                (this->*parse)(diag);
+            } catch (const Failure &) {
+                // the problem has already been reported; parse the other elements nevertheless
+            }
+        }
+    } catch (...) {
+        restoreStream();
+        throw;
+    }
+    restoreStream();
+}
+
+/*!
+ * \brief Assigns the specified \a stream to the container and to the containers created when parsing the segments concurrently.
+ * \remarks The latter own the elements the tracks, tags, chapters and attachments have been parsed from if segments have been
+ *          parsed concurrently. So they need to read from the same stream when making the file.
+ */
+void MatroskaContainer::setStreamIncludingSegments(std::iostream &stream)
+{
+    setStream(stream);
+    for (auto &segmentContainer : m_segmentContainers) {
+        segmentContainer->setStream(stream);
+    }
+}
+
+/*!
+ * \brief Returns the list the level 1 elements with the specified \a id are gathered in or nullptr if such elements are not gathered.
+ */
+std::vector<EbmlElement *> *MatroskaContainer::level1Elements(EbmlElement::IdentifierType id)
+{
+    switch (id) {
+    case MatroskaIds::SegmentInfo:
+        return &m_segmentInfoElements;
+    case MatroskaIds::Tracks:
+        return &m_tracksElements;
+    case MatroskaIds::Tags:
+        return &m_tagsElements;
+    case MatroskaIds::Chapters:
+        return &m_chaptersElements;
+    case MatroskaIds::Attachments:
+        return &m_attachmentsElements;
+    default:
+        return nullptr;
+    }
+}
+
+/*!
+ * \brief Gathers the level 1 elements denoted by the seek information parsed so far (starting at \a seekInfosIndex).
+ *
+ * This private method is called when parsing the header as soon as the first "Cluster"-element of a segment has been
+ * reached. The positions of the seek information are relative to \a segmentOffset.
+ */
+void MatroskaContainer::addElementsFromSeekInfos(std::uint64_t segmentOffset, std::size_t &seekInfosIndex, Diagnostics &diag)
+{
+    static const string context("parsing header of Matroska container");
+    for (const auto seekInfosCount = m_seekInfos.size(); seekInfosIndex != seekInfosCount; ++seekInfosIndex) {
+        for (const auto &infoPair : m_seekInfos[seekInfosIndex]->info()) {
+            std::uint64_t offset = segmentOffset + infoPair.second;
+            if (offset >= fileInfo().size()) {
+                diag.emplace_back(DiagLevel::Critical, argsToString("Offset (", offset, ") denoted by \"SeekHead\" element is invalid."), context);
+                continue;
+            }
+            auto element = make_unique<EbmlElement>(*this, offset);
+            try {
+                element->parse(diag);
+                if (element->id() != infoPair.first) {
+                    diag.emplace_back(DiagLevel::Critical,
+                        argsToString("ID of element ", element->idToString(), " at ", offset, " does not match the ID denoted in the \"SeekHead\" element (0x",
+                            numberToString(infoPair.first, 16), ")."),
+                        context);
+                }
+                if (auto *const elements = level1Elements(element->id()); elements && excludesOffset(*elements, offset)) {
+                    m_additionalElements.emplace_back(move(element));
+                    elements->emplace_back(m_additionalElements.back().get());
+                }
+            } catch (const Failure &) {
+                diag.emplace_back(DiagLevel::Critical, argsToString("Can not parse element at ", offset, " (denoted using \"SeekHead\" element)."), context);
+            }
+        }
+    }
+}
+
 /*!
  * \brief Parses the (segment) "Info"-element.
  *
@@ -654,9 +921,109 @@ void MatroskaContainer::readTrackStatisticsFromTags(Diagnostics &diag)
     }
 }
 
+/*!
+ * \brief Computes the statistics of the tracks (frame count, byte count, duration and bitrate) from the "Cluster"-elements.
+ *
+ * Only the block headers are read and the clusters are scanned by multiple threads; see MatroskaStatisticsEngine for
+ * details. The statistics are assigned to the tracks, replacing the values read from tags. If \a writeTags is set,
+ * the statistics are also assigned to the track-specific tags (as done by mkvmerge) so they are written when applying
+ * changes.
+ *
+ * \remarks The header and the tracks must have been parsed before calling this method.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \throws Throws TagParser::Failure or a derived exception when a parsing error occurs.
+ * \throws Throws OperationAbortedException when aborted via \a progress.
+ */
+void MatroskaContainer::computeTrackStatistics(Diagnostics &diag, AbortableProgressFeedback *progress, bool writeTags)
+{
+    static const string context("computing Matroska track statistics");
+    if (!m_firstElement || tracks().empty()) {
+        return;
+    }
+    if (progress) {
+        progress->updateStep("Computing track statistics ...");
+    }
+
+    // only the first segment is considered since the tracks are only parsed from it
+    auto *const segmentElement = m_firstElement->siblingByIdIncludingThis(MatroskaIds::Segment, diag);
+    if (!segmentElement) {
+        diag.emplace_back(DiagLevel::Warning, "No \"Segment\"-element found.", context);
+        return;
+    }
+    auto engine = MatroskaStatisticsEngine(fileInfo().path(), static_cast<std::uint8_t>(m_maxIdLength), static_cast<std::uint8_t>(m_maxSizeLength));
+    auto timestampScale = std::uint64_t(1000000);
+    segmentElement->parse(diag);
+    for (auto *childElement = segmentElement->firstChild(); childElement; childElement = childElement->nextSibling()) {
+        childElement->parse(diag);
+        switch (childElement->id()) {
+        case MatroskaIds::SegmentInfo:
+            if (auto *const timestampScaleElement = childElement->childById(MatroskaIds::TimeCodeScale, diag)) {
+                timestampScale = timestampScaleElement->readUInteger();
+            }
+            break;
+        case MatroskaIds::Cluster:
+            engine.addCluster(childElement->dataOffset(), childElement->dataSize());
+            break;
+        default:;
+        }
+    }
+    if (!engine.clusterCount()) {
+        diag.emplace_back(DiagLevel::Information, "No \"Cluster\"-elements found.", context);
+        return;
+    }
+    const auto statistics = engine.compute(diag, progress);
+    if (auto *const fileStatistics = fileInfo().statistics()) {
+        for (const auto &values : statistics) {
+            fileStatistics->framesParsed += values.frameCount;
+        }
+    }
+
+    // assign statistics to tracks
+    const auto writingDate = DateTime::gmtNow();
+    const auto noStatistics = MatroskaTrackStatistics();
+    for (auto &track : tracks()) {
+        auto trackStatistics = find_if(statistics.cbegin(), statistics.cend(),
+            [number = track->trackNumber()](const MatroskaTrackStatistics &candidate) { return candidate.trackNumber == number; });
+        const auto &values = trackStatistics != statistics.cend() ? *trackStatistics : noStatistics;
+        // blocks without "BlockDuration"-element last as long as denoted by the "DefaultDuration"-element
+        auto defaultDuration = std::uint64_t();
+        if (auto *const defaultDurationElement = track->m_trackElement->childById(MatroskaIds::DefaultDuration, diag)) {
+            defaultDuration = defaultDurationElement->readUInteger();
+        }
+        track->m_sampleCount = values.frameCount;
+        track->m_size = values.byteCount;
+        track->m_duration = values.duration(timestampScale, defaultDuration);
+        track->m_bitrate = values.bitrate(timestampScale, defaultDuration);
+        if (!writeTags) {
+            continue;
+        }
+        using namespace MatroskaTagIds::TrackSpecific;
+        auto *const tag = createTag(TagTarget(50, { track->id() }));
+        tag->setValue(numberOfFrames(), TagValue(numberToString(values.frameCount)));
+        tag->setValue(numberOfBytes(), TagValue(numberToString(values.byteCount)));
+        tag->setValue(MatroskaTagIds::TrackSpecific::duration(),
+            TagValue(MatroskaTrackStatistics::formatDuration(values.durationInNanoseconds(timestampScale, defaultDuration))));
+        tag->setValue(MatroskaTagIds::TrackSpecific::bitrate(), TagValue(numberToString(static_cast<std::uint64_t>(track->m_bitrate * 1000.0))));
+        tag->setValue(writingApp(),
+            TagValue(fileInfo().writingApplication().empty() ? string(APP_NAME " v" APP_VERSION) : string(fileInfo().writingApplication())));
+        tag->setValue(MatroskaTagIds::TrackSpecific::writingDate(), TagValue(writingDate.toString(DateTimeOutputFormat::DateAndTime)));
+        tag->setValue(statisticsTags(),
+            TagValue(argsToString(MatroskaTagIds::TrackSpecific::bitrate(), ' ', MatroskaTagIds::TrackSpecific::duration(), ' ', numberOfFrames(),
+                ' ', numberOfBytes())));
+    }
+}
+
 void MatroskaContainer::internalParseTags(Diagnostics &diag)
 {
     static const string context("parsing tags of Matroska container");
+    // take the tags which have already been parsed when parsing the segments concurrently
+    if (!m_segmentContainers.empty()) {
+        for (auto &segmentContainer : m_segmentContainers) {
+            moveObjects(segmentContainer->m_tags, m_tags);
+        }
+        readTrackStatisticsFromTags(diag);
+        return;
+    }
     for (EbmlElement *element : m_tagsElements) {
         try {
             element->parse(diag);
@@ -666,7 +1033,7 @@ void MatroskaContainer::internalParseTags(Diagnostics &diag)
                 case MatroskaIds::Tag:
                     m_tags.emplace_back(make_unique<MatroskaTag>());
                     try {
-                        m_tags.back()->parse(*subElement, diag);
+                        m_tags.back()->parse(*subElement, diag, !fileInfo().isParsingTagsLazily());
                     } catch (const NoDataFoundException &) {
                         m_tags.pop_back();
                     } catch (const Failure &) {
@@ -692,6 +1059,14 @@ void MatroskaContainer::internalParseTags(Diagnostics &diag)
 void MatroskaContainer::internalParseTracks(Diagnostics &diag)
 {
     static const string context("parsing tracks of Matroska container");
+    // take the tracks which have already been parsed when parsing the segments concurrently
+    if (!m_segmentContainers.empty()) {
+        for (auto &segmentContainer : m_segmentContainers) {
+            moveObjects(segmentContainer->m_tracks, m_tracks);
+        }
+        readTrackStatisticsFromTags(diag);
+        return;
+    }
     for (EbmlElement *element : m_tracksElements) {
         try {
             element->parse(diag);
@@ -728,6 +1103,13 @@ void MatroskaContainer::internalParseTracks(Diagnostics &diag)
 void MatroskaContainer::internalParseChapters(Diagnostics &diag)
 {
     static const string context("parsing editions/chapters of Matroska container");
+    // take the editions which have already been parsed when parsing the segments concurrently
+    if (!m_segmentContainers.empty()) {
+        for (auto &segmentContainer : m_segmentContainers) {
+            moveObjects(segmentContainer->m_editionEntries, m_editionEntries);
+        }
+        return;
+    }
     for (EbmlElement *element : m_chaptersElements) {
         try {
             element->parse(diag);
@@ -762,6 +1144,13 @@ void MatroskaContainer::internalParseChapters(Diagnostics &diag)
 void MatroskaContainer::internalParseAttachments(Diagnostics &diag)
 {
     static const string context("parsing attachments of Matroska container");
+    // take the attachments which have already been parsed when parsing the segments concurrently
+    if (!m_segmentContainers.empty()) {
+        for (auto &segmentContainer : m_segmentContainers) {
+            moveObjects(segmentContainer->m_attachments, m_attachments);
+        }
+        return;
+    }
     for (EbmlElement *element : m_attachmentsElements) {
         try {
             element->parse(diag);
@@ -798,10 +1187,11 @@ struct SegmentData {
     /// \brief Constructs a new segment data object.
     SegmentData()
         : hasCrc32(false)
+        , originalCrc32(0)
         , cuesElement(nullptr)
+        , initialized(false)
         , infoDataSize(0)
         , firstClusterElement(nullptr)
-        , clusterEndOffset(0)
         , startOffset(0)
         , newPadding(0)
         , totalDataSize(0)
@@ -813,20 +1203,22 @@ struct SegmentData {
 
     /// \brief whether CRC-32 checksum is present
     bool hasCrc32;
+    /// \brief CRC-32 checksum (original file)
+    std::uint32_t originalCrc32;
     /// \brief used to make "SeekHead"-element
     MatroskaSeekInfo seekInfo;
     /// \brief "Cues"-element (original file)
     EbmlElement *cuesElement;
     /// \brief used to make "Cues"-element
     MatroskaCuePositionUpdater cuesUpdater;
+    /// \brief whether cuesUpdater and layout have been initialized
+    bool initialized;
     /// \brief size of the "SegmentInfo"-element
     std::uint64_t infoDataSize;
-    /// \brief cluster sizes
-    vector<std::uint64_t> clusterSizes;
+    /// \brief used to place the "Cluster"-elements
+    MatroskaLayoutPlanner layout;
     /// \brief first "Cluster"-element (original file)
     EbmlElement *firstClusterElement;
-    /// \brief end offset of last "Cluster"-element (original file)
-    std::uint64_t clusterEndOffset;
     /// \brief start offset (in the new file)
     std::uint64_t startOffset;
     /// \brief padding (in the new file)
@@ -869,10 +1261,14 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
     attachmentMaker.reserve(m_attachments.size());
     std::uint64_t attachedFileElementsSize = 0;
     std::uint64_t attachmentsSize;
+    // offset of the "Attachments"-element relative to the data of the segment it is written to
+    std::uint64_t attachmentsOffset = 0;
+    unsigned int attachmentsSegmentIndex = 0;
     vector<MatroskaTrackHeaderMaker> trackHeaderMaker;
     trackHeaderMaker.reserve(tracks().size());
     std::uint64_t trackHeaderElementsSize = 0;
     std::uint64_t trackHeaderSize;
+    vector<std::uint64_t> indexedTrackNumbers;
 
     // define variables to store sizes, offsets and other information required to make a header and "Segment"-elements
     // current segment index
@@ -889,8 +1285,8 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
     vector<tuple<std::uint64_t, std::uint64_t>> crc32Offsets;
     // size length used to make size denotations
     std::uint8_t sizeLength;
-    // sizes and offsets for cluster calculation
-    std::uint64_t clusterSize, clusterReadSize, clusterReadOffset;
+    // offset of the "Cluster"-element which is currently written (used to make "Position"-elements)
+    std::uint64_t clusterSize;
 
     // define variables needed to manage file layout
     // -> use the preferred tag position by default (might be changed later if not forced)
@@ -976,6 +1372,15 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
         trackHeaderSize
             = trackHeaderElementsSize ? 4 + EbmlElement::calculateSizeDenotationLength(trackHeaderElementsSize) + trackHeaderElementsSize : 0;
 
+        // determine the tracks to be indexed when generating the cues (video tracks unless all tracks should be indexed)
+        if (fileInfo().indexGeneration() != IndexGeneration::Never && !fileInfo().isIndexingAllTracks()) {
+            for (const auto &track : tracks()) {
+                if (track->mediaType() == MediaType::Video) {
+                    indexedTrackNumbers.emplace_back(track->trackNumber());
+                }
+            }
+        }
+
         // inspect layout of original file
         //  - number of segments
         //  - position of tags relative to the media data
@@ -1059,14 +1464,21 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                 // get reference to the current segment data instance
                 SegmentData &segment = segmentData[segmentIndex];
 
-                // parse original "Cues"-element (if present)
-                if (!segment.cuesElement && (segment.cuesElement = level0Element->childById(MatroskaIds::Cues, diag))) {
-                    segment.cuesUpdater.parse(segment.cuesElement, diag);
-                }
-
-                // get first "Cluster"-element
-                if (!segment.firstClusterElement) {
-                    segment.firstClusterElement = level0Element->childById(MatroskaIds::Cluster, diag);
+                // determine the "Cluster"-elements, parse original "Cues"-element (if present) and generate the cues if required
+                if (!segment.initialized) {
+                    segment.initialized = true;
+                    segment.layout.parseClusters(level0Element, diag);
+                    segment.firstClusterElement = segment.layout.clusterCount() ? segment.layout.cluster(0) : nullptr;
+                    const auto indexGeneration = fileInfo().indexGeneration();
+                    if ((segment.cuesElement = level0Element->childById(MatroskaIds::Cues, diag)) && indexGeneration != IndexGeneration::Always) {
+                        segment.cuesUpdater.parse(segment.cuesElement, diag);
+                    }
+                    // -> an updater holding only the "Cues"-element itself has no cue points
+                    if (indexGeneration == IndexGeneration::Always
+                        || (indexGeneration == IndexGeneration::IfMissing && segment.cuesUpdater.entryCount() <= 1)) {
+                        progress.updateStep("Generating index ...");
+                        segment.cuesUpdater.generate(level0Element, indexedTrackNumbers, diag);
+                    }
                 }
 
                 // determine current/new cue position
@@ -1085,6 +1497,11 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
 
                 // check whether the segment has a CRC-32 element
                 segment.hasCrc32 = level0Element->firstChild() && level0Element->firstChild()->id() == EbmlIds::Crc32;
+                if (segment.hasCrc32 && level0Element->firstChild()->dataSize() == 4) {
+                    // keep the original checksum to write it as placeholder (so it is not altered when updating an unchanged file in-place)
+                    stream().seekg(static_cast<streamoff>(level0Element->firstChild()->dataOffset()));
+                    segment.originalCrc32 = reader().readUInt32LE();
+                }
 
                 // precalculate the size of the segment
             calculateSegmentSize:
@@ -1177,6 +1594,8 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                             goto calculateSegmentSize;
                         } else {
                             // add size of "Attachments"-element
+                            attachmentsOffset = segment.totalDataSize;
+                            attachmentsSegmentIndex = segmentIndex;
                             segment.totalDataSize += attachmentsSize;
                         }
                     }
@@ -1185,7 +1604,7 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                 offset = segment.totalDataSize; // save current offset (offset before "Cues"-element)
 
                 // pretend writing "Cues"-element
-                if (newCuesPos == ElementPosition::BeforeData && segment.cuesElement) {
+                if (newCuesPos == ElementPosition::BeforeData && segment.cuesUpdater.entryCount()) {
                     // update offset of "Cues"-element in "SeekHead"-element
                     if (segment.seekInfo.push(0, MatroskaIds::Cues, currentPosition + segment.totalDataSize)) {
                         goto calculateSegmentSize;
@@ -1228,33 +1647,18 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                                     0, MatroskaIds::Cluster, level1Element->startOffset() - 4 - segment.sizeDenotationLength - ebmlHeaderSize)) {
                                 goto calculateSegmentSize;
                             }
-                            // -> update offset of "Cluster"-element in "Cues"-element and get end offset of last "Cluster"-element
-                            bool cuesInvalidated = false;
-                            for (index = 0; level1Element; level1Element = level1Element->siblingById(MatroskaIds::Cluster, diag), ++index) {
-                                clusterReadOffset = level1Element->startOffset() - level0Element->dataOffset() + readOffset;
-                                segment.clusterEndOffset = level1Element->endOffset();
-                                if (segment.cuesElement
-                                    && segment.cuesUpdater.updateOffsets(
-                                        clusterReadOffset, level1Element->startOffset() - 4 - segment.sizeDenotationLength - ebmlHeaderSize)
-                                    && newCuesPos == ElementPosition::BeforeData) {
-                                    cuesInvalidated = true;
-                                }
-                                // check whether aborted (because this loop might take some seconds to process)
-                                progress.stopIfAborted();
-                                // update the progress percentage (using offset / file size should be accurate enough)
-                                if (index % 50 == 0) {
-                                    progress.updateStepPercentage(static_cast<std::uint8_t>(level1Element->dataOffset() * 100 / fileInfo().size()));
-                                }
-                            }
-                            if (cuesInvalidated) {
+                            // -> update offsets of "Cluster"-elements in "Cues"-element
+                            segment.layout.keep(level1Element->startOffset() - 4 - segment.sizeDenotationLength - ebmlHeaderSize);
+                            if (segment.cuesUpdater.entryCount() && segment.cuesUpdater.updateOffsets(segment.layout, readOffset)
+                                && newCuesPos == ElementPosition::BeforeData) {
                                 segment.totalDataSize = offset;
                                 goto addCuesElementSize;
                             }
-                            segment.totalDataSize = segment.clusterEndOffset - currentOffset - 4 - segment.sizeDenotationLength;
+                            segment.totalDataSize = segment.layout.originalEndOffset() - currentOffset - 4 - segment.sizeDenotationLength;
 
                             // pretend writing "Cues"-element
                             progress.updateStep("Calculating offsets of elements after cluster ...");
-                            if (newCuesPos == ElementPosition::AfterData && segment.cuesElement) {
+                            if (newCuesPos == ElementPosition::AfterData && segment.cuesUpdater.entryCount()) {
                                 // update offset of "Cues"-element in "SeekHead"-element
                                 if (segment.seekInfo.push(0, MatroskaIds::Cues, currentPosition + segment.totalDataSize)) {
                                     goto calculateSegmentSize;
@@ -1282,6 +1686,8 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                                         goto calculateSegmentSize;
                                     } else {
                                         // add size of "Attachments"-element
+                                        attachmentsOffset = segment.totalDataSize;
+                                        attachmentsSegmentIndex = segmentIndex;
                                         segment.totalDataSize += attachmentsSize;
                                     }
                                 }
@@ -1340,67 +1746,32 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                     // if rewrite is required, pretend writing the remaining elements to compute total segment size
 
                     // pretend writing "Void"-element (only if there is at least one "Cluster"-element in the segment)
-                    if (!segmentIndex && rewriteRequired && (level1Element = level0Element->childById(MatroskaIds::Cluster, diag))) {
-                        // simply use the preferred padding
-                        segment.totalDataSize += (segment.newPadding = newPadding = fileInfo().preferredPadding());
+                    if (!segmentIndex && rewriteRequired && segment.layout.clusterCount()) {
+                        // use the preferred padding or the padding determined by the padding policy
+                        segment.totalDataSize += (segment.newPadding = newPadding = fileInfo().paddingForRewrite(tagsSize));
                     }
 
-                    // pretend writing "Cluster"-element
-                    segment.clusterSizes.clear();
-                    bool cuesInvalidated = false;
-                    for (index = 0; level1Element; level1Element = level1Element->siblingById(MatroskaIds::Cluster, diag), ++index) {
-                        // update offset of "Cluster"-element in "Cues"-element
-                        clusterReadOffset = level1Element->startOffset() - level0Element->dataOffset() + readOffset;
-                        if (segment.cuesElement && segment.cuesUpdater.updateOffsets(clusterReadOffset, currentPosition + segment.totalDataSize)
-                            && newCuesPos == ElementPosition::BeforeData) {
-                            cuesInvalidated = true;
-                        } else {
-                            if (index == 0 && segment.seekInfo.push(index, MatroskaIds::Cluster, currentPosition + segment.totalDataSize)) {
-                                goto calculateSegmentSize;
-                            } else {
-                                // add size of "Cluster"-element
-                                clusterSize = clusterReadSize = 0;
-                                for (level2Element = level1Element->firstChild(); level2Element; level2Element = level2Element->nextSibling()) {
-                                    level2Element->parse(diag);
-                                    if (segment.cuesElement
-                                        && segment.cuesUpdater.updateRelativeOffsets(clusterReadOffset, clusterReadSize, clusterSize)
-                                        && newCuesPos == ElementPosition::BeforeData) {
-                                        cuesInvalidated = true;
-                                    }
-                                    switch (level2Element->id()) {
-                                    case EbmlIds::Void:
-                                    case EbmlIds::Crc32:
-                                        break;
-                                    case MatroskaIds::Position:
-                                        clusterSize += 1 + 1 + EbmlElement::calculateUIntegerLength(currentPosition + segment.totalDataSize);
-                                        break;
-                                    default:
-                                        clusterSize += level2Element->totalSize();
-                                    }
-                                    clusterReadSize += level2Element->totalSize();
-                                }
-                                segment.clusterSizes.push_back(clusterSize);
-                                segment.totalDataSize += 4 + EbmlElement::calculateSizeDenotationLength(clusterSize) + clusterSize;
-                            }
+                    // pretend writing "Cluster"-elements
+                    if (segment.layout.clusterCount()) {
+                        // update offset in "SeekHead"-element
+                        if (segment.seekInfo.push(0, MatroskaIds::Cluster, currentPosition + segment.totalDataSize)) {
+                            goto calculateSegmentSize;
                         }
-                        // check whether aborted (because this loop might take some seconds to process)
-                        progress.stopIfAborted();
-                        // update the progress percentage (using offset / file size should be accurate enough)
-                        if ((index % 50 == 0) && fileInfo().size()) {
-                            progress.updateStepPercentage(static_cast<std::uint8_t>(level1Element->dataOffset() * 100 / fileInfo().size()));
+                        // place the clusters (their children are only parsed once) and update offsets in "Cues"-element
+                        segment.layout.parseClusterChildren(diag, progress);
+                        segment.layout.rewrite(currentPosition + segment.totalDataSize);
+                        if (segment.cuesUpdater.entryCount() && segment.cuesUpdater.updateOffsets(segment.layout, readOffset)
+                            && newCuesPos == ElementPosition::BeforeData) {
+                            // the size of the "Cues"-element has been invalidated -> reset element size to previously saved offset of "Cues"-element
+                            segment.totalDataSize = offset;
+                            goto addCuesElementSize;
                         }
-                        // TODO: reduce code duplication for aborting and progress updates
-                    }
-                    // check whether the total size of the "Cues"-element has been invalidated and recompute cluster if required
-                    if (cuesInvalidated) {
-                        // reset element size to previously saved offset of "Cues"-element
-                        segment.totalDataSize = offset;
-                        goto addCuesElementSize;
+                        segment.totalDataSize += segment.layout.totalSize();
                     }
 
                     // pretend writing "Cues"-element
                     progress.updateStep("Calculating offsets of elements after cluster ...");
-                    if (newCuesPos == ElementPosition::AfterData && segment.cuesElement) {
+                    if (newCuesPos == ElementPosition::AfterData && segment.cuesUpdater.entryCount()) {
                         // update offset of "Cues"-element in "SeekHead"-element
                         if (segment.seekInfo.push(0, MatroskaIds::Cues, currentPosition + segment.totalDataSize)) {
                             goto calculateSegmentSize;
@@ -1431,6 +1802,8 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                                 goto calculateSegmentSize;
                             } else {
                                 // add size of "Attachments"-element
+                                attachmentsOffset = segment.totalDataSize;
+                                attachmentsSegmentIndex = segmentIndex;
                                 segment.totalDataSize += attachmentsSize;
                             }
                         }
@@ -1468,6 +1841,26 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
             }
         }
 
+        // report the calculated layout; don't modify the file if only planning
+        if (m_changesPlan) {
+            m_changesPlan->rewriteRequired = rewriteRequired;
+            m_changesPlan->newPadding = newPadding;
+            m_changesPlan->tagPosition = newTagPos;
+            m_changesPlan->indexPosition = newCuesPos;
+            // -> the whole file is written when rewriting; otherwise everything except the "Cluster"-elements
+            m_changesPlan->bytesToWrite = currentOffset;
+            if (!rewriteRequired) {
+                for (const auto &segment : segmentData) {
+                    if (segment.firstClusterElement) {
+                        m_changesPlan->bytesToWrite -= segment.layout.originalEndOffset() - segment.layout.originalStartOffset();
+                    }
+                }
+            }
+            if (m_planningChanges) {
+                return;
+            }
+        }
+
     } catch (const OperationAbortedException &) {
         diag.emplace_back(DiagLevel::Information, "Applying new tag information has been aborted.", context);
         throw;
@@ -1489,12 +1882,16 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
     NativeFileStream backupStream; // create a stream to open the backup/original file for the case rewriting the file is required
     BinaryWriter outputWriter(&outputStream);
     char buff[8]; // buffer used to make size denotations
+    auto allocator = FileAllocator(); // manages the disk space of the new file when rewriting
+    auto copyEngine = unique_ptr<CopyEngine>(); // copies the blocks of the clusters in the background when rewriting (if enabled)
+    auto attachmentWritePlan = MatroskaAttachmentWritePlan(); // moves the data of the existing attachments when updating in-place
 
     if (rewriteRequired) {
         if (fileInfo().saveFilePath().empty()) {
             // move current file to temp dir and reopen it as backupStream, recreate original file
             try {
-                BackupHelper::createBackupFile(fileInfo().backupDirectory(), fileInfo().path(), backupPath, outputStream, backupStream);
+                const auto backupTimer = MediaFileStageTimer(fileInfo().statistics(), MediaFileStage::Backup);
+                BackupHelper::createBackupFile(fileInfo().backupDirectory(), fileInfo().path(), backupPath, outputStream, backupStream, &progress);
                 // recreate original file, define buffer variables
                 outputStream.open(BasicFileInfo::pathForOpen(fileInfo().path()), ios_base::out | ios_base::binary | ios_base::trunc);
             } catch (const std::ios_base::failure &failure) {
@@ -1515,15 +1912,40 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
             }
         }
 
+        // reserve the disk space for the new file; padding exceeding the configured threshold is left as hole
+        allocator = FileAllocator(fileInfo().saveFilePath().empty() ? fileInfo().path() : fileInfo().saveFilePath(), fileInfo().sparsePaddingThreshold());
+        if (fileInfo().isPreallocatingOutput() && m_changesPlan) {
+            allocator.preallocate(m_changesPlan->bytesToWrite);
+        }
+
+        // copy the blocks of the clusters asynchronously if enabled
+        if (fileInfo().isCopyingAsynchronously()) {
+            copyEngine = make_unique<CopyEngine>(backupPath.empty() ? fileInfo().path() : backupPath, allocator.path());
+        }
+
         // set backup stream as associated input stream since we need the original elements to write the new file
-        setStream(backupStream);
+        setStreamIncludingSegments(backupStream);
 
         // TODO: reduce code duplication
 
     } else { // !rewriteRequired
         // buffer currently assigned attachments
-        for (auto &maker : attachmentMaker) {
-            maker.bufferCurrentAttachments(diag);
+        // -> the data of attachments from the original file is not buffered but moved to its new offset before writing
+        if (attachmentsSize) {
+            const auto &segment = segmentData[attachmentsSegmentIndex];
+            auto attachedFileOffset = segment.startOffset + 4 + EbmlElement::calculateSizeDenotationLength(segment.totalDataSize) + attachmentsOffset
+                + 4 + EbmlElement::calculateSizeDenotationLength(attachedFileElementsSize);
+            for (auto &maker : attachmentMaker) {
+                const auto *const data = maker.attachment().data();
+                const auto moveData = data && data->size() && !maker.attachment().isDataFromFile() && !data->buffer() && &data->stream() == &stream();
+                maker.bufferCurrentAttachments(diag, !moveData);
+                if (moveData) {
+                    attachmentWritePlan.add(static_cast<std::uint64_t>(data->startOffset()), attachedFileOffset + maker.dataOffset(),
+                        static_cast<std::uint64_t>(data->size()));
+                    maker.setDataInPlace(true);
+                }
+                attachedFileOffset += maker.requiredSize();
+            }
         }
 
         // reopen original file to ensure it is opened for writing
@@ -1538,6 +1960,17 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
 
     // start actual writing
     try {
+        // move the data of the attachments from the original file (before anything else overwrites it)
+        if (attachmentWritePlan.moveCount()) {
+            progress.updateStep("Moving attachments ...");
+            attachmentWritePlan.execute(outputStream, diag, &progress);
+        }
+
+        // stage the many small writes of the makers to pass them to the file in big chunks
+        // -> skip data which is already present when updating in-place so the file is not touched if nothing changes
+        auto coalescingWriteScope = CoalescingWriteScope(outputStream);
+        coalescingWriteScope.setSkipUnchangedData(!rewriteRequired);
+
         // write EBML header
         progress.nextStepOrStop("Writing EBML header ...");
         outputWriter.writeUInt32BE(EbmlIds::Header);
@@ -1581,6 +2014,7 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                     // ... if the original element had a CRC-32 element
                     *buff = static_cast<char>(EbmlIds::Crc32);
                     *(buff + 1) = static_cast<char>(0x84); // length denotation: 4 byte
+                    LE::getBytes(segment.originalCrc32, buff + 2);
                     // set the value after writing the element
                     crc32Offsets.emplace_back(outputStream.tellp(), segment.totalDataSize);
                     outputStream.write(buff, 6);
@@ -1662,7 +2096,7 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                 }
 
                 // write "Cues"-element
-                if (newCuesPos == ElementPosition::BeforeData && segment.cuesElement) {
+                if (newCuesPos == ElementPosition::BeforeData && segment.cuesUpdater.entryCount()) {
                     segment.cuesUpdater.make(outputStream, diag);
                 }
 
@@ -1681,9 +2115,7 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                     outputWriter.writeByte(EbmlIds::Void);
                     outputStream.write(buff, sizeLength);
                     // write zeroes
-                    for (; voidLength; --voidLength) {
-                        outputStream.put(0);
-                    }
+                    allocator.writeZeroes(outputStream, voidLength);
                 }
 
                 // write media data / "Cluster"-elements
@@ -1693,14 +2125,13 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                     progress.nextStepOrStop("Writing cluster ...",
                         static_cast<std::uint8_t>((static_cast<std::uint64_t>(outputStream.tellp()) - offset) * 100 / segment.totalDataSize));
                     // write "Cluster"-element
-                    auto clusterSizesIterator = segment.clusterSizes.cbegin();
-                    unsigned int index = 0;
-                    for (; level1Element; level1Element = level1Element->siblingById(MatroskaIds::Cluster, diag), ++clusterSizesIterator, ++index) {
+                    for (std::size_t index = 0, clusterCount = segment.layout.clusterCount(); index != clusterCount; ++index) {
+                        level1Element = segment.layout.cluster(index);
                         // calculate position of cluster in segment
                         clusterSize = currentPosition + (static_cast<std::uint64_t>(outputStream.tellp()) - offset);
-                        // write header; checking whether clusterSizesIterator is valid shouldn't be necessary
+                        // write header
                         outputWriter.writeUInt32BE(MatroskaIds::Cluster);
-                        sizeLength = EbmlElement::makeSizeDenotation(*clusterSizesIterator, buff);
+                        sizeLength = EbmlElement::makeSizeDenotation(segment.layout.dataSize(index), buff);
                         outputStream.write(buff, sizeLength);
                         // write children
                         for (level2Element = level1Element->firstChild(); level2Element; level2Element = level2Element->nextSibling()) {
@@ -1712,7 +2143,11 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                                 EbmlElement::makeSimpleElement(outputStream, MatroskaIds::Position, clusterSize);
                                 break;
                             default:
-                                level2Element->copyEntirely(outputStream, diag, nullptr);
+                                if (copyEngine) {
+                                    level2Element->copyEntirely(*copyEngine, outputStream, diag);
+                                } else {
+                                    level2Element->copyEntirely(outputStream, diag, nullptr);
+                                }
                             }
                         }
                         // update percentage, check whether the operation has been aborted
@@ -1749,13 +2184,13 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
                         }
                     }
                     // skip existing "Cluster"-elements
-                    outputStream.seekp(static_cast<streamoff>(segment.clusterEndOffset));
+                    outputStream.seekp(static_cast<streamoff>(segment.layout.originalEndOffset()));
                 }
 
                 progress.updateStep("Writing segment tail ...");
 
                 // write "Cues"-element
-                if (newCuesPos == ElementPosition::AfterData && segment.cuesElement) {
+                if (newCuesPos == ElementPosition::AfterData && segment.cuesUpdater.entryCount()) {
                     segment.cuesUpdater.make(outputStream, diag);
                 }
 
@@ -1795,6 +2230,17 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
             }
         }
 
+        // wait for the blocks being copied asynchronously and write staged data (before the stream is reopened)
+        if (copyEngine) {
+            progress.updateStep("Copying blocks ...");
+            copyEngine->finish(&progress);
+            copyEngine.reset();
+        }
+        coalescingWriteScope.finish();
+        if (!rewriteRequired && !coalescingWriteScope.bytesWritten()) {
+            diag.emplace_back(DiagLevel::Information, "Nothing to be changed; the serialized tags are identical to the data in the file.", context);
+        }
+
         // reparse what is written so far
         progress.updateStep("Reparsing output file ...");
         if (rewriteRequired) {
@@ -1809,8 +2255,9 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
 
             // the outputStream needs to be reopened to be able to read again
             outputStream.close();
+            allocator.releaseUnusedSpace(fileInfo().size());
             outputStream.open(fileInfo().path(), ios_base::in | ios_base::out | ios_base::binary);
-            setStream(outputStream);
+            setStreamIncludingSegments(outputStream);
         } else {
             const auto newSize = static_cast<std::uint64_t>(outputStream.tellp());
             if (newSize < fileInfo().size()) {
@@ -1839,21 +2286,35 @@ void MatroskaContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFee
         }
 
         // update CRC-32 checksums
+        // note: This reads the whole written segment again because its data does not always go through outputStream; the copy
+        //       engine writes the cluster data directly when copying asynchronously.
         if (!crc32Offsets.empty()) {
             progress.updateStep("Updating CRC-32 checksums ...");
             for (const auto &crc32Offset : crc32Offsets) {
                 outputStream.seekg(static_cast<streamoff>(get<0>(crc32Offset) + 6));
-                outputStream.seekp(static_cast<streamoff>(get<0>(crc32Offset) + 2));
-                writer().writeUInt32LE(reader().readCrc32(get<1>(crc32Offset) - 6));
+                const auto checksum = EbmlCrc32::compute(outputStream, get<1>(crc32Offset) - 6);
+                // -> write the checksum only if it differs from the placeholder
+                outputStream.seekg(static_cast<streamoff>(get<0>(crc32Offset) + 2));
+                if (reader().readUInt32LE() != checksum) {
+                    outputStream.seekp(static_cast<streamoff>(get<0>(crc32Offset) + 2));
+                    writer().writeUInt32LE(checksum);
+                }
             }
         }
 
         // prevent deferring final write operations (to catch and handle possible errors here)
         outputStream.flush();
 
+        // report the layout of the new file; the header has been re-parsed from it so it remains valid
+        if (m_changesPlan) {
+            m_appliedChanges = *m_changesPlan;
+        }
+
         // handle errors (which might have been occurred after renaming/creating backup file)
     } catch (...) {
-        BackupHelper::handleFailureAfterFileModified(fileInfo(), backupPath, outputStream, backupStream, diag, context);
+        // stop copying before the backup is restored
+        copyEngine.reset();
+        BackupHelper::handleFailureAfterFileModified(fileInfo(), backupPath, outputStream, backupStream, diag, &progress, context);
     }
 }
 
@@ -20,6 +20,7 @@ class MatroskaSeekInfo;
 class MatroskaEditionEntry;
 
 class MediaFileInfo;
+struct MediaFileStatistics;
 
 class TAG_PARSER_EXPORT MatroskaContainer final : public GenericContainer<MediaFileInfo, MatroskaTag, MatroskaTrack, EbmlElement> {
 public:
@@ -27,9 +28,12 @@ public:
     ~MatroskaContainer() override;
 
     void validateIndex(Diagnostics &diag);
+    void validateChecksums(Diagnostics &diag);
+    void computeTrackStatistics(Diagnostics &diag, AbortableProgressFeedback *progress = nullptr, bool writeTags = false);
     std::uint64_t maxIdLength() const;
     std::uint64_t maxSizeLength() const;
     const std::vector<std::unique_ptr<MatroskaSeekInfo>> &seekInfos() const;
+    MediaFileStatistics *statistics() const;
 
     static std::uint64_t maxFullParseSize();
     void setMaxFullParseSize(std::uint64_t maxFullParseSize);
@@ -57,6 +61,12 @@ protected:
     void internalMakeFile(Diagnostics &diag, AbortableProgressFeedback &progress) override;
 
 private:
+    std::vector<EbmlElement *> *level1Elements(EbmlElement::IdentifierType id);
+    bool parseSegment(EbmlElement &segmentElement, std::uint64_t segmentOffset, std::size_t &seekInfosIndex, Diagnostics &diag);
+    void parseSegmentsConcurrently(const std::vector<std::pair<EbmlElement *, std::uint64_t>> &segments, Diagnostics &diag);
+    void parseSegmentUsingOwnStream(std::uint64_t segmentOffset, Diagnostics &diag);
+    void addElementsFromSeekInfos(std::uint64_t segmentOffset, std::size_t &seekInfosIndex, Diagnostics &diag);
+    void setStreamIncludingSegments(std::iostream &stream);
     void parseSegmentInfo(Diagnostics &diag);
     void readTrackStatisticsFromTags(Diagnostics &diag);
 
@@ -71,6 +81,8 @@ private:
     std::vector<std::unique_ptr<MatroskaSeekInfo>> m_seekInfos;
     std::vector<std::unique_ptr<MatroskaEditionEntry>> m_editionEntries;
     std::vector<std::unique_ptr<MatroskaAttachment>> m_attachments;
+    std::vector<std::unique_ptr<MatroskaContainer>> m_segmentContainers;
+    std::unique_ptr<MediaFileStatistics> m_segmentStatistics;
     std::size_t m_segmentCount;
     static std::uint64_t m_maxFullParseSize;
 };
@@ -1,7 +1,17 @@
 #include "./matroskacues.h"
+#include "./ebmlheaderdecoder.h"
 #include "./matroskacontainer.h"
+#include "./matroskaid.h"
+#include "./matroskalayoutplanner.h"
 
-#include <c++utilities/conversion/binaryconversion.h>
+#include "../exceptions.h"
+
+#include <c++utilities/conversion/stringbuilder.h>
+#include <c++utilities/conversion/stringconversion.h>
+
+#include <algorithm>
+#include <memory>
+#include <optional>
 
 using namespace std;
 using namespace CppUtilities;
@@ -29,20 +39,89 @@ namespace TagParser {
  * \brief The MatroskaCuePositionUpdater class helps to rewrite the "Cues"-element with shifted positions.
  *
  * This class is used when rewriting a Matroska file to save changed tag information.
+ *
+ * The "Cues"-element is read at once and decoded into a flat table rather than being parsed as tree of EbmlElement
+ * objects. The table holds one entry per element in the order the elements are written (each parent precedes its
+ * children) in contiguous arrays:
+ * - the ID,
+ * - the index of the parent entry,
+ * - the value of simple elements (e.g. "CueTime", "CueTrack", "CueClusterPosition", "CueRelativePosition" and
+ *   "CueBlockNumber") or the data size of master elements (e.g. "CuePoint") and
+ * - the initial value of simple elements (as read from the file).
+ *
+ * The entries holding absolute offsets are indexed by their initial value and the entries holding relative offsets by
+ * their reference offset and initial value. So updating offsets only visits the affected entries. Size changes are
+ * propagated to the parent entries. The make() method encodes the table again.
+ *
+ * Instead of parsing an existing "Cues"-element, the table can also be generated from the "Cluster"-elements of a
+ * segment via generate().
+ *
+ * \remarks Unsigned integers are written using the minimum number of bytes.
  */
 
+/// \cond
+namespace {
+
+bool isMasterElement(std::uint32_t id)
+{
+    switch (id) {
+    case MatroskaIds::Cues:
+    case MatroskaIds::CuePoint:
+    case MatroskaIds::CueTrackPositions:
+    case MatroskaIds::CueReference:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// \brief Compares the indices of entries holding absolute offsets by their initial value.
+struct OffsetComparator {
+    bool operator()(std::uint32_t index, std::uint64_t offset) const
+    {
+        return initialValues[index] < offset;
+    }
+    bool operator()(std::uint64_t offset, std::uint32_t index) const
+    {
+        return offset < initialValues[index];
+    }
+    const std::vector<std::uint64_t> &initialValues;
+};
+
+/// \brief Compares the indices of entries holding relative offsets by their reference offset and initial value.
+struct RelativeOffsetComparator {
+    bool operator()(const std::pair<std::uint64_t, std::uint32_t> &entry, const std::pair<std::uint64_t, std::uint64_t> &offset) const
+    {
+        return make_pair(entry.first, initialValues[entry.second]) < offset;
+    }
+    bool operator()(const std::pair<std::uint64_t, std::uint64_t> &offset, const std::pair<std::uint64_t, std::uint32_t> &entry) const
+    {
+        return offset < make_pair(entry.first, initialValues[entry.second]);
+    }
+    const std::vector<std::uint64_t> &initialValues;
+};
+
+/// \brief Reads the header of the specified "SimpleBlock"- or "Block"-\a element; the frame data is not read.
+bool readBlockHeader(EbmlElement *element, MatroskaBlockHeader &header)
+{
+    // read the track number (up to 8 byte), the timestamp (2 byte) and the flags (1 byte)
+    char buffer[8 + 2 + 1];
+    const auto size = static_cast<std::size_t>(min<std::uint64_t>(element->dataSize(), sizeof(buffer)));
+    element->stream().seekg(static_cast<streamoff>(element->dataOffset()));
+    element->stream().read(buffer, static_cast<streamsize>(size));
+    return EbmlHeaderDecoder::decodeBlockHeader(buffer, size, header);
+}
+
+} // namespace
+/// \endcond
+
 /*!
  * \brief Returns how many bytes will be written when calling the make() method.
  * \remarks The returned size might change when the object is altered (eg. by calling the updatePositions() method).
  */
 std::uint64_t MatroskaCuePositionUpdater::totalSize() const
 {
-    if (m_cuesElement) {
-        std::uint64_t size = m_sizes.at(m_cuesElement);
-        return 4 + EbmlElement::calculateSizeDenotationLength(size) + size;
-    } else {
-        return 0;
-    }
+    return m_ids.empty() ? 0 : encodedSize(0);
 }
 
 /*!
@@ -53,116 +132,313 @@ void MatroskaCuePositionUpdater::parse(EbmlElement *cuesElement, Diagnostics &di
 {
     static const string context("parsing \"Cues\"-element");
     clear();
-    std::uint64_t cuesElementSize = 0, cuePointElementSize, cueTrackPositionsElementSize, cueReferenceElementSize, pos, relPos, statePos;
-    EbmlElement *cueRelativePositionElement, *cueClusterPositionElement;
-    for (EbmlElement *cuePointElement = cuesElement->firstChild(); cuePointElement; cuePointElement = cuePointElement->nextSibling()) {
-        // parse children of "Cues"-element which must be "CuePoint"-elements
-        cuePointElement->parse(diag);
-        switch (cuePointElement->id()) {
+
+    // read the entire element at once
+    cuesElement->parse(diag);
+    const auto &container = cuesElement->container();
+    m_maxIdLength = static_cast<std::uint8_t>(min<std::uint64_t>(container.maxIdLength(), 4));
+    m_maxSizeLength = static_cast<std::uint8_t>(min<std::uint64_t>(container.maxSizeLength(), 8));
+    const auto dataSize = static_cast<std::size_t>(cuesElement->dataSize());
+    const auto data = make_unique<char[]>(dataSize);
+    cuesElement->stream().seekg(static_cast<streamoff>(cuesElement->dataOffset()));
+    cuesElement->stream().read(data.get(), static_cast<streamsize>(dataSize));
+
+    // decode it into the table; reserve space assuming each "CuePoint" takes about 16 bytes and has about 5 descendants
+    const auto estimatedEntryCount = dataSize / 16 * 6 + 1;
+    m_ids.reserve(estimatedEntryCount);
+    m_parents.reserve(estimatedEntryCount);
+    m_values.reserve(estimatedEntryCount);
+    m_initialValues.reserve(estimatedEntryCount);
+    decodeMaster(MatroskaIds::Cues, noParent, data.get(), dataSize, diag);
+    m_cuesElement = cuesElement;
+
+    indexOffsets();
+}
+
+/*!
+ * \brief Generates the cues for the specified \a segmentElement by scanning its "Cluster"-elements.
+ *
+ * A cue point is added for the first keyframe of each of the tracks with the specified \a trackNumbers within each
+ * "Cluster"-element (for all tracks if \a trackNumbers is empty). Only the headers of the "SimpleBlock"- and "Block"-elements
+ * are read; the frame data is not read.
+ *
+ * \remarks
+ * - Previous parsing results and updates will be cleared.
+ * - The cluster positions are relative to the data of \a segmentElement (like the positions read via parse()).
+ * - cuesElement() returns nullptr afterwards. If no keyframes could be found, entryCount() returns zero.
+ */
+void MatroskaCuePositionUpdater::generate(EbmlElement *segmentElement, const std::vector<std::uint64_t> &trackNumbers, Diagnostics &diag)
+{
+    static const string context("generating \"Cues\"-element");
+    clear();
+
+    // scan the "Cluster"-elements for keyframes
+    struct CuePointInfo {
+        std::uint64_t time;
+        std::uint64_t trackNumber;
+        std::uint64_t clusterPosition;
+        std::uint64_t relativePosition;
+    };
+    auto cuePoints = vector<CuePointInfo>();
+    auto indexedTracks = vector<std::uint64_t>();
+    const auto isSkipped = [&trackNumbers, &indexedTracks](std::uint64_t trackNumber) {
+        return (!trackNumbers.empty() && find(trackNumbers.cbegin(), trackNumbers.cend(), trackNumber) == trackNumbers.cend())
+            || find(indexedTracks.cbegin(), indexedTracks.cend(), trackNumber) != indexedTracks.cend();
+    };
+    for (auto *cluster = segmentElement->childById(MatroskaIds::Cluster, diag); cluster; cluster = cluster->siblingById(MatroskaIds::Cluster, diag)) {
+        const auto clusterPosition = cluster->startOffset() - segmentElement->dataOffset();
+        auto clusterTime = std::uint64_t();
+        indexedTracks.clear();
+        for (auto *clusterChild = cluster->firstChild(); clusterChild; clusterChild = clusterChild->nextSibling()) {
+            clusterChild->parse(diag);
+            auto block = MatroskaBlockHeader();
+            switch (clusterChild->id()) {
+            case MatroskaIds::Timecode:
+                clusterTime = clusterChild->readUInteger();
+                continue;
+            case MatroskaIds::SimpleBlock:
+                if (!readBlockHeader(clusterChild, block) || !(block.flags & 0x80)) {
+                    continue;
+                }
+                break;
+            case MatroskaIds::BlockGroup: {
+                // a "Block"-element is a keyframe if it does not reference other frames
+                auto referencesOtherFrames = false, hasBlock = false;
+                for (auto *blockGroupChild = clusterChild->firstChild(); blockGroupChild; blockGroupChild = blockGroupChild->nextSibling()) {
+                    blockGroupChild->parse(diag);
+                    switch (blockGroupChild->id()) {
+                    case MatroskaIds::Block:
+                        hasBlock = readBlockHeader(blockGroupChild, block);
+                        break;
+                    case MatroskaIds::ReferenceBlock:
+                        referencesOtherFrames = true;
+                        break;
+                    default:;
+                    }
+                }
+                if (!hasBlock || referencesOtherFrames) {
+                    continue;
+                }
+                break;
+            }
+            default:
+                continue;
+            }
+            if (isSkipped(block.trackNumber)) {
+                continue;
+            }
+            // the time of the block is relative to the time of the cluster which precedes the blocks
+            const auto time = block.timestamp < 0 && static_cast<std::uint64_t>(-block.timestamp) > clusterTime
+                ? 0
+                : static_cast<std::uint64_t>(static_cast<std::int64_t>(clusterTime) + block.timestamp);
+            cuePoints.emplace_back(CuePointInfo{ time, block.trackNumber, clusterPosition, clusterChild->startOffset() - cluster->dataOffset() });
+            indexedTracks.emplace_back(block.trackNumber);
+        }
+    }
+    if (cuePoints.empty()) {
+        diag.emplace_back(DiagLevel::Warning, "No keyframes found; no cues will be written.", context);
+        return;
+    }
+
+    // make the table; cue points with the same time are combined
+    stable_sort(cuePoints.begin(), cuePoints.end(), [](const CuePointInfo &lhs, const CuePointInfo &rhs) { return lhs.time < rhs.time; });
+    const auto cuesIndex = addEntry(MatroskaIds::Cues, noParent, 0);
+    auto cuePointIndex = noParent;
+    for (const auto &cuePoint : cuePoints) {
+        if (cuePointIndex == noParent || m_values[cuePointIndex + 1] != cuePoint.time) {
+            cuePointIndex = addEntry(MatroskaIds::CuePoint, cuesIndex, 0);
+            addEntry(MatroskaIds::CueTime, cuePointIndex, cuePoint.time);
+        }
+        const auto trackPositionsIndex = addEntry(MatroskaIds::CueTrackPositions, cuePointIndex, 0);
+        addEntry(MatroskaIds::CueTrack, trackPositionsIndex, cuePoint.trackNumber);
+        m_offsetIndices.emplace_back(addEntry(MatroskaIds::CueClusterPosition, trackPositionsIndex, cuePoint.clusterPosition));
+        m_relativeOffsetIndices.emplace_back(
+            cuePoint.clusterPosition, addEntry(MatroskaIds::CueRelativePosition, trackPositionsIndex, cuePoint.relativePosition));
+    }
+
+    // compute the sizes of the master elements; the children of an entry follow it so they are complete when iterating backwards
+    for (auto index = static_cast<std::uint32_t>(m_ids.size() - 1); index != cuesIndex; --index) {
+        if (isMasterElement(m_ids[index])) {
+            m_initialValues[index] = m_values[index];
+        }
+        m_values[m_parents[index]] += encodedSize(index);
+    }
+    m_initialValues[cuesIndex] = m_values[cuesIndex];
+    indexOffsets();
+}
+
+/*!
+ * \brief Appends an entry for an element with the specified \a id, \a parent and \a value to the table.
+ * \returns Returns the index of the new entry.
+ */
+std::uint32_t MatroskaCuePositionUpdater::addEntry(std::uint32_t id, std::uint32_t parent, std::uint64_t value)
+{
+    const auto index = static_cast<std::uint32_t>(m_ids.size());
+    m_ids.emplace_back(id);
+    m_parents.emplace_back(parent);
+    m_values.emplace_back(value);
+    m_initialValues.emplace_back(value);
+    return index;
+}
+
+/*!
+ * \brief Sorts the indices of the entries holding offsets so updateOffsets() and updateRelativeOffsets() can use a binary search.
+ */
+void MatroskaCuePositionUpdater::indexOffsets()
+{
+    stable_sort(m_offsetIndices.begin(), m_offsetIndices.end(),
+        [this](std::uint32_t lhs, std::uint32_t rhs) { return m_initialValues[lhs] < m_initialValues[rhs]; });
+    stable_sort(m_relativeOffsetIndices.begin(), m_relativeOffsetIndices.end(), [this](const auto &lhs, const auto &rhs) {
+        return make_pair(lhs.first, m_initialValues[lhs.second]) < make_pair(rhs.first, m_initialValues[rhs.second]);
+    });
+}
+
+/*!
+ * \brief Adds an entry for the master element with the specified \a id and \a parent and decodes its children from the \a size bytes at \a data.
+ * \returns Returns the index of the new entry.
+ */
+std::uint32_t MatroskaCuePositionUpdater::decodeMaster(
+    std::uint32_t id, std::uint32_t parent, const char *data, std::size_t size, Diagnostics &diag)
+{
+    static const string context("parsing \"Cues\"-element");
+    const auto index = addEntry(id, parent, 0);
+
+    // determine the cluster position the relative position refers to
+    auto clusterPosition = std::optional<std::uint64_t>();
+    if (id == MatroskaIds::CueTrackPositions) {
+        auto decoder = EbmlHeaderDecoder(data, size, m_maxIdLength, m_maxSizeLength);
+        auto header = EbmlHeader();
+        for (auto elementOffset = decoder.offset(); !clusterPosition.has_value() && decoder.next(header); elementOffset = decoder.offset()) {
+            if (header.id == MatroskaIds::CueClusterPosition) {
+                const auto dataOffset = elementOffset + header.headerSize();
+                clusterPosition = EbmlHeaderDecoder::decodeUInteger(data + dataOffset, decoder.offset() - dataOffset);
+            }
+        }
+        if (!clusterPosition.has_value()) {
+            diag.emplace_back(
+                DiagLevel::Critical, "\"CueTrackPositions\"-element does not contain mandatory \"CueClusterPosition\"-element.", context);
+        }
+    }
+
+    // decode children
+    auto dataSize = std::uint64_t();
+    auto decoder = EbmlHeaderDecoder(data, size, m_maxIdLength, m_maxSizeLength);
+    auto header = EbmlHeader();
+    for (auto elementOffset = decoder.offset(); decoder.next(header); elementOffset = decoder.offset()) {
+        const auto dataOffset = elementOffset + header.headerSize();
+        const auto *const childData = data + dataOffset;
+        const auto childSize = decoder.offset() - dataOffset;
+        if (header.sizeUnknown || childSize < header.dataSize) {
+            diag.emplace_back(DiagLevel::Warning,
+                argsToString("Element 0x", numberToString(header.id, 16), " is truncated or has an unknown size; only the available data is used."),
+                context);
+        }
+        auto childIndex = noParent;
+        switch (header.id) {
         case EbmlIds::Void:
         case EbmlIds::Crc32:
-            break;
+            continue;
         case MatroskaIds::CuePoint:
-            cuePointElementSize = 0;
-            for (EbmlElement *cuePointChild = cuePointElement->firstChild(); cuePointChild; cuePointChild = cuePointChild->nextSibling()) {
-                // parse children of "CuePoint"-element
-                cuePointChild->parse(diag);
-                switch (cuePointChild->id()) {
-                case EbmlIds::Void:
-                case EbmlIds::Crc32:
-                    break;
-                case MatroskaIds::CueTime:
-                    cuePointChild->makeBuffer();
-                    cuePointElementSize += cuePointChild->totalSize();
-                    break;
-                case MatroskaIds::CueTrackPositions:
-                    cueTrackPositionsElementSize = 0;
-                    cueRelativePositionElement = cueClusterPositionElement = nullptr;
-                    for (EbmlElement *cueTrackPositionsChild = cuePointChild->firstChild(); cueTrackPositionsChild;
-                         cueTrackPositionsChild = cueTrackPositionsChild->nextSibling()) {
-                        // parse children of "CueTrackPositions"-element
-                        cueTrackPositionsChild->parse(diag);
-                        switch (cueTrackPositionsChild->id()) {
-                        case MatroskaIds::CueTrack:
-                        case MatroskaIds::CueDuration:
-                        case MatroskaIds::CueBlockNumber:
-                            cueTrackPositionsChild->makeBuffer();
-                            cueTrackPositionsElementSize += cueTrackPositionsChild->totalSize();
-                            break;
-                        case MatroskaIds::CueRelativePosition:
-                            relPos = (cueRelativePositionElement = cueTrackPositionsChild)->readUInteger();
-                            break;
-                        case MatroskaIds::CueClusterPosition:
-                            pos = (cueClusterPositionElement = cueTrackPositionsChild)->readUInteger();
-                            cueTrackPositionsElementSize += 2 + EbmlElement::calculateUIntegerLength(pos);
-                            m_offsets.emplace(cueTrackPositionsChild, pos);
-                            break;
-                        case MatroskaIds::CueCodecState:
-                            statePos = cueTrackPositionsChild->readUInteger();
-                            cueTrackPositionsElementSize += 2 + EbmlElement::calculateUIntegerLength(statePos);
-                            m_offsets.emplace(cueTrackPositionsChild, statePos);
-                            break;
-                        case MatroskaIds::CueReference:
-                            cueReferenceElementSize = 0;
-                            for (EbmlElement *cueReferenceChild = cueTrackPositionsChild->firstChild(); cueReferenceChild;
-                                 cueReferenceChild = cueReferenceChild->nextSibling()) {
-                                // parse children of "CueReference"-element
-                                cueReferenceChild->parse(diag);
-                                switch (cueReferenceChild->id()) {
-                                case EbmlIds::Void:
-                                case EbmlIds::Crc32:
-                                    break;
-                                case MatroskaIds::CueRefTime:
-                                case MatroskaIds::CueRefNumber:
-                                    cueReferenceChild->makeBuffer();
-                                    cueReferenceElementSize += cueReferenceChild->totalSize();
-                                    break;
-                                case MatroskaIds::CueRefCluster:
-                                case MatroskaIds::CueRefCodecState:
-                                    statePos = cueReferenceChild->readUInteger();
-                                    cueReferenceElementSize += 2 + EbmlElement::calculateUIntegerLength(statePos);
-                                    m_offsets.emplace(cueReferenceChild, statePos);
-                                    break;
-                                default:
-                                    diag.emplace_back(DiagLevel::Warning,
-                                        "\"CueReference\"-element contains a element which is not known to the parser. It will be ignored.", context);
-                                }
-                            }
-                            cueTrackPositionsElementSize
-                                += 1 + EbmlElement::calculateSizeDenotationLength(cueReferenceElementSize) + cueReferenceElementSize;
-                            m_sizes.emplace(cueTrackPositionsChild, cueReferenceElementSize);
-                            break;
-                        default:
-                            diag.emplace_back(DiagLevel::Warning,
-                                "\"CueTrackPositions\"-element contains a element which is not known to the parser. It will be ignored.", context);
-                        }
-                    }
-                    if (!cueClusterPositionElement) {
-                        diag.emplace_back(
-                            DiagLevel::Critical, "\"CueTrackPositions\"-element does not contain mandatory \"CueClusterPosition\"-element.", context);
-                    } else if (cueRelativePositionElement) {
-                        cueTrackPositionsElementSize += 2 + EbmlElement::calculateUIntegerLength(relPos);
-                        m_relativeOffsets.emplace(piecewise_construct, forward_as_tuple(cueRelativePositionElement), forward_as_tuple(pos, relPos));
-                    }
-                    cuePointElementSize
-                        += 1 + EbmlElement::calculateSizeDenotationLength(cueTrackPositionsElementSize) + cueTrackPositionsElementSize;
-                    m_sizes.emplace(cuePointChild, cueTrackPositionsElementSize);
-                    break;
-                default:
-                    diag.emplace_back(DiagLevel::Warning,
-                        "\"CuePoint\"-element contains a element which is not a \"CueTime\"- or a \"CueTrackPositions\"-element. It will be ignored.",
-                        context);
+            if (id == MatroskaIds::Cues) {
+                childIndex = decodeMaster(header.id, index, childData, childSize, diag);
+            }
+            break;
+        case MatroskaIds::CueTime:
+            if (id == MatroskaIds::CuePoint) {
+                childIndex = addEntry(header.id, index, EbmlHeaderDecoder::decodeUInteger(childData, childSize));
+            }
+            break;
+        case MatroskaIds::CueTrackPositions:
+            if (id == MatroskaIds::CuePoint) {
+                childIndex = decodeMaster(header.id, index, childData, childSize, diag);
+            }
+            break;
+        case MatroskaIds::CueTrack:
+        case MatroskaIds::CueDuration:
+        case MatroskaIds::CueBlockNumber:
+            if (id == MatroskaIds::CueTrackPositions) {
+                childIndex = addEntry(header.id, index, EbmlHeaderDecoder::decodeUInteger(childData, childSize));
+            }
+            break;
+        case MatroskaIds::CueClusterPosition:
+        case MatroskaIds::CueCodecState:
+            if (id == MatroskaIds::CueTrackPositions) {
+                m_offsetIndices.emplace_back(childIndex = addEntry(header.id, index, EbmlHeaderDecoder::decodeUInteger(childData, childSize)));
+            }
+            break;
+        case MatroskaIds::CueRelativePosition:
+            if (id == MatroskaIds::CueTrackPositions) {
+                if (!clusterPosition.has_value()) {
+                    // the relative position can not be updated without the cluster position so it is omitted
+                    continue;
                 }
+                childIndex = addEntry(header.id, index, EbmlHeaderDecoder::decodeUInteger(childData, childSize));
+                m_relativeOffsetIndices.emplace_back(clusterPosition.value(), childIndex);
             }
-            cuesElementSize += 1 + EbmlElement::calculateSizeDenotationLength(cuePointElementSize) + cuePointElementSize;
-            m_sizes.emplace(cuePointElement, cuePointElementSize);
             break;
-        default:
+        case MatroskaIds::CueReference:
+            if (id == MatroskaIds::CueTrackPositions) {
+                childIndex = decodeMaster(header.id, index, childData, childSize, diag);
+            }
+            break;
+        case MatroskaIds::CueRefTime:
+        case MatroskaIds::CueRefNumber:
+            if (id == MatroskaIds::CueReference) {
+                childIndex = addEntry(header.id, index, EbmlHeaderDecoder::decodeUInteger(childData, childSize));
+            }
+            break;
+        case MatroskaIds::CueRefCluster:
+        case MatroskaIds::CueRefCodecState:
+            if (id == MatroskaIds::CueReference) {
+                m_offsetIndices.emplace_back(childIndex = addEntry(header.id, index, EbmlHeaderDecoder::decodeUInteger(childData, childSize)));
+            }
+            break;
+        default:;
+        }
+        if (childIndex != noParent) {
+            dataSize += encodedSize(childIndex);
+            continue;
+        }
+        switch (id) {
+        case MatroskaIds::Cues:
             diag.emplace_back(
                 DiagLevel::Warning, "\"Cues\"-element contains a element which is not a \"CuePoint\"-element. It will be ignored.", context);
+            break;
+        case MatroskaIds::CuePoint:
+            diag.emplace_back(DiagLevel::Warning,
+                "\"CuePoint\"-element contains a element which is not a \"CueTime\"- or a \"CueTrackPositions\"-element. It will be ignored.",
+                context);
+            break;
+        case MatroskaIds::CueTrackPositions:
+            diag.emplace_back(DiagLevel::Warning,
+                "\"CueTrackPositions\"-element contains a element which is not known to the parser. It will be ignored.", context);
+            break;
+        default:
+            diag.emplace_back(
+                DiagLevel::Warning, "\"CueReference\"-element contains a element which is not known to the parser. It will be ignored.", context);
         }
     }
-    m_sizes.emplace(m_cuesElement = cuesElement, cuesElementSize);
+    if (decoder.status() != EbmlHeaderStatus::Ok) {
+        diag.emplace_back(DiagLevel::Critical,
+            argsToString("Unable to decode the header of a child of a \"", matroskaIdName(id), "\"-element; the \"Cues\"-element is invalid."),
+            context);
+        throw InvalidDataException();
+    }
+    m_values[index] = m_initialValues[index] = dataSize;
+    return index;
+}
+
+/*!
+ * \brief Returns the size of the element denoted by the entry with the specified \a index (including its header).
+ */
+std::uint64_t MatroskaCuePositionUpdater::encodedSize(std::uint32_t index) const
+{
+    const auto id = m_ids[index];
+    const auto value = m_values[index];
+    if (isMasterElement(id)) {
+        return EbmlElement::calculateIdLength(id) + EbmlElement::calculateSizeDenotationLength(value) + value;
+    }
+    return EbmlElement::calculateIdLength(id) + 1 + EbmlElement::calculateUIntegerLength(value);
 }
 
 /*!
@@ -171,15 +447,10 @@ void MatroskaCuePositionUpdater::parse(EbmlElement *cuesElement, Diagnostics &di
  */
 bool MatroskaCuePositionUpdater::updateOffsets(std::uint64_t originalOffset, std::uint64_t newOffset)
 {
-    bool updated = false;
-    for (auto &offset : m_offsets) {
-        if (offset.second.initialValue() == originalOffset && offset.second.currentValue() != newOffset) {
-            updated = updateSize(offset.first->parent(),
-                          static_cast<int>(EbmlElement::calculateUIntegerLength(newOffset))
-                              - static_cast<int>(EbmlElement::calculateUIntegerLength(offset.second.currentValue())))
-                || updated;
-            offset.second.update(newOffset);
-        }
+    auto updated = false;
+    const auto range = equal_range(m_offsetIndices.cbegin(), m_offsetIndices.cend(), originalOffset, OffsetComparator{ m_initialValues });
+    for (auto i = range.first; i != range.second; ++i) {
+        updated = updateValue(*i, newOffset) || updated;
     }
     return updated;
 }
@@ -191,51 +462,79 @@ bool MatroskaCuePositionUpdater::updateOffsets(std::uint64_t originalOffset, std
 bool MatroskaCuePositionUpdater::updateRelativeOffsets(
     std::uint64_t referenceOffset, std::uint64_t originalRelativeOffset, std::uint64_t newRelativeOffset)
 {
-    bool updated = false;
-    for (auto &offset : m_relativeOffsets) {
-        if (offset.second.referenceOffset() == referenceOffset && offset.second.initialValue() == originalRelativeOffset
-            && offset.second.currentValue() != newRelativeOffset) {
-            updated = updateSize(offset.first->parent(),
-                          static_cast<int>(EbmlElement::calculateUIntegerLength(newRelativeOffset))
-                              - static_cast<int>(EbmlElement::calculateUIntegerLength(offset.second.currentValue())))
-                || updated;
-            offset.second.update(newRelativeOffset);
+    auto updated = false;
+    const auto range = equal_range(m_relativeOffsetIndices.cbegin(), m_relativeOffsetIndices.cend(),
+        make_pair(referenceOffset, originalRelativeOffset), RelativeOffsetComparator{ m_initialValues });
+    for (auto i = range.first; i != range.second; ++i) {
+        updated = updateValue(i->second, newRelativeOffset) || updated;
+    }
+    return updated;
+}
+
+/*!
+ * \brief Sets the offsets of all entries pointing to a "Cluster"-element (or one of its children) to the offsets planned by \a layout.
+ * \param layout Specifies the layout of the "Cluster"-elements of the segment.
+ * \param readOffset Specifies the total size of the preceding segments in the original file (which the initial values are relative to).
+ * \returns Returns whether the size of the "Cues"-element has been altered.
+ * \remarks The clusters of \a layout and the indexed entries are both ordered by their original offset so they are merged in a single pass.
+ */
+bool MatroskaCuePositionUpdater::updateOffsets(const MatroskaLayoutPlanner &layout, std::uint64_t readOffset)
+{
+    auto updated = false;
+    auto offsetIndex = m_offsetIndices.cbegin();
+    const auto offsetIndicesEnd = m_offsetIndices.cend();
+    auto relativeOffsetIndex = m_relativeOffsetIndices.cbegin();
+    const auto relativeOffsetIndicesEnd = m_relativeOffsetIndices.cend();
+    for (std::size_t cluster = 0, clusterCount = layout.clusterCount(); cluster != clusterCount; ++cluster) {
+        const auto originalOffset = readOffset + layout.readOffset(cluster);
+        // update entries pointing to the cluster; skip entries not pointing to any cluster
+        for (; offsetIndex != offsetIndicesEnd && m_initialValues[*offsetIndex] < originalOffset; ++offsetIndex)
+            ;
+        for (; offsetIndex != offsetIndicesEnd && m_initialValues[*offsetIndex] == originalOffset; ++offsetIndex) {
+            updated = updateValue(*offsetIndex, layout.offset(cluster)) || updated;
+        }
+        // update entries pointing to a child of the cluster
+        for (; relativeOffsetIndex != relativeOffsetIndicesEnd && relativeOffsetIndex->first < originalOffset; ++relativeOffsetIndex)
+            ;
+        for (; relativeOffsetIndex != relativeOffsetIndicesEnd && relativeOffsetIndex->first == originalOffset; ++relativeOffsetIndex) {
+            const auto index = relativeOffsetIndex->second;
+            updated = updateValue(index, layout.relativeOffset(cluster, m_initialValues[index])) || updated;
         }
     }
     return updated;
 }
 
 /*!
- * \brief Updates the sizes for the specified \a element by adding the specified \a shift value.
+ * \brief Sets the value of the simple element denoted by the entry with the specified \a index to \a newValue.
  * \returns Returns whether the size of the "Cues"-element has been altered.
  */
-bool MatroskaCuePositionUpdater::updateSize(EbmlElement *element, int shift)
+bool MatroskaCuePositionUpdater::updateValue(std::uint32_t index, std::uint64_t newValue)
 {
-    if (!shift) {
-        // shift is gone
+    auto &value = m_values[index];
+    if (value == newValue) {
         return false;
     }
-    if (!element) {
-        // there was no parent (shouldn't happen in a normal file structure since the Segment element should
-        // be parent of the Cues element)
-        return shift;
-    }
-    try {
-        // get size info
-        std::uint64_t &size = m_sizes.at(element);
-        // calculate new size
-        const std::uint64_t newSize = shift > 0 ? size + static_cast<std::uint64_t>(shift) : size - static_cast<std::uint64_t>(-shift);
-        // shift parent
-        const bool updated = updateSize(element->parent(),
-            shift + static_cast<int>(EbmlElement::calculateSizeDenotationLength(newSize))
-                - static_cast<int>(EbmlElement::calculateSizeDenotationLength(size)));
-        // apply new size
+    const auto shift
+        = static_cast<int>(EbmlElement::calculateUIntegerLength(newValue)) - static_cast<int>(EbmlElement::calculateUIntegerLength(value));
+    value = newValue;
+    return updateSize(m_parents[index], shift);
+}
+
+/*!
+ * \brief Updates the sizes of the master element with the specified \a index and its parents by adding the specified \a shift value.
+ * \returns Returns whether the size of the "Cues"-element has been altered.
+ */
+bool MatroskaCuePositionUpdater::updateSize(std::uint32_t index, int shift)
+{
+    for (; shift && index != noParent; index = m_parents[index]) {
+        auto &size = m_values[index];
+        const auto newSize = shift > 0 ? size + static_cast<std::uint64_t>(shift) : size - static_cast<std::uint64_t>(-shift);
+        // the size denotation of the element itself might change as well which shifts its parent even more
+        shift += static_cast<int>(EbmlElement::calculateSizeDenotationLength(newSize))
+            - static_cast<int>(EbmlElement::calculateSizeDenotationLength(size));
         size = newSize;
-        return updated;
-    } catch (const out_of_range &) {
-        // the element is out of the scope of the cue position updater (likely the Segment element)
-        return shift;
     }
+    return shift;
 }
 
 /*!
@@ -244,131 +543,22 @@ bool MatroskaCuePositionUpdater::updateSize(EbmlElement *element, int shift)
 void MatroskaCuePositionUpdater::make(ostream &stream, Diagnostics &diag)
 {
     static const string context("making \"Cues\"-element");
-    if (!m_cuesElement) {
+    if (m_ids.empty()) {
         diag.emplace_back(DiagLevel::Warning, "No cues written; the cues of the source file could not be parsed correctly.", context);
         return;
     }
-    // temporary variables
+    // write the entries in order; the header of a master element is followed by its children
     char buff[8];
-    std::uint8_t len;
-    // write "Cues"-element
-    try {
-        BE::getBytes(static_cast<std::uint32_t>(MatroskaIds::Cues), buff);
-        stream.write(buff, 4);
-        len = EbmlElement::makeSizeDenotation(m_sizes[m_cuesElement], buff);
-        stream.write(buff, len);
-        // loop through original elements and write (a updated version) of them
-        for (EbmlElement *cuePointElement = m_cuesElement->firstChild(); cuePointElement; cuePointElement = cuePointElement->nextSibling()) {
-            cuePointElement->parse(diag);
-            switch (cuePointElement->id()) {
-            case EbmlIds::Void:
-            case EbmlIds::Crc32:
-                break;
-            case MatroskaIds::CuePoint:
-                // write "CuePoint"-element
-                stream.put(static_cast<char>(MatroskaIds::CuePoint));
-                len = EbmlElement::makeSizeDenotation(m_sizes[cuePointElement], buff);
-                stream.write(buff, len);
-                for (EbmlElement *cuePointChild = cuePointElement->firstChild(); cuePointChild; cuePointChild = cuePointChild->nextSibling()) {
-                    cuePointChild->parse(diag);
-                    switch (cuePointChild->id()) {
-                    case EbmlIds::Void:
-                    case EbmlIds::Crc32:
-                        break;
-                    case MatroskaIds::CueTime:
-                        // write "CueTime"-element
-                        cuePointChild->copyBuffer(stream);
-                        cuePointChild->discardBuffer();
-                        //cuePointChild->copyEntirely(stream);
-                        break;
-                    case MatroskaIds::CueTrackPositions:
-                        // write "CueTrackPositions"-element
-                        stream.put(static_cast<char>(MatroskaIds::CueTrackPositions));
-                        len = EbmlElement::makeSizeDenotation(m_sizes[cuePointChild], buff);
-                        stream.write(buff, len);
-                        for (EbmlElement *cueTrackPositionsChild = cuePointChild->firstChild(); cueTrackPositionsChild;
-                             cueTrackPositionsChild = cueTrackPositionsChild->nextSibling()) {
-                            cueTrackPositionsChild->parse(diag);
-                            switch (cueTrackPositionsChild->id()) {
-                            case MatroskaIds::CueTrack:
-                            case MatroskaIds::CueDuration:
-                            case MatroskaIds::CueBlockNumber:
-                                // write unchanged children of "CueTrackPositions"-element
-                                cueTrackPositionsChild->copyBuffer(stream);
-                                cueTrackPositionsChild->discardBuffer();
-                                //cueTrackPositionsChild->copyEntirely(stream);
-                                break;
-                            case MatroskaIds::CueRelativePosition:
-                                try {
-                                    EbmlElement::makeSimpleElement(
-                                        stream, cueTrackPositionsChild->id(), m_relativeOffsets.at(cueTrackPositionsChild).currentValue());
-                                } catch (const out_of_range &) {
-                                    // we were not able parse the relative offset because the absolute offset is missing
-                                    // continue anyways
-                                }
-                                break;
-                            case MatroskaIds::CueClusterPosition:
-                            case MatroskaIds::CueCodecState:
-                                // write "CueClusterPosition"/"CueCodecState"-element
-                                EbmlElement::makeSimpleElement(
-                                    stream, cueTrackPositionsChild->id(), m_offsets.at(cueTrackPositionsChild).currentValue());
-                                break;
-                            case MatroskaIds::CueReference:
-                                // write "CueReference"-element
-                                stream.put(static_cast<char>(MatroskaIds::CueRefTime));
-                                len = EbmlElement::makeSizeDenotation(m_sizes[cueTrackPositionsChild], buff);
-                                stream.write(buff, len);
-                                for (EbmlElement *cueReferenceChild = cueTrackPositionsChild->firstChild(); cueReferenceChild;
-                                     cueReferenceChild = cueReferenceChild->nextSibling()) {
-                                    cueReferenceChild->parse(diag);
-                                    switch (cueReferenceChild->id()) {
-                                    case EbmlIds::Void:
-                                    case EbmlIds::Crc32:
-                                        break;
-                                    case MatroskaIds::CueRefTime:
-                                    case MatroskaIds::CueRefNumber:
-                                        // write unchanged children of "CueReference"-element
-                                        cueReferenceChild->copyBuffer(stream);
-                                        cueReferenceChild->discardBuffer();
-                                        cueReferenceChild->copyEntirely(stream, diag, nullptr);
-                                        break;
-                                    case MatroskaIds::CueRefCluster:
-                                    case MatroskaIds::CueRefCodecState:
-                                        // write "CueRefCluster"/"CueRefCodecState"-element
-                                        EbmlElement::makeSimpleElement(
-                                            stream, cueReferenceChild->id(), m_offsets.at(cueReferenceChild).currentValue());
-                                        break;
-                                    default:
-                                        diag.emplace_back(DiagLevel::Warning,
-                                            "\"CueReference\"-element contains a element which is not known to the parser. It will be ignored.",
-                                            context);
-                                    }
-                                }
-                                break;
-                            default:
-                                diag.emplace_back(DiagLevel::Warning,
-                                    "\"CueTrackPositions\"-element contains a element which is not known to the parser. It will be ignored.",
-                                    context);
-                            }
-                        }
-                        break;
-                    default:
-                        diag.emplace_back(DiagLevel::Warning,
-                            "\"CuePoint\"-element contains a element which is not a \"CueTime\"- or a \"CueTrackPositions\"-element. It will be "
-                            "ignored.",
-                            context);
-                    }
-                }
-                break;
-            default:
-                diag.emplace_back(
-                    DiagLevel::Warning, "\"Cues\"-element contains a element which is not a \"CuePoint\"-element. It will be ignored.", context);
-            }
+    for (std::size_t i = 0, count = m_ids.size(); i != count; ++i) {
+        const auto id = m_ids[i];
+        if (isMasterElement(id)) {
+            const auto idLength = EbmlElement::makeId(id, buff);
+            stream.write(buff, idLength);
+            const auto sizeLength = EbmlElement::makeSizeDenotation(m_values[i], buff);
+            stream.write(buff, sizeLength);
+        } else {
+            EbmlElement::makeSimpleElement(stream, id, m_values[i]);
         }
-    } catch (const out_of_range &) {
-        diag.emplace_back(
-            DiagLevel::Critical, "Unable to write the file index because the index of the original file could not be parsed correctly.", context);
-        throw InvalidDataException();
     }
 }
 
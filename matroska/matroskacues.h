@@ -3,11 +3,16 @@
 
 #include "./ebmlelement.h"
 
+#include <cstdint>
+#include <limits>
 #include <ostream>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace TagParser {
 
+class MatroskaLayoutPlanner;
+
 class TAG_PARSER_EXPORT MatroskaOffsetStates {
 public:
     constexpr MatroskaOffsetStates(std::uint64_t initialValue);
@@ -66,21 +71,36 @@ public:
     MatroskaCuePositionUpdater();
 
     EbmlElement *cuesElement() const;
+    std::size_t entryCount() const;
     std::uint64_t totalSize() const;
 
     void parse(EbmlElement *cuesElement, Diagnostics &diag);
+    void generate(EbmlElement *segmentElement, const std::vector<std::uint64_t> &trackNumbers, Diagnostics &diag);
     bool updateOffsets(std::uint64_t originalOffset, std::uint64_t newOffset);
     bool updateRelativeOffsets(std::uint64_t referenceOffset, std::uint64_t originalRelativeOffset, std::uint64_t newRelativeOffset);
+    bool updateOffsets(const MatroskaLayoutPlanner &layout, std::uint64_t readOffset);
     void make(std::ostream &stream, Diagnostics &diag);
     void clear();
 
 private:
-    bool updateSize(EbmlElement *element, int shift);
+    static constexpr auto noParent = std::numeric_limits<std::uint32_t>::max();
+
+    void indexOffsets();
+    std::uint32_t addEntry(std::uint32_t id, std::uint32_t parent, std::uint64_t value);
+    std::uint32_t decodeMaster(std::uint32_t id, std::uint32_t parent, const char *data, std::size_t size, Diagnostics &diag);
+    std::uint64_t encodedSize(std::uint32_t index) const;
+    bool updateValue(std::uint32_t index, std::uint64_t newValue);
+    bool updateSize(std::uint32_t index, int shift);
 
     EbmlElement *m_cuesElement;
-    std::unordered_map<EbmlElement *, MatroskaOffsetStates> m_offsets;
-    std::unordered_map<EbmlElement *, MatroskaReferenceOffsetPair> m_relativeOffsets;
-    std::unordered_map<EbmlElement *, std::uint64_t> m_sizes;
+    std::uint8_t m_maxIdLength;
+    std::uint8_t m_maxSizeLength;
+    std::vector<std::uint32_t> m_ids;
+    std::vector<std::uint32_t> m_parents;
+    std::vector<std::uint64_t> m_values;
+    std::vector<std::uint64_t> m_initialValues;
+    std::vector<std::uint32_t> m_offsetIndices;
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> m_relativeOffsetIndices;
 };
 
 /*!
@@ -90,27 +110,41 @@ private:
  */
 inline MatroskaCuePositionUpdater::MatroskaCuePositionUpdater()
     : m_cuesElement(nullptr)
+    , m_maxIdLength(4)
+    , m_maxSizeLength(8)
 {
 }
 
 /*!
  * \brief Returns the "Cues"-element specified when calling the parse() method.
  *
- * Returns nullptr if no "Cues"-element is set.
+ * Returns nullptr if no "Cues"-element is set (also if the cues have been generated via generate()).
  */
 inline EbmlElement *MatroskaCuePositionUpdater::cuesElement() const
 {
     return m_cuesElement;
 }
 
+/*!
+ * \brief Returns the number of entries in the cue table (the "Cues"-element itself and all of its descendants).
+ */
+inline std::size_t MatroskaCuePositionUpdater::entryCount() const
+{
+    return m_ids.size();
+}
+
 /*!
  * \brief Resets the object to its initial state. Parsing results and updates are cleared.
  */
 inline void MatroskaCuePositionUpdater::clear()
 {
     m_cuesElement = nullptr;
-    m_offsets.clear();
-    m_sizes.clear();
+    m_ids.clear();
+    m_parents.clear();
+    m_values.clear();
+    m_initialValues.clear();
+    m_offsetIndices.clear();
+    m_relativeOffsetIndices.clear();
 }
 
 } // namespace TagParser
@@ -0,0 +1,200 @@
+#include "./matroskalayoutplanner.h"
+#include "./ebmlelement.h"
+#include "./ebmlid.h"
+#include "./matroskaid.h"
+
+#include "../progressfeedback.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace TagParser {
+
+/*!
+ * \class TagParser::MatroskaLayoutPlanner
+ * \brief The MatroskaLayoutPlanner class computes the offsets of the "Cluster"-elements of a segment when making a Matroska file.
+ *
+ * MatroskaContainer::internalMakeFile() needs to know where the "Cluster"-elements end up in the new file to update the
+ * "SeekHead"- and "Cues"-element. Deciding on the layout (e.g. whether rewriting the file can be avoided by moving the
+ * tags to the end) might require to place the clusters multiple times at different offsets.
+ *
+ * The planner walks the "Cluster"-elements once and stores everything required to place them in compact arrays: the
+ * offsets in the original file and, when rewriting, the size of each cluster without the children omitted or altered
+ * ("Void", "CRC-32" and "Position"). The new offsets of the clusters are kept as prefix sums relative to the first
+ * cluster. So placing the clusters at a different offset only shifts the prefix sums; they are only recomputed if the
+ * size of a "Position"-element changes due to the shift.
+ */
+
+/*!
+ * \brief Determines the "Cluster"-elements of the specified \a segmentElement.
+ */
+void MatroskaLayoutPlanner::parseClusters(EbmlElement *segmentElement, Diagnostics &diag)
+{
+    for (auto *clusterElement = segmentElement->childById(MatroskaIds::Cluster, diag); clusterElement;
+         clusterElement = clusterElement->siblingById(MatroskaIds::Cluster, diag)) {
+        m_clusters.emplace_back(clusterElement);
+        m_readOffsets.emplace_back(clusterElement->startOffset() - segmentElement->dataOffset());
+        m_originalEndOffset = clusterElement->endOffset();
+    }
+    if (!m_clusters.empty()) {
+        m_originalStartOffset = m_clusters.front()->startOffset();
+    }
+}
+
+/*!
+ * \brief Parses the children of the "Cluster"-elements to determine their sizes when being rewritten.
+ * \remarks
+ * - Does nothing if the children have already been parsed.
+ * - Must be called before calling rewrite().
+ */
+void MatroskaLayoutPlanner::parseClusterChildren(Diagnostics &diag, AbortableProgressFeedback &progress)
+{
+    if (m_childrenParsed) {
+        return;
+    }
+    const auto clusterCount = m_clusters.size();
+    m_contentSizes.reserve(clusterCount);
+    m_positionCounts.reserve(clusterCount);
+    m_adjustmentBegins.reserve(clusterCount + 1);
+    for (std::size_t index = 0; index != clusterCount; ++index) {
+        auto contentSize = std::uint64_t(), readOffset = std::uint64_t();
+        auto positionCount = std::uint32_t();
+        m_adjustmentBegins.emplace_back(static_cast<std::uint32_t>(m_adjustments.size()));
+        for (auto *childElement = m_clusters[index]->firstChild(); childElement; childElement = childElement->nextSibling()) {
+            childElement->parse(diag);
+            switch (childElement->id()) {
+            case EbmlIds::Void:
+            case EbmlIds::Crc32:
+                m_adjustments.emplace_back(Adjustment{ readOffset, childElement->totalSize(), false });
+                break;
+            case MatroskaIds::Position:
+                m_adjustments.emplace_back(Adjustment{ readOffset, childElement->totalSize(), true });
+                ++positionCount;
+                break;
+            default:
+                contentSize += childElement->totalSize();
+            }
+            readOffset += childElement->totalSize();
+        }
+        m_contentSizes.emplace_back(contentSize);
+        m_positionCounts.emplace_back(positionCount);
+        if (positionCount) {
+            m_positionIndices.emplace_back(static_cast<std::uint32_t>(index));
+        }
+        // check whether aborted (because this loop might take some seconds to process)
+        progress.stopIfAborted();
+        // update the progress percentage (using the number of processed clusters should be accurate enough)
+        if (index % 50 == 0) {
+            progress.updateStepPercentage(static_cast<std::uint8_t>(index * 100 / clusterCount));
+        }
+    }
+    m_adjustmentBegins.emplace_back(static_cast<std::uint32_t>(m_adjustments.size()));
+    m_childrenParsed = true;
+}
+
+/*!
+ * \brief Plans to keep the "Cluster"-elements as they are in the original file with the first one at the specified \a offset.
+ */
+void MatroskaLayoutPlanner::keep(std::uint64_t offset)
+{
+    m_rewriting = false;
+    m_offset = offset;
+}
+
+/*!
+ * \brief Plans to rewrite the "Cluster"-elements with the first one at the specified \a offset.
+ * \remarks
+ * - The offsets are only recomputed if the size of a "Position"-element changes; otherwise placing the clusters takes
+ *   constant time (plus a few binary searches if there are "Position"-elements).
+ * - parseClusterChildren() must have been called before.
+ */
+void MatroskaLayoutPlanner::rewrite(std::uint64_t offset)
+{
+    m_rewriting = true;
+    if (!m_offsetsComputed || !positionLengthsUnchanged(offset)) {
+        computeOffsets(offset);
+    }
+    m_offset = offset;
+}
+
+/*!
+ * \brief Returns the data size of the "Cluster"-element with the specified \a index in the planned layout.
+ */
+std::uint64_t MatroskaLayoutPlanner::dataSize(std::size_t index) const
+{
+    if (!m_rewriting) {
+        return m_clusters[index]->dataSize();
+    }
+    return m_contentSizes[index] + m_positionCounts[index] * (2u + EbmlElement::calculateUIntegerLength(offset(index)));
+}
+
+/*!
+ * \brief Maps the \a originalRelativeOffset of a child of the "Cluster"-element with the specified \a index to its
+ *        offset in the planned layout.
+ * \remarks Both offsets are relative to the data of the "Cluster"-element.
+ */
+std::uint64_t MatroskaLayoutPlanner::relativeOffset(std::size_t index, std::uint64_t originalRelativeOffset) const
+{
+    if (!m_rewriting) {
+        return originalRelativeOffset;
+    }
+    auto newRelativeOffset = originalRelativeOffset;
+    for (auto i = m_adjustmentBegins[index], end = m_adjustmentBegins[index + 1]; i != end && m_adjustments[i].readOffset < originalRelativeOffset;
+         ++i) {
+        const auto &adjustment = m_adjustments[i];
+        newRelativeOffset -= adjustment.size;
+        if (adjustment.position) {
+            newRelativeOffset += 2u + EbmlElement::calculateUIntegerLength(offset(index));
+        }
+    }
+    return newRelativeOffset;
+}
+
+/*!
+ * \brief Returns whether placing the clusters at the specified \a offset would leave the sizes of all "Position"-elements unchanged.
+ * \remarks The size of a "Position"-element only changes when its value crosses a power of 256. Since the offsets of
+ *          the clusters are ascending, comparing the number of clusters below each of these boundaries is sufficient.
+ */
+bool MatroskaLayoutPlanner::positionLengthsUnchanged(std::uint64_t offset) const
+{
+    if (m_positionIndices.empty() || offset == m_computedOffset) {
+        return true;
+    }
+    const auto countBelow = [this](std::uint64_t boundary, std::uint64_t base) {
+        if (boundary <= base) {
+            return std::size_t();
+        }
+        const auto limit = boundary - base;
+        return static_cast<std::size_t>(
+            partition_point(m_positionIndices.cbegin(), m_positionIndices.cend(), [&](std::uint32_t index) { return m_offsets[index] < limit; })
+            - m_positionIndices.cbegin());
+    };
+    // check the boundaries 2^8, 2^16, ..., 2^56 (where the length of an unsigned integer changes)
+    for (auto boundary = std::uint64_t(0x100); boundary; boundary <<= 8) {
+        if (countBelow(boundary, m_computedOffset) != countBelow(boundary, offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief Computes the offsets of the clusters relative to the first cluster assuming the first cluster is at the specified \a offset.
+ */
+void MatroskaLayoutPlanner::computeOffsets(std::uint64_t offset)
+{
+    const auto clusterCount = m_clusters.size();
+    m_offsets.resize(clusterCount + 1);
+    m_offsets.front() = 0;
+    for (std::size_t index = 0; index != clusterCount; ++index) {
+        const auto positionCount = m_positionCounts[index];
+        const auto dataSize
+            = m_contentSizes[index] + (positionCount ? positionCount * (2u + EbmlElement::calculateUIntegerLength(offset + m_offsets[index])) : 0u);
+        m_offsets[index + 1] = m_offsets[index] + 4 + EbmlElement::calculateSizeDenotationLength(dataSize) + dataSize;
+    }
+    m_computedOffset = offset;
+    m_offsetsComputed = true;
+}
+
+} // namespace TagParser
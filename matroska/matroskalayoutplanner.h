@@ -0,0 +1,136 @@
+#ifndef TAG_PARSER_MATROSKALAYOUTPLANNER_H
+#define TAG_PARSER_MATROSKALAYOUTPLANNER_H
+
+#include "../global.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace TagParser {
+
+class AbortableProgressFeedback;
+class Diagnostics;
+class EbmlElement;
+
+class TAG_PARSER_EXPORT MatroskaLayoutPlanner {
+public:
+    MatroskaLayoutPlanner();
+
+    void parseClusters(EbmlElement *segmentElement, Diagnostics &diag);
+    void parseClusterChildren(Diagnostics &diag, AbortableProgressFeedback &progress);
+    void keep(std::uint64_t offset);
+    void rewrite(std::uint64_t offset);
+
+    std::size_t clusterCount() const;
+    EbmlElement *cluster(std::size_t index) const;
+    std::uint64_t readOffset(std::size_t index) const;
+    std::uint64_t originalStartOffset() const;
+    std::uint64_t originalEndOffset() const;
+    std::uint64_t offset(std::size_t index) const;
+    std::uint64_t dataSize(std::size_t index) const;
+    std::uint64_t relativeOffset(std::size_t index, std::uint64_t originalRelativeOffset) const;
+    std::uint64_t totalSize() const;
+
+private:
+    /// \brief The Adjustment struct denotes a child of a "Cluster"-element which is omitted or altered when rewriting the cluster.
+    struct Adjustment {
+        std::uint64_t readOffset; /**< the offset of the child relative to the cluster data (original file) */
+        std::uint64_t size; /**< the total size of the child (original file) */
+        bool position; /**< whether the child is a "Position"-element (which is rewritten rather than omitted) */
+    };
+
+    bool positionLengthsUnchanged(std::uint64_t offset) const;
+    void computeOffsets(std::uint64_t offset);
+
+    std::vector<EbmlElement *> m_clusters;
+    std::vector<std::uint64_t> m_readOffsets;
+    std::vector<std::uint64_t> m_contentSizes;
+    std::vector<std::uint32_t> m_positionCounts;
+    std::vector<std::uint32_t> m_positionIndices;
+    std::vector<std::uint32_t> m_adjustmentBegins;
+    std::vector<Adjustment> m_adjustments;
+    std::vector<std::uint64_t> m_offsets;
+    std::uint64_t m_originalStartOffset;
+    std::uint64_t m_originalEndOffset;
+    std::uint64_t m_offset;
+    std::uint64_t m_computedOffset;
+    bool m_childrenParsed;
+    bool m_rewriting;
+    bool m_offsetsComputed;
+};
+
+/*!
+ * \brief Constructs a new planner; call parseClusters() to do further initialization.
+ */
+inline MatroskaLayoutPlanner::MatroskaLayoutPlanner()
+    : m_originalStartOffset(0)
+    , m_originalEndOffset(0)
+    , m_offset(0)
+    , m_computedOffset(0)
+    , m_childrenParsed(false)
+    , m_rewriting(false)
+    , m_offsetsComputed(false)
+{
+}
+
+/*!
+ * \brief Returns the number of "Cluster"-elements.
+ */
+inline std::size_t MatroskaLayoutPlanner::clusterCount() const
+{
+    return m_clusters.size();
+}
+
+/*!
+ * \brief Returns the "Cluster"-element with the specified \a index.
+ */
+inline EbmlElement *MatroskaLayoutPlanner::cluster(std::size_t index) const
+{
+    return m_clusters[index];
+}
+
+/*!
+ * \brief Returns the offset of the "Cluster"-element with the specified \a index relative to the segment data (original file).
+ */
+inline std::uint64_t MatroskaLayoutPlanner::readOffset(std::size_t index) const
+{
+    return m_readOffsets[index];
+}
+
+/*!
+ * \brief Returns the start offset of the first "Cluster"-element (original file).
+ */
+inline std::uint64_t MatroskaLayoutPlanner::originalStartOffset() const
+{
+    return m_originalStartOffset;
+}
+
+/*!
+ * \brief Returns the end offset of the last "Cluster"-element (original file).
+ */
+inline std::uint64_t MatroskaLayoutPlanner::originalEndOffset() const
+{
+    return m_originalEndOffset;
+}
+
+/*!
+ * \brief Returns the offset of the "Cluster"-element with the specified \a index in the planned layout.
+ * \remarks The offset has the same reference as the offset passed to keep() or rewrite().
+ */
+inline std::uint64_t MatroskaLayoutPlanner::offset(std::size_t index) const
+{
+    return m_rewriting ? m_offset + m_offsets[index] : m_offset + (m_readOffsets[index] - m_readOffsets.front());
+}
+
+/*!
+ * \brief Returns the total size of all "Cluster"-elements in the planned layout.
+ */
+inline std::uint64_t MatroskaLayoutPlanner::totalSize() const
+{
+    return m_rewriting ? m_offsets.back() : m_originalEndOffset - m_originalStartOffset;
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_MATROSKALAYOUTPLANNER_H
@@ -0,0 +1,440 @@
+#include "./matroskastatisticsengine.h"
+#include "./ebmlheaderdecoder.h"
+#include "./matroskaid.h"
+
+#include "../basicfileinfo.h"
+#include "../diagnostics.h"
+#include "../exceptions.h"
+#include "../progressfeedback.h"
+
+#include <c++utilities/conversion/stringbuilder.h>
+#include <c++utilities/io/nativefilestream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+using namespace std;
+using namespace CppUtilities;
+
+namespace TagParser {
+
+/*!
+ * \brief Adds the statistics of the \a other part of the same track.
+ */
+void MatroskaTrackStatistics::add(const MatroskaTrackStatistics &other)
+{
+    frameCount += other.frameCount;
+    byteCount += other.byteCount;
+    startTimestamp = min(startTimestamp, other.startTimestamp);
+    endTimestamp = max(endTimestamp, other.endTimestamp);
+    if (other.lastTimestampWithoutDuration > lastTimestampWithoutDuration) {
+        lastTimestampWithoutDuration = other.lastTimestampWithoutDuration;
+        lastFrameCountWithoutDuration = other.lastFrameCountWithoutDuration;
+    }
+}
+
+/*!
+ * \brief Returns the duration from the first to the end of the last block in nanoseconds.
+ * \remarks
+ * - The duration of a block is taken from its "BlockDuration"-element. For blocks without that element (e.g. all
+ *   "SimpleBlock"-elements) the \a defaultDuration (in nanoseconds) of each of its frames is used instead. That is
+ *   the value of the "DefaultDuration"-element of the track.
+ * - If no \a defaultDuration is specified, the duration is one frame shorter for such blocks.
+ */
+std::uint64_t MatroskaTrackStatistics::durationInNanoseconds(std::uint64_t timestampScale, std::uint64_t defaultDuration) const
+{
+    if (endTimestamp < startTimestamp) {
+        return 0; // no blocks
+    }
+    auto duration = static_cast<std::uint64_t>(endTimestamp - startTimestamp) * timestampScale;
+    if (lastTimestampWithoutDuration >= startTimestamp) {
+        duration = max(duration,
+            static_cast<std::uint64_t>(lastTimestampWithoutDuration - startTimestamp) * timestampScale + lastFrameCountWithoutDuration * defaultDuration);
+    }
+    return duration;
+}
+
+/*!
+ * \brief Returns the duration from the first to the end of the last block.
+ * \sa durationInNanoseconds()
+ */
+CppUtilities::TimeSpan MatroskaTrackStatistics::duration(std::uint64_t timestampScale, std::uint64_t defaultDuration) const
+{
+    return TimeSpan(static_cast<std::int64_t>(durationInNanoseconds(timestampScale, defaultDuration) / 100));
+}
+
+/*!
+ * \brief Returns the average bitrate in kbit/s (like AbstractTrack::bitrate()).
+ * \sa durationInNanoseconds()
+ */
+double MatroskaTrackStatistics::bitrate(std::uint64_t timestampScale, std::uint64_t defaultDuration) const
+{
+    const auto seconds = static_cast<double>(durationInNanoseconds(timestampScale, defaultDuration)) / 1000000000.0;
+    return seconds > 0.0 ? static_cast<double>(byteCount) * 8.0 / seconds / 1000.0 : 0.0;
+}
+
+/*!
+ * \brief Returns the specified duration in \a nanoseconds formatted as "HH:MM:SS.nnnnnnnnn".
+ * \remarks That is the format mkvmerge uses for the "DURATION"-tag.
+ */
+std::string MatroskaTrackStatistics::formatDuration(std::uint64_t nanoseconds)
+{
+    auto res = std::ostringstream();
+    res << std::setfill('0') << std::setw(2) << nanoseconds / 3600000000000u << ':' << std::setw(2) << nanoseconds / 60000000000u % 60u << ':'
+        << std::setw(2) << nanoseconds / 1000000000u % 60u << '.' << std::setw(9) << nanoseconds % 1000000000u;
+    return res.str();
+}
+
+/*!
+ * \class TagParser::MatroskaStatisticsEngine
+ * \brief The MatroskaStatisticsEngine class determines track statistics by scanning the blocks of a Matroska file.
+ *
+ * Muxers like mkvmerge write statistics (frame count, byte count, bitrate and duration) as tags. Those tags are
+ * missing in many files or outdated. This class computes the statistics from the "Cluster"-elements instead. It only
+ * reads the headers of the "SimpleBlock"- and "Block"-elements (track number, timestamp, flags and lacing) and skips
+ * the frame data.
+ *
+ * The clusters added via addCluster() are split into contiguous ranges which are scanned by multiple threads. Each
+ * thread uses its own stream and reads the file in small chunks, so the headers of small frames are read at once
+ * while big frames are skipped. The statistics of the ranges are combined afterwards.
+ *
+ * \sa MatroskaContainer::computeTrackStatistics()
+ */
+
+/// \cond
+namespace {
+
+/// \brief Returns the pointer to the \a size bytes at \a offset which are read from the file in chunks.
+class ChunkReader {
+public:
+    explicit ChunkReader(std::istream &stream, std::uint64_t fileSize);
+    const char *read(std::uint64_t offset, std::size_t &size);
+
+private:
+    std::istream &m_stream;
+    std::uint64_t m_fileSize;
+    std::unique_ptr<char[]> m_buffer;
+    std::uint64_t m_bufferOffset;
+    std::size_t m_bufferedBytes;
+};
+
+ChunkReader::ChunkReader(std::istream &stream, std::uint64_t fileSize)
+    : m_stream(stream)
+    , m_fileSize(fileSize)
+    , m_buffer(make_unique<char[]>(MatroskaStatisticsEngine::bufferSize))
+    , m_bufferOffset(0)
+    , m_bufferedBytes(0)
+{
+}
+
+/// \remarks Reduces \a size to the number of available bytes (which is never more than MatroskaStatisticsEngine::bufferSize).
+const char *ChunkReader::read(std::uint64_t offset, std::size_t &size)
+{
+    size = static_cast<std::size_t>(min<std::uint64_t>({ size, MatroskaStatisticsEngine::bufferSize, offset < m_fileSize ? m_fileSize - offset : 0 }));
+    if (offset < m_bufferOffset || offset + size > m_bufferOffset + m_bufferedBytes) {
+        m_bufferOffset = offset;
+        m_bufferedBytes = static_cast<std::size_t>(min<std::uint64_t>(MatroskaStatisticsEngine::bufferSize, m_fileSize - offset));
+        m_stream.seekg(static_cast<streamoff>(m_bufferOffset));
+        m_stream.read(m_buffer.get(), static_cast<streamsize>(m_bufferedBytes));
+    }
+    return m_buffer.get() + (offset - m_bufferOffset);
+}
+
+/// \brief Returns the statistics for the track with the specified \a trackNumber; adds them if not present yet.
+MatroskaTrackStatistics &statisticsFor(std::vector<MatroskaTrackStatistics> &statistics, std::uint64_t trackNumber)
+{
+    for (auto &trackStatistics : statistics) {
+        if (trackStatistics.trackNumber == trackNumber) {
+            return trackStatistics;
+        }
+    }
+    auto &trackStatistics = statistics.emplace_back();
+    trackStatistics.trackNumber = trackNumber;
+    return trackStatistics;
+}
+
+/// \brief Reads the header of the "SimpleBlock"- or "Block"-element with the specified \a dataOffset and \a dataSize and adds it to \a statistics.
+/// \returns Returns whether the header is valid.
+bool addBlock(ChunkReader &reader, std::uint64_t dataOffset, std::uint64_t dataSize, std::uint64_t clusterTimestamp,
+    std::optional<std::uint64_t> duration, std::vector<MatroskaTrackStatistics> &statistics)
+{
+    // read track number (up to 8 byte), timestamp (2 byte), flags (1 byte) and lace count (1 byte)
+    auto size = static_cast<std::size_t>(min<std::uint64_t>(dataSize, 8 + 2 + 1 + 1));
+    const auto *data = reader.read(dataOffset, size);
+    auto block = MatroskaBlockHeader();
+    if (!EbmlHeaderDecoder::decodeBlockHeader(data, size, block)) {
+        return false;
+    }
+    const auto lacing = (block.flags >> 1) & 0x3;
+    auto headerSize = static_cast<std::uint64_t>(block.headerSize());
+
+    // determine the number of frames and the size of the lacing header
+    auto frameCount = std::uint64_t(1);
+    if (lacing) {
+        if (size <= headerSize) {
+            return false;
+        }
+        frameCount = static_cast<std::uint8_t>(data[headerSize++]) + 1u;
+        const auto readByte = [&]() -> std::optional<std::uint8_t> {
+            if (headerSize >= dataSize) {
+                return std::nullopt;
+            }
+            auto byteSize = std::size_t(1);
+            const auto *const byte = reader.read(dataOffset + headerSize++, byteSize);
+            return byteSize ? std::make_optional(static_cast<std::uint8_t>(*byte)) : std::nullopt;
+        };
+        switch (lacing) {
+        case 0x1: // Xiph lacing: the size of each frame except the last one is denoted by bytes which are added up until one is not 0xFF
+            for (auto frame = std::uint64_t(1); frame < frameCount; ++frame) {
+                for (auto byte = readByte();; byte = readByte()) {
+                    if (!byte.has_value()) {
+                        return false;
+                    }
+                    if (*byte != 0xFF) {
+                        break;
+                    }
+                }
+            }
+            break;
+        case 0x3: // EBML lacing: the size of each frame except the last one is denoted by a variable size integer
+            for (auto frame = std::uint64_t(1); frame < frameCount; ++frame) {
+                const auto firstByte = readByte();
+                if (!firstByte.has_value() || !*firstByte) {
+                    return false;
+                }
+                for (auto length = EbmlHeaderDecoder::vintLength(*firstByte); length > 1; --length) {
+                    if (!readByte().has_value()) {
+                        return false;
+                    }
+                }
+            }
+            break;
+        default:; // fixed-size lacing: no sizes denoted
+        }
+    }
+    if (headerSize > dataSize) {
+        return false;
+    }
+
+    // add the block to the statistics of its track
+    auto &trackStatistics = statisticsFor(statistics, block.trackNumber);
+    const auto blockTimestamp = static_cast<std::int64_t>(clusterTimestamp) + block.timestamp;
+    trackStatistics.frameCount += frameCount;
+    trackStatistics.byteCount += dataSize - headerSize;
+    trackStatistics.startTimestamp = min(trackStatistics.startTimestamp, blockTimestamp);
+    trackStatistics.endTimestamp = max(trackStatistics.endTimestamp, blockTimestamp + static_cast<std::int64_t>(duration.value_or(0)));
+    if (!duration.has_value() && blockTimestamp >= trackStatistics.lastTimestampWithoutDuration) {
+        trackStatistics.lastTimestampWithoutDuration = blockTimestamp;
+        trackStatistics.lastFrameCountWithoutDuration = frameCount;
+    }
+    return true;
+}
+
+} // namespace
+/// \endcond
+
+/*!
+ * \brief Constructs a new engine for the Matroska file with the specified \a path.
+ * \remarks Headers with an ID longer than \a maxIdLength or a size denotation longer than \a maxSizeLength are considered invalid.
+ */
+MatroskaStatisticsEngine::MatroskaStatisticsEngine(const std::string &path, std::uint8_t maxIdLength, std::uint8_t maxSizeLength)
+    : m_path(path)
+    , m_threadCount(max(std::thread::hardware_concurrency(), 1u))
+    , m_maxIdLength(min<std::uint8_t>(maxIdLength, 4))
+    , m_maxSizeLength(min<std::uint8_t>(maxSizeLength, 8))
+{
+}
+
+/*!
+ * \brief Computes the statistics of all tracks from the clusters added via addCluster().
+ * \returns Returns the statistics ordered by track number.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \throws Throws OperationAbortedException when aborted via \a progress.
+ * \remarks
+ * - Invalid elements are reported via \a diag; the rest of the affected cluster is skipped.
+ * - The callbacks of \a progress are invoked from the threads scanning the clusters but never concurrently.
+ */
+std::vector<MatroskaTrackStatistics> MatroskaStatisticsEngine::compute(Diagnostics &diag, AbortableProgressFeedback *progress) const
+{
+    // split the clusters into ranges of about the same size; use more ranges than threads to balance the load
+    const auto threadCount = min(m_threadCount, m_clusters.size());
+    const auto rangeCount = min(threadCount * 4, m_clusters.size());
+    auto totalSize = std::uint64_t();
+    for (const auto &cluster : m_clusters) {
+        totalSize += cluster.second;
+    }
+    auto ranges = vector<pair<std::size_t, std::size_t>>();
+    ranges.reserve(rangeCount);
+    for (auto begin = std::size_t(), index = std::size_t(), rangeSize = std::uint64_t(); index != m_clusters.size(); ++index) {
+        rangeSize += m_clusters[index].second;
+        if (rangeSize * rangeCount >= totalSize || index + 1 == m_clusters.size()) {
+            ranges.emplace_back(begin, index + 1);
+            begin = index + 1;
+            rangeSize = 0;
+        }
+    }
+
+    // scan the ranges concurrently
+    struct RangeResult {
+        std::vector<MatroskaTrackStatistics> statistics;
+        Diagnostics diag;
+        std::exception_ptr failure;
+    };
+    auto results = vector<RangeResult>(ranges.size());
+    for (auto &result : results) {
+        // drop messages the caller is not interested in right away; the results are merged into diag unfiltered
+        result.diag.setMinimumLevel(diag.minimumLevel());
+    }
+    auto nextRange = atomic_size_t(0);
+    auto rangesDone = std::size_t();
+    auto mutex = std::mutex();
+    const auto scanRanges = [&] {
+        for (auto index = nextRange++; index < ranges.size(); index = nextRange++) {
+            auto &result = results[index];
+            if (!progress || !progress->isAborted()) {
+                try {
+                    scanClusters(ranges[index].first, ranges[index].second, result.statistics, result.diag, progress);
+                } catch (...) {
+                    result.failure = current_exception();
+                }
+            }
+            if (progress) {
+                const auto lock = std::lock_guard<std::mutex>(mutex);
+                progress->updateStepPercentage(static_cast<std::uint8_t>(++rangesDone * 100 / ranges.size()));
+            }
+        }
+    };
+    auto workers = vector<thread>();
+    auto failure = exception_ptr();
+    try {
+        for (auto i = threadCount; i > 1; --i) {
+            workers.emplace_back(scanRanges);
+        }
+    } catch (const std::system_error &) {
+        // scan the remaining ranges on the current thread
+    }
+    scanRanges();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    // combine the results
+    auto statistics = vector<MatroskaTrackStatistics>();
+    for (auto &result : results) {
+        diag.insert(diag.end(), result.diag.begin(), result.diag.end());
+        if (!failure && result.failure) {
+            failure = result.failure;
+        }
+        for (const auto &trackStatistics : result.statistics) {
+            statisticsFor(statistics, trackStatistics.trackNumber).add(trackStatistics);
+        }
+    }
+    if (failure) {
+        rethrow_exception(failure);
+    }
+    if (progress) {
+        progress->stopIfAborted();
+    }
+    sort(statistics.begin(), statistics.end(),
+        [](const MatroskaTrackStatistics &lhs, const MatroskaTrackStatistics &rhs) { return lhs.trackNumber < rhs.trackNumber; });
+    return statistics;
+}
+
+/*!
+ * \brief Scans the clusters within [\a begin, \a end) adding their blocks to \a statistics.
+ * \remarks Invoked concurrently via compute() so it must only access members which are not altered.
+ */
+void MatroskaStatisticsEngine::scanClusters(std::size_t begin, std::size_t end, std::vector<MatroskaTrackStatistics> &statistics, Diagnostics &diag,
+    AbortableProgressFeedback *progress) const
+{
+    static const string context("computing Matroska track statistics");
+    auto stream = NativeFileStream();
+    stream.exceptions(ios_base::badbit | ios_base::failbit);
+    stream.open(BasicFileInfo::pathForOpen(m_path), ios_base::in | ios_base::binary);
+    stream.seekg(0, ios_base::end);
+    auto reader = ChunkReader(stream, static_cast<std::uint64_t>(stream.tellg()));
+
+    // decodes the header of the element at offset which must end before endOffset
+    const auto readHeader = [&](std::uint64_t offset, std::uint64_t endOffset, EbmlHeader &header) {
+        auto size = static_cast<std::size_t>(min<std::uint64_t>(endOffset - offset, EbmlHeaderDecoder::maxHeaderSize));
+        const auto *const data = reader.read(offset, size);
+        if (EbmlHeaderDecoder::decode(data, size, header, m_maxIdLength, m_maxSizeLength) != EbmlHeaderStatus::Ok) {
+            diag.emplace_back(DiagLevel::Warning,
+                argsToString("The EBML element at ", offset, " is invalid. Skipping the rest of the enclosing element."), context);
+            return false;
+        }
+        return true;
+    };
+    const auto readUInteger = [&](std::uint64_t offset, std::uint64_t dataSize) {
+        auto size = static_cast<std::size_t>(min<std::uint64_t>(dataSize, 8));
+        const auto *const data = reader.read(offset, size);
+        return EbmlHeaderDecoder::decodeUInteger(data, size);
+    };
+
+    for (auto index = begin; index != end; ++index) {
+        if (progress && progress->isAborted()) {
+            return;
+        }
+        const auto [clusterOffset, clusterSize] = m_clusters[index];
+        const auto clusterEnd = clusterOffset + clusterSize;
+        auto clusterTimestamp = std::uint64_t();
+        for (auto offset = clusterOffset, elementEnd = offset; offset < clusterEnd; offset = elementEnd) {
+            auto header = EbmlHeader();
+            if (!readHeader(offset, clusterEnd, header)) {
+                break;
+            }
+            const auto dataOffset = offset + header.headerSize();
+            elementEnd = header.sizeUnknown ? clusterEnd : min(clusterEnd, dataOffset + header.dataSize);
+            auto blockValid = true;
+            switch (header.id) {
+            case MatroskaIds::Timecode:
+                clusterTimestamp = readUInteger(dataOffset, elementEnd - dataOffset);
+                break;
+            case MatroskaIds::SimpleBlock:
+                blockValid = addBlock(reader, dataOffset, elementEnd - dataOffset, clusterTimestamp, std::nullopt, statistics);
+                break;
+            case MatroskaIds::BlockGroup: {
+                // the "BlockDuration"-element might follow the "Block"-element so determine the block first
+                auto blockOffset = std::uint64_t(), blockSize = std::uint64_t();
+                auto duration = std::optional<std::uint64_t>();
+                for (auto childOffset = dataOffset, childEnd = childOffset; childOffset < elementEnd; childOffset = childEnd) {
+                    auto childHeader = EbmlHeader();
+                    if (!readHeader(childOffset, elementEnd, childHeader)) {
+                        break;
+                    }
+                    const auto childDataOffset = childOffset + childHeader.headerSize();
+                    childEnd = childHeader.sizeUnknown ? elementEnd : min(elementEnd, childDataOffset + childHeader.dataSize);
+                    switch (childHeader.id) {
+                    case MatroskaIds::Block:
+                        blockOffset = childDataOffset;
+                        blockSize = childEnd - childDataOffset;
+                        break;
+                    case MatroskaIds::BlockDuration:
+                        duration = readUInteger(childDataOffset, childEnd - childDataOffset);
+                        break;
+                    default:;
+                    }
+                }
+                if (blockOffset) {
+                    blockValid = addBlock(reader, blockOffset, blockSize, clusterTimestamp, duration, statistics);
+                }
+                break;
+            }
+            default:;
+            }
+            if (!blockValid) {
+                diag.emplace_back(DiagLevel::Warning, argsToString("The header of the block at ", offset, " is invalid. It will be ignored."), context);
+            }
+        }
+    }
+}
+
+} // namespace TagParser
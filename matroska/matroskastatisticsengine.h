@@ -0,0 +1,100 @@
+#ifndef TAG_PARSER_MATROSKASTATISTICSENGINE_H
+#define TAG_PARSER_MATROSKASTATISTICSENGINE_H
+
+#include "../global.h"
+
+#include <c++utilities/chrono/timespan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace TagParser {
+
+class AbortableProgressFeedback;
+class Diagnostics;
+
+/*!
+ * \brief The MatroskaTrackStatistics struct holds the statistics of a track determined by the MatroskaStatisticsEngine.
+ * \remarks Timestamps are in the unit specified by the "TimestampScale"-element of the segment.
+ */
+struct TAG_PARSER_EXPORT MatroskaTrackStatistics {
+    void add(const MatroskaTrackStatistics &other);
+    std::uint64_t durationInNanoseconds(std::uint64_t timestampScale, std::uint64_t defaultDuration = 0) const;
+    CppUtilities::TimeSpan duration(std::uint64_t timestampScale, std::uint64_t defaultDuration = 0) const;
+    double bitrate(std::uint64_t timestampScale, std::uint64_t defaultDuration = 0) const;
+    static std::string formatDuration(std::uint64_t nanoseconds);
+
+    std::uint64_t trackNumber = 0; /**< the number of the track (as used in the blocks) */
+    std::uint64_t frameCount = 0; /**< the number of frames (laced frames are counted individually) */
+    std::uint64_t byteCount = 0; /**< the size of the frames in byte (excluding the block and lacing headers) */
+    std::int64_t startTimestamp = std::numeric_limits<std::int64_t>::max(); /**< the lowest timestamp of a block */
+    std::int64_t endTimestamp = std::numeric_limits<std::int64_t>::min(); /**< the highest timestamp of a block plus its duration (if known) */
+    std::int64_t lastTimestampWithoutDuration = std::numeric_limits<std::int64_t>::min(); /**< the highest timestamp of a block without duration */
+    std::uint64_t lastFrameCountWithoutDuration = 0; /**< the number of frames of the block with lastTimestampWithoutDuration */
+};
+
+class TAG_PARSER_EXPORT MatroskaStatisticsEngine {
+public:
+    static constexpr std::size_t bufferSize = 0x1000;
+
+    explicit MatroskaStatisticsEngine(const std::string &path, std::uint8_t maxIdLength = 4, std::uint8_t maxSizeLength = 8);
+
+    std::size_t threadCount() const;
+    void setThreadCount(std::size_t threadCount);
+    std::size_t clusterCount() const;
+    void addCluster(std::uint64_t dataOffset, std::uint64_t dataSize);
+    std::vector<MatroskaTrackStatistics> compute(Diagnostics &diag, AbortableProgressFeedback *progress = nullptr) const;
+
+private:
+    void scanClusters(std::size_t begin, std::size_t end, std::vector<MatroskaTrackStatistics> &statistics, Diagnostics &diag,
+        AbortableProgressFeedback *progress) const;
+
+    std::string m_path;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> m_clusters;
+    std::size_t m_threadCount;
+    std::uint8_t m_maxIdLength;
+    std::uint8_t m_maxSizeLength;
+};
+
+/*!
+ * \brief Returns the max. number of threads used to scan the clusters.
+ * \remarks Defaults to the number of hardware threads.
+ */
+inline std::size_t MatroskaStatisticsEngine::threadCount() const
+{
+    return m_threadCount;
+}
+
+/*!
+ * \brief Sets the max. number of threads used to scan the clusters.
+ * \remarks A value of zero is treated as one.
+ */
+inline void MatroskaStatisticsEngine::setThreadCount(std::size_t threadCount)
+{
+    m_threadCount = threadCount ? threadCount : 1;
+}
+
+/*!
+ * \brief Returns the number of clusters added via addCluster().
+ */
+inline std::size_t MatroskaStatisticsEngine::clusterCount() const
+{
+    return m_clusters.size();
+}
+
+/*!
+ * \brief Adds the "Cluster"-element with the specified \a dataOffset and \a dataSize to the clusters to be scanned.
+ * \remarks The clusters should be added in the order they appear in the file.
+ */
+inline void MatroskaStatisticsEngine::addCluster(std::uint64_t dataOffset, std::uint64_t dataSize)
+{
+    m_clusters.emplace_back(dataOffset, dataSize);
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_MATROSKASTATISTICSENGINE_H
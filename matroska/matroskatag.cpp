@@ -2,10 +2,11 @@
 #include "./ebmlelement.h"
 
 #include "../diagnostics.h"
+#include "../knownfieldmapping.h"
 
 #include <initializer_list>
-#include <map>
 #include <stdexcept>
+#include <string_view>
 
 using namespace std;
 using namespace CppUtilities;
@@ -17,70 +18,21 @@ namespace TagParser {
  * \brief Implementation of TagParser::Tag for the Matroska container.
  */
 
-MatroskaTag::IdentifierType MatroskaTag::internallyGetFieldId(KnownField field) const
-{
-    using namespace MatroskaTagIds;
-    switch (field) {
-    case KnownField::Artist:
-        return artist();
-    case KnownField::Album:
-        return album();
-    case KnownField::Comment:
-        return comment();
-    case KnownField::RecordDate:
-    case KnownField::Year:
-        return dateRecorded();
-    case KnownField::ReleaseDate:
-        return dateRelease();
-    case KnownField::Title:
-        return title();
-    case KnownField::Genre:
-        return genre();
-    case KnownField::PartNumber:
-        return partNumber();
-    case KnownField::TotalParts:
-        return totalParts();
-    case KnownField::Encoder:
-        return encoder();
-    case KnownField::EncoderSettings:
-        return encoderSettings();
-    case KnownField::Bpm:
-        return bpm();
-    case KnownField::Bps:
-        return bps();
-    case KnownField::Rating:
-        return rating();
-    case KnownField::Description:
-        return description();
-    case KnownField::Lyrics:
-        return lyrics();
-    case KnownField::RecordLabel:
-        return label();
-    case KnownField::Performers:
-        return actor();
-    case KnownField::Lyricist:
-        return lyricist();
-    case KnownField::Composer:
-        return composer();
-    case KnownField::Length:
-        return duration();
-    case KnownField::Language:
-        return language();
-    default:
-        return string();
-    }
-}
-
-KnownField MatroskaTag::internallyGetKnownField(const IdentifierType &id) const
+/// \cond
+namespace {
+constexpr auto makeMatroskaTagFieldMapping()
 {
     using namespace MatroskaTagIds;
-    static const map<string, KnownField> fieldMap({
+    // clang-format off
+    constexpr FieldIdMapping<std::string_view> fieldIds[] = {
         { artist(), KnownField::Artist },
         { album(), KnownField::Album },
         { comment(), KnownField::Comment },
         { dateRecorded(), KnownField::RecordDate },
+        { dateRecorded(), KnownField::Year, FieldMappingDirection::ToIdOnly },
         { dateRelease(), KnownField::ReleaseDate },
         { title(), KnownField::Title },
+        { genre(), KnownField::Genre },
         { partNumber(), KnownField::PartNumber },
         { totalParts(), KnownField::TotalParts },
         { encoder(), KnownField::Encoder },
@@ -96,19 +48,35 @@ KnownField MatroskaTag::internallyGetKnownField(const IdentifierType &id) const
         { composer(), KnownField::Composer },
         { duration(), KnownField::Length },
         { language(), KnownField::Language },
-    });
-    const auto knownField(fieldMap.find(id));
-    return knownField != fieldMap.cend() ? knownField->second : KnownField::Invalid;
+    };
+    // clang-format on
+    return makeKnownFieldMapping<FieldIdHash>(fieldIds);
+}
+constexpr auto matroskaTagFieldMapping = makeMatroskaTagFieldMapping();
+static_assert(matroskaTagFieldMapping.isValid(), "Matroska tag field mapping must not contain conflicting entries");
+} // namespace
+/// \endcond
+
+MatroskaTag::IdentifierType MatroskaTag::internallyGetFieldId(KnownField field) const
+{
+    return IdentifierType(matroskaTagFieldMapping.id(field));
+}
+
+KnownField MatroskaTag::internallyGetKnownField(const IdentifierType &id) const
+{
+    return matroskaTagFieldMapping.knownField(id);
 }
 
 /*!
  * \brief Parses tag information from the specified \a tagElement.
  *
+ * If \a decodeFields is false, the fields are only indexed (see MatroskaTagField::index()) and decoded when accessed.
+ *
  * \throws Throws std::ios_base::failure when an IO error occurs.
  * \throws Throws TagParser::Failure or a derived exception when a parsing
  *         error occurs.
  */
-void MatroskaTag::parse(EbmlElement &tagElement, Diagnostics &diag)
+void MatroskaTag::parse(EbmlElement &tagElement, Diagnostics &diag, bool decodeFields)
 {
     static const string context("parsing Matroska tag");
     tagElement.parse(diag);
@@ -124,7 +92,11 @@ void MatroskaTag::parse(EbmlElement &tagElement, Diagnostics &diag)
         case MatroskaIds::SimpleTag:
             try {
                 MatroskaTagField field;
-                field.reparse(*child, diag, true);
+                if (decodeFields) {
+                    field.reparse(*child, diag, true);
+                } else {
+                    field.index(*child, diag);
+                }
                 fields().emplace(field.id(), move(field));
             } catch (const Failure &) {
             }
@@ -69,7 +69,7 @@ public:
     bool supportsMultipleValues(KnownField field) const override;
     TagTargetLevel targetLevel() const override;
 
-    void parse(EbmlElement &tagElement, Diagnostics &diag);
+    void parse(EbmlElement &tagElement, Diagnostics &diag, bool decodeFields = true);
     MatroskaTagMaker prepareMaking(Diagnostics &diag);
     void make(std::ostream &stream, Diagnostics &diag);
 
@@ -1,7 +1,9 @@
 #include "./matroskatagfield.h"
 #include "./ebmlelement.h"
+#include "./ebmlheaderdecoder.h"
 #include "./matroskacontainer.h"
 
+#include "../diagnostics.h"
 #include "../exceptions.h"
 
 #include <c++utilities/io/binarywriter.h>
@@ -18,69 +20,62 @@ namespace TagParser {
  * \brief The MatroskaTagField class is used by MatroskaTag to store the fields.
  */
 
-/*!
- * \brief Constructs a new MatroskaTagField.
- */
-MatroskaTagField::MatroskaTagField()
-{
-}
+/// \cond
+namespace {
 
 /*!
- * \brief Constructs a new MatroskaTagField with the specified \a id and \a value.
+ * \brief The SimpleTagDecoder struct decodes the children of a "SimpleTag"-element from a buffer.
  */
-MatroskaTagField::MatroskaTagField(const string &id, const TagValue &value)
-    : TagField<MatroskaTagField>(id, value)
-{
-}
+struct SimpleTagDecoder {
+    void decode(const char *data, std::size_t size, std::uint64_t dataOffset, std::string &id, TagValue &value, bool &isDefault,
+        std::vector<MatroskaTagField> &nestedFields) const;
+    void report(DiagLevel level, std::string &&message, const std::string &context) const;
+
+    Diagnostics *diag = nullptr; // messages are discarded if not set
+    bool decodeValues = true; // whether to decode more than the ID
+    bool parseNestedFields = true;
+};
 
 /*!
- * \brief Parses field information from the specified EbmlElement.
- *
- * The specified atom should be a simple tag element. These elements
- * represents the fields of a MatroskaTag.
- *
- * \throws Throws std::ios_base::failure when an IO error occurs.
- * \throws Throws TagParser::Failure or a derived exception when a parsing
- *         error occurs.
+ * \brief Decodes the children of a "SimpleTag"-element which has been buffered at \a data.
+ * \remarks The \a dataOffset is the offset of the children within the file; it is only used for messages.
  */
-void MatroskaTagField::reparse(EbmlElement &simpleTagElement, Diagnostics &diag, bool parseNestedFields)
+void SimpleTagDecoder::decode(const char *data, std::size_t size, std::uint64_t dataOffset, std::string &id, TagValue &value, bool &isDefault,
+    std::vector<MatroskaTagField> &nestedFields) const
 {
-    string context("parsing Matroska tag field");
-    simpleTagElement.parse(diag);
-    bool tagDefaultFound = false, tagLanguageFound = false, tagLanguageIETFFound = false;
-    for (EbmlElement *child = simpleTagElement.firstChild(); child; child = child->nextSibling()) {
-        try {
-            child->parse(diag);
-        } catch (const Failure &) {
-            diag.emplace_back(DiagLevel::Critical, "Unable to parse children of \"SimpleTag\"-element.", context);
-            break;
+    auto context = id.empty() ? string("parsing Matroska tag field") : "parsing Matroska tag field " + id;
+    auto tagNameFound = !id.empty(), tagValueFound = !value.isEmpty();
+    auto tagDefaultFound = false, tagLanguageFound = false, tagLanguageIETFFound = false;
+    auto decoder = EbmlHeaderDecoder(data, size);
+    auto header = EbmlHeader();
+    for (auto childOffset = decoder.offset(); decoder.next(header); childOffset = decoder.offset()) {
+        const auto *const childData = data + childOffset + header.headerSize();
+        const auto childDataSize = decoder.offset() - childOffset - header.headerSize();
+        if (!header.sizeUnknown && header.dataSize > childDataSize) {
+            report(DiagLevel::Warning, "Data of EBML element seems to be truncated; unable to parse siblings of that element.", context);
         }
-        switch (child->id()) {
+        switch (header.id) {
         case MatroskaIds::TagName:
-            if (id().empty()) {
-                setId(child->readString());
-                context = "parsing Matroska tag field " + id();
+            if (!tagNameFound) {
+                tagNameFound = true;
+                id.assign(childData, childDataSize);
+                context = "parsing Matroska tag field " + id;
             } else {
-                diag.emplace_back(DiagLevel::Warning,
+                report(DiagLevel::Warning,
                     "\"SimpleTag\"-element contains multiple \"TagName\"-elements. Surplus TagName elements will be ignored.", context);
             }
             break;
         case MatroskaIds::TagString:
         case MatroskaIds::TagBinary:
-            if (value().isEmpty()) {
-                unique_ptr<char[]> buffer = make_unique<char[]>(child->dataSize());
-                child->stream().seekg(static_cast<streamoff>(child->dataOffset()));
-                child->stream().read(buffer.get(), static_cast<streamoff>(child->dataSize()));
-                switch (child->id()) {
-                case MatroskaIds::TagString:
-                    value().assignData(move(buffer), child->dataSize(), TagDataType::Text, TagTextEncoding::Utf8);
-                    break;
-                case MatroskaIds::TagBinary:
-                    value().assignData(move(buffer), child->dataSize(), TagDataType::Undefined);
-                    break;
+            if (!tagValueFound) {
+                tagValueFound = true;
+                if (decodeValues && header.id == MatroskaIds::TagString) {
+                    value.assignData(childData, childDataSize, TagDataType::Text, TagTextEncoding::Utf8);
+                } else if (decodeValues) {
+                    value.assignData(childData, childDataSize, TagDataType::Undefined);
                 }
             } else {
-                diag.emplace_back(DiagLevel::Warning,
+                report(DiagLevel::Warning,
                     "\"SimpleTag\"-element contains multiple \"TagString\"/\"TagBinary\"-elements. Surplus \"TagName\"/\"TagBinary\"-elements will "
                     "be ignored.",
                     context);
@@ -89,40 +84,53 @@ void MatroskaTagField::reparse(EbmlElement &simpleTagElement, Diagnostics &diag,
         case MatroskaIds::TagLanguage:
             if (!tagLanguageFound) {
                 tagLanguageFound = true;
-                auto language = child->readString();
-                if (language != "und") {
-                    value().locale().emplace_back(std::move(language), LocaleFormat::ISO_639_2_B);
+                auto language = string(childData, childDataSize);
+                if (decodeValues && language != "und") {
+                    value.locale().emplace_back(std::move(language), LocaleFormat::ISO_639_2_B);
                 }
             } else {
-                diag.emplace_back(DiagLevel::Warning,
+                report(DiagLevel::Warning,
                     "\"SimpleTag\"-element contains multiple \"TagLanguage\"-elements. Surplus \"TagLanguage\"-elements will be ignored.", context);
             }
             break;
         case MatroskaIds::TagLanguageIETF:
             if (!tagLanguageIETFFound) {
                 tagLanguageIETFFound = true;
-                value().locale().emplace_back(child->readString(), LocaleFormat::BCP_47);
+                if (decodeValues) {
+                    value.locale().emplace_back(string(childData, childDataSize), LocaleFormat::BCP_47);
+                }
             } else {
-                diag.emplace_back(DiagLevel::Warning,
+                report(DiagLevel::Warning,
                     "\"SimpleTag\"-element contains multiple \"TagLanguageIETF\"-elements. Surplus \"TagLanguageIETF\"-elements will be ignored.",
                     context);
             }
             break;
         case MatroskaIds::TagDefault:
             if (!tagDefaultFound) {
-                setDefault(child->readUInteger() > 0);
                 tagDefaultFound = true;
+                if (decodeValues) {
+                    isDefault = EbmlHeaderDecoder::decodeUInteger(childData, childDataSize) > 0;
+                }
             } else {
-                diag.emplace_back(DiagLevel::Warning,
+                report(DiagLevel::Warning,
                     "\"SimpleTag\"-element contains multiple \"TagDefault\" elements. Surplus \"TagDefault\"-elements will be ignored.", context);
             }
             break;
         case MatroskaIds::SimpleTag:
             if (parseNestedFields) {
-                nestedFields().emplace_back();
-                nestedFields().back().reparse(*child, diag, true);
+                // decode nested fields into a temporary field if only indexing (so messages are still reported)
+                auto nestedField = MatroskaTagField();
+                auto nestedId = string();
+                auto nestedIsDefault = nestedField.isDefault();
+                decode(childData, childDataSize, dataOffset + childOffset + header.headerSize(), nestedId, nestedField.value(), nestedIsDefault,
+                    nestedField.nestedFields());
+                if (decodeValues) {
+                    nestedField.setId(nestedId);
+                    nestedField.setDefault(nestedIsDefault);
+                    nestedFields.emplace_back(std::move(nestedField));
+                }
             } else {
-                diag.emplace_back(DiagLevel::Warning,
+                report(DiagLevel::Warning,
                     "Nested fields are currently not supported. Nested tags can not be displayed and will be discarded when rewriting the file.",
                     context);
             }
@@ -131,12 +139,131 @@ void MatroskaTagField::reparse(EbmlElement &simpleTagElement, Diagnostics &diag,
         case EbmlIds::Void:
             break;
         default:
-            diag.emplace_back(DiagLevel::Warning,
-                argsToString(
-                    "\"SimpleTag\"-element contains unknown element ", child->idToString(), " at ", child->startOffset(), ". It will be ignored."),
+            report(DiagLevel::Warning,
+                argsToString("\"SimpleTag\"-element contains unknown element ", EbmlElement::idToString(header.id), " at ", dataOffset + childOffset,
+                    ". It will be ignored."),
                 context);
         }
     }
+    if (decoder.offset() < size) {
+        report(DiagLevel::Critical, "Unable to parse children of \"SimpleTag\"-element.", context);
+    }
+}
+
+/*!
+ * \brief Adds the specified message to the diagnostics (if any).
+ */
+void SimpleTagDecoder::report(DiagLevel level, std::string &&message, const std::string &context) const
+{
+    if (diag) {
+        diag->emplace_back(level, std::move(message), context);
+    }
+}
+
+/*!
+ * \brief Reads the specified \a simpleTagElement (including its header) into a buffer.
+ */
+std::string readSimpleTagElement(EbmlElement &simpleTagElement)
+{
+    auto buffer = std::string(static_cast<std::size_t>(simpleTagElement.totalSize()), '\0');
+    simpleTagElement.stream().seekg(static_cast<streamoff>(simpleTagElement.startOffset()));
+    simpleTagElement.stream().read(buffer.data(), static_cast<streamoff>(buffer.size()));
+    return buffer;
+}
+
+} // namespace
+/// \endcond
+
+/*!
+ * \brief Constructs a new MatroskaTagField.
+ */
+MatroskaTagField::MatroskaTagField()
+{
+}
+
+/*!
+ * \brief Constructs a new MatroskaTagField with the specified \a id and \a value.
+ */
+MatroskaTagField::MatroskaTagField(const string &id, const TagValue &value)
+    : TagField<MatroskaTagField>(id, value)
+{
+}
+
+/*!
+ * \brief Parses field information from the specified EbmlElement.
+ *
+ * The specified atom should be a simple tag element. These elements
+ * represents the fields of a MatroskaTag.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \throws Throws TagParser::Failure or a derived exception when a parsing
+ *         error occurs.
+ */
+void MatroskaTagField::reparse(EbmlElement &simpleTagElement, Diagnostics &diag, bool parseNestedFields)
+{
+    simpleTagElement.parse(diag);
+    m_simpleTagData.clear();
+    const auto buffer = readSimpleTagElement(simpleTagElement);
+    auto id = this->id();
+    auto isDefault = this->isDefault();
+    auto decoder = SimpleTagDecoder();
+    decoder.diag = &diag;
+    decoder.parseNestedFields = parseNestedFields;
+    decoder.decode(buffer.data() + simpleTagElement.headerSize(), static_cast<std::size_t>(simpleTagElement.dataSize()),
+        simpleTagElement.dataOffset(), id, value(), isDefault, nestedFields());
+    setId(id);
+    setDefault(isDefault);
+}
+
+/*!
+ * \brief Indexes the field from the specified \a simpleTagElement without decoding it.
+ *
+ * The element is buffered but only the "TagName"-element is decoded. The other children are decoded when the value,
+ * the language, the default flag or the nested fields are accessed. If none of them is accessed, the buffered element is
+ * copied verbatim when making the field. So the field does not refer to the element or the file after indexing.
+ *
+ * The field is cleared before. Diagnostic messages are reported when indexing as decoding the field later does not
+ * report any.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \throws Throws TagParser::Failure or a derived exception when a parsing
+ *         error occurs.
+ */
+void MatroskaTagField::index(EbmlElement &simpleTagElement, Diagnostics &diag)
+{
+    simpleTagElement.parse(diag);
+    auto buffer = readSimpleTagElement(simpleTagElement);
+    auto id = string();
+    auto isDefault = false;
+    auto value = TagValue();
+    auto nestedFields = vector<MatroskaTagField>();
+    auto decoder = SimpleTagDecoder();
+    decoder.diag = &diag;
+    decoder.decodeValues = false;
+    decoder.decode(buffer.data() + simpleTagElement.headerSize(), static_cast<std::size_t>(simpleTagElement.dataSize()),
+        simpleTagElement.dataOffset(), id, value, isDefault, nestedFields);
+    clear();
+    setId(id);
+    m_simpleTagData = std::move(buffer);
+}
+
+/*!
+ * \brief Decodes the buffered "SimpleTag"-element if the field has only been indexed so far.
+ * \remarks Invoked via the accessors of TagField.
+ */
+void MatroskaTagField::internallyDecode(TagValue &value, bool &isDefault, std::vector<MatroskaTagField> &nestedFields) const
+{
+    if (m_simpleTagData.empty()) {
+        return;
+    }
+    const auto buffer = std::move(m_simpleTagData);
+    m_simpleTagData.clear();
+    auto header = EbmlHeader();
+    if (EbmlHeaderDecoder::decode(buffer.data(), buffer.size(), header) != EbmlHeaderStatus::Ok) {
+        return;
+    }
+    auto id = this->id();
+    SimpleTagDecoder().decode(buffer.data() + header.headerSize(), buffer.size() - header.headerSize(), 0, id, value, isDefault, nestedFields);
 }
 
 /*!
@@ -189,10 +316,17 @@ void MatroskaTagField::make(ostream &stream, Diagnostics &diag)
  */
 MatroskaTagFieldMaker::MatroskaTagFieldMaker(MatroskaTagField &field, Diagnostics &diag)
     : m_field(field)
-    , m_language(m_field.value().locale().abbreviatedName(LocaleFormat::ISO_639_2_B, LocaleFormat::Unknown))
-    , m_languageIETF(m_field.value().locale().abbreviatedName(LocaleFormat::BCP_47))
+    , m_language(m_field.isDecoded() ? m_field.value().locale().abbreviatedName(LocaleFormat::ISO_639_2_B, LocaleFormat::Unknown)
+                                     : LocaleDetail::getEmpty())
+    , m_languageIETF(m_field.isDecoded() ? m_field.value().locale().abbreviatedName(LocaleFormat::BCP_47) : LocaleDetail::getEmpty())
     , m_isBinary(false)
 {
+    // copy fields which have not been decoded verbatim
+    if (!m_field.isDecoded()) {
+        m_simpleTagSize = m_totalSize = m_field.m_simpleTagData.size();
+        return;
+    }
+
     try {
         m_stringValue = m_field.value().toString();
     } catch (const ConversionException &) {
@@ -241,6 +375,11 @@ MatroskaTagFieldMaker::MatroskaTagFieldMaker(MatroskaTagField &field, Diagnostic
  */
 void MatroskaTagFieldMaker::make(ostream &stream) const
 {
+    // copy field which has not been decoded verbatim
+    if (!m_field.isDecoded()) {
+        stream.write(m_field.m_simpleTagData.data(), static_cast<streamsize>(m_field.m_simpleTagData.size()));
+        return;
+    }
     BinaryWriter writer(&stream);
     char buff[8];
     // write "SimpleTag" element
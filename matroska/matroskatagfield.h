@@ -66,12 +66,15 @@ inline std::uint64_t MatroskaTagFieldMaker::requiredSize() const
 
 class TAG_PARSER_EXPORT MatroskaTagField : public TagField<MatroskaTagField> {
     friend class TagField<MatroskaTagField>;
+    friend class MatroskaTagFieldMaker;
 
 public:
     MatroskaTagField();
     MatroskaTagField(const std::string &id, const TagValue &value);
 
     void reparse(EbmlElement &simpleTagElement, Diagnostics &diag, bool parseNestedFields = true);
+    void index(EbmlElement &simpleTagElement, Diagnostics &diag);
+    bool isDecoded() const;
     MatroskaTagFieldMaker prepareMaking(Diagnostics &diag);
     void make(std::ostream &stream, Diagnostics &diag);
     bool isAdditionalTypeInfoUsed() const;
@@ -82,8 +85,20 @@ public:
 
 private:
     void reset();
+    void internallyDecode(TagValue &value, bool &isDefault, std::vector<MatroskaTagField> &nestedFields) const;
+
+    mutable std::string m_simpleTagData;
 };
 
+/*!
+ * \brief Returns whether the value, the language, the default flag and the nested fields have been decoded.
+ * \remarks Fields which have been indexed via index() are not decoded until one of these is accessed.
+ */
+inline bool MatroskaTagField::isDecoded() const
+{
+    return m_simpleTagData.empty();
+}
+
 /*!
  * \brief Returns whether the additional type info is used.
  */
@@ -123,6 +138,7 @@ inline std::string MatroskaTagField::fieldIdToString(const std::string &id)
  */
 inline void MatroskaTagField::reset()
 {
+    m_simpleTagData.clear();
 }
 
 } // namespace TagParser
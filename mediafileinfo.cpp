@@ -1,9 +1,12 @@
 #include "./mediafileinfo.h"
 #include "./abstracttrack.h"
 #include "./backuphelper.h"
+#include "./coalescingstreambuffer.h"
 #include "./diagnostics.h"
 #include "./exceptions.h"
+#include "./fileallocator.h"
 #include "./locale.h"
+#include "./mediafilestatistics.h"
 #include "./progressfeedback.h"
 #include "./signature.h"
 #include "./tag.h"
@@ -90,12 +93,21 @@ MediaFileInfo::MediaFileInfo()
     , m_minPadding(0)
     , m_maxPadding(0)
     , m_preferredPadding(0)
+    , m_paddingPolicy(nullptr)
     , m_tagPosition(ElementPosition::BeforeData)
     , m_indexPosition(ElementPosition::BeforeData)
+    , m_indexGeneration(IndexGeneration::Never)
+    , m_rewriteStrategy(RewriteStrategy::BackupFile)
+    , m_sparsePaddingThreshold(0)
     , m_forceFullParse(MEDIAINFO_CPP_FORCE_FULL_PARSE)
     , m_forceRewrite(true)
     , m_forceTagPosition(true)
     , m_forceIndexPosition(true)
+    , m_preallocateOutput(false)
+    , m_copyAsynchronously(false)
+    , m_indexAllTracks(false)
+    , m_parseTagsLazily(false)
+    , m_parseSegmentsConcurrently(false)
 {
 }
 
@@ -117,12 +129,21 @@ MediaFileInfo::MediaFileInfo(const string &path)
     , m_minPadding(0)
     , m_maxPadding(0)
     , m_preferredPadding(0)
+    , m_paddingPolicy(nullptr)
     , m_tagPosition(ElementPosition::BeforeData)
     , m_indexPosition(ElementPosition::BeforeData)
+    , m_indexGeneration(IndexGeneration::Never)
+    , m_rewriteStrategy(RewriteStrategy::BackupFile)
+    , m_sparsePaddingThreshold(0)
     , m_forceFullParse(MEDIAINFO_CPP_FORCE_FULL_PARSE)
     , m_forceRewrite(true)
     , m_forceTagPosition(true)
     , m_forceIndexPosition(true)
+    , m_preallocateOutput(false)
+    , m_copyAsynchronously(false)
+    , m_indexAllTracks(false)
+    , m_parseTagsLazily(false)
+    , m_parseSegmentsConcurrently(false)
 {
 }
 
@@ -156,6 +177,7 @@ void MediaFileInfo::parseContainerFormat(Diagnostics &diag)
     }
 
     static const string context("parsing file header");
+    const auto timer = MediaFileStageTimer(m_statistics.get(), MediaFileStage::ContainerFormat);
     open(); // ensure the file is open
     m_containerFormat = ContainerFormat::Unknown;
 
@@ -244,6 +266,7 @@ startParsingSignature:
                     // validating the element structure of Matroska files takes too long when
                     // parsing big files so do this only when explicitely desired
                     container->validateElementStructure(diag, &m_paddingSize);
+                    container->validateChecksums(diag);
                     container->validateIndex(diag);
                 }
             } catch (const Failure &) {
@@ -311,6 +334,7 @@ void MediaFileInfo::parseTracks(Diagnostics &diag)
         return;
     }
     static const string context("parsing tracks");
+    const auto timer = MediaFileStageTimer(m_statistics.get(), MediaFileStage::Tracks);
 
     try {
         // parse tracks via container object
@@ -382,6 +406,7 @@ void MediaFileInfo::parseTags(Diagnostics &diag)
         return;
     }
     static const string context("parsing tag");
+    const auto timer = MediaFileStageTimer(m_statistics.get(), MediaFileStage::Tags);
 
     // check for ID3v1 tag
     if (size() >= 128) {
@@ -464,6 +489,7 @@ void MediaFileInfo::parseChapters(Diagnostics &diag)
         return;
     }
     static const string context("parsing chapters");
+    const auto timer = MediaFileStageTimer(m_statistics.get(), MediaFileStage::Chapters);
 
     try {
         // parse chapters via container object
@@ -499,6 +525,7 @@ void MediaFileInfo::parseAttachments(Diagnostics &diag)
         return;
     }
     static const string context("parsing attachments");
+    const auto timer = MediaFileStageTimer(m_statistics.get(), MediaFileStage::Attachments);
 
     try {
         // parse attachments via container object
@@ -656,22 +683,202 @@ bool MediaFileInfo::createAppropriateTags(const TagCreationSettings &settings)
  * Depending on the changes to be applied the file will be rewritten.
  *
  * When the file needs to be rewritten it will be renamed. A new file with the old name
- * will be created to replace the old file.
+ * will be created to replace the old file. Alternatively, the file can be written to a temporary
+ * file which replaces the old file when complete (see setRewriteStrategy()).
  *
  * \throws Throws std::ios_base::failure when an IO error occurs.
  * \throws Throws TagParser::Failure or a derived exception when a making error occurs.
  *
- * \remarks Tags and tracks need to be parsed without errors before this method can be called.
- *          All previous parsing results are cleared (using clearParsingResults()). Hence
- *          the file must be reparsed. All related objects (tags, tracks, ...) might get invalidated.
- *          This includes notifications of these objects as well.
+ * \remarks
+ * - Tags and tracks need to be parsed without errors before this method can be called.
+ * - All related objects (tags, tracks, ...) might get invalidated. This includes notifications of these
+ *   objects as well. Hence the file must be parsed again.
+ * - If the container has re-parsed the new file when writing it (Matroska and MP4), the container format
+ *   and header remain parsed. So parsing tags, tracks, chapters and attachments again only reads those
+ *   from the new file. Otherwise, all previous parsing results are cleared (using clearParsingResults())
+ *   and the file must be parsed again entirely.
  *
  * \sa clearParsingResults()
  */
 void MediaFileInfo::applyChanges(Diagnostics &diag, AbortableProgressFeedback &progress)
 {
     static const string context("making file");
+    const auto timer = MediaFileStageTimer(m_statistics.get(), MediaFileStage::ApplyChanges);
     diag.emplace_back(DiagLevel::Information, "Changes are about to be applied.", context);
+    ensurePreviousParsingSuccessful(diag, context);
+    // the makers reopen the stream directly so the read cache can not be used anymore
+    suspendReadCache();
+    m_rewritePadding.reset();
+    // write to a temporary file replacing the original file when done if configured; the makers handle this like a "save file path"
+    const auto useTemporaryFile = m_rewriteStrategy != RewriteStrategy::BackupFile && m_saveFilePath.empty();
+    const auto originalPath = useTemporaryFile ? path() : string();
+    auto temporaryPath = string();
+    if (useTemporaryFile) {
+        try {
+            temporaryPath = BackupHelper::createTemporaryFile(originalPath);
+        } catch (const std::ios_base::failure &failure) {
+            diag.emplace_back(DiagLevel::Critical, argsToString("Creation of temporary file (to rewrite the original file) failed: ", failure.what()), context);
+            throw;
+        }
+        m_saveFilePath = temporaryPath;
+    }
+    try {
+        if (m_container) { // container object takes care
+            // ID3 tags can not be applied in this case -> add warnings if ID3 tags have been assigned
+            if (hasId3v1Tag()) {
+                diag.emplace_back(DiagLevel::Warning, "Assigned ID3v1 tag can't be attached and will be ignored.", context);
+            }
+            if (hasId3v2Tag()) {
+                diag.emplace_back(DiagLevel::Warning, "Assigned ID3v2 tag can't be attached and will be ignored.", context);
+            }
+            m_tracksParsingStatus = ParsingStatus::NotParsedYet;
+            m_tagsParsingStatus = ParsingStatus::NotParsedYet;
+            const auto makeFileTimer = MediaFileStageTimer(m_statistics.get(), MediaFileStage::MakeFile);
+            m_container->makeFile(diag, progress);
+        } else { // implementation if no container object is present
+            // assume the file is a MP3 file
+            const auto makeFileTimer = MediaFileStageTimer(m_statistics.get(), MediaFileStage::MakeFile);
+            makeMp3File(diag, progress);
+        }
+        if (useTemporaryFile) {
+            close();
+            try {
+                BackupHelper::replaceOriginalFile(originalPath, temporaryPath, m_rewriteStrategy == RewriteStrategy::TemporaryFileWithSync, diag, context);
+            } catch (const std::ios_base::failure &failure) {
+                diag.emplace_back(DiagLevel::Critical, argsToString("Unable to replace the original file with the temporary file: ", failure.what()), context);
+                throw;
+            }
+            reportPathChanged(originalPath);
+            // reopen the stream without invalidating (rather than via open()) so the parsing results of the new file can be kept
+            if (m_container && m_container->appliedChanges().has_value()) {
+                reopenStream(false);
+            }
+        }
+    } catch (...) {
+        // since the file might be messed up, invalidate the parsing results
+        clearParsingResults();
+        // the original file has not been touched when using a temporary file -> just get rid of the temporary file
+        if (useTemporaryFile) {
+            close();
+            std::remove(BasicFileInfo::pathForOpen(temporaryPath));
+            reportPathChanged(originalPath);
+            m_saveFilePath.clear();
+        }
+        throw;
+    }
+    // let the padding policy know about the rewrite
+    if (m_paddingPolicy && m_rewritePadding.has_value()) {
+        m_paddingPolicy->recordRewrite(m_rewritePaddingContext, m_rewritePadding.value());
+    }
+    if (!keepParsingResultsOfNewFile()) {
+        clearParsingResults();
+    }
+}
+
+/*!
+ * \brief Keeps the parsing results the container has obtained by re-parsing the file after applying changes.
+ *
+ * The container format and the header remain parsed. The tracks remain parsed if the container has re-parsed
+ * them as well. Tags, chapters and attachments are marked as not parsed so they are read from the new file
+ * again when requested. ID3 tags are not written along with a container so they are discarded.
+ *
+ * \returns Returns whether the parsing results could be kept; if not, clearParsingResults() must be called.
+ */
+bool MediaFileInfo::keepParsingResultsOfNewFile()
+{
+    if (!m_container || m_containerOffset || !m_container->appliedChanges().has_value() || !stream().is_open()) {
+        return false;
+    }
+    m_paddingSize = m_container->appliedChanges()->newPadding;
+    m_tracksParsingStatus = m_container->areTracksParsed() ? ParsingStatus::Ok : ParsingStatus::NotParsedYet;
+    m_tagsParsingStatus = ParsingStatus::NotParsedYet;
+    m_chaptersParsingStatus = ParsingStatus::NotParsedYet;
+    m_attachmentsParsingStatus = ParsingStatus::NotParsedYet;
+    m_id3v1Tag.reset();
+    m_id3v2Tags.clear();
+    m_actualId3v2TagOffsets.clear();
+    m_actualExistingId3v1Tag = false;
+    return true;
+}
+
+/*!
+ * \brief Determines how applyChanges() would apply assigned/changed tag information without modifying the file.
+ *
+ * Only the size and layout calculation of applyChanges() is done. So it can be checked beforehand whether the
+ * file would be rewritten entirely, which padding and tag/index positions the new file would have and roughly
+ * how much data would be written.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \throws Throws TagParser::Failure or a derived exception when a making error occurs; throws
+ *         TagParser::NotImplementedException if the container format does not support making files.
+ *
+ * \remarks
+ * - Tags and tracks need to be parsed without errors before this method can be called.
+ * - In contrast to applyChanges(), the parsing results remain valid. However, calculating the layout might
+ *   parse and buffer further elements of the file.
+ * - The settings (e.g. padding, tag position, rewrite strategy) are taken into account as applyChanges() would do.
+ *
+ * \sa ChangesPlan
+ */
+ChangesPlan MediaFileInfo::planChanges(Diagnostics &diag, AbortableProgressFeedback &progress)
+{
+    static const string context("planning changes");
+    ensurePreviousParsingSuccessful(diag, context);
+    // pretend a "save file path" is set when applyChanges() would write to a temporary file (which always means rewriting)
+    const auto pretendTemporaryFile = m_rewriteStrategy != RewriteStrategy::BackupFile && m_saveFilePath.empty();
+    if (pretendTemporaryFile) {
+        m_saveFilePath = path();
+    }
+    auto plan = ChangesPlan();
+    try {
+        if (m_container) {
+            plan = m_container->planChanges(diag, progress);
+        } else {
+            makeMp3File(diag, progress, &plan);
+        }
+    } catch (...) {
+        if (pretendTemporaryFile) {
+            m_saveFilePath.clear();
+        }
+        m_rewritePadding.reset();
+        throw;
+    }
+    if (pretendTemporaryFile) {
+        m_saveFilePath.clear();
+    }
+    m_rewritePadding.reset();
+    return plan;
+}
+
+/*!
+ * \brief Returns the padding to be used because the file needs to be rewritten.
+ *
+ * Consults the paddingPolicy() if one is assigned; otherwise returns preferredPadding().
+ *
+ * \param tagsSize Specifies the size of the new tags (and other metadata written along with the tags).
+ * \remarks This method is internally used by the makers and only meaningful while applying changes.
+ */
+std::uint64_t MediaFileInfo::paddingForRewrite(std::uint64_t tagsSize)
+{
+    if (!m_paddingPolicy) {
+        return m_preferredPadding;
+    }
+    m_rewritePaddingContext.path = path();
+    m_rewritePaddingContext.containerFormat = m_containerFormat;
+    m_rewritePaddingContext.fileSize = size();
+    m_rewritePaddingContext.tagsSize = tagsSize;
+    m_rewritePaddingContext.minPadding = m_minPadding;
+    m_rewritePaddingContext.maxPadding = m_maxPadding;
+    m_rewritePaddingContext.preferredPadding = m_preferredPadding;
+    return m_rewritePadding.emplace(m_paddingPolicy->padding(m_rewritePaddingContext));
+}
+
+/*!
+ * \brief Ensures tags and tracks have been parsed without critical errors as required to make the file.
+ * \throws Throws TagParser::InvalidDataException if that is not the case.
+ */
+void MediaFileInfo::ensurePreviousParsingSuccessful(Diagnostics &diag, const std::string &context) const
+{
     bool previousParsingSuccessful = true;
     switch (tagsParsingStatus()) {
     case ParsingStatus::Ok:
@@ -692,34 +899,6 @@ void MediaFileInfo::applyChanges(Diagnostics &diag, AbortableProgressFeedback &p
     if (!previousParsingSuccessful) {
         throw InvalidDataException();
     }
-    if (m_container) { // container object takes care
-        // ID3 tags can not be applied in this case -> add warnings if ID3 tags have been assigned
-        if (hasId3v1Tag()) {
-            diag.emplace_back(DiagLevel::Warning, "Assigned ID3v1 tag can't be attached and will be ignored.", context);
-        }
-        if (hasId3v2Tag()) {
-            diag.emplace_back(DiagLevel::Warning, "Assigned ID3v2 tag can't be attached and will be ignored.", context);
-        }
-        m_tracksParsingStatus = ParsingStatus::NotParsedYet;
-        m_tagsParsingStatus = ParsingStatus::NotParsedYet;
-        try {
-            m_container->makeFile(diag, progress);
-        } catch (...) {
-            // since the file might be messed up, invalidate the parsing results
-            clearParsingResults();
-            throw;
-        }
-    } else { // implementation if no container object is present
-        // assume the file is a MP3 file
-        try {
-            makeMp3File(diag, progress);
-        } catch (...) {
-            // since the file might be messed up, invalidate the parsing results
-            clearParsingResults();
-            throw;
-        }
-    }
-    clearParsingResults();
 }
 
 /*!
@@ -1503,6 +1682,31 @@ vector<Tag *> MediaFileInfo::tags() const
     return res;
 }
 
+/*!
+ * \brief Sets whether statistics about parsing and making the file should be recorded.
+ *
+ * When enabled, the I/O operations on the stream(), the number of parsed elements and the wall time of the
+ * stages listed in MediaFileStage are recorded in the MediaFileStatistics returned by statistics(). Set
+ * MediaFileStatistics::recordTraceEvents to additionally record each stage invocation, e.g. to export
+ * them via MediaFileStatistics::toChromeTraceJson().
+ *
+ * \remarks
+ * - Recording statistics is disabled by default. Then only a null-check per stage and parsed element is done.
+ * - Disabling recording statistics discards the statistics recorded so far.
+ */
+void MediaFileInfo::setStatisticsEnabled(bool statisticsEnabled)
+{
+    if (!statisticsEnabled) {
+        setIoStatistics(nullptr);
+        m_statistics.reset();
+        return;
+    }
+    if (!m_statistics) {
+        m_statistics = make_unique<MediaFileStatistics>();
+        setIoStatistics(&m_statistics->io);
+    }
+}
+
 /*!
  * \brief Reimplemented from BasicFileInfo::invalidated().
  */
@@ -1514,14 +1718,21 @@ void MediaFileInfo::invalidated()
 
 /*!
  * \brief Internally used to save chanings of MP3/FLAC files and any other files which might have ID3 tags.
+ * \remarks If \a plan is specified, it is only populated and the file is not modified.
  */
-void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &progress)
+void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &progress, ChangesPlan *plan)
 {
     static const string context("making MP3/FLAC file");
 
     // don't rewrite the complete file if there are no ID3v2/FLAC tags present or to be written
     if (!isForcingRewrite() && m_id3v2Tags.empty() && m_actualId3v2TagOffsets.empty() && m_saveFilePath.empty()
         && m_containerFormat != ContainerFormat::Flac) {
+        // only report that the ID3v1 tag would be altered in-place if only planning
+        if (plan) {
+            plan->tagPosition = m_id3v1Tag || m_actualExistingId3v1Tag ? ElementPosition::AfterData : ElementPosition::Keep;
+            plan->bytesToWrite = m_id3v1Tag ? 128 : 0;
+            return;
+        }
         // alter ID3v1 tag
         if (!m_id3v1Tag) {
             // remove ID3v1 tag
@@ -1545,11 +1756,18 @@ void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &pr
                 // ensure the file is still open / not readonly
                 open();
                 stream().seekp(-128, ios_base::end);
+                // leave the file untouched if the tag has not been changed
+                auto coalescingWriteScope = CoalescingWriteScope(stream());
+                coalescingWriteScope.setSkipUnchangedData(true);
                 try {
                     m_id3v1Tag->make(stream(), diag);
                 } catch (const Failure &) {
                     diag.emplace_back(DiagLevel::Warning, "Unable to write ID3v1 tag.", context);
                 }
+                coalescingWriteScope.finish();
+                if (!coalescingWriteScope.bytesWritten()) {
+                    diag.emplace_back(DiagLevel::Information, "Nothing to be changed; the ID3v1 tag is identical to the one in the file.", context);
+                }
             } else {
                 progress.updateStep("Adding new ID3v1 tag ...");
                 // ensure the file is still open / not readonly
@@ -1620,12 +1838,12 @@ void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &pr
         }
     } else if (rewriteRequired) {
         // rewriting is forced or new ID3v2 tag is too big for available space
-        // -> use preferred padding when rewriting anyways
-        padding = preferredPadding();
+        // -> use preferred padding (or the padding determined by the padding policy) when rewriting anyways
+        padding = static_cast<std::size_t>(paddingForRewrite(tagsSize));
     } else if (makers.empty() && flacStream && padding && padding < 4) {
         // no ID3v2 tag -> must include padding in FLAC stream
         // but padding of 1, 2, and 3 byte isn't possible -> need to rewrite
-        padding = preferredPadding();
+        padding = static_cast<std::size_t>(paddingForRewrite(tagsSize));
         rewriteRequired = true;
     }
     if (rewriteRequired && flacStream && makers.empty() && padding) {
@@ -1633,6 +1851,22 @@ void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &pr
         // can not be used for additional meta data
         padding += 4;
     }
+
+    // determine the number of bytes to be written: tags and padding are always written, media data only when rewriting
+    auto bytesToWrite = tagsSize + padding + (m_id3v1Tag ? 128 : 0);
+    if (rewriteRequired) {
+        bytesToWrite += size() - streamOffset - (m_actualExistingId3v1Tag ? 128 : 0);
+    }
+
+    // report the calculated layout without modifying the file if only planning
+    if (plan) {
+        plan->rewriteRequired = rewriteRequired;
+        plan->newPadding = padding;
+        plan->tagPosition = ElementPosition::BeforeData;
+        plan->bytesToWrite = bytesToWrite;
+        return;
+    }
+
     progress.updateStep(rewriteRequired ? "Preparing streams for rewriting ..." : "Preparing streams for updating ...");
 
     // setup stream(s) for writing
@@ -1640,12 +1874,14 @@ void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &pr
     string backupPath;
     NativeFileStream &outputStream = stream();
     NativeFileStream backupStream; // create a stream to open the backup/original file for the case rewriting the file is required
+    auto allocator = FileAllocator(); // manages the disk space of the new file when rewriting
 
     if (rewriteRequired) {
         if (m_saveFilePath.empty()) {
             // move current file to temp dir and reopen it as backupStream, recreate original file
             try {
-                BackupHelper::createBackupFile(backupDirectory(), path(), backupPath, outputStream, backupStream);
+                const auto backupTimer = MediaFileStageTimer(m_statistics.get(), MediaFileStage::Backup);
+                BackupHelper::createBackupFile(backupDirectory(), path(), backupPath, outputStream, backupStream, &progress);
                 // recreate original file, define buffer variables
                 outputStream.open(BasicFileInfo::pathForOpen(path()), ios_base::out | ios_base::binary | ios_base::trunc);
             } catch (const std::ios_base::failure &failure) {
@@ -1666,6 +1902,12 @@ void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &pr
             }
         }
 
+        // reserve the disk space for the new file; padding exceeding the configured threshold is left as hole
+        allocator = FileAllocator(m_saveFilePath.empty() ? path() : m_saveFilePath, m_sparsePaddingThreshold);
+        if (m_preallocateOutput) {
+            allocator.preallocate(bytesToWrite);
+        }
+
     } else { // !rewriteRequired
         // reopen original file to ensure it is opened for writing
         try {
@@ -1680,6 +1922,11 @@ void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &pr
 
     // start actual writing
     try {
+        // stage the many small writes of the makers to pass them to the file in big chunks
+        // -> skip data which is already present when updating in-place so the file is not touched if nothing changes
+        auto coalescingWriteScope = CoalescingWriteScope(outputStream);
+        coalescingWriteScope.setSkipUnchangedData(!rewriteRequired);
+
         // ensure we can cast padding safely to uint32
         if (padding > numeric_limits<std::uint32_t>::max()) {
             padding = numeric_limits<std::uint32_t>::max();
@@ -1711,15 +1958,13 @@ void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &pr
 
             // write padding
             if (padding) {
-                flacStream->makePadding(outputStream, static_cast<std::uint32_t>(padding), true, diag);
+                flacStream->makePadding(outputStream, static_cast<std::uint32_t>(padding), true, diag, &allocator);
             }
         }
 
         if (makers.empty() && !flacStream) {
             // just write padding (however, padding should be set to 0 in this case?)
-            for (; padding; --padding) {
-                outputStream.put(0);
-            }
+            allocator.writeZeroes(outputStream, padding);
         }
 
         // copy / skip actual stream data
@@ -1757,6 +2002,12 @@ void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &pr
             }
         }
 
+        // write staged data (before the stream is closed)
+        coalescingWriteScope.finish();
+        if (!rewriteRequired && !coalescingWriteScope.bytesWritten()) {
+            diag.emplace_back(DiagLevel::Information, "Nothing to be changed; the serialized tags are identical to the data in the file.", context);
+        }
+
         // handle streams
         if (rewriteRequired) {
             // report new size
@@ -1769,6 +2020,7 @@ void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &pr
             // prevent deferring final write operations (to catch and handle possible errors here); stream is useless for further
             // usage anyways because it is write-only
             outputStream.close();
+            allocator.releaseUnusedSpace(size());
         } else {
             const auto newSize = static_cast<std::uint64_t>(outputStream.tellp());
             if (newSize < size()) {
@@ -1791,7 +2043,7 @@ void MediaFileInfo::makeMp3File(Diagnostics &diag, AbortableProgressFeedback &pr
         }
 
     } catch (...) {
-        BackupHelper::handleFailureAfterFileModified(*this, backupPath, outputStream, backupStream, diag, context);
+        BackupHelper::handleFailureAfterFileModified(*this, backupPath, outputStream, backupStream, diag, &progress, context);
     }
 }
 
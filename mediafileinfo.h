@@ -3,11 +3,13 @@
 
 #include "./abstractcontainer.h"
 #include "./basicfileinfo.h"
+#include "./paddingpolicy.h"
 #include "./settings.h"
 #include "./signature.h"
 
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <unordered_set>
 #include <vector>
 
@@ -27,6 +29,7 @@ class AbstractTrack;
 class VorbisComment;
 class Diagnostics;
 class AbortableProgressFeedback;
+struct MediaFileStatistics;
 
 enum class MediaType : unsigned int;
 enum class TagType : unsigned int;
@@ -61,6 +64,7 @@ public:
 
     // methods to apply changes
     void applyChanges(Diagnostics &diag, AbortableProgressFeedback &progress);
+    ChangesPlan planChanges(Diagnostics &diag, AbortableProgressFeedback &progress);
 
     // methods to get parsed information regarding ...
     // ... the container
@@ -133,12 +137,23 @@ public:
     void setForceFullParse(bool forceFullParse);
     bool isForcingRewrite() const;
     void setForceRewrite(bool forceRewrite);
+    RewriteStrategy rewriteStrategy() const;
+    void setRewriteStrategy(RewriteStrategy rewriteStrategy);
+    bool isPreallocatingOutput() const;
+    void setPreallocateOutput(bool preallocateOutput);
+    bool isCopyingAsynchronously() const;
+    void setCopyAsynchronously(bool copyAsynchronously);
+    std::uint64_t sparsePaddingThreshold() const;
+    void setSparsePaddingThreshold(std::uint64_t sparsePaddingThreshold);
     std::size_t minPadding() const;
     void setMinPadding(std::size_t minPadding);
     std::size_t maxPadding() const;
     void setMaxPadding(std::size_t maxPadding);
     std::size_t preferredPadding() const;
     void setPreferredPadding(std::size_t preferredPadding);
+    PaddingPolicy *paddingPolicy() const;
+    void setPaddingPolicy(PaddingPolicy *paddingPolicy);
+    std::uint64_t paddingForRewrite(std::uint64_t tagsSize);
     ElementPosition tagPosition() const;
     void setTagPosition(ElementPosition tagPosition);
     bool forceTagPosition() const;
@@ -147,6 +162,16 @@ public:
     void setIndexPosition(ElementPosition indexPosition);
     bool forceIndexPosition() const;
     void setForceIndexPosition(bool forceTagPosition);
+    IndexGeneration indexGeneration() const;
+    void setIndexGeneration(IndexGeneration indexGeneration);
+    bool isIndexingAllTracks() const;
+    void setIndexAllTracks(bool indexAllTracks);
+    bool isParsingTagsLazily() const;
+    void setParseTagsLazily(bool parseTagsLazily);
+    bool isParsingSegmentsConcurrently() const;
+    void setParseSegmentsConcurrently(bool parseSegmentsConcurrently);
+    MediaFileStatistics *statistics() const;
+    void setStatisticsEnabled(bool statisticsEnabled);
 
 protected:
     void invalidated() override;
@@ -155,7 +180,9 @@ private:
     // private methods internally used when rewriting the file to apply new tag information
     // currently only the makeMp3File() methods is present; corresponding methods for
     // other formats are outsourced to container classes
-    void makeMp3File(Diagnostics &diag, AbortableProgressFeedback &progress);
+    void makeMp3File(Diagnostics &diag, AbortableProgressFeedback &progress, ChangesPlan *plan = nullptr);
+    void ensurePreviousParsingSuccessful(Diagnostics &diag, const std::string &context) const;
+    bool keepParsingResultsOfNewFile();
 
     // fields related to the container
     ParsingStatus m_containerParsingStatus;
@@ -186,12 +213,24 @@ private:
     std::size_t m_minPadding;
     std::size_t m_maxPadding;
     std::size_t m_preferredPadding;
+    PaddingPolicy *m_paddingPolicy;
+    PaddingContext m_rewritePaddingContext;
+    std::optional<std::uint64_t> m_rewritePadding;
     ElementPosition m_tagPosition;
     ElementPosition m_indexPosition;
+    IndexGeneration m_indexGeneration;
+    RewriteStrategy m_rewriteStrategy;
+    std::uint64_t m_sparsePaddingThreshold;
     bool m_forceFullParse;
     bool m_forceRewrite;
     bool m_forceTagPosition;
     bool m_forceIndexPosition;
+    bool m_preallocateOutput;
+    bool m_copyAsynchronously;
+    bool m_indexAllTracks;
+    bool m_parseTagsLazily;
+    bool m_parseSegmentsConcurrently;
+    std::unique_ptr<MediaFileStatistics> m_statistics;
 };
 
 /*!
@@ -473,6 +512,104 @@ inline void MediaFileInfo::setForceRewrite(bool forceRewrite)
     m_forceRewrite = forceRewrite;
 }
 
+/*!
+ * \brief Returns how the file is rewritten when applying changes.
+ * \sa setRewriteStrategy()
+ */
+inline RewriteStrategy MediaFileInfo::rewriteStrategy() const
+{
+    return m_rewriteStrategy;
+}
+
+/*!
+ * \brief Sets how the file is rewritten when applying changes.
+ *
+ * By default, RewriteStrategy::BackupFile is used which allows updating the file in-place if there is enough
+ * padding. When using RewriteStrategy::TemporaryFile or RewriteStrategy::TemporaryFileWithSync, the file is always
+ * rewritten (as if a saveFilePath() was set) so other processes reading the file never observe a partially
+ * written file and the original file is left untouched if applying changes fails.
+ *
+ * \remarks Has no effect if a saveFilePath() has been set.
+ */
+inline void MediaFileInfo::setRewriteStrategy(RewriteStrategy rewriteStrategy)
+{
+    m_rewriteStrategy = rewriteStrategy;
+}
+
+/*!
+ * \brief Returns whether the disk space for rewritten files is reserved upfront when applying changes.
+ *
+ * The size of the new file is known from the size calculation done before writing. Reserving the space
+ * upfront avoids fragmenting large files which would otherwise be extended through many appends.
+ *
+ * This is disabled by default; consider enabling it when rewriting large files. It has no effect if not supported
+ * by the platform or file system.
+ *
+ * \sa FileAllocator
+ */
+inline bool MediaFileInfo::isPreallocatingOutput() const
+{
+    return m_preallocateOutput;
+}
+
+/*!
+ * \brief Sets whether the disk space for rewritten files is reserved upfront when applying changes.
+ * \sa isPreallocatingOutput()
+ */
+inline void MediaFileInfo::setPreallocateOutput(bool preallocateOutput)
+{
+    m_preallocateOutput = preallocateOutput;
+}
+
+/*!
+ * \brief Returns whether the media data is copied asynchronously when rewriting the file.
+ *
+ * The data is then copied in big chunks by background threads (using io_uring on Linux) while the new headers
+ * are written. This reduces the time spent on rewriting big files, especially on fast storage.
+ *
+ * This is disabled by default. It is only used by the Matroska, MP4 and Ogg implementations.
+ *
+ * \sa CopyEngine
+ */
+inline bool MediaFileInfo::isCopyingAsynchronously() const
+{
+    return m_copyAsynchronously;
+}
+
+/*!
+ * \brief Sets whether the media data is copied asynchronously when rewriting the file.
+ * \sa isCopyingAsynchronously()
+ */
+inline void MediaFileInfo::setCopyAsynchronously(bool copyAsynchronously)
+{
+    m_copyAsynchronously = copyAsynchronously;
+}
+
+/*!
+ * \brief Returns the min. size of padding which is left as hole in rewritten files rather than being written.
+ *
+ * Holes read as zeroes but occupy no disk blocks. So multi-MB padding costs neither write bandwidth nor disk space
+ * until it is filled. Padding is only left as hole when rewriting the file; when updating the file in-place it is
+ * written as usual.
+ *
+ * The default value is 0 which means padding is always written.
+ *
+ * \sa FileAllocator
+ */
+inline std::uint64_t MediaFileInfo::sparsePaddingThreshold() const
+{
+    return m_sparsePaddingThreshold;
+}
+
+/*!
+ * \brief Sets the min. size of padding which is left as hole in rewritten files rather than being written.
+ * \sa sparsePaddingThreshold()
+ */
+inline void MediaFileInfo::setSparsePaddingThreshold(std::uint64_t sparsePaddingThreshold)
+{
+    m_sparsePaddingThreshold = sparsePaddingThreshold;
+}
+
 /*!
  * \brief Returns the minimum padding to be written before the data blocks when applying changes.
  *
@@ -549,6 +686,29 @@ inline void MediaFileInfo::setPreferredPadding(std::size_t preferredPadding)
     m_preferredPadding = preferredPadding;
 }
 
+/*!
+ * \brief Returns the policy determining the padding when the file needs to be rewritten anyways.
+ * \remarks If no policy is set (the default), preferredPadding() is used.
+ * \sa setPaddingPolicy()
+ */
+inline PaddingPolicy *MediaFileInfo::paddingPolicy() const
+{
+    return m_paddingPolicy;
+}
+
+/*!
+ * \brief Sets the policy determining the padding when the file needs to be rewritten anyways.
+ * \remarks
+ * - The policy is not owned by the MediaFileInfo and must be valid as long as it is assigned. It can be shared
+ *   among multiple MediaFileInfo objects.
+ * - This value might be ignored if not supported by the container/tag format or the corresponding implementation.
+ * \sa paddingPolicy()
+ */
+inline void MediaFileInfo::setPaddingPolicy(PaddingPolicy *paddingPolicy)
+{
+    m_paddingPolicy = paddingPolicy;
+}
+
 /*!
  * \brief Returns the position (in the output file) where the tag information is written when applying changes.
  * \sa setTagPosition()
@@ -634,6 +794,113 @@ inline void MediaFileInfo::setForceIndexPosition(bool forceIndexPosition)
     m_forceIndexPosition = forceIndexPosition;
 }
 
+/*!
+ * \brief Returns whether the index is generated when applying changes.
+ *
+ * A generated index is built by scanning the headers of the blocks of the media data for keyframes; the payload is
+ * not read. It is written at indexPosition(). This allows players to seek quickly in files which have no index.
+ *
+ * The default value is IndexGeneration::Never. Generating the index is currently only supported by the Matroska
+ * implementation.
+ *
+ * \sa isIndexingAllTracks()
+ */
+inline IndexGeneration MediaFileInfo::indexGeneration() const
+{
+    return m_indexGeneration;
+}
+
+/*!
+ * \brief Sets whether the index is generated when applying changes.
+ * \sa indexGeneration()
+ */
+inline void MediaFileInfo::setIndexGeneration(IndexGeneration indexGeneration)
+{
+    m_indexGeneration = indexGeneration;
+}
+
+/*!
+ * \brief Returns whether a generated index covers all tracks.
+ *
+ * By default, only the keyframes of video tracks are indexed (or the blocks of all tracks if there is no video track).
+ *
+ * \sa indexGeneration()
+ */
+inline bool MediaFileInfo::isIndexingAllTracks() const
+{
+    return m_indexAllTracks;
+}
+
+/*!
+ * \brief Sets whether a generated index covers all tracks.
+ * \sa isIndexingAllTracks()
+ */
+inline void MediaFileInfo::setIndexAllTracks(bool indexAllTracks)
+{
+    m_indexAllTracks = indexAllTracks;
+}
+
+/*!
+ * \brief Returns whether tags are parsed lazily.
+ *
+ * When parsing lazily, the fields are buffered but only the targets and the names of the fields are decoded when parsing
+ * the tags. The value, the language and the nested fields of a field are decoded when accessed (so accessing fields is
+ * not thread-safe even via const references). Fields which are not accessed are copied verbatim when applying changes.
+ * This speeds up parsing files containing many tags (e.g. per chapter and per track).
+ *
+ * The default value is false. Parsing tags lazily is currently only supported by the Matroska implementation.
+ */
+inline bool MediaFileInfo::isParsingTagsLazily() const
+{
+    return m_parseTagsLazily;
+}
+
+/*!
+ * \brief Sets whether tags are parsed lazily.
+ * \remarks Must be set before parsing the tags to take effect.
+ * \sa isParsingTagsLazily()
+ */
+inline void MediaFileInfo::setParseTagsLazily(bool parseTagsLazily)
+{
+    m_parseTagsLazily = parseTagsLazily;
+}
+
+/*!
+ * \brief Returns whether the segments are parsed concurrently.
+ *
+ * When enabled and the file consists of multiple segments, the boundaries of all segments are determined first. Then the
+ * segments are parsed concurrently, each one using its own stream and element tree. This includes the tracks, tags,
+ * chapters and attachments within them; messages emitted when parsing these are therefore reported when parsing the
+ * container format. The results are merged in the order of the segments so they do not depend on the scheduling. Unlike
+ * the sequential parsing, all segments are taken into account (and not only the segments up to the one where all
+ * relevant information has been found).
+ *
+ * The default value is false. Parsing segments concurrently is currently only supported by the Matroska implementation.
+ */
+inline bool MediaFileInfo::isParsingSegmentsConcurrently() const
+{
+    return m_parseSegmentsConcurrently;
+}
+
+/*!
+ * \brief Sets whether the segments are parsed concurrently.
+ * \remarks Must be set before parsing the container format to take effect.
+ * \sa isParsingSegmentsConcurrently()
+ */
+inline void MediaFileInfo::setParseSegmentsConcurrently(bool parseSegmentsConcurrently)
+{
+    m_parseSegmentsConcurrently = parseSegmentsConcurrently;
+}
+
+/*!
+ * \brief Returns the statistics recorded so far or nullptr if recording statistics is not enabled.
+ * \sa setStatisticsEnabled()
+ */
+inline MediaFileStatistics *MediaFileInfo::statistics() const
+{
+    return m_statistics.get();
+}
+
 } // namespace TagParser
 
 #endif // TAG_PARSER_MEDIAINFO_H
@@ -0,0 +1,96 @@
+#include "./mediafilestatistics.h"
+
+#include <c++utilities/conversion/stringconversion.h>
+
+using namespace std;
+using namespace CppUtilities;
+
+namespace TagParser {
+
+/*!
+ * \brief Returns the name of the specified \a stage.
+ */
+const char *mediaFileStageName(MediaFileStage stage)
+{
+    switch (stage) {
+    case MediaFileStage::ContainerFormat:
+        return "parsing container format";
+    case MediaFileStage::Tracks:
+        return "parsing tracks";
+    case MediaFileStage::Tags:
+        return "parsing tags";
+    case MediaFileStage::Chapters:
+        return "parsing chapters";
+    case MediaFileStage::Attachments:
+        return "parsing attachments";
+    case MediaFileStage::ApplyChanges:
+        return "applying changes";
+    case MediaFileStage::MakeFile:
+        return "making file";
+    case MediaFileStage::Backup:
+        return "creating backup file";
+    default:
+        return "";
+    }
+}
+
+/*!
+ * \brief Resets all counters, timings and trace events and sets the referenceTime to the current time.
+ * \remarks Whether trace events are recorded is preserved.
+ */
+void MediaFileStatistics::reset()
+{
+    io = IoStatistics();
+    elementsParsed = 0;
+    pagesParsed = 0;
+    framesParsed = 0;
+    stages.fill(MediaFileStageStatistics());
+    traceEvents.clear();
+    referenceTime = chrono::steady_clock::now();
+}
+
+/*!
+ * \brief Returns the trace events and counters in the "Trace Event Format" used by Chrome's trace viewer.
+ * \remarks
+ * - The stages are emitted as complete events ("X"). Timestamps are relative to referenceTime and given in microseconds.
+ * - The counters are emitted as a single counter event ("C") at the end of the last stage.
+ * - Only stage invocations recorded while recordTraceEvents was set are present.
+ */
+string MediaFileStatistics::toChromeTraceJson() const
+{
+    const auto toMicroseconds = [](chrono::nanoseconds duration) { return numberToString(duration.count() / 1000); };
+    auto json = string("{\"traceEvents\":[");
+    auto end = chrono::nanoseconds::zero();
+    for (const auto &event : traceEvents) {
+        json += "{\"name\":\"";
+        json += mediaFileStageName(event.stage);
+        json += "\",\"cat\":\"tagparser\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":";
+        json += toMicroseconds(event.start);
+        json += ",\"dur\":";
+        json += toMicroseconds(event.duration);
+        json += "},";
+        end = max(end, event.start + event.duration);
+    }
+    json += "{\"name\":\"I/O\",\"cat\":\"tagparser\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":";
+    json += toMicroseconds(end);
+    json += ",\"args\":{\"bytesRead\":";
+    json += numberToString(io.bytesRead);
+    json += ",\"bytesWritten\":";
+    json += numberToString(io.bytesWritten);
+    json += ",\"readOperations\":";
+    json += numberToString(io.readOperations);
+    json += ",\"writeOperations\":";
+    json += numberToString(io.writeOperations);
+    json += ",\"seekOperations\":";
+    json += numberToString(io.seekOperations);
+    json += ",\"elementsParsed\":";
+    json += numberToString(elementsParsed);
+    json += ",\"pagesParsed\":";
+    json += numberToString(pagesParsed);
+    json += ",\"framesParsed\":";
+    json += numberToString(framesParsed);
+    json += "}}]}";
+    return json;
+}
+
+} // namespace TagParser
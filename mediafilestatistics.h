@@ -0,0 +1,147 @@
+#ifndef TAG_PARSER_MEDIAFILESTATISTICS_H
+#define TAG_PARSER_MEDIAFILESTATISTICS_H
+
+#include "./global.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace TagParser {
+
+/*!
+ * \brief The IoStatistics struct holds counters for the I/O operations on the stream of a BasicFileInfo.
+ * \sa BasicFileInfo::setIoStatistics()
+ */
+struct TAG_PARSER_EXPORT IoStatistics {
+    std::uint64_t bytesRead = 0; /**< the number of bytes read */
+    std::uint64_t bytesWritten = 0; /**< the number of bytes written */
+    std::uint64_t readOperations = 0; /**< the number of read operations (bulk reads and single-character reads) */
+    std::uint64_t writeOperations = 0; /**< the number of write operations (bulk writes and single-character writes) */
+    std::uint64_t seekOperations = 0; /**< the number of seek operations (not counting querying the current position) */
+};
+
+/*!
+ * \brief The MediaFileStage enum specifies a stage of parsing or making a file recorded by MediaFileStatistics.
+ */
+enum class MediaFileStage : std::uint8_t {
+    ContainerFormat, /**< MediaFileInfo::parseContainerFormat() */
+    Tracks, /**< MediaFileInfo::parseTracks() */
+    Tags, /**< MediaFileInfo::parseTags() */
+    Chapters, /**< MediaFileInfo::parseChapters() */
+    Attachments, /**< MediaFileInfo::parseAttachments() */
+    ApplyChanges, /**< MediaFileInfo::applyChanges() */
+    MakeFile, /**< writing the file within MediaFileInfo::applyChanges() (including creating a backup) */
+    Backup, /**< creating the backup file when the file needs to be rewritten */
+};
+
+/// \brief The number of MediaFileStage values.
+constexpr std::size_t mediaFileStageCount = static_cast<std::size_t>(MediaFileStage::Backup) + 1;
+
+TAG_PARSER_EXPORT const char *mediaFileStageName(MediaFileStage stage);
+
+/*!
+ * \brief The MediaFileStageStatistics struct holds the accumulated wall time of a MediaFileStage.
+ */
+struct TAG_PARSER_EXPORT MediaFileStageStatistics {
+    std::uint64_t invocations = 0; /**< the number of times the stage has been entered */
+    std::chrono::nanoseconds duration = std::chrono::nanoseconds::zero(); /**< the accumulated wall time spent in the stage */
+};
+
+/*!
+ * \brief The MediaFileTraceEvent struct holds a single invocation of a MediaFileStage.
+ */
+struct TAG_PARSER_EXPORT MediaFileTraceEvent {
+    MediaFileStage stage; /**< the stage */
+    std::chrono::nanoseconds start; /**< the start time relative to MediaFileStatistics::referenceTime */
+    std::chrono::nanoseconds duration; /**< the wall time spent in the stage */
+};
+
+/*!
+ * \brief The MediaFileStatistics struct holds I/O counters and timings recorded by a MediaFileInfo.
+ * \sa MediaFileInfo::setStatisticsEnabled()
+ */
+struct TAG_PARSER_EXPORT MediaFileStatistics {
+    const MediaFileStageStatistics &stage(MediaFileStage mediaFileStage) const;
+    MediaFileStageStatistics &stage(MediaFileStage mediaFileStage);
+    void reset();
+    std::string toChromeTraceJson() const;
+
+    IoStatistics io; /**< the I/O operations on the file's stream */
+    std::uint64_t elementsParsed = 0; /**< the number of parsed EBML elements and MP4 atoms */
+    std::uint64_t pagesParsed = 0; /**< the number of parsed Ogg pages */
+    std::uint64_t framesParsed = 0; /**< the number of frames found in the Matroska blocks parsed when computing track statistics */
+    std::array<MediaFileStageStatistics, mediaFileStageCount> stages; /**< the timings per MediaFileStage */
+    std::vector<MediaFileTraceEvent> traceEvents; /**< the individual stage invocations (only populated if recordTraceEvents is set) */
+    std::chrono::steady_clock::time_point referenceTime = std::chrono::steady_clock::now(); /**< the reference point of the trace events */
+    bool recordTraceEvents = false; /**< whether traceEvents should be populated */
+};
+
+/*!
+ * \brief Returns the statistics of the specified \a stage.
+ */
+inline const MediaFileStageStatistics &MediaFileStatistics::stage(MediaFileStage mediaFileStage) const
+{
+    return stages[static_cast<std::size_t>(mediaFileStage)];
+}
+
+/*!
+ * \brief Returns the statistics of the specified \a stage.
+ */
+inline MediaFileStageStatistics &MediaFileStatistics::stage(MediaFileStage mediaFileStage)
+{
+    return stages[static_cast<std::size_t>(mediaFileStage)];
+}
+
+/*!
+ * \brief The MediaFileStageTimer class records the wall time of a MediaFileStage within its scope.
+ * \remarks Does nothing if no statistics are passed so it can be used unconditionally.
+ */
+class TAG_PARSER_EXPORT MediaFileStageTimer {
+public:
+    explicit MediaFileStageTimer(MediaFileStatistics *statistics, MediaFileStage stage);
+    MediaFileStageTimer(const MediaFileStageTimer &) = delete;
+    MediaFileStageTimer &operator=(const MediaFileStageTimer &) = delete;
+    ~MediaFileStageTimer();
+
+private:
+    MediaFileStatistics *const m_statistics;
+    const MediaFileStage m_stage;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+/*!
+ * \brief Starts recording the specified \a stage if \a statistics is not nullptr.
+ */
+inline MediaFileStageTimer::MediaFileStageTimer(MediaFileStatistics *statistics, MediaFileStage stage)
+    : m_statistics(statistics)
+    , m_stage(stage)
+{
+    if (m_statistics) {
+        m_start = std::chrono::steady_clock::now();
+    }
+}
+
+/*!
+ * \brief Stops recording the stage and adds the spent time to the statistics.
+ */
+inline MediaFileStageTimer::~MediaFileStageTimer()
+{
+    if (!m_statistics) {
+        return;
+    }
+    const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start);
+    auto &stage = m_statistics->stage(m_stage);
+    ++stage.invocations;
+    stage.duration += duration;
+    if (m_statistics->recordTraceEvents) {
+        m_statistics->traceEvents.emplace_back(
+            MediaFileTraceEvent{ m_stage, std::chrono::duration_cast<std::chrono::nanoseconds>(m_start - m_statistics->referenceTime), duration });
+    }
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_MEDIAFILESTATISTICS_H
@@ -6,6 +6,7 @@
 
 #include "../exceptions.h"
 #include "../mediafileinfo.h"
+#include "../mediafilestatistics.h"
 
 #include <c++utilities/conversion/stringbuilder.h>
 #include <c++utilities/io/binaryreader.h>
@@ -61,6 +62,9 @@ string Mp4Atom::parsingContext() const
 void Mp4Atom::internalParse(Diagnostics &diag)
 {
     static const string context("parsing MP4 atom");
+    if (auto *const statistics = container().fileInfo().statistics()) {
+        ++statistics->elementsParsed;
+    }
     if (maxTotalSize() < minimumElementSize()) {
         diag.emplace_back(DiagLevel::Critical,
             argsToString("Atom is smaller than 8 byte and hence invalid. The remaining size within the parent atom is ", maxTotalSize(), '.'),
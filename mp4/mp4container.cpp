@@ -2,8 +2,12 @@
 #include "./mp4ids.h"
 
 #include "../backuphelper.h"
+#include "../coalescingstreambuffer.h"
+#include "../copyengine.h"
 #include "../exceptions.h"
+#include "../fileallocator.h"
 #include "../mediafileinfo.h"
+#include "../mediafilestatistics.h"
 
 #include <c++utilities/conversion/stringbuilder.h>
 #include <c++utilities/io/binaryreader.h>
@@ -232,8 +236,8 @@ void Mp4Container::internalMakeFile(Diagnostics &diag, AbortableProgressFeedback
     // define variables needed to manage file layout
     // -> whether media data is written chunk by chunk (need to write chunk by chunk if tracks have been altered)
     const bool writeChunkByChunk = m_tracksAltered;
-    // -> whether rewrite is required (always required when forced to rewrite or when tracks have been altered)
-    bool rewriteRequired = fileInfo().isForcingRewrite() || writeChunkByChunk;
+    // -> whether rewrite is required (always required when forced to rewrite, when tracks have been altered or when saving to another file)
+    bool rewriteRequired = fileInfo().isForcingRewrite() || writeChunkByChunk || !fileInfo().saveFilePath().empty();
     // -> use the preferred tag position/index position (force one wins, if both are force tag pos wins; might be changed later if none is forced)
     ElementPosition initialNewTagPos
         = fileInfo().forceTagPosition() || !fileInfo().forceIndexPosition() ? fileInfo().tagPosition() : fileInfo().indexPosition();
@@ -446,7 +450,10 @@ void Mp4Container::internalMakeFile(Diagnostics &diag, AbortableProgressFeedback
     // calculate padding if no rewrite is required; otherwise use the preferred padding
 calculatePadding:
     if (rewriteRequired) {
-        newPadding = (fileInfo().preferredPadding() && fileInfo().preferredPadding() < 8 ? 8 : fileInfo().preferredPadding());
+        newPadding = fileInfo().paddingForRewrite(tagsSize);
+        if (newPadding && newPadding < 8) {
+            newPadding = 8;
+        }
     } else {
         // file type atom
         currentOffset = fileTypeAtom->totalSize();
@@ -500,6 +507,37 @@ calculatePadding:
         }
     }
 
+    // report the calculated layout; don't modify the file if only planning
+    if (m_changesPlan) {
+        m_changesPlan->rewriteRequired = rewriteRequired;
+        m_changesPlan->newPadding = newPadding;
+        m_changesPlan->tagPosition = m_changesPlan->indexPosition = newTagPos;
+        // -> header, movie atom and padding are always written
+        m_changesPlan->bytesToWrite = fileTypeAtom->totalSize() + movieAtomSize + newPadding;
+        if (progressiveDownloadInfoAtom) {
+            m_changesPlan->bytesToWrite += progressiveDownloadInfoAtom->totalSize();
+        }
+        // -> media data is only written when rewriting
+        if (rewriteRequired) {
+            for (level0Atom = firstMediaDataAtom; level0Atom; level0Atom = level0Atom->nextSibling()) {
+                level0Atom->parse(diag);
+                switch (level0Atom->id()) {
+                case Mp4AtomIds::FileType:
+                case Mp4AtomIds::ProgressiveDownloadInformation:
+                case Mp4AtomIds::Movie:
+                case Mp4AtomIds::Free:
+                case Mp4AtomIds::Skip:
+                    break;
+                default:
+                    m_changesPlan->bytesToWrite += level0Atom->totalSize();
+                }
+            }
+        }
+        if (m_planningChanges) {
+            return;
+        }
+    }
+
     // setup stream(s) for writing
     // -> update status
     progress.nextStepOrStop("Preparing streams ...");
@@ -509,12 +547,15 @@ calculatePadding:
     NativeFileStream &outputStream = fileInfo().stream();
     NativeFileStream backupStream; // create a stream to open the backup/original file for the case rewriting the file is required
     BinaryWriter outputWriter(&outputStream);
+    auto allocator = FileAllocator(); // manages the disk space of the new file when rewriting
+    auto copyEngine = unique_ptr<CopyEngine>(); // copies the media data in the background when rewriting (if enabled)
 
     if (rewriteRequired) {
         if (fileInfo().saveFilePath().empty()) {
             // move current file to temp dir and reopen it as backupStream, recreate original file
             try {
-                BackupHelper::createBackupFile(fileInfo().backupDirectory(), fileInfo().path(), backupPath, outputStream, backupStream);
+                const auto backupTimer = MediaFileStageTimer(fileInfo().statistics(), MediaFileStage::Backup);
+                BackupHelper::createBackupFile(fileInfo().backupDirectory(), fileInfo().path(), backupPath, outputStream, backupStream, &progress);
                 // recreate original file, define buffer variables
                 outputStream.open(BasicFileInfo::pathForOpen(fileInfo().path()), ios_base::out | ios_base::binary | ios_base::trunc);
             } catch (const std::ios_base::failure &failure) {
@@ -535,6 +576,17 @@ calculatePadding:
             }
         }
 
+        // reserve the disk space for the new file; padding exceeding the configured threshold is left as hole
+        allocator = FileAllocator(fileInfo().saveFilePath().empty() ? fileInfo().path() : fileInfo().saveFilePath(), fileInfo().sparsePaddingThreshold());
+        if (fileInfo().isPreallocatingOutput() && m_changesPlan) {
+            allocator.preallocate(m_changesPlan->bytesToWrite);
+        }
+
+        // copy the media data asynchronously if enabled (not used when writing chunk-by-chunk)
+        if (fileInfo().isCopyingAsynchronously()) {
+            copyEngine = make_unique<CopyEngine>(backupPath.empty() ? fileInfo().path() : backupPath, allocator.path());
+        }
+
         // set backup stream as associated input stream since we need the original elements to write the new file
         setStream(backupStream);
 
@@ -558,6 +610,11 @@ calculatePadding:
 
     // start actual writing
     try {
+        // stage the many small writes of the makers to pass them to the file in big chunks
+        // -> skip data which is already present when updating in-place so the file is not touched if nothing changes
+        auto coalescingWriteScope = CoalescingWriteScope(outputStream);
+        coalescingWriteScope.setSkipUnchangedData(!rewriteRequired);
+
         // write header
         progress.nextStepOrStop("Writing header and tags ...");
         // -> make file type atom
@@ -680,9 +737,7 @@ calculatePadding:
                     }
 
                     // write zeroes
-                    for (; newPadding; --newPadding) {
-                        outputStream.put(0);
-                    }
+                    allocator.writeZeroes(outputStream, newPadding);
                 }
 
                 // write media data
@@ -709,8 +764,12 @@ calculatePadding:
                         default:
                             // update status
                             progress.updateStep("Writing atom: " + level0Atom->idToString());
-                            // copy atom entirely and forward status update calls
-                            level0Atom->copyEntirely(outputStream, diag, &progress);
+                            // copy atom entirely and forward status update calls (or let the copy engine copy it in the background)
+                            if (copyEngine) {
+                                level0Atom->copyEntirely(*copyEngine, outputStream, diag);
+                            } else {
+                                level0Atom->copyEntirely(outputStream, diag, &progress);
+                            }
                         }
                     }
 
@@ -807,6 +866,17 @@ calculatePadding:
             }
         }
 
+        // wait for the media data being copied asynchronously and write staged data (before the stream is reopened)
+        if (copyEngine) {
+            progress.updateStep("Copying media data ...");
+            copyEngine->finish(&progress);
+            copyEngine.reset();
+        }
+        coalescingWriteScope.finish();
+        if (!rewriteRequired && !coalescingWriteScope.bytesWritten()) {
+            diag.emplace_back(DiagLevel::Information, "Nothing to be changed; the serialized tags are identical to the data in the file.", context);
+        }
+
         // reparse what is written so far
         progress.updateStep("Reparsing output file ...");
         if (rewriteRequired) {
@@ -819,6 +889,7 @@ calculatePadding:
             }
             // the outputStream needs to be reopened to be able to read again
             outputStream.close();
+            allocator.releaseUnusedSpace(fileInfo().size());
             outputStream.open(BasicFileInfo::pathForOpen(fileInfo().path()), ios_base::in | ios_base::out | ios_base::binary);
             setStream(outputStream);
         } else {
@@ -884,9 +955,16 @@ calculatePadding:
         // prevent deferring final write operations (to catch and handle possible errors here)
         outputStream.flush();
 
+        // report the layout of the new file; the tracks have been re-parsed from it so they remain valid
+        if (m_changesPlan) {
+            m_appliedChanges = *m_changesPlan;
+        }
+
         // handle errors (which might have been occurred after renaming/creating backup file)
     } catch (...) {
-        BackupHelper::handleFailureAfterFileModified(fileInfo(), backupPath, outputStream, backupStream, diag, context);
+        // stop copying before the backup is restored
+        copyEngine.reset();
+        BackupHelper::handleFailureAfterFileModified(fileInfo(), backupPath, outputStream, backupStream, diag, &progress, context);
     }
 }
 
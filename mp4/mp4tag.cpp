@@ -4,6 +4,7 @@
 #include "./mp4ids.h"
 
 #include "../exceptions.h"
+#include "../knownfieldmapping.h"
 
 #include <c++utilities/conversion/stringconversion.h>
 #include <c++utilities/io/binarywriter.h>
@@ -116,106 +117,53 @@ const TagValue &Mp4Tag::value(const char *mean, const char *name) const
     return TagValue::empty();
 }
 
-Mp4Tag::IdentifierType Mp4Tag::internallyGetFieldId(KnownField field) const
+/// \cond
+namespace {
+constexpr auto makeMp4TagFieldMapping()
 {
     using namespace Mp4TagAtomIds;
-    switch (field) {
-    case KnownField::Album:
-        return Album;
-    case KnownField::Artist:
-        return Artist;
-    case KnownField::Comment:
-        return Comment;
-    case KnownField::RecordDate:
-    case KnownField::Year:
-        return Year;
-    case KnownField::Title:
-        return Title;
-    case KnownField::Genre:
-        return Genre;
-    case KnownField::TrackPosition:
-        return TrackPosition;
-    case KnownField::DiskPosition:
-        return DiskPosition;
-    case KnownField::Composer:
-        return Composer;
-    case KnownField::Encoder:
-        return Encoder;
-    case KnownField::Bpm:
-        return Bpm;
-    case KnownField::Cover:
-        return Cover;
-    case KnownField::Rating:
-        return Rating;
-    case KnownField::Grouping:
-        return Grouping;
-    case KnownField::Description:
-        return Description;
-    case KnownField::Lyrics:
-        return Lyrics;
-    case KnownField::RecordLabel:
-        return RecordLabel;
-    case KnownField::Performers:
-        return Performers;
-    case KnownField::Lyricist:
-        return Lyricist;
-    case KnownField::AlbumArtist:
-        return AlbumArtist;
-    default:
-        return 0;
-    }
-    // do not forget to extend Mp4Tag::internallyGetKnownField() and Mp4TagField::appropriateRawDataType() as well
+    // clang-format off
+    constexpr FieldIdMapping<std::uint32_t> fieldIds[] = {
+        { Album, KnownField::Album },
+        { Artist, KnownField::Artist },
+        { Comment, KnownField::Comment },
+        { Year, KnownField::RecordDate },
+        { Year, KnownField::Year, FieldMappingDirection::ToIdOnly },
+        { Title, KnownField::Title },
+        { Genre, KnownField::Genre },
+        { PreDefinedGenre, KnownField::Genre, FieldMappingDirection::ToKnownFieldOnly },
+        { TrackPosition, KnownField::TrackPosition },
+        { DiskPosition, KnownField::DiskPosition },
+        { Composer, KnownField::Composer },
+        { Encoder, KnownField::Encoder },
+        { Bpm, KnownField::Bpm },
+        { Cover, KnownField::Cover },
+        { Rating, KnownField::Rating },
+        { Grouping, KnownField::Grouping },
+        { Description, KnownField::Description },
+        { Lyrics, KnownField::Lyrics },
+        { RecordLabel, KnownField::RecordLabel },
+        { Performers, KnownField::Performers },
+        { Lyricist, KnownField::Lyricist },
+        { AlbumArtist, KnownField::AlbumArtist },
+    };
+    // clang-format on
+    // do not forget to extend Mp4TagField::appropriateRawDataType() as well
+    return makeKnownFieldMapping<IntegerFieldIdHash>(fieldIds);
+}
+constexpr auto mp4TagFieldMapping = makeMp4TagFieldMapping();
+static_assert(mp4TagFieldMapping.isValid(), "MP4 tag field mapping must not contain conflicting entries");
+} // namespace
+/// \endcond
+
+Mp4Tag::IdentifierType Mp4Tag::internallyGetFieldId(KnownField field) const
+{
+    return mp4TagFieldMapping.id(field);
 }
 
 KnownField Mp4Tag::internallyGetKnownField(const IdentifierType &id) const
 {
-    using namespace Mp4TagAtomIds;
-    switch (id) {
-    case Album:
-        return KnownField::Album;
-    case Artist:
-        return KnownField::Artist;
-    case Comment:
-        return KnownField::Comment;
-    case Year:
-        return KnownField::RecordDate;
-    case Title:
-        return KnownField::Title;
-    case PreDefinedGenre:
-    case Genre:
-        return KnownField::Genre;
-    case TrackPosition:
-        return KnownField::TrackPosition;
-    case DiskPosition:
-        return KnownField::DiskPosition;
-    case Composer:
-        return KnownField::Composer;
-    case Encoder:
-        return KnownField::Encoder;
-    case Bpm:
-        return KnownField::Bpm;
-    case Cover:
-        return KnownField::Cover;
-    case Rating:
-        return KnownField::Rating;
-    case Grouping:
-        return KnownField::Grouping;
-    case Description:
-        return KnownField::Description;
-    case Lyrics:
-        return KnownField::Lyrics;
-    case RecordLabel:
-        return KnownField::RecordLabel;
-    case Performers:
-        return KnownField::Performers;
-    case Lyricist:
-        return KnownField::Lyricist;
-    case AlbumArtist:
-        return KnownField::AlbumArtist;
-    default:
-        return KnownField::Invalid;
-    }
-    // do not forget to extend Mp4Tag::internallyGetFieldId() and Mp4TagField::appropriateRawDataType() as well
+    return mp4TagFieldMapping.knownField(id);
 }
 
 bool Mp4Tag::setValue(KnownField field, const TagValue &value)
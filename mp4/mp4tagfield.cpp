@@ -459,7 +459,7 @@ Mp4TagFieldMaker::Mp4TagFieldMaker(Mp4TagField &field, Diagnostics &diag)
         diag.emplace_back(DiagLevel::Warning, "Invalid tag atom id.", "making MP4 tag field");
         throw InvalidDataException();
     }
-    const string context("making MP4 tag field " + Mp4TagField::fieldIdToString(m_field.id()));
+    const auto context = [this] { return "making MP4 tag field " + Mp4TagField::fieldIdToString(m_field.id()); };
     if (m_field.value().isEmpty() && (!m_field.mean().empty() || !m_field.name().empty())) {
         diag.emplace_back(DiagLevel::Critical, "No tag value assigned.", context);
         throw InvalidDataException();
@@ -3,7 +3,10 @@
 #include "../flac/flacmetadata.h"
 
 #include "../backuphelper.h"
+#include "../coalescingstreambuffer.h"
+#include "../copyengine.h"
 #include "../mediafileinfo.h"
+#include "../mediafilestatistics.h"
 #include "../progressfeedback.h"
 
 #include <c++utilities/conversion/stringbuilder.h>
@@ -237,6 +240,9 @@ void OggContainer::internalParseHeader(Diagnostics &diag)
                     // abort if skipping pages didn't work
                     diag.emplace_back(DiagLevel::Critical,
                         "Unable to re-sync after skipping OGG pages in the middle of the file. Try forcing a full parse.", context);
+                    if (auto *const statistics = fileInfo().statistics()) {
+                        statistics->pagesParsed += m_iterator.pages().size();
+                    }
                     return;
                 }
             }
@@ -249,6 +255,9 @@ void OggContainer::internalParseHeader(Diagnostics &diag)
         diag.emplace_back(
             DiagLevel::Critical, argsToString("Capture pattern \"OggS\" at ", m_iterator.currentSegmentOffset(), " expected."), context);
     }
+    if (auto *const statistics = fileInfo().statistics()) {
+        statistics->pagesParsed += m_iterator.pages().size();
+    }
 
     // invalidate stream sizes in case pages have been skipped
     if (pagesSkipped) {
@@ -363,18 +372,94 @@ void OggContainer::makeVorbisCommentSegment(stringstream &buffer, CopyHelper<653
     newSegmentSizes.push_back(static_cast<std::uint32_t>(buffer.tellp() - offset));
 }
 
+/*!
+ * \brief Returns whether making the comments would yield exactly the data which is already present in the file.
+ *
+ * The serialized comments are compared with the segments they have been parsed from. New and removed comments
+ * are considered a change. Diagnostic messages emitted while making the comments are only added to \a diag if
+ * nothing has been changed (otherwise they will be emitted again when actually making the comments).
+ */
+bool OggContainer::areCommentsUnchanged(Diagnostics &diag)
+{
+    if (m_tags.empty()) {
+        return false;
+    }
+    auto makingDiag = Diagnostics();
+    auto copyHelper = CopyHelper<65307>();
+    auto existingData = string();
+    m_iterator.setStream(fileInfo().stream());
+    try {
+        for (const auto &comment : m_tags) {
+            auto &params = comment->oggParams();
+            if (params.removed || params.firstSegmentIndex == numeric_limits<size_t>::max() || params.lastPageIndex >= m_iterator.pages().size()) {
+                return false;
+            }
+
+            // determine the size of the segments the comment is stored in
+            auto existingSize = std::size_t();
+            for (auto pageIndex = params.firstPageIndex; pageIndex <= params.lastPageIndex; ++pageIndex) {
+                const auto &segmentSizes = m_iterator.pages()[pageIndex].segmentSizes();
+                const auto segmentEnd = pageIndex == params.lastPageIndex ? min(params.lastSegmentIndex + 1, segmentSizes.size()) : segmentSizes.size();
+                for (auto segmentIndex = pageIndex == params.firstPageIndex ? params.firstSegmentIndex : 0; segmentIndex < segmentEnd; ++segmentIndex) {
+                    existingSize += segmentSizes[segmentIndex];
+                }
+            }
+
+            // make the comment and compare it with the existing segments
+            stringstream buffer(ios_base::in | ios_base::out | ios_base::binary);
+            buffer.exceptions(ios_base::badbit | ios_base::failbit);
+            auto newSegmentSizes = vector<std::uint32_t>();
+            makeVorbisCommentSegment(buffer, copyHelper, newSegmentSizes, comment.get(), &params, makingDiag);
+            if (newSegmentSizes.back() != existingSize) {
+                return false;
+            }
+            existingData.resize(existingSize);
+            m_iterator.setPageIndex(params.firstPageIndex);
+            m_iterator.setSegmentIndex(params.firstSegmentIndex);
+            m_iterator.read(existingData.data(), existingSize);
+            if (buffer.str() != existingData) {
+                return false;
+            }
+        }
+    } catch (const Failure &) {
+        // let the actual making report the problem
+        return false;
+    }
+    diag.insert(diag.end(), makingDiag.begin(), makingDiag.end());
+    return true;
+}
+
 void OggContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFeedback &progress)
 {
     const string context("making OGG file");
     progress.updateStep("Prepare for rewriting OGG file ...");
     parseTags(diag); // tags need to be parsed before the file can be rewritten
+
+    // don't touch the file at all if the serialized comments are identical to the data in the file
+    if (!fileInfo().isForcingRewrite() && fileInfo().saveFilePath().empty() && areCommentsUnchanged(diag)) {
+        if (!m_planningChanges) {
+            diag.emplace_back(DiagLevel::Information, "Nothing to be changed; the serialized tags are identical to the data in the file.", context);
+        }
+        return;
+    }
+
+    // OGG files are always rewritten otherwise; the size of the new comment pages is only known when making them
+    // -> assume the file size does not change when only planning
+    if (m_planningChanges) {
+        m_changesPlan->rewriteRequired = true;
+        m_changesPlan->bytesToWrite = fileInfo().size();
+        return;
+    }
+
     string backupPath;
     NativeFileStream backupStream;
+    auto copyEngine = unique_ptr<CopyEngine>(); // copies the pages in the background (if enabled)
 
     if (fileInfo().saveFilePath().empty()) {
         // move current file to temp dir and reopen it as backupStream, recreate original file
         try {
-            BackupHelper::createBackupFile(fileInfo().backupDirectory(), fileInfo().path(), backupPath, fileInfo().stream(), backupStream);
+            const auto backupTimer = MediaFileStageTimer(fileInfo().statistics(), MediaFileStage::Backup);
+            BackupHelper::createBackupFile(fileInfo().backupDirectory(), fileInfo().path(), backupPath, fileInfo().stream(), backupStream, &progress);
             // recreate original file, define buffer variables
             fileInfo().stream().open(BasicFileInfo::pathForOpen(fileInfo().path()), ios_base::out | ios_base::binary | ios_base::trunc);
         } catch (const std::ios_base::failure &failure) {
@@ -395,7 +480,16 @@ void OggContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFeedback
         }
     }
 
+    // copy the pages asynchronously if enabled
+    if (fileInfo().isCopyingAsynchronously()) {
+        copyEngine = make_unique<CopyEngine>(backupPath.empty() ? fileInfo().path() : backupPath,
+            fileInfo().saveFilePath().empty() ? fileInfo().path() : fileInfo().saveFilePath());
+    }
+
     try {
+        // stage the many small writes of the page headers to pass them to the file in big chunks
+        auto coalescingWriteScope = CoalescingWriteScope(fileInfo().stream());
+
         // prepare iterating comments
         OggVorbisComment *currentComment;
         OggParameter *currentParams;
@@ -551,7 +645,14 @@ void OggContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFeedback
                     stream().seekp(-9, ios_base::cur);
                     writer().writeUInt32LE(pageSequenceNumber);
                     stream().seekp(5, ios_base::cur);
-                    copyHelper.copy(backupStream, stream(), pageSize - 27);
+                    if (copyEngine) {
+                        copyEngine->submit(stream(), currentPage.startOffset() + 27, pageSize - 27);
+                    } else {
+                        copyHelper.copy(backupStream, stream(), pageSize - 27);
+                    }
+                } else if (copyEngine) {
+                    // copy page unchanged in the background
+                    copyEngine->submit(stream(), currentPage.startOffset(), pageSize);
                 } else {
                     // copy page unchanged
                     backupStream.seekg(static_cast<streamoff>(currentPage.startOffset()));
@@ -561,6 +662,14 @@ void OggContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFeedback
             }
         }
 
+        // wait for the pages being copied asynchronously and write staged data (before the stream is reopened)
+        if (copyEngine) {
+            progress.updateStep("Copying pages ...");
+            copyEngine->finish(&progress);
+            copyEngine.reset();
+        }
+        coalescingWriteScope.finish();
+
         // report new size
         fileInfo().reportSizeChanged(static_cast<std::uint64_t>(stream().tellp()));
 
@@ -587,8 +696,10 @@ void OggContainer::internalMakeFile(Diagnostics &diag, AbortableProgressFeedback
         m_iterator.clear(fileInfo().stream(), startOffset(), fileInfo().size());
 
     } catch (...) {
+        // stop copying before the backup is restored
+        copyEngine.reset();
         m_iterator.setStream(fileInfo().stream());
-        BackupHelper::handleFailureAfterFileModified(fileInfo(), backupPath, fileInfo().stream(), backupStream, diag, context);
+        BackupHelper::handleFailureAfterFileModified(fileInfo(), backupPath, fileInfo().stream(), backupStream, diag, &progress, context);
     }
 }
 
@@ -0,0 +1,164 @@
+#include "./paddingpolicy.h"
+#include "./basicfileinfo.h"
+
+#include <c++utilities/io/nativefilestream.h>
+
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+using namespace CppUtilities;
+
+namespace TagParser {
+
+/*!
+ * \class TagParser::PaddingPolicy
+ * \brief The PaddingPolicy class determines the padding to be used when a file needs to be rewritten.
+ *
+ * Without a policy, MediaFileInfo::preferredPadding() is used whenever a file needs to be rewritten. When
+ * tags grow over time this leads to rewriting the same file again and again. A policy can take the size of
+ * the tags, the size of the file and previous rewrites into account to reserve enough space for further edits.
+ *
+ * \sa MediaFileInfo::setPaddingPolicy()
+ */
+
+/*!
+ * \brief Destroys the policy.
+ */
+PaddingPolicy::~PaddingPolicy()
+{
+}
+
+/*!
+ * \fn PaddingPolicy::padding()
+ * \brief Returns the padding to be used when rewriting the file described by \a context.
+ * \remarks Might be called when MediaFileInfo::planChanges() is used as well. So it must not record anything.
+ */
+
+/*!
+ * \brief Records that the file described by \a context has been rewritten using the specified \a padding.
+ * \remarks Only called after the changes have been applied successfully. Does nothing by default.
+ */
+void PaddingPolicy::recordRewrite(const PaddingContext &context, std::uint64_t padding)
+{
+    CPP_UTILITIES_UNUSED(context);
+    CPP_UTILITIES_UNUSED(padding);
+}
+
+/*!
+ * \class TagParser::AdaptivePaddingPolicy
+ * \brief The AdaptivePaddingPolicy class sizes the padding according to the tags, the file and previous rewrites.
+ *
+ * The padding is the largest of
+ * - AdaptivePaddingSettings::minimum and MediaFileInfo::preferredPadding(),
+ * - AdaptivePaddingSettings::tagsSizeRatio times the size of the tags,
+ * - AdaptivePaddingSettings::fileSizeRatio times the size of the file and
+ * - AdaptivePaddingSettings::growthFactor times the growth of the tags since the last recorded rewrite of the file.
+ *
+ * It is limited by AdaptivePaddingSettings::maximum and kept within MediaFileInfo::minPadding() and
+ * MediaFileInfo::maxPadding() so the padding itself does not cause a rewrite when applying the next changes.
+ *
+ * Since the padding grows with each rewrite caused by growing tags, the number of rewrites only grows
+ * logarithmically with the number of edits. The recorded rewrites can be persisted in a small history file
+ * using saveHistory() and loadHistory() to take advantage of them across sessions.
+ *
+ * The history is protected by a mutex so one policy can be shared by files written concurrently (e.g. by a
+ * BatchWriter).
+ */
+
+/*!
+ * \brief Constructs a new policy with the specified \a settings.
+ */
+AdaptivePaddingPolicy::AdaptivePaddingPolicy(const AdaptivePaddingSettings &settings)
+    : m_settings(settings)
+{
+}
+
+std::uint64_t AdaptivePaddingPolicy::padding(const PaddingContext &context) const
+{
+    auto padding = max({ m_settings.minimum, context.preferredPadding,
+        static_cast<std::uint64_t>(static_cast<double>(context.tagsSize) * m_settings.tagsSizeRatio),
+        static_cast<std::uint64_t>(static_cast<double>(context.fileSize) * m_settings.fileSizeRatio) });
+    {
+        const auto lock = std::lock_guard<std::mutex>(m_historyMutex);
+        if (const auto entry = m_history.find(context.path); entry != m_history.end() && context.tagsSize > entry->second.tagsSize) {
+            padding = max(
+                padding, static_cast<std::uint64_t>(static_cast<double>(context.tagsSize - entry->second.tagsSize) * m_settings.growthFactor));
+        }
+    }
+    padding = min(padding, m_settings.maximum);
+    if (context.minPadding <= context.maxPadding) {
+        padding = clamp(padding, context.minPadding, context.maxPadding);
+    }
+    return padding;
+}
+
+void AdaptivePaddingPolicy::recordRewrite(const PaddingContext &context, std::uint64_t padding)
+{
+    const auto lock = std::lock_guard<std::mutex>(m_historyMutex);
+    auto &entry = m_history[context.path];
+    entry.tagsSize = context.tagsSize;
+    entry.padding = padding;
+    ++entry.rewrites;
+}
+
+/*!
+ * \brief Returns a copy of what has been recorded about the file with the specified \a path.
+ * \remarks Returns an empty optional if nothing has been recorded.
+ */
+std::optional<PaddingHistoryEntry> AdaptivePaddingPolicy::historyEntry(const std::string &path) const
+{
+    const auto lock = std::lock_guard<std::mutex>(m_historyMutex);
+    const auto entry = m_history.find(path);
+    return entry != m_history.end() ? std::make_optional(entry->second) : std::nullopt;
+}
+
+/*!
+ * \brief Adds the rewrites recorded in the specified history file to the history.
+ *
+ * Does nothing if the file does not exist (yet). Lines which can not be parsed are ignored.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \sa saveHistory()
+ */
+void AdaptivePaddingPolicy::loadHistory(const std::string &historyFilePath)
+{
+    NativeFileStream historyFile;
+    historyFile.open(BasicFileInfo::pathForOpen(historyFilePath), ios_base::in | ios_base::binary);
+    if (!historyFile.is_open()) {
+        return;
+    }
+    historyFile.exceptions(ios_base::badbit);
+    const auto lock = std::lock_guard<std::mutex>(m_historyMutex);
+    for (string line; getline(historyFile, line);) {
+        auto lineStream = istringstream(line);
+        auto entry = PaddingHistoryEntry();
+        auto path = string();
+        if (lineStream >> entry.tagsSize >> entry.padding >> entry.rewrites && lineStream.get() == ' ' && getline(lineStream, path) && !path.empty()) {
+            m_history[path] = entry;
+        }
+    }
+}
+
+/*!
+ * \brief Writes the history to the specified file.
+ *
+ * The file contains one line per file consisting of the size of the tags, the padding, the number of
+ * rewrites and the path of the file (separated by spaces).
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \sa loadHistory()
+ */
+void AdaptivePaddingPolicy::saveHistory(const std::string &historyFilePath) const
+{
+    NativeFileStream historyFile;
+    historyFile.exceptions(ios_base::failbit | ios_base::badbit);
+    historyFile.open(BasicFileInfo::pathForOpen(historyFilePath), ios_base::out | ios_base::binary | ios_base::trunc);
+    const auto lock = std::lock_guard<std::mutex>(m_historyMutex);
+    for (const auto &[path, entry] : m_history) {
+        historyFile << entry.tagsSize << ' ' << entry.padding << ' ' << entry.rewrites << ' ' << path << '\n';
+    }
+    historyFile.flush();
+}
+
+} // namespace TagParser
@@ -0,0 +1,101 @@
+#ifndef TAG_PARSER_PADDINGPOLICY_H
+#define TAG_PARSER_PADDINGPOLICY_H
+
+#include "./signature.h"
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace TagParser {
+
+/*!
+ * \brief The PaddingContext struct holds the information a PaddingPolicy can base its decision on.
+ */
+struct TAG_PARSER_EXPORT PaddingContext {
+    std::string path; /**< the path of the file being rewritten */
+    ContainerFormat containerFormat = ContainerFormat::Unknown; /**< the container format of the file */
+    std::uint64_t fileSize = 0; /**< the size of the file before rewriting it */
+    std::uint64_t tagsSize = 0; /**< the size of the new tags (and other metadata written along with the tags) */
+    std::uint64_t minPadding = 0; /**< the value of MediaFileInfo::minPadding() */
+    std::uint64_t maxPadding = 0; /**< the value of MediaFileInfo::maxPadding() */
+    std::uint64_t preferredPadding = 0; /**< the value of MediaFileInfo::preferredPadding() */
+};
+
+class TAG_PARSER_EXPORT PaddingPolicy {
+public:
+    virtual ~PaddingPolicy();
+
+    virtual std::uint64_t padding(const PaddingContext &context) const = 0;
+    virtual void recordRewrite(const PaddingContext &context, std::uint64_t padding);
+};
+
+/*!
+ * \brief The AdaptivePaddingSettings struct specifies the configuration of an AdaptivePaddingPolicy.
+ */
+struct TAG_PARSER_EXPORT AdaptivePaddingSettings {
+    std::uint64_t minimum = 0x400; /**< the padding to use at least */
+    std::uint64_t maximum = 0x100000; /**< the padding to use at most */
+    double tagsSizeRatio = 0.5; /**< the padding to use relative to the size of the tags */
+    double fileSizeRatio = 0.001; /**< the padding to use relative to the size of the file */
+    double growthFactor = 2.0; /**< the factor to apply to the growth of the tags since the last rewrite */
+};
+
+/*!
+ * \brief The PaddingHistoryEntry struct holds what an AdaptivePaddingPolicy recorded about a file.
+ */
+struct TAG_PARSER_EXPORT PaddingHistoryEntry {
+    std::uint64_t tagsSize = 0; /**< the size of the tags when the file has been rewritten the last time */
+    std::uint64_t padding = 0; /**< the padding used when the file has been rewritten the last time */
+    std::uint64_t rewrites = 0; /**< the number of recorded rewrites */
+};
+
+class TAG_PARSER_EXPORT AdaptivePaddingPolicy : public PaddingPolicy {
+public:
+    explicit AdaptivePaddingPolicy(const AdaptivePaddingSettings &settings = AdaptivePaddingSettings());
+
+    const AdaptivePaddingSettings &settings() const;
+    void setSettings(const AdaptivePaddingSettings &settings);
+    std::uint64_t padding(const PaddingContext &context) const override;
+    void recordRewrite(const PaddingContext &context, std::uint64_t padding) override;
+    std::optional<PaddingHistoryEntry> historyEntry(const std::string &path) const;
+    void clearHistory();
+    void loadHistory(const std::string &historyFilePath);
+    void saveHistory(const std::string &historyFilePath) const;
+
+private:
+    AdaptivePaddingSettings m_settings;
+    std::unordered_map<std::string, PaddingHistoryEntry> m_history;
+    mutable std::mutex m_historyMutex;
+};
+
+/*!
+ * \brief Returns the current settings.
+ */
+inline const AdaptivePaddingSettings &AdaptivePaddingPolicy::settings() const
+{
+    return m_settings;
+}
+
+/*!
+ * \brief Sets the settings to be used when determining the padding from now on.
+ */
+inline void AdaptivePaddingPolicy::setSettings(const AdaptivePaddingSettings &settings)
+{
+    m_settings = settings;
+}
+
+/*!
+ * \brief Discards all recorded rewrites.
+ */
+inline void AdaptivePaddingPolicy::clearHistory()
+{
+    const auto lock = std::lock_guard<std::mutex>(m_historyMutex);
+    m_history.clear();
+}
+
+} // namespace TagParser
+
+#endif // TAG_PARSER_PADDINGPOLICY_H
@@ -16,6 +16,26 @@ enum class ElementPosition {
     Keep, /**< the element is placed where it was before */
 };
 
+/*!
+ * \brief The RewriteStrategy enum specifies how MediaFileInfo::applyChanges() rewrites a file.
+ * \sa MediaFileInfo::setRewriteStrategy()
+ */
+enum class RewriteStrategy {
+    BackupFile, /**< the original file is moved to a backup file and the new file is written to the original path; the backup file is restored on failure */
+    TemporaryFile, /**< the new file is written to a temporary file next to the original file which then replaces the original file atomically */
+    TemporaryFileWithSync, /**< like TemporaryFile but the temporary file is flushed to the storage device before it replaces the original file */
+};
+
+/*!
+ * \brief The IndexGeneration enum specifies whether MediaFileInfo::applyChanges() generates the index of a file.
+ * \sa MediaFileInfo::setIndexGeneration()
+ */
+enum class IndexGeneration {
+    Never, /**< an existing index is kept (and updated) but no index is generated */
+    IfMissing, /**< an index is generated if the file has none or the existing one contains no entries */
+    Always, /**< an index is always generated; an existing index is replaced */
+};
+
 /*!
  * \brief The TagUsage enum specifies the usage of a certain tag type.
  */
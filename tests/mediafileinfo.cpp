@@ -1,9 +1,16 @@
 #include "./helper.h"
 
+#include "../abstractcontainer.h"
 #include "../abstracttrack.h"
+#include "../batchwriter.h"
+#include "../exceptions.h"
 #include "../mediafileinfo.h"
+#include "../mediafilestatistics.h"
+#include "../progressfeedback.h"
 #include "../tag.h"
 
+#include <c++utilities/conversion/stringbuilder.h>
+#include <c++utilities/io/misc.h>
 #include <c++utilities/tests/testutils.h>
 using namespace CppUtilities;
 
@@ -12,6 +19,8 @@ using namespace CppUtilities;
 
 #include <cstdio>
 
+#include <sys/stat.h>
+
 using namespace std;
 using namespace CppUtilities::Literals;
 using namespace TagParser;
@@ -28,6 +37,13 @@ class MediaFileInfoTests : public TestFixture {
     CPPUNIT_TEST(testFileSystemMethods);
     CPPUNIT_TEST(testParsingUnsupportedFile);
     CPPUNIT_TEST(testFullParseAndFurtherProperties);
+    CPPUNIT_TEST(testStatistics);
+    CPPUNIT_TEST(testReadCache);
+    CPPUNIT_TEST(testRewritingViaTemporaryFile);
+    CPPUNIT_TEST(testPlanningChanges);
+    CPPUNIT_TEST(testBatchWriter);
+    CPPUNIT_TEST(testSkippingUnchangedTags);
+    CPPUNIT_TEST(testKeepingParsingResults);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -40,6 +56,13 @@ public:
     void testPartialParsingAndTagCreationOfMp4File();
 
     void testFullParseAndFurtherProperties();
+    void testStatistics();
+    void testReadCache();
+    void testRewritingViaTemporaryFile();
+    void testPlanningChanges();
+    void testBatchWriter();
+    void testSkippingUnchangedTags();
+    void testKeepingParsingResults();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(MediaFileInfoTests);
@@ -189,3 +212,314 @@ void MediaFileInfoTests::testFullParseAndFurtherProperties()
     CPPUNIT_ASSERT_EQUAL("ID: 3653291187, type: Audio, language: English"s, file.tracks()[1]->label());
     CPPUNIT_ASSERT_EQUAL("MS-MPEG-4-480p / MP3-2ch-eng"s, file.technicalSummary());
 }
+
+void MediaFileInfoTests::testStatistics()
+{
+    Diagnostics diag;
+    MediaFileInfo file(testFilePath("matroska_wave1/test1.mkv"));
+    CPPUNIT_ASSERT(!file.statistics());
+    file.setStatisticsEnabled(true);
+    auto *const statistics = file.statistics();
+    CPPUNIT_ASSERT(statistics);
+    statistics->recordTraceEvents = true;
+    file.open(true);
+    file.parseEverything(diag);
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.tagsParsingStatus());
+    CPPUNIT_ASSERT(statistics->io.bytesRead > 0);
+    CPPUNIT_ASSERT(statistics->io.readOperations > 0);
+    CPPUNIT_ASSERT(statistics->io.seekOperations > 0);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), statistics->io.bytesWritten);
+    CPPUNIT_ASSERT(statistics->elementsParsed > 0);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), statistics->pagesParsed);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(1), statistics->stage(MediaFileStage::ContainerFormat).invocations);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(1), statistics->stage(MediaFileStage::Tags).invocations);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), statistics->stage(MediaFileStage::ApplyChanges).invocations);
+    CPPUNIT_ASSERT_EQUAL(5_st, statistics->traceEvents.size());
+    TESTUTILS_ASSERT_LIKE("Chrome trace JSON", "\\{\"traceEvents\":\\[\\{\"name\":\"parsing container format\".*\\}\\]\\}", statistics->toChromeTraceJson());
+    file.setStatisticsEnabled(false);
+    CPPUNIT_ASSERT(!file.statistics());
+
+    // Ogg pages are counted separately from elements
+    MediaFileInfo oggFile(testFilePath("mtx-test-data/ogg/qt4dance_medium.ogg"));
+    oggFile.setStatisticsEnabled(true);
+    oggFile.open(true);
+    oggFile.parseContainerFormat(diag);
+    CPPUNIT_ASSERT(oggFile.statistics()->pagesParsed > 0);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), oggFile.statistics()->elementsParsed);
+}
+
+void MediaFileInfoTests::testReadCache()
+{
+    // parse the file without read cache for reference
+    Diagnostics diag;
+    MediaFileInfo file(testFilePath("matroska_wave1/test1.mkv"));
+    file.setStatisticsEnabled(true);
+    file.open(true);
+    file.parseEverything(diag);
+    const auto uncachedIo = file.statistics()->io;
+    const auto uncachedTitle = file.tags().empty() ? std::string() : file.tags().front()->value(KnownField::Title).toString();
+    CPPUNIT_ASSERT(!file.isReadCacheEnabled());
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), file.readCacheStatistics().misses);
+
+    // parse the file again with read cache; the same results are expected with less reads and seeks on the file
+    diag.clear();
+    file.invalidate();
+    file.statistics()->reset();
+    file.setReadCacheEnabled(true);
+    file.open(true);
+    file.parseEverything(diag);
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.tagsParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.tracksParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(uncachedTitle, file.tags().empty() ? std::string() : file.tags().front()->value(KnownField::Title).toString());
+    const auto &cacheStatistics = file.readCacheStatistics();
+    CPPUNIT_ASSERT(cacheStatistics.hits > 0);
+    CPPUNIT_ASSERT(cacheStatistics.blocksFetched > 0);
+    CPPUNIT_ASSERT(file.statistics()->io.readOperations < uncachedIo.readOperations);
+    CPPUNIT_ASSERT(file.statistics()->io.seekOperations < uncachedIo.seekOperations);
+    file.resetReadCacheStatistics();
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), file.readCacheStatistics().hits);
+}
+
+void MediaFileInfoTests::testRewritingViaTemporaryFile()
+{
+    const auto path = workingCopyPath("matroska_wave1/test2.mkv");
+    CPPUNIT_ASSERT_EQUAL(0, chmod(path.data(), 0640));
+
+    // apply changes using a temporary file
+    Diagnostics diag;
+    auto progress = AbortableProgressFeedback(AbortableProgressFeedback::Callback());
+    MediaFileInfo file(path);
+    file.setRewriteStrategy(RewriteStrategy::TemporaryFileWithSync);
+    file.open();
+    file.parseEverything(diag);
+    file.createAppropriateTags();
+    CPPUNIT_ASSERT(!file.tags().empty());
+    file.tags().front()->setValue(KnownField::Title, TagValue("written via temporary file"));
+    file.applyChanges(diag, progress);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+    CPPUNIT_ASSERT_EQUAL(path, file.path());
+    CPPUNIT_ASSERT(file.saveFilePath().empty());
+
+    // neither a backup file nor the temporary file is left behind and the permissions are preserved
+    struct stat fileStat;
+    CPPUNIT_ASSERT(stat((path + ".bak").data(), &fileStat));
+    CPPUNIT_ASSERT(stat((path + ".tmp").data(), &fileStat));
+    CPPUNIT_ASSERT_EQUAL(0, stat(path.data(), &fileStat));
+    CPPUNIT_ASSERT_EQUAL(static_cast<mode_t>(0640), static_cast<mode_t>(fileStat.st_mode & 07777));
+
+    // the changes have been applied
+    file.parseEverything(diag);
+    CPPUNIT_ASSERT(!file.tags().empty());
+    CPPUNIT_ASSERT_EQUAL("written via temporary file"s, file.tags().front()->value(KnownField::Title).toString());
+    file.close();
+    CPPUNIT_ASSERT_EQUAL(0, remove(path.data()));
+}
+
+void MediaFileInfoTests::testPlanningChanges()
+{
+    const auto path = workingCopyPath("matroska_wave1/test2.mkv");
+    struct stat originalStat, currentStat;
+    CPPUNIT_ASSERT_EQUAL(0, stat(path.data(), &originalStat));
+
+    // plan applying a changed title
+    Diagnostics diag;
+    auto progress = AbortableProgressFeedback(AbortableProgressFeedback::Callback());
+    MediaFileInfo file(path);
+    file.open();
+    file.parseEverything(diag);
+    file.createAppropriateTags();
+    CPPUNIT_ASSERT(!file.tags().empty());
+    file.tags().front()->setValue(KnownField::Title, TagValue("planned title"));
+    file.setTagPosition(ElementPosition::BeforeData);
+    file.setForceTagPosition(true);
+    const auto plan = file.planChanges(diag, progress);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+    CPPUNIT_ASSERT_EQUAL(ElementPosition::BeforeData, plan.tagPosition);
+    CPPUNIT_ASSERT(plan.bytesToWrite > 0);
+    CPPUNIT_ASSERT(plan.rewriteRequired || plan.bytesToWrite < file.size());
+
+    // a rewrite is predicted when forced; the whole file is written then
+    file.setForceRewrite(true);
+    file.setPreferredPadding(0x1000);
+    const auto rewritePlan = file.planChanges(diag, progress);
+    CPPUNIT_ASSERT(rewritePlan.rewriteRequired);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x1000), rewritePlan.newPadding);
+    CPPUNIT_ASSERT(rewritePlan.bytesToWrite > file.size() / 2);
+
+    // neither the file nor the parsing results have been altered
+    CPPUNIT_ASSERT_EQUAL(0, stat(path.data(), &currentStat));
+    CPPUNIT_ASSERT_EQUAL(originalStat.st_size, currentStat.st_size);
+    CPPUNIT_ASSERT_EQUAL(originalStat.st_mtime, currentStat.st_mtime);
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.tagsParsingStatus());
+    CPPUNIT_ASSERT_EQUAL("planned title"s, file.tags().front()->value(KnownField::Title).toString());
+
+    // the prediction matches the actual result
+    file.applyChanges(diag, progress);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+    CPPUNIT_ASSERT_EQUAL(rewritePlan.bytesToWrite, file.size());
+    file.close();
+    CPPUNIT_ASSERT_EQUAL(0, remove(path.data()));
+    remove((path + ".bak").data());
+}
+
+/*!
+ * \brief Tests applying changes to multiple files via BatchWriter including the rollback when aborting.
+ */
+void MediaFileInfoTests::testBatchWriter()
+{
+    const string paths[] = { workingCopyPath("matroska_wave1/test1.mkv"), workingCopyPath("matroska_wave1/test2.mkv") };
+    struct stat originalStats[2], currentStat;
+    Diagnostics diag;
+    MediaFileInfo files[2];
+    BatchWriter writer;
+    writer.setMaxConcurrentRewrites(1);
+    for (auto i = 0; i != 2; ++i) {
+        CPPUNIT_ASSERT_EQUAL(0, stat(paths[i].data(), originalStats + i));
+        files[i].setPath(paths[i]);
+        files[i].open();
+        files[i].parseEverything(diag);
+        files[i].createAppropriateTags();
+        files[i].tags().front()->setValue(KnownField::Title, TagValue(argsToString("batch title ", i)));
+        writer.addFile(files[i]);
+    }
+    files[0].setForceRewrite(true); // ensure at least one file is rewritten
+
+    // abort as soon as the files are being written; all files are supposed to be restored
+    auto abortingProgress = AbortableProgressFeedback([](AbortableProgressFeedback &feedback) {
+        if (feedback.step().find("Writing files") == 0) {
+            feedback.tryToAbort();
+        }
+    });
+    CPPUNIT_ASSERT_THROW(writer.applyChanges(diag, abortingProgress), OperationAbortedException);
+    for (auto i = 0; i != 2; ++i) {
+        CPPUNIT_ASSERT_EQUAL(0, stat(paths[i].data(), &currentStat));
+        CPPUNIT_ASSERT_EQUAL(originalStats[i].st_size, currentStat.st_size);
+        CPPUNIT_ASSERT_EQUAL(originalStats[i].st_ino, currentStat.st_ino);
+        CPPUNIT_ASSERT(!files[i].isOpen() || files[i].saveFilePath().empty());
+    }
+
+    // apply the changes to both files (parsing again as the parsing results have been cleared)
+    for (auto i = 0; i != 2; ++i) {
+        files[i].open();
+        files[i].parseEverything(diag);
+        files[i].createAppropriateTags();
+        files[i].tags().front()->setValue(KnownField::Title, TagValue(argsToString("batch title ", i)));
+    }
+    auto progress = AbortableProgressFeedback(AbortableProgressFeedback::Callback());
+    writer.applyChanges(diag, progress);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+    CPPUNIT_ASSERT_EQUAL("All changes have been applied."s, progress.step());
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint8_t>(100), progress.overallPercentage());
+    for (auto i = 0; i != 2; ++i) {
+        files[i].close();
+        CPPUNIT_ASSERT_EQUAL(paths[i], files[i].path());
+        CPPUNIT_ASSERT(files[i].saveFilePath().empty());
+        files[i].open(true);
+        files[i].parseEverything(diag);
+        CPPUNIT_ASSERT(!files[i].tags().empty());
+        CPPUNIT_ASSERT_EQUAL(argsToString("batch title ", i), files[i].tags().front()->value(KnownField::Title).toString());
+        files[i].close();
+        // the backups are removed
+        CPPUNIT_ASSERT(stat((paths[i] + ".bak").data(), &currentStat) != 0);
+        CPPUNIT_ASSERT_EQUAL(0, remove(paths[i].data()));
+    }
+}
+
+/*!
+ * \brief Tests whether applying unchanged tags leaves the file untouched.
+ */
+void MediaFileInfoTests::testSkippingUnchangedTags()
+{
+    const auto path = workingCopyPath("matroska_wave1/test2.mkv");
+    Diagnostics diag;
+    auto progress = AbortableProgressFeedback(AbortableProgressFeedback::Callback());
+    MediaFileInfo file(path);
+    file.setMinPadding(0);
+    file.setMaxPadding(0x100000);
+
+    // apply changes once so the file is in the layout the library produces (e.g. element order, "MuxingApp")
+    file.open();
+    file.parseEverything(diag);
+    file.createAppropriateTags();
+    file.tags().front()->setValue(KnownField::Title, TagValue("unchanged title"));
+    file.applyChanges(diag, progress);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+    const auto contents = readFile(path, 0x1000000);
+
+    // apply changes again setting the same value; nothing is supposed to be written
+    diag.clear();
+    file.parseEverything(diag);
+    file.tags().front()->setValue(KnownField::Title, TagValue("unchanged title"));
+    file.applyChanges(diag, progress);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+    const auto skipped = find_if(diag.cbegin(), diag.cend(), [](const DiagMessage &message) {
+        return message.level() == DiagLevel::Information && message.message().find("Nothing to be changed") == 0;
+    });
+    CPPUNIT_ASSERT_MESSAGE("skipping reported", skipped != diag.cend());
+    file.close();
+    CPPUNIT_ASSERT_EQUAL(contents, readFile(path, 0x1000000));
+
+    // changing the value is still applied
+    diag.clear();
+    file.open();
+    file.parseEverything(diag);
+    file.tags().front()->setValue(KnownField::Title, TagValue("changed title"));
+    file.applyChanges(diag, progress);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+    file.close();
+    CPPUNIT_ASSERT(contents != readFile(path, 0x1000000));
+    CPPUNIT_ASSERT_EQUAL(0, remove(path.data()));
+    remove((path + ".bak").data());
+}
+
+void MediaFileInfoTests::testKeepingParsingResults()
+{
+    const auto path = workingCopyPath("matroska_wave1/test2.mkv");
+    Diagnostics diag;
+    auto progress = AbortableProgressFeedback(AbortableProgressFeedback::Callback());
+    MediaFileInfo file(path);
+    file.setRewriteStrategy(RewriteStrategy::TemporaryFile);
+    file.setStatisticsEnabled(true);
+    file.open();
+    file.parseEverything(diag);
+    const auto trackCount = file.trackCount();
+    file.createAppropriateTags();
+    file.tags().front()->setValue(KnownField::Title, TagValue("kept container"));
+    file.setForceRewrite(true);
+    file.applyChanges(diag, progress);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+
+    // the container has been re-parsed from the new file; only tags and tracks need to be read again
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.containerParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(ContainerFormat::Matroska, file.containerFormat());
+    CPPUNIT_ASSERT(file.container()->appliedChanges().has_value());
+    CPPUNIT_ASSERT(file.container()->appliedChanges()->rewriteRequired);
+    CPPUNIT_ASSERT_EQUAL(file.container()->appliedChanges()->newPadding, file.paddingSize());
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::NotParsedYet, file.tagsParsingStatus());
+    const auto bytesReadBefore = file.statistics()->io.bytesRead;
+    file.parseEverything(diag);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.tagsParsingStatus());
+    CPPUNIT_ASSERT_MESSAGE("reads from the reopened stream are still counted", file.statistics()->io.bytesRead > bytesReadBefore);
+    CPPUNIT_ASSERT_EQUAL(file.size(), static_cast<std::uint64_t>(readFile(path, 0x1000000).size()));
+    CPPUNIT_ASSERT_EQUAL(trackCount, file.trackCount());
+    CPPUNIT_ASSERT_EQUAL("kept container"s, file.tags().front()->value(KnownField::Title).toString());
+
+    // the results are the same as when parsing the file from scratch
+    file.setForceRewrite(false);
+    file.tags().front()->setValue(KnownField::Title, TagValue("updated in-place"));
+    file.applyChanges(diag, progress);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.containerParsingStatus());
+    file.parseEverything(diag);
+    CPPUNIT_ASSERT_EQUAL("updated in-place"s, file.tags().front()->value(KnownField::Title).toString());
+    file.close();
+    file.open();
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::NotParsedYet, file.containerParsingStatus());
+    file.parseEverything(diag);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+    CPPUNIT_ASSERT_EQUAL(trackCount, file.trackCount());
+    CPPUNIT_ASSERT_EQUAL("updated in-place"s, file.tags().front()->value(KnownField::Title).toString());
+    file.close();
+    CPPUNIT_ASSERT_EQUAL(0, remove(path.data()));
+}
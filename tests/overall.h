@@ -44,12 +44,18 @@ class OverallTests : public TestFixture {
     CPPUNIT_TEST(testOggParsing);
     CPPUNIT_TEST(testFlacParsing);
     CPPUNIT_TEST(testMkvParsing);
+    CPPUNIT_TEST(testMkvParsingSegmentsConcurrently);
     CPPUNIT_TEST(testMp4Making);
     CPPUNIT_TEST(testMp3Making);
     CPPUNIT_TEST(testOggMaking);
     CPPUNIT_TEST(testFlacMaking);
     CPPUNIT_TEST(testMkvMakingWithDifferentSettings);
     CPPUNIT_TEST(testMkvMakingNestedTags);
+    CPPUNIT_TEST(testMkvMakingLazyTags);
+    CPPUNIT_TEST(testMkvMakingIndex);
+    CPPUNIT_TEST(testMkvMakingMultipleSegments);
+    CPPUNIT_TEST(testMkvMakingInPlaceWithAttachments);
+    CPPUNIT_TEST(testMkvMakingTrackStatistics);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -72,6 +78,11 @@ private:
     void checkMkvTestfile8();
     void checkMkvTestfileHandbrakeChapters();
     void checkMkvTestfileNestedTags();
+    void checkMkvTestfileLazyTags();
+    void checkMkvTestfile1WithTaggedSegment();
+    void checkMkvTestfile6WithGeneratedIndex();
+    void checkMkvTestfile1WithAdditionalSegment();
+    void checkMkvTrackStatistics();
     void checkMkvTestMetaData();
     void checkMkvConstraints();
 
@@ -106,15 +117,22 @@ private:
     void noop();
     void alterMp4Tracks();
     void removeSecondTrack();
+    void computeMkvTrackStatistics();
 
 public:
     void testMkvParsing();
+    void testMkvParsingSegmentsConcurrently();
     void testMp4Parsing();
     void testMp3Parsing();
     void testOggParsing();
     void testFlacParsing();
     void testMkvMakingWithDifferentSettings();
     void testMkvMakingNestedTags();
+    void testMkvMakingLazyTags();
+    void testMkvMakingIndex();
+    void testMkvMakingTrackStatistics();
+    void testMkvMakingMultipleSegments();
+    void testMkvMakingInPlaceWithAttachments();
     void testMp4Making();
     void testMp3Making();
     void testOggMaking();
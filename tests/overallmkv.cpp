@@ -312,6 +312,67 @@ void OverallTests::checkMkvTestfile6()
     CPPUNIT_ASSERT(m_diag.level() <= DiagLevel::Information);
 }
 
+/*!
+ * \brief Checks "matroska_wave1/test6.mkv" after generating the index.
+ * \remarks The index is validated when parsing the file (because full parse is forced).
+ */
+void OverallTests::checkMkvTestfile6WithGeneratedIndex()
+{
+    checkMkvTestfile6();
+    CPPUNIT_ASSERT(m_fileInfo.container());
+    CPPUNIT_ASSERT_EQUAL(ElementPosition::BeforeData, m_fileInfo.container()->determineIndexPosition(m_diag));
+}
+
+/*!
+ * \brief Checks "matroska_wave1/test1.mkv" with the 2nd segment appended by testMkvMakingMultipleSegments().
+ * \remarks The index is validated when parsing the file (because full parse is forced).
+ */
+void OverallTests::checkMkvTestfile1WithAdditionalSegment()
+{
+    checkMkvTestfile1();
+    const auto *const container = static_cast<const MatroskaContainer *>(m_fileInfo.container());
+    CPPUNIT_ASSERT(container);
+    CPPUNIT_ASSERT_EQUAL(2_st, container->segmentCount());
+    CPPUNIT_ASSERT_EQUAL(2_st, container->titles().size());
+    CPPUNIT_ASSERT_EQUAL("second segment"s, container->titles().back());
+}
+
+/*!
+ * \brief Checks "matroska_wave1/test1.mkv" with the 2nd segment appended by testMkvParsingSegmentsConcurrently().
+ */
+void OverallTests::checkMkvTestfile1WithTaggedSegment()
+{
+    const auto *const container = static_cast<const MatroskaContainer *>(m_fileInfo.container());
+    CPPUNIT_ASSERT(container);
+    CPPUNIT_ASSERT_EQUAL(2_st, container->segmentCount());
+    CPPUNIT_ASSERT_EQUAL(2_st, container->titles().size());
+    CPPUNIT_ASSERT_EQUAL("second segment"s, container->titles().back());
+    CPPUNIT_ASSERT_EQUAL(2_st, m_fileInfo.tracks().size());
+    // the tags are merged in the order of the segments
+    const auto tags = m_fileInfo.tags();
+    CPPUNIT_ASSERT_EQUAL(2_st, tags.size());
+    CPPUNIT_ASSERT_EQUAL("Big Buck Bunny - test 1"s, tags.front()->value(KnownField::Title).toString());
+    CPPUNIT_ASSERT_EQUAL("second segment tag"s, tags.back()->value(KnownField::Title).toString());
+    CPPUNIT_ASSERT(m_diag.level() <= DiagLevel::Information);
+}
+
+/*!
+ * \brief Checks whether the track statistics written via computeMkvTrackStatistics() are read from the tags.
+ */
+void OverallTests::checkMkvTrackStatistics()
+{
+    CPPUNIT_ASSERT_EQUAL(ContainerFormat::Matroska, m_fileInfo.containerFormat());
+    CPPUNIT_ASSERT_EQUAL(3_st, m_fileInfo.tags().size());
+    for (const auto &track : m_fileInfo.tracks()) {
+        CPPUNIT_ASSERT_EQUAL_MESSAGE("frame count", m_preservedMetaData.front(), TagValue(numberToString(track->sampleCount())));
+        m_preservedMetaData.pop();
+        CPPUNIT_ASSERT_EQUAL_MESSAGE("byte count", m_preservedMetaData.front(), TagValue(numberToString(track->size())));
+        m_preservedMetaData.pop();
+    }
+    CPPUNIT_ASSERT(m_preservedMetaData.empty());
+    CPPUNIT_ASSERT(m_diag.level() <= DiagLevel::Information);
+}
+
 /*!
  * \brief Checks "matroska_wave1/test7.mkv".
  */
@@ -523,6 +584,46 @@ void OverallTests::checkMkvTestfileNestedTags()
     CPPUNIT_ASSERT(m_diag.level() <= DiagLevel::Warning);
 }
 
+/*!
+ * \brief Checks "mkv/nested-tags.mkv" when parsing tags lazily.
+ * \remarks Indexed fields must be decoded when accessed via TagField as well and must not refer to the file anymore.
+ */
+void OverallTests::checkMkvTestfileLazyTags()
+{
+    CPPUNIT_ASSERT_EQUAL(ContainerFormat::Matroska, m_fileInfo.containerFormat());
+    const MatroskaTagField *indexedField = nullptr;
+    for (const auto &tag : m_fileInfo.matroskaTags()) {
+        if (tag->target().level() == 50 && tag->target().tracks().empty()) {
+            const auto &fields = tag->fields();
+            const auto artistField = fields.find(tag->fieldId(KnownField::Artist));
+            CPPUNIT_ASSERT(artistField != fields.end());
+            indexedField = &artistField->second;
+        }
+    }
+    CPPUNIT_ASSERT(indexedField);
+    CPPUNIT_ASSERT_MESSAGE("field only indexed", !indexedField->isDecoded());
+
+    // copy the field, close the file and decode the copy via the TagField interface
+    const auto copiedField = *indexedField;
+    m_fileInfo.close();
+    const TagField<MatroskaTagField> &field = copiedField;
+    CPPUNIT_ASSERT_EQUAL("ARTIST"s, field.idToString());
+    CPPUNIT_ASSERT_EQUAL("Test artist"s, field.value().toString());
+    CPPUNIT_ASSERT_EQUAL(1_st, field.nestedFields().size());
+    CPPUNIT_ASSERT_EQUAL("ADDRESS"s, field.nestedFields()[0].idToString());
+    CPPUNIT_ASSERT_EQUAL("Test address"s, field.nestedFields()[0].value().toString());
+    CPPUNIT_ASSERT(copiedField.isDecoded());
+    CPPUNIT_ASSERT_MESSAGE("original field still only indexed", !indexedField->isDecoded());
+
+    // messages are reported when indexing
+    auto unknownElementReported = false;
+    for (const auto &msg : m_diag) {
+        unknownElementReported = unknownElementReported || startsWith(msg.message(), "\"SimpleTag\"-element contains unknown element 0x44B4 at");
+    }
+    CPPUNIT_ASSERT(unknownElementReported);
+    CPPUNIT_ASSERT(m_diag.level() <= DiagLevel::Warning);
+}
+
 /*!
  * \brief Checks whether test meta data for Matroska files has been applied correctly.
  */
@@ -627,6 +728,59 @@ void OverallTests::setMkvTestMetaData()
     attachment->setName("cover.jpg");
 }
 
+/*!
+ * \brief Computes the track statistics from the clusters and assigns them to the track-specific tags.
+ */
+void OverallTests::computeMkvTrackStatistics()
+{
+    CPPUNIT_ASSERT_EQUAL(ContainerFormat::Matroska, m_fileInfo.containerFormat());
+    auto *const container = static_cast<MatroskaContainer *>(m_fileInfo.container());
+    container->computeTrackStatistics(m_diag, &m_progress, true);
+    CPPUNIT_ASSERT(m_diag.level() <= DiagLevel::Information);
+    for (const auto &track : m_fileInfo.tracks()) {
+        CPPUNIT_ASSERT(track->sampleCount() > 0);
+        CPPUNIT_ASSERT(track->size() > 0);
+        CPPUNIT_ASSERT(track->bitrate() > 0.0);
+        CPPUNIT_ASSERT(track->duration() > TimeSpan::fromSeconds(80));
+        CPPUNIT_ASSERT(track->duration() <= m_fileInfo.duration());
+        m_preservedMetaData.push(TagValue(numberToString(track->sampleCount())));
+        m_preservedMetaData.push(TagValue(numberToString(track->size())));
+    }
+    // one tag targeting each track has been added
+    CPPUNIT_ASSERT_EQUAL(3_st, m_fileInfo.tags().size());
+}
+
+/*!
+ * \brief Tests parsing the segments of a Matroska file concurrently via MediaFileInfo.
+ */
+void OverallTests::testMkvParsingSegmentsConcurrently()
+{
+    cerr << endl << "Matroska parser - parse segments concurrently" << endl;
+    m_fileInfo.setForceFullParse(false);
+    m_fileInfo.setParseSegmentsConcurrently(true);
+    {
+        // append a 2nd "Segment"-element containing a "SegmentInfo"-element with a title and a "Tags"-element
+        auto file = ofstream(workingCopyPath("matroska_wave1/test1.mkv"), ios_base::out | ios_base::app | ios_base::binary);
+        file << "\x18\x53\x80\x67\xC5" // "Segment"
+                "\x15\x49\xA9\x66\x98" // "SegmentInfo"
+                "\x2A\xD7\xB1\x83\x0F\x42\x40" // "TimestampScale"
+                "\x7B\xA9\x8E"
+                "second segment" // "Title"
+                "\x12\x54\xC3\x67\xA3" // "Tags"
+                "\x73\x73\xA0" // "Tag"
+                "\x67\xC8\x9D" // "SimpleTag"
+                "\x45\xA3\x85"
+                "TITLE" // "TagName"
+                "\x44\x87\x92"
+                "second segment tag"; // "TagString"
+    }
+    // parse the file twice to check whether the result is deterministic
+    for (auto i = 0; i != 2; ++i) {
+        parseFile(workingCopyPath("matroska_wave1/test1.mkv", WorkingCopyMode::NoCopy), &OverallTests::checkMkvTestfile1WithTaggedSegment);
+    }
+    m_fileInfo.setParseSegmentsConcurrently(false);
+}
+
 /*!
  * \brief Tests the Matroska parser via MediaFileInfo.
  */
@@ -746,3 +900,150 @@ void OverallTests::testMkvMakingNestedTags()
     m_fileInfo.setIndexPosition(ElementPosition::BeforeData);
     makeFile(workingCopyPath("mkv/nested-tags.mkv"), &OverallTests::noop, &OverallTests::checkMkvTestfileNestedTags);
 }
+
+/*!
+ * \brief Tests making a Matroska file with nested tags via MediaFileInfo when parsing tags lazily.
+ * \remarks Relies on the parser to check results; the fields are not accessed before making so they are copied verbatim.
+ *          The fields are accessed after closing the file when only parsing it.
+ */
+void OverallTests::testMkvMakingLazyTags()
+{
+    cerr << endl << "Matroska maker - rewrite file with lazily parsed tags" << endl;
+    m_fileInfo.setMinPadding(0);
+    m_fileInfo.setMaxPadding(0);
+    m_fileInfo.setTagPosition(ElementPosition::BeforeData);
+    m_fileInfo.setIndexPosition(ElementPosition::BeforeData);
+    m_fileInfo.setParseTagsLazily(true);
+    parseFile(testFilePath("mkv/nested-tags.mkv"), &OverallTests::checkMkvTestfileLazyTags);
+    makeFile(workingCopyPath("mkv/nested-tags.mkv"), &OverallTests::noop, &OverallTests::checkMkvTestfileNestedTags);
+    m_fileInfo.setParseTagsLazily(false);
+}
+
+/*!
+ * \brief Tests generating the index of a Matroska file without "Cues"-element via MediaFileInfo.
+ * \remarks Relies on the parser to check results.
+ */
+void OverallTests::testMkvMakingIndex()
+{
+    cerr << endl << "Matroska maker - generate index" << endl;
+    m_fileInfo.setForceFullParse(true);
+    m_fileInfo.setForceRewrite(true);
+    m_fileInfo.setMinPadding(0);
+    m_fileInfo.setMaxPadding(0);
+    m_fileInfo.setTagPosition(ElementPosition::BeforeData);
+    m_fileInfo.setIndexPosition(ElementPosition::BeforeData);
+    m_fileInfo.setIndexGeneration(IndexGeneration::IfMissing);
+    m_tagStatus = TagStatus::Original;
+    makeFile(workingCopyPath("matroska_wave1/test6.mkv"), &OverallTests::noop, &OverallTests::checkMkvTestfile6WithGeneratedIndex);
+    m_fileInfo.setIndexAllTracks(true);
+    m_fileInfo.setIndexGeneration(IndexGeneration::Always);
+    makeFile(workingCopyPath("matroska_wave1/test6.mkv"), &OverallTests::noop, &OverallTests::checkMkvTestfile6WithGeneratedIndex);
+    m_fileInfo.setIndexAllTracks(false);
+    m_fileInfo.setIndexGeneration(IndexGeneration::Never);
+}
+
+/*!
+ * \brief Tests computing the track statistics of a Matroska file and writing them as tags via MediaFileInfo.
+ * \remarks Relies on the parser to check results.
+ */
+void OverallTests::testMkvMakingTrackStatistics()
+{
+    cerr << endl << "Matroska maker - compute track statistics" << endl;
+    m_fileInfo.setForceFullParse(true);
+    m_fileInfo.setForceRewrite(false);
+    m_fileInfo.setTagPosition(ElementPosition::Keep);
+    m_fileInfo.setIndexPosition(ElementPosition::Keep);
+    m_tagStatus = TagStatus::Original;
+    makeFile(workingCopyPath("matroska_wave1/test1.mkv"), &OverallTests::computeMkvTrackStatistics, &OverallTests::checkMkvTrackStatistics);
+}
+
+/*!
+ * \brief Tests rewriting a Matroska file with multiple segments via MediaFileInfo.
+ * \remarks
+ * - The clusters of the 1st segment are moved so the "Cues"-element of the 1st segment needs to be updated while the 2nd
+ *   segment is moved as a whole.
+ * - Relies on the parser to check results and to validate the index.
+ */
+void OverallTests::testMkvMakingMultipleSegments()
+{
+    cerr << endl << "Matroska maker - rewrite file with multiple segments" << endl;
+    m_fileInfo.setForceFullParse(true);
+    m_fileInfo.setForceRewrite(true);
+    m_fileInfo.setMinPadding(0);
+    m_fileInfo.setMaxPadding(0);
+    m_fileInfo.setTagPosition(ElementPosition::BeforeData);
+    m_tagStatus = TagStatus::Original;
+    const auto makeTestFile = [] {
+        // append a 2nd "Segment"-element only containing a "SegmentInfo"-element with a title
+        const auto path = workingCopyPath("matroska_wave1/test1.mkv");
+        auto file = ofstream(path, ios_base::out | ios_base::app | ios_base::binary);
+        file << "\x18\x53\x80\x67\x9D" // "Segment"
+                "\x15\x49\xA9\x66\x98" // "SegmentInfo"
+                "\x2A\xD7\xB1\x83\x0F\x42\x40" // "TimestampScale"
+                "\x7B\xA9\x8E"
+                "second segment"; // "Title"
+        return path;
+    };
+    // parse the segments concurrently as the sequential parsing stops after the 1st segment (which contains tracks and tags)
+    m_fileInfo.setParseSegmentsConcurrently(true);
+    for (const auto indexPosition : { ElementPosition::AfterData, ElementPosition::BeforeData }) {
+        m_fileInfo.setIndexPosition(indexPosition);
+        makeFile(makeTestFile(), &OverallTests::noop, &OverallTests::checkMkvTestfile1WithAdditionalSegment);
+    }
+    m_fileInfo.setParseSegmentsConcurrently(false);
+}
+
+/*!
+ * \brief Tests updating a Matroska file with attachments read from the file itself in-place via MediaFileInfo.
+ * \remarks
+ * - The tags in front of the "Attachments"-element grow and shrink so the payloads of the attachments are moved within
+ *   the file (see MatroskaAttachmentWritePlan).
+ * - Relies on the parser to check results.
+ */
+void OverallTests::testMkvMakingInPlaceWithAttachments()
+{
+    cerr << endl << "Matroska maker - update file with existing attachments in-place" << endl;
+    const auto path = workingCopyPath("matroska_wave1/test1.mkv");
+    m_fileInfo.setForceFullParse(true);
+    m_fileInfo.setForceRewrite(true);
+    m_fileInfo.setTagPosition(ElementPosition::BeforeData);
+    m_fileInfo.setIndexPosition(ElementPosition::Keep);
+    m_fileInfo.setForceTagPosition(true);
+    m_fileInfo.setForceIndexPosition(false);
+    m_fileInfo.setPreferredPadding(0x1000);
+    m_fileInfo.setMinPadding(0);
+    m_fileInfo.setMaxPadding(0x10000);
+    m_tagStatus = TagStatus::TestMetaDataPresent;
+    m_diag.clear();
+    m_fileInfo.setPath(path);
+    m_fileInfo.reopen(true);
+    m_fileInfo.parseEverything(m_diag);
+
+    // add the test meta data (including an attachment read from another file) by rewriting the file
+    setMkvTestMetaData();
+    m_fileInfo.applyChanges(m_diag, m_progress);
+    m_fileInfo.clearParsingResults();
+    m_fileInfo.parseEverything(m_diag);
+    checkMkvTestfile1();
+    const auto fileSize = m_fileInfo.size();
+
+    // let the tags grow and shrink; the attachment is now read from the file itself so its data needs to be moved
+    m_fileInfo.setForceRewrite(false);
+    for (const auto lyricsSize : { 1000_st, 10_st }) {
+        const auto lyrics = string(lyricsSize, 'l');
+        CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.attachments().size());
+        CPPUNIT_ASSERT(!m_fileInfo.attachments().front()->isDataFromFile());
+        m_fileInfo.tags().front()->setValue(KnownField::Lyrics, TagValue(lyrics));
+        m_fileInfo.applyChanges(m_diag, m_progress);
+        m_fileInfo.clearParsingResults();
+        m_fileInfo.reopen(true);
+        m_fileInfo.parseEverything(m_diag);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE("file updated in-place", fileSize, m_fileInfo.size());
+        CPPUNIT_ASSERT_EQUAL(lyrics, m_fileInfo.tags().front()->value(KnownField::Lyrics).toString());
+        checkMkvTestfile1(); // also checks the data of the attachment
+    }
+
+    m_fileInfo.close();
+    remove(path.c_str());
+    remove((path + ".bak").c_str());
+}
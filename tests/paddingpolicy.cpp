@@ -0,0 +1,220 @@
+#include "./helper.h"
+
+#include "../mediafileinfo.h"
+#include "../paddingpolicy.h"
+#include "../progressfeedback.h"
+
+#include <c++utilities/tests/testutils.h>
+using namespace CppUtilities;
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstdio>
+
+using namespace std;
+using namespace TagParser;
+
+using namespace CPPUNIT_NS;
+
+/*!
+ * \brief The PaddingPolicyTests class tests the TagParser::PaddingPolicy implementations.
+ */
+class PaddingPolicyTests : public TestFixture {
+    CPPUNIT_TEST_SUITE(PaddingPolicyTests);
+    CPPUNIT_TEST(testAdaptivePadding);
+    CPPUNIT_TEST(testHistoryFile);
+    CPPUNIT_TEST(testRewriteSimulation);
+    CPPUNIT_TEST(testApplyingChanges);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() override;
+    void tearDown() override;
+
+    void testAdaptivePadding();
+    void testHistoryFile();
+    void testRewriteSimulation();
+    void testApplyingChanges();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PaddingPolicyTests);
+
+void PaddingPolicyTests::setUp()
+{
+}
+
+void PaddingPolicyTests::tearDown()
+{
+}
+
+/// \cond
+namespace {
+
+PaddingContext makeContext(std::uint64_t tagsSize, std::uint64_t fileSize = 0x80000)
+{
+    auto context = PaddingContext();
+    context.path = "/music/song.mp3";
+    context.containerFormat = ContainerFormat::MpegAudioFrames;
+    context.fileSize = fileSize;
+    context.tagsSize = tagsSize;
+    context.maxPadding = 0x1000000;
+    return context;
+}
+
+/*!
+ * \brief Simulates editing a file \a editCount times and returns the number of required rewrites.
+ *
+ * The decision whether a rewrite is required mirrors the one of MediaFileInfo::makeMp3File(): the tags and the padding
+ * have to fit into the space before the media data and the padding has to be within the min./max. padding.
+ * Without \a policy, the preferred padding is used when rewriting (like MediaFileInfo does without policy).
+ */
+unsigned int simulateEdits(PaddingPolicy *policy, unsigned int editCount)
+{
+    auto context = makeContext(0x800);
+    context.preferredPadding = 0x400;
+    auto availableSize = context.tagsSize + context.preferredPadding;
+    auto rewrites = 0u;
+    for (auto edit = 0u; edit != editCount; ++edit) {
+        // let the tags grow by a few hundred bytes (e.g. ReplayGain, MusicBrainz IDs, lyrics) and add a cover once
+        context.tagsSize += 100 + (edit * 37) % 400 + (edit == 10 ? 0x8000 : 0);
+        if (context.tagsSize <= availableSize) {
+            const auto padding = availableSize - context.tagsSize;
+            if (padding >= context.minPadding && padding <= context.maxPadding) {
+                continue;
+            }
+        }
+        const auto padding = policy ? policy->padding(context) : context.preferredPadding;
+        if (policy) {
+            policy->recordRewrite(context, padding);
+        }
+        availableSize = context.tagsSize + padding;
+        context.fileSize += padding;
+        ++rewrites;
+    }
+    return rewrites;
+}
+
+} // namespace
+/// \endcond
+
+/*!
+ * \brief Tests how AdaptivePaddingPolicy sizes the padding.
+ */
+void PaddingPolicyTests::testAdaptivePadding()
+{
+    auto settings = AdaptivePaddingSettings();
+    settings.minimum = 0x400;
+    settings.maximum = 0x10000;
+    settings.tagsSizeRatio = 0.5;
+    settings.fileSizeRatio = 0.001;
+    settings.growthFactor = 2.0;
+    auto policy = AdaptivePaddingPolicy(settings);
+
+    // the minimum is used for small tags in small files
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x400), policy.padding(makeContext(0x100)));
+    // the padding grows with the tags and the file
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x1000), policy.padding(makeContext(0x2000)));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(8000), policy.padding(makeContext(0x100, 8000000)));
+    // the preferred padding is used if it is bigger
+    auto context = makeContext(0x100);
+    context.preferredPadding = 0x800;
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x800), policy.padding(context));
+    // the padding is limited by the maximum and by the max. padding of the file
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x10000), policy.padding(makeContext(0x100000)));
+    context.maxPadding = 0x600;
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x600), policy.padding(context));
+    // the padding is at least the min. padding of the file
+    context = makeContext(0x100);
+    context.minPadding = 0x2000;
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x2000), policy.padding(context));
+
+    // the growth since the last rewrite is taken into account
+    CPPUNIT_ASSERT(!policy.historyEntry("/music/song.mp3"));
+    policy.recordRewrite(makeContext(0x100), 0x400);
+    const auto entry = policy.historyEntry("/music/song.mp3");
+    CPPUNIT_ASSERT(entry);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x100), entry->tagsSize);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x400), entry->padding);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(1), entry->rewrites);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0xC00), policy.padding(makeContext(0x700)));
+    policy.clearHistory();
+    CPPUNIT_ASSERT(!policy.historyEntry("/music/song.mp3"));
+}
+
+/*!
+ * \brief Tests saving and loading the history of AdaptivePaddingPolicy.
+ */
+void PaddingPolicyTests::testHistoryFile()
+{
+    const auto historyPath = workingCopyPath("padding-history.txt", WorkingCopyMode::NoCopy);
+    auto policy = AdaptivePaddingPolicy();
+    policy.loadHistory(historyPath); // not existing yet; supposed to be no-op
+    policy.recordRewrite(makeContext(0x100), 0x400);
+    auto context = makeContext(0x200);
+    context.path = "/music/file name with spaces.flac";
+    policy.recordRewrite(context, 0x800);
+    policy.recordRewrite(context, 0x1000);
+    policy.saveHistory(historyPath);
+
+    auto loadedPolicy = AdaptivePaddingPolicy();
+    loadedPolicy.loadHistory(historyPath);
+    const auto entry = loadedPolicy.historyEntry(context.path);
+    CPPUNIT_ASSERT(entry);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x200), entry->tagsSize);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x1000), entry->padding);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(2), entry->rewrites);
+    CPPUNIT_ASSERT(loadedPolicy.historyEntry("/music/song.mp3"));
+    CPPUNIT_ASSERT_EQUAL(0, remove(historyPath.data()));
+}
+
+/*!
+ * \brief Simulates repeated edits of a file with growing tags and compares the number of rewrites.
+ */
+void PaddingPolicyTests::testRewriteSimulation()
+{
+    auto policy = AdaptivePaddingPolicy();
+    for (const auto editCount : { 10u, 50u, 200u }) {
+        policy.clearHistory();
+        const auto fixedRewrites = simulateEdits(nullptr, editCount);
+        const auto adaptiveRewrites = simulateEdits(&policy, editCount);
+        CPPUNIT_ASSERT(adaptiveRewrites < fixedRewrites);
+    }
+    // the number of rewrites grows only logarithmically with the adaptive policy
+    policy.clearHistory();
+    CPPUNIT_ASSERT(simulateEdits(&policy, 200u) <= 10u);
+}
+
+/*!
+ * \brief Tests whether MediaFileInfo consults the padding policy and records the rewrite.
+ */
+void PaddingPolicyTests::testApplyingChanges()
+{
+    const auto path = workingCopyPath("mtx-test-data/mp3/id3-tag-and-xing-header.mp3");
+    AdaptivePaddingPolicy policy;
+    Diagnostics diag;
+    auto progress = AbortableProgressFeedback(AbortableProgressFeedback::Callback());
+    MediaFileInfo file(path);
+    file.setPaddingPolicy(&policy);
+    file.setMaxPadding(0x100000);
+    file.setForceRewrite(true);
+    file.open();
+    file.parseEverything(diag);
+
+    // planning changes consults the policy but does not record anything
+    const auto plan = file.planChanges(diag, progress);
+    CPPUNIT_ASSERT(plan.rewriteRequired);
+    CPPUNIT_ASSERT(plan.newPadding >= policy.settings().minimum);
+    CPPUNIT_ASSERT(!policy.historyEntry(path));
+
+    // applying changes records the rewrite
+    file.applyChanges(diag, progress);
+    CPPUNIT_ASSERT(diag.level() < DiagLevel::Critical);
+    const auto entry = policy.historyEntry(path);
+    CPPUNIT_ASSERT(entry);
+    CPPUNIT_ASSERT_EQUAL(plan.newPadding, entry->padding);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(1), entry->rewrites);
+    file.close();
+    CPPUNIT_ASSERT_EQUAL(0, remove(path.data()));
+    remove((path + ".bak").data());
+}
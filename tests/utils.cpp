@@ -2,10 +2,17 @@
 
 #include "../aspectratio.h"
 #include "../backuphelper.h"
+#include "../coalescingstreambuffer.h"
+#include "../copyengine.h"
+#include "../countingstreambuffer.h"
 #include "../diagnostics.h"
 #include "../exceptions.h"
+#include "../fileallocator.h"
+#include "../flatfieldmap.h"
+#include "../knownfieldmapping.h"
 #include "../margin.h"
 #include "../mediafileinfo.h"
+#include "../mediafilestatistics.h"
 #include "../mediaformat.h"
 #include "../positioninset.h"
 #include "../progressfeedback.h"
@@ -13,7 +20,24 @@
 #include "../size.h"
 #include "../tagtarget.h"
 
+#include "../matroska/ebmlcrc32.h"
+#include "../matroska/ebmlelement.h"
+#include "../matroska/ebmlheaderdecoder.h"
+#include "../matroska/ebmlid.h"
+#include "../matroska/ebmlresyncscanner.h"
+#include "../matroska/matroskaattachmentwriteplan.h"
+#include "../matroska/matroskacontainer.h"
+#include "../matroska/matroskacues.h"
+#include "../matroska/matroskaid.h"
+#include "../matroska/matroskalayoutplanner.h"
+#include "../matroska/matroskastatisticsengine.h"
+#include "../matroska/matroskatag.h"
+#include "../mp4/mp4ids.h"
+#include "../mp4/mp4tag.h"
+#include "../vorbis/vorbiscomment.h"
+
 #include <c++utilities/conversion/stringbuilder.h>
+#include <c++utilities/io/misc.h>
 #include <c++utilities/tests/testutils.h>
 using namespace CppUtilities;
 
@@ -22,6 +46,7 @@ using namespace CppUtilities;
 
 #include <cstdio>
 #include <regex>
+#include <sstream>
 
 #include <unistd.h>
 
@@ -46,6 +71,20 @@ class UtilitiesTests : public TestFixture {
     CPPUNIT_TEST(testAbortableProgressFeedback);
     CPPUNIT_TEST(testDiagnostics);
     CPPUNIT_TEST(testBackupFile);
+    CPPUNIT_TEST(testCopyFile);
+    CPPUNIT_TEST(testCoalescingStreamBuffer);
+    CPPUNIT_TEST(testSkippingUnchangedData);
+    CPPUNIT_TEST(testFileAllocator);
+    CPPUNIT_TEST(testCopyEngine);
+    CPPUNIT_TEST(testEbmlHeaderDecoder);
+    CPPUNIT_TEST(testEbmlResyncScanner);
+    CPPUNIT_TEST(testEbmlCrc32);
+    CPPUNIT_TEST(testMatroskaCuePositionUpdater);
+    CPPUNIT_TEST(testMatroskaLayoutPlanner);
+    CPPUNIT_TEST(testMatroskaAttachmentWritePlan);
+    CPPUNIT_TEST(testMatroskaTrackStatistics);
+    CPPUNIT_TEST(testFlatFieldMap);
+    CPPUNIT_TEST(testKnownFieldMapping);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -64,6 +103,20 @@ public:
     void testAbortableProgressFeedback();
     void testDiagnostics();
     void testBackupFile();
+    void testCopyFile();
+    void testCoalescingStreamBuffer();
+    void testSkippingUnchangedData();
+    void testFileAllocator();
+    void testCopyEngine();
+    void testEbmlHeaderDecoder();
+    void testEbmlResyncScanner();
+    void testEbmlCrc32();
+    void testMatroskaCuePositionUpdater();
+    void testMatroskaLayoutPlanner();
+    void testMatroskaAttachmentWritePlan();
+    void testMatroskaTrackStatistics();
+    void testFlatFieldMap();
+    void testKnownFieldMapping();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(UtilitiesTests);
@@ -288,6 +341,23 @@ void UtilitiesTests::testDiagnostics()
     diag.emplace_back(DiagLevel::Critical, "critical msg", "context");
     CPPUNIT_ASSERT_EQUAL(DiagLevel::Critical, diag.level());
     CPPUNIT_ASSERT(diag.has(DiagLevel::Critical));
+
+    // test filtering by level and lazy formatting
+    Diagnostics criticalDiag(DiagLevel::Critical);
+    auto formatCount = 0;
+    const auto context = [&formatCount] {
+        ++formatCount;
+        return "lazy context"s;
+    };
+    CPPUNIT_ASSERT(!criticalDiag.isRelevant(DiagLevel::Warning));
+    criticalDiag.emplace_back(DiagLevel::Warning, "warning msg", context);
+    CPPUNIT_ASSERT_EQUAL(0_st, criticalDiag.size());
+    CPPUNIT_ASSERT_EQUAL(0, formatCount);
+    criticalDiag.emplace_back(DiagLevel::Critical, [] { return "critical msg"s; }, context);
+    CPPUNIT_ASSERT_EQUAL(1_st, criticalDiag.size());
+    CPPUNIT_ASSERT_EQUAL(1, formatCount);
+    CPPUNIT_ASSERT_EQUAL("critical msg"s, criticalDiag.front().message());
+    CPPUNIT_ASSERT_EQUAL("lazy context"s, criticalDiag.front().context());
 }
 
 void UtilitiesTests::testBackupFile()
@@ -392,3 +462,601 @@ void UtilitiesTests::testBackupFile()
 
     CPPUNIT_ASSERT_EQUAL(0, remove(file.path().data()));
 }
+
+void UtilitiesTests::testCopyFile()
+{
+    using namespace BackupHelper;
+    const auto sourcePath = testFilePath("unsupported.bin");
+    const auto targetPath = workingCopyPath("unsupported-copy.bin", WorkingCopyMode::NoCopy);
+
+    // copy file reporting progress
+    auto percentage = std::uint8_t();
+    AbortableProgressFeedback progress([&percentage](AbortableProgressFeedback &feedback) { percentage = feedback.stepPercentage(); });
+    const auto method = copyFile(sourcePath, targetPath, &progress);
+    CPPUNIT_ASSERT(method == FileCopyMethod::Reflink || method == FileCopyMethod::CopyFileRange || method == FileCopyMethod::Buffered);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint8_t>(100), percentage);
+    CPPUNIT_ASSERT_EQUAL(readFile(sourcePath), readFile(targetPath));
+
+    // copying is supposed to stop when aborted
+    progress.tryToAbort();
+    CPPUNIT_ASSERT_THROW(copyFile(sourcePath, targetPath, &progress), OperationAbortedException);
+
+    // errors are reported as IO failure
+    CPPUNIT_ASSERT_THROW(copyFile(sourcePath + ".non-existent", targetPath), std::ios_base::failure);
+
+    CPPUNIT_ASSERT_EQUAL(0, remove(targetPath.data()));
+}
+
+void UtilitiesTests::testCoalescingStreamBuffer()
+{
+    // write many small chunks like the makers do and count what reaches the underlying buffer
+    stringbuf buffer(ios_base::in | ios_base::out | ios_base::binary);
+    IoStatistics statistics;
+    CountingStreamBuffer countingBuffer(&buffer, statistics);
+    iostream stream(&countingBuffer);
+    stream.exceptions(ios_base::failbit | ios_base::badbit);
+    {
+        auto scope = CoalescingWriteScope(stream, 64);
+        for (char i = 0; i != 100; ++i) {
+            stream.put(i);
+            stream.write("ab", 2);
+        }
+        CPPUNIT_ASSERT_EQUAL_MESSAGE("position includes staged data", static_cast<std::streamoff>(300), static_cast<std::streamoff>(stream.tellp()));
+        CPPUNIT_ASSERT_MESSAGE("writes coalesced", statistics.writeOperations < 10);
+
+        // patch previously written data
+        stream.seekp(1);
+        stream.write("xy", 2);
+        stream.seekp(0, ios_base::end);
+        stream.write(string(100, 'z').data(), 100);
+
+        // read back written data
+        stream.seekg(0);
+        CPPUNIT_ASSERT_EQUAL(0, stream.get());
+        CPPUNIT_ASSERT_EQUAL(static_cast<int>('x'), stream.get());
+        scope.flush();
+        scope.finish();
+    }
+    CPPUNIT_ASSERT(stream.rdbuf() == &countingBuffer);
+    CPPUNIT_ASSERT_EQUAL(402_st, static_cast<size_t>(statistics.bytesWritten));
+    const auto data = buffer.str();
+    CPPUNIT_ASSERT_EQUAL(400_st, data.size());
+    CPPUNIT_ASSERT_EQUAL("\0xy\1ab"s, data.substr(0, 6));
+    CPPUNIT_ASSERT_EQUAL(string(100, 'z'), data.substr(300));
+}
+
+void UtilitiesTests::testSkippingUnchangedData()
+{
+    // write the same data as already present; nothing is supposed to reach the underlying buffer
+    stringbuf buffer(string(300, 'a'), ios_base::in | ios_base::out | ios_base::binary);
+    IoStatistics statistics;
+    CountingStreamBuffer countingBuffer(&buffer, statistics);
+    iostream stream(&countingBuffer);
+    stream.exceptions(ios_base::failbit | ios_base::badbit);
+    {
+        auto scope = CoalescingWriteScope(stream, 64);
+        scope.setSkipUnchangedData(true);
+        for (auto i = 0; i != 300; ++i) {
+            stream.put('a');
+        }
+        CPPUNIT_ASSERT_EQUAL(static_cast<std::streamoff>(300), static_cast<std::streamoff>(stream.tellp()));
+        scope.finish();
+        CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), scope.bytesWritten());
+    }
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), statistics.bytesWritten);
+
+    // only data from the first differing byte of a chunk on is written; data beyond the end is written
+    stream.seekp(0);
+    {
+        auto scope = CoalescingWriteScope(stream, 64);
+        scope.setSkipUnchangedData(true);
+        for (auto i = 0; i != 300; ++i) {
+            stream.put(i == 150 ? 'b' : 'a');
+        }
+        stream.write("cc", 2);
+        stream.seekp(5);
+        stream.write("az", 2);
+        scope.finish();
+        CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(192 - 150 + 2 + 1), scope.bytesWritten());
+    }
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(45), statistics.bytesWritten);
+    const auto data = buffer.str();
+    CPPUNIT_ASSERT_EQUAL(302_st, data.size());
+    CPPUNIT_ASSERT_EQUAL("aaaaaaz"s, data.substr(0, 7));
+    CPPUNIT_ASSERT_EQUAL("aba"s, data.substr(149, 3));
+    CPPUNIT_ASSERT_EQUAL("acc"s, data.substr(299));
+}
+
+void UtilitiesTests::testFileAllocator()
+{
+    const auto path = workingCopyPath("sparse-padding.bin", WorkingCopyMode::NoCopy);
+    const auto expectedSize = static_cast<std::size_t>(4 + 0x100 + 0x20000 + 4 + 0x10000);
+    {
+        fstream stream;
+        stream.exceptions(ios_base::failbit | ios_base::badbit);
+        stream.open(path, ios_base::out | ios_base::binary | ios_base::trunc);
+        auto allocator = FileAllocator(path, 0x10000);
+        const auto preallocated = allocator.preallocate(expectedSize + 0x1000);
+        CPPUNIT_ASSERT(!preallocated || FileAllocator::isSupported());
+        auto scope = CoalescingWriteScope(stream, 64);
+        stream.write("head", 4);
+        // zeroes below the threshold are written as usual
+        allocator.writeZeroes(stream, 0x100);
+        CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), allocator.sparseBytes());
+        // zeroes exceeding the threshold are left as hole
+        allocator.writeZeroes(stream, 0x20000);
+        CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x20000 - 1), allocator.sparseBytes());
+        CPPUNIT_ASSERT_EQUAL(static_cast<std::streamoff>(4 + 0x100 + 0x20000), static_cast<std::streamoff>(stream.tellp()));
+        stream.write("tail", 4);
+        // a hole at the end still extends the file
+        allocator.writeZeroes(stream, 0x10000);
+        scope.finish();
+        stream.close();
+        allocator.releaseUnusedSpace(expectedSize);
+        CPPUNIT_ASSERT(allocator.preallocatedSize() <= expectedSize);
+    }
+    const auto contents = readFile(path, 0x100000);
+    CPPUNIT_ASSERT_EQUAL(expectedSize, contents.size());
+    CPPUNIT_ASSERT_EQUAL("head"s, contents.substr(0, 4));
+    CPPUNIT_ASSERT_EQUAL("tail"s, contents.substr(4 + 0x100 + 0x20000, 4));
+    CPPUNIT_ASSERT_EQUAL(string(0x100 + 0x20000, '\0'), contents.substr(4, 0x100 + 0x20000));
+    CPPUNIT_ASSERT_EQUAL(string(0x10000, '\0'), contents.substr(expectedSize - 0x10000));
+
+    // a disabled allocator always writes zeroes
+    stringstream buffer(ios_base::in | ios_base::out | ios_base::binary);
+    auto disabledAllocator = FileAllocator(string(), 1);
+    disabledAllocator.writeZeroes(buffer, 0x1234);
+    CPPUNIT_ASSERT_EQUAL(string(0x1234, '\0'), buffer.str());
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), disabledAllocator.sparseBytes());
+    CPPUNIT_ASSERT_EQUAL(0, remove(path.data()));
+}
+
+void UtilitiesTests::testCopyEngine()
+{
+    const auto sourcePath = workingCopyPath("copy-engine-source.bin", WorkingCopyMode::NoCopy);
+    const auto targetPath = workingCopyPath("copy-engine-target.bin", WorkingCopyMode::NoCopy);
+    auto sourceData = string(3 * CopyEngine::bufferSize + 123, '\0');
+    for (auto i = std::size_t(); i != sourceData.size(); ++i) {
+        sourceData[i] = static_cast<char>(i * 7 + i / 251);
+    }
+    writeFile(sourcePath, sourceData);
+
+    for (const auto backend : { CopyBackend::Threads, CopyBackend::IoUring }) {
+        {
+            fstream target;
+            target.exceptions(ios_base::failbit | ios_base::badbit);
+            target.open(targetPath, ios_base::out | ios_base::binary | ios_base::trunc);
+            auto engine = CopyEngine(sourcePath, targetPath, backend);
+            CPPUNIT_ASSERT(engine.backend() == CopyBackend::Threads || CopyEngine::isIoUringSupported());
+            auto scope = CoalescingWriteScope(target, 64);
+            // copied ranges are skipped in the target stream; adjacent ranges are merged
+            target.write("head", 4);
+            engine.submit(target, 100, 1000);
+            engine.submit(target, 1100, sourceData.size() - 1100);
+            CPPUNIT_ASSERT_EQUAL(static_cast<std::streamoff>(4 + sourceData.size() - 100), static_cast<std::streamoff>(target.tellp()));
+            target.write("mid", 3);
+            engine.submit(target, 0, 10);
+            target.write("tail", 4);
+            scope.finish();
+            target.flush();
+            engine.finish();
+            CPPUNIT_ASSERT_EQUAL(engine.bytesSubmitted(), engine.bytesCopied());
+            CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(sourceData.size() - 100 + 10), engine.bytesCopied());
+            // reading beyond the end of the source file is reported when finishing
+            engine.submit(CopyRange{ sourceData.size() + 10, 100, 0 });
+            CPPUNIT_ASSERT_THROW(engine.finish(), std::ios_base::failure);
+        }
+        const auto contents = readFile(targetPath, 0x1000000);
+        CPPUNIT_ASSERT_EQUAL(argsToString("head", sourceData.substr(100), "mid", sourceData.substr(0, 10), "tail"), contents);
+    }
+    CPPUNIT_ASSERT_EQUAL(0, remove(sourcePath.data()));
+    CPPUNIT_ASSERT_EQUAL(0, remove(targetPath.data()));
+}
+
+void UtilitiesTests::testEbmlHeaderDecoder()
+{
+    for (auto byte = 0u; byte != 0x100; ++byte) {
+        auto expectedLength = std::uint8_t(1);
+        for (auto mask = 0x80u; mask && !(byte & mask); mask >>= 1) {
+            ++expectedLength;
+        }
+        CPPUNIT_ASSERT_EQUAL(static_cast<int>(expectedLength), static_cast<int>(EbmlHeaderDecoder::vintLength(static_cast<std::uint8_t>(byte))));
+    }
+
+    // EBML header with a 4-byte ID, "Void" element with an 8-byte size denotation, "Segment" of unknown size
+    const char data[] = { 0x1A, 0x45, static_cast<char>(0xDF), static_cast<char>(0xA3), static_cast<char>(0x84), 0x01, 0x02, 0x03, 0x04,
+        static_cast<char>(0xEC), 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x18, 0x53, static_cast<char>(0x80), 0x67,
+        static_cast<char>(0xFF), 0x42 };
+    auto decoder = EbmlHeaderDecoder(data, sizeof(data));
+    auto header = EbmlHeader();
+    CPPUNIT_ASSERT(decoder.next(header));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint32_t>(EbmlIds::Header), header.id);
+    CPPUNIT_ASSERT_EQUAL(static_cast<int>(5), static_cast<int>(header.headerSize()));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(4), header.dataSize);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::size_t>(9), decoder.offset());
+    CPPUNIT_ASSERT(decoder.next(header));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint32_t>(EbmlIds::Void), header.id);
+    CPPUNIT_ASSERT_EQUAL(static_cast<int>(9), static_cast<int>(header.headerSize()));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(2), header.dataSize);
+    CPPUNIT_ASSERT(decoder.next(header));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint32_t>(MatroskaIds::Segment), header.id);
+    CPPUNIT_ASSERT(header.sizeUnknown);
+    CPPUNIT_ASSERT_EQUAL(sizeof(data), decoder.offset());
+    CPPUNIT_ASSERT(!decoder.next(header));
+    CPPUNIT_ASSERT(decoder.status() == EbmlHeaderStatus::Ok);
+
+    // invalid and truncated headers
+    CPPUNIT_ASSERT(EbmlHeaderDecoder::decode("\x08\x01\x81", 3, header) == EbmlHeaderStatus::InvalidIdLength);
+    CPPUNIT_ASSERT(EbmlHeaderDecoder::decode("\xEC\x00", 2, header) == EbmlHeaderStatus::InvalidSizeLength);
+    CPPUNIT_ASSERT(EbmlHeaderDecoder::decode("\x1A\x45\xDF", 3, header) == EbmlHeaderStatus::Truncated);
+    CPPUNIT_ASSERT(EbmlHeaderDecoder::decode("\xEC\x40", 2, header) == EbmlHeaderStatus::Truncated);
+    CPPUNIT_ASSERT(EbmlHeaderDecoder::decode("\xEC\x40", 2, header, 4, 1) == EbmlHeaderStatus::InvalidSizeLength);
+
+    // unsigned integers and the headers of "SimpleBlock"- and "Block"-elements
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), EbmlHeaderDecoder::decodeUInteger(nullptr, 0));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x1234), EbmlHeaderDecoder::decodeUInteger("\x12\x34", 2));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x0102030405060708), EbmlHeaderDecoder::decodeUInteger("\x01\x02\x03\x04\x05\x06\x07\x08\x09", 9));
+    auto block = MatroskaBlockHeader();
+    CPPUNIT_ASSERT(EbmlHeaderDecoder::decodeBlockHeader("\x41\x02\xFF\xFE\x86", 5, block));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0x102), block.trackNumber);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::int16_t>(-2), block.timestamp);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint8_t>(0x86), block.flags);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint8_t>(5), block.headerSize());
+    CPPUNIT_ASSERT(!EbmlHeaderDecoder::decodeBlockHeader("\x81\x00\x00", 3, block));
+    CPPUNIT_ASSERT(!EbmlHeaderDecoder::decodeBlockHeader("\x00\x00\x00\x00", 4, block));
+}
+
+void UtilitiesTests::testEbmlResyncScanner()
+{
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::size_t>(11), EbmlResyncScanner::findCandidate("\x00\x20\xFF\x0F\x21\x00\x00\x00\x00\x00\x00\x1F", 12));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::size_t>(5), EbmlResyncScanner::findCandidate("\x00\x20\xFF\x0F\x21", 5));
+
+    // damaged data containing a bogus "Cluster" ID, followed by a "Cluster" with "Timecode" and "SimpleBlock" and an empty "Cluster"
+    const auto damagedData = string(0x18000, '\x1F') + "\x1F\x43\xB6\x75\x81\x00"s;
+    const auto clusters = "\x1F\x43\xB6\x75\x86\xE7\x81\x05\xA3\x81\x00\x1F\x43\xB6\x75\x80"s;
+    auto stream = stringstream(damagedData + clusters, ios_base::in | ios_base::binary);
+    auto scanner = EbmlResyncScanner(stream);
+    const auto offset = scanner.findElement(1, damagedData.size() + clusters.size(), MatroskaElementLevel::Level1);
+    CPPUNIT_ASSERT(offset.has_value());
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(damagedData.size()), offset.value());
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(damagedData.size() - 1), scanner.bytesScanned());
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(2), scanner.candidatesChecked());
+
+    // no plausible element of the requested level
+    CPPUNIT_ASSERT(!scanner.findElement(1, damagedData.size() + clusters.size(), MatroskaElementLevel::TopLevel).has_value());
+    CPPUNIT_ASSERT(!scanner.findElement(0, damagedData.size(), MatroskaElementLevel::Level1).has_value());
+}
+
+void UtilitiesTests::testEbmlCrc32()
+{
+    CPPUNIT_ASSERT_EQUAL(0u, EbmlCrc32().value());
+    CPPUNIT_ASSERT_EQUAL(0xCBF43926u, EbmlCrc32::compute("123456789", 9));
+    CPPUNIT_ASSERT_EQUAL(0x190A55ADu, EbmlCrc32::compute(string(32, '\0').data(), 32));
+
+    // process data which is big enough for the folding via PCLMULQDQ (if supported) at once and in chunks of various sizes
+    auto data = string(1000, '\0');
+    for (std::size_t i = 0; i != data.size(); ++i) {
+        data[i] = static_cast<char>(i % 251);
+    }
+    CPPUNIT_ASSERT_EQUAL(0x721746A6u, EbmlCrc32::compute(data.data(), data.size()));
+    for (const auto chunkSize : { 1, 15, 64, 100, 999 }) {
+        auto crc = EbmlCrc32();
+        for (std::size_t offset = 0; offset < data.size(); offset += static_cast<std::size_t>(chunkSize)) {
+            crc.update(data.data() + offset, min(data.size() - offset, static_cast<std::size_t>(chunkSize)));
+        }
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(argsToString("chunk size ", chunkSize), 0x721746A6u, crc.value());
+    }
+    auto stream = stringstream(data, ios_base::in | ios_base::binary);
+    CPPUNIT_ASSERT_EQUAL(0x721746A6u, EbmlCrc32::compute(stream, data.size()));
+}
+
+void UtilitiesTests::testMatroskaCuePositionUpdater()
+{
+    // build "Cues"-elements using the minimum number of bytes for sizes and integers (like the updater does)
+    const auto element = [](const string &id, const string &data) { return id + string(1, static_cast<char>(0x80 | data.size())) + data; };
+    const auto makeCues = [&element](const string &clusterPosition1, const string &clusterPosition2, const string &relativePosition2) {
+        // 1st "CuePoint" with "CueBlockNumber" and "CueReference"
+        const auto cueReference = element("\xDB"s, element("\x96"s, "\x05"s) + element("\x97"s, clusterPosition1));
+        const auto trackPositions1 = element("\xB7"s,
+            element("\xF7"s, "\x01"s) + element("\xF1"s, clusterPosition1) + element("\xF0"s, "\x20"s) + element("\x53\x78"s, "\x02"s) + cueReference);
+        const auto cuePoint1 = element("\xBB"s, element("\xB3"s, "\x00"s) + trackPositions1);
+        // 2nd "CuePoint" referring to a different cluster
+        const auto trackPositions2 = element("\xB7"s, element("\xF7"s, "\x01"s) + element("\xF1"s, clusterPosition2) + element("\xF0"s, relativePosition2));
+        const auto cuePoint2 = element("\xBB"s, element("\xB3"s, "\x50"s) + trackPositions2);
+        return element("\x1C\x53\xBB\x6B"s, cuePoint1 + cuePoint2);
+    };
+    const auto original = makeCues("\x10\x00"s, "\xFF"s, "\x10"s);
+    const auto path = workingCopyPath("cues.mkv", WorkingCopyMode::NoCopy);
+    writeFile(path, original);
+
+    // parse the "Cues"-element and make it again without changes
+    Diagnostics diag;
+    MediaFileInfo file(path);
+    file.open(true);
+    MatroskaContainer container(file, 0);
+    EbmlElement cuesElement(container, 0);
+    auto updater = MatroskaCuePositionUpdater();
+    updater.parse(&cuesElement, diag);
+    CPPUNIT_ASSERT(diag.level() <= DiagLevel::Information);
+    CPPUNIT_ASSERT_EQUAL(17_st, updater.entryCount());
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(original.size()), updater.totalSize());
+    auto made = stringstream(ios_base::in | ios_base::out | ios_base::binary);
+    updater.make(made, diag);
+    CPPUNIT_ASSERT_EQUAL(original, made.str());
+
+    // update absolute offsets ("CueClusterPosition" and "CueRefCluster") and relative offsets; size changes are propagated
+    CPPUNIT_ASSERT(updater.updateOffsets(0x1000, 0x10));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(original.size() - 2), updater.totalSize());
+    CPPUNIT_ASSERT(!updater.updateOffsets(0x1000, 0x20));
+    CPPUNIT_ASSERT(updater.updateOffsets(0xFF, 0x100));
+    CPPUNIT_ASSERT(!updater.updateOffsets(0x1234, 0x1));
+    CPPUNIT_ASSERT(!updater.updateRelativeOffsets(0x1000, 0x10, 0x1234));
+    CPPUNIT_ASSERT(updater.updateRelativeOffsets(0xFF, 0x10, 0x1234));
+    const auto updated = makeCues("\x20"s, "\x01\x00"s, "\x12\x34"s);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(updated.size()), updater.totalSize());
+    made.str(string());
+    updater.make(made, diag);
+    CPPUNIT_ASSERT_EQUAL(updated, made.str());
+    CPPUNIT_ASSERT(diag.level() <= DiagLevel::Information);
+
+    file.close();
+    CPPUNIT_ASSERT_EQUAL(0, remove(path.data()));
+}
+
+void UtilitiesTests::testMatroskaLayoutPlanner()
+{
+    // build a "Segment"-element with two "Cluster"-elements containing "CRC-32"-, "Void"- and "Position"-elements
+    const auto element = [](const string &id, const string &data) { return id + string(1, static_cast<char>(0x80 | data.size())) + data; };
+    const auto simpleBlock = element("\xA3"s, string(10, '\x42'));
+    const auto cluster1 = element("\x1F\x43\xB6\x75"s,
+        element("\xBF"s, string(4, '\0')) // "CRC-32" (0 to 6)
+            + element("\xE7"s, "\x00"s) // "Timestamp" (6 to 9)
+            + element("\xA7"s, "\x00"s) // "Position" (9 to 12)
+            + element("\xEC"s, string(2, '\0')) // "Void" (12 to 16)
+            + simpleBlock); // "SimpleBlock" (16 to 28)
+    const auto cluster2 = element("\x1F\x43\xB6\x75"s,
+        element("\xE7"s, "\x10"s) // "Timestamp" (0 to 3)
+            + element("\xA7"s, "\x21"s) // "Position" (3 to 6)
+            + simpleBlock); // "SimpleBlock" (6 to 18)
+    const auto path = workingCopyPath("layout.mkv", WorkingCopyMode::NoCopy);
+    writeFile(path, element("\x18\x53\x80\x67"s, cluster1 + cluster2));
+
+    Diagnostics diag;
+    MediaFileInfo file(path);
+    file.open(true);
+    MatroskaContainer container(file, 0);
+    EbmlElement segmentElement(container, 0);
+    auto layout = MatroskaLayoutPlanner();
+    layout.parseClusters(&segmentElement, diag);
+    CPPUNIT_ASSERT_EQUAL(2_st, layout.clusterCount());
+    CPPUNIT_ASSERT_EQUAL(0_st, static_cast<std::size_t>(layout.readOffset(0)));
+    CPPUNIT_ASSERT_EQUAL(33_st, static_cast<std::size_t>(layout.readOffset(1)));
+    CPPUNIT_ASSERT_EQUAL(5_st, static_cast<std::size_t>(layout.originalStartOffset()));
+    CPPUNIT_ASSERT_EQUAL(61_st, static_cast<std::size_t>(layout.originalEndOffset()));
+
+    // keep the clusters as they are
+    layout.keep(0x100);
+    CPPUNIT_ASSERT_EQUAL(0x100_st, static_cast<std::size_t>(layout.offset(0)));
+    CPPUNIT_ASSERT_EQUAL(0x121_st, static_cast<std::size_t>(layout.offset(1)));
+    CPPUNIT_ASSERT_EQUAL(28_st, static_cast<std::size_t>(layout.dataSize(0)));
+    CPPUNIT_ASSERT_EQUAL(18_st, static_cast<std::size_t>(layout.dataSize(1)));
+    CPPUNIT_ASSERT_EQUAL(16_st, static_cast<std::size_t>(layout.relativeOffset(0, 16)));
+    CPPUNIT_ASSERT_EQUAL(56_st, static_cast<std::size_t>(layout.totalSize()));
+
+    // rewrite the clusters omitting "CRC-32" and "Void"; the "Position"-elements take 3 bytes each when below 2^8
+    auto progress = AbortableProgressFeedback(AbortableProgressFeedback::Callback());
+    layout.parseClusterChildren(diag, progress);
+    layout.rewrite(0);
+    CPPUNIT_ASSERT_EQUAL(0_st, static_cast<std::size_t>(layout.offset(0)));
+    CPPUNIT_ASSERT_EQUAL(23_st, static_cast<std::size_t>(layout.offset(1)));
+    CPPUNIT_ASSERT_EQUAL(18_st, static_cast<std::size_t>(layout.dataSize(0)));
+    CPPUNIT_ASSERT_EQUAL(18_st, static_cast<std::size_t>(layout.dataSize(1)));
+    CPPUNIT_ASSERT_EQUAL(46_st, static_cast<std::size_t>(layout.totalSize()));
+    CPPUNIT_ASSERT_EQUAL(0_st, static_cast<std::size_t>(layout.relativeOffset(0, 0)));
+    CPPUNIT_ASSERT_EQUAL(0_st, static_cast<std::size_t>(layout.relativeOffset(0, 6)));
+    CPPUNIT_ASSERT_EQUAL(3_st, static_cast<std::size_t>(layout.relativeOffset(0, 9)));
+    CPPUNIT_ASSERT_EQUAL(6_st, static_cast<std::size_t>(layout.relativeOffset(0, 16)));
+    CPPUNIT_ASSERT_EQUAL(6_st, static_cast<std::size_t>(layout.relativeOffset(1, 6)));
+
+    // shift the 2nd cluster across 2^8 and back
+    layout.rewrite(0xF0);
+    CPPUNIT_ASSERT_EQUAL(0x107_st, static_cast<std::size_t>(layout.offset(1)));
+    CPPUNIT_ASSERT_EQUAL(18_st, static_cast<std::size_t>(layout.dataSize(0)));
+    CPPUNIT_ASSERT_EQUAL(19_st, static_cast<std::size_t>(layout.dataSize(1)));
+    CPPUNIT_ASSERT_EQUAL(47_st, static_cast<std::size_t>(layout.totalSize()));
+    CPPUNIT_ASSERT_EQUAL(7_st, static_cast<std::size_t>(layout.relativeOffset(1, 6)));
+    layout.rewrite(0xE0);
+    CPPUNIT_ASSERT_EQUAL(0xF7_st, static_cast<std::size_t>(layout.offset(1)));
+    CPPUNIT_ASSERT_EQUAL(18_st, static_cast<std::size_t>(layout.dataSize(1)));
+    CPPUNIT_ASSERT_EQUAL(46_st, static_cast<std::size_t>(layout.totalSize()));
+
+    // shift the 2nd cluster across 2^16
+    layout.rewrite(0xFFF0);
+    CPPUNIT_ASSERT_EQUAL(0x10008_st, static_cast<std::size_t>(layout.offset(1)));
+    CPPUNIT_ASSERT_EQUAL(19_st, static_cast<std::size_t>(layout.dataSize(0)));
+    CPPUNIT_ASSERT_EQUAL(20_st, static_cast<std::size_t>(layout.dataSize(1)));
+    CPPUNIT_ASSERT_EQUAL(49_st, static_cast<std::size_t>(layout.totalSize()));
+    CPPUNIT_ASSERT_EQUAL(7_st, static_cast<std::size_t>(layout.relativeOffset(0, 16)));
+    CPPUNIT_ASSERT_EQUAL(8_st, static_cast<std::size_t>(layout.relativeOffset(1, 6)));
+
+    // shift the clusters without changing the size of the "Position"-elements
+    layout.rewrite(0x1000);
+    CPPUNIT_ASSERT_EQUAL(0x1018_st, static_cast<std::size_t>(layout.offset(1)));
+    CPPUNIT_ASSERT_EQUAL(48_st, static_cast<std::size_t>(layout.totalSize()));
+    layout.rewrite(0x2000);
+    CPPUNIT_ASSERT_EQUAL(0x2018_st, static_cast<std::size_t>(layout.offset(1)));
+    CPPUNIT_ASSERT_EQUAL(19_st, static_cast<std::size_t>(layout.dataSize(1)));
+    CPPUNIT_ASSERT_EQUAL(48_st, static_cast<std::size_t>(layout.totalSize()));
+
+    // switch between keeping and rewriting
+    layout.keep(0x2000);
+    CPPUNIT_ASSERT_EQUAL(0x2021_st, static_cast<std::size_t>(layout.offset(1)));
+    CPPUNIT_ASSERT_EQUAL(28_st, static_cast<std::size_t>(layout.dataSize(0)));
+    CPPUNIT_ASSERT_EQUAL(16_st, static_cast<std::size_t>(layout.relativeOffset(0, 16)));
+    CPPUNIT_ASSERT_EQUAL(56_st, static_cast<std::size_t>(layout.totalSize()));
+    layout.rewrite(0);
+    CPPUNIT_ASSERT_EQUAL(23_st, static_cast<std::size_t>(layout.offset(1)));
+    CPPUNIT_ASSERT_EQUAL(6_st, static_cast<std::size_t>(layout.relativeOffset(0, 16)));
+    CPPUNIT_ASSERT_EQUAL(46_st, static_cast<std::size_t>(layout.totalSize()));
+    CPPUNIT_ASSERT(diag.level() <= DiagLevel::Information);
+
+    file.close();
+    CPPUNIT_ASSERT_EQUAL(0, remove(path.data()));
+}
+
+void UtilitiesTests::testMatroskaAttachmentWritePlan()
+{
+    struct Move {
+        std::uint64_t sourceOffset, targetOffset, size;
+    };
+    // executes the specified moves on a stream and compares the result with copying the payloads from the original data
+    const auto testMoves = [](std::size_t streamSize, std::initializer_list<Move> moves, std::uint64_t expectedBufferedSize) {
+        auto original = string(streamSize, '\0');
+        for (std::size_t i = 0; i != streamSize; ++i) {
+            original[i] = static_cast<char>(i % 251);
+        }
+        auto expected = original;
+        auto plan = MatroskaAttachmentWritePlan();
+        for (const auto &move : moves) {
+            plan.add(move.sourceOffset, move.targetOffset, move.size);
+            expected.replace(move.targetOffset, move.size, original, move.sourceOffset, move.size);
+        }
+        auto stream = stringstream(original, ios_base::in | ios_base::out | ios_base::binary);
+        Diagnostics diag;
+        plan.execute(stream, diag);
+        CPPUNIT_ASSERT_EQUAL(moves.size(), plan.moveCount());
+        CPPUNIT_ASSERT_EQUAL(expectedBufferedSize, plan.bufferedSize());
+        CPPUNIT_ASSERT_MESSAGE("payloads moved", expected == stream.str());
+    };
+
+    // overlapping moves towards the start/end of the stream (in-place without buffering)
+    testMoves(100, { { 20, 10, 30 }, { 60, 40, 20 } }, 0);
+    testMoves(100, { { 10, 30, 30 }, { 50, 65, 20 } }, 0);
+    // mixed directions and a payload which stays where it is
+    testMoves(100, { { 20, 10, 20 }, { 50, 60, 20 }, { 85, 85, 5 }, { 92, 90, 8 } }, 0);
+    // reordered payloads need to be buffered
+    testMoves(100, { { 10, 40, 20 }, { 40, 10, 20 } }, 20);
+    testMoves(100, { { 0, 70, 30 }, { 40, 40, 20 }, { 70, 0, 30 } }, 30);
+    // payloads exceeding the buffer size are moved chunk-wise
+    constexpr auto largeSize = MatroskaAttachmentWritePlan::bufferSize * 2 + 3;
+    testMoves(largeSize + 100, { { 100, 0, largeSize } }, 0);
+    testMoves(largeSize + 100, { { 0, 100, largeSize } }, 0);
+}
+
+void UtilitiesTests::testMatroskaTrackStatistics()
+{
+    // statistics of two ranges of "SimpleBlock"-elements (timestamps in ms) with 40 ms per frame and two frames in the last block
+    auto first = MatroskaTrackStatistics(), second = MatroskaTrackStatistics();
+    first.startTimestamp = first.lastTimestampWithoutDuration = 0;
+    first.endTimestamp = 960;
+    first.lastFrameCountWithoutDuration = 1;
+    second.startTimestamp = 1000;
+    second.endTimestamp = second.lastTimestampWithoutDuration = 1960;
+    second.lastFrameCountWithoutDuration = 2;
+    second.byteCount = 5100;
+    first.add(second);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::int64_t>(0), first.startTimestamp);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::int64_t>(1960), first.lastTimestampWithoutDuration);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(2), first.lastFrameCountWithoutDuration);
+
+    // the frames of the last block last as long as denoted by the "DefaultDuration"-element
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(1960000000), first.durationInNanoseconds(1000000));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(2040000000), first.durationInNanoseconds(1000000, 40000000));
+    CPPUNIT_ASSERT_EQUAL(TimeSpan::fromMilliseconds(2040), first.duration(1000000, 40000000));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(20.0, first.bitrate(1000000, 40000000), 0.0001);
+    // a longer "BlockDuration" is not shortened
+    first.endTimestamp = 2100;
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(2100000000), first.durationInNanoseconds(1000000, 40000000));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint64_t>(0), MatroskaTrackStatistics().durationInNanoseconds(1000000, 40000000));
+
+    // the duration is formatted like mkvmerge does
+    CPPUNIT_ASSERT_EQUAL("00:00:00.000000000"s, MatroskaTrackStatistics::formatDuration(0));
+    CPPUNIT_ASSERT_EQUAL("00:01:27.336000000"s, MatroskaTrackStatistics::formatDuration(87336000000));
+    CPPUNIT_ASSERT_EQUAL("26:03:04.000000005"s, MatroskaTrackStatistics::formatDuration(93784000000005));
+}
+
+void UtilitiesTests::testFlatFieldMap()
+{
+    // test the container itself
+    FlatFieldMap<std::string, int, CaseInsensitiveStringNormalizer> map;
+    map.emplace("title", 1);
+    map.emplace("ARTIST", 2);
+    map.emplace("Title", 3);
+    map.insert(std::make_pair("album"s, 4));
+    CPPUNIT_ASSERT_EQUAL(4_st, map.size());
+    CPPUNIT_ASSERT_EQUAL("album"s, map.begin()->first);
+    CPPUNIT_ASSERT_EQUAL(2_st, map.count("TITLE"));
+    const auto [first, end] = map.equal_range("TiTlE");
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("multi-value order preserved", 1, first->second);
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("multi-value order preserved", 3, (first + 1)->second);
+    CPPUNIT_ASSERT(first + 2 == end);
+    CPPUNIT_ASSERT(map.find("artist") != map.end());
+    CPPUNIT_ASSERT(map.find("comment") == map.end());
+    CPPUNIT_ASSERT_EQUAL(2_st, map.erase("title"));
+    CPPUNIT_ASSERT_EQUAL(2_st, map.size());
+    map.erase(map.find("album"));
+    CPPUNIT_ASSERT_EQUAL("ARTIST"s, map.begin()->first);
+
+    // insert multiple entries at once; the order of entries with equivalent keys is preserved
+    const auto entries = std::vector<std::pair<std::string, int>>{ { "title", 5 }, { "Artist", 6 }, { "album", 7 }, { "TITLE", 8 } };
+    map.insert(entries.cbegin(), entries.cend());
+    CPPUNIT_ASSERT_EQUAL(5_st, map.size());
+    auto mappedValues = std::vector<int>();
+    for (const auto &entry : map) {
+        mappedValues.emplace_back(entry.second);
+    }
+    CPPUNIT_ASSERT((std::vector<int>{ 7, 2, 6, 5, 8 }) == mappedValues);
+    CPPUNIT_ASSERT_EQUAL(2_st, map.count("aRtIsT"));
+    CPPUNIT_ASSERT_EQUAL(0_st, map.count("artists"));
+    CPPUNIT_ASSERT_EQUAL(0_st, map.count("artis"));
+    CPPUNIT_ASSERT_EQUAL(7, map.find("ALBUM")->second);
+
+    // test usage as storage for fields of a tag
+    VorbisComment tag;
+    CPPUNIT_ASSERT(tag.setValues(KnownField::Artist, { TagValue("foo"), TagValue("bar") }));
+    CPPUNIT_ASSERT(tag.setValue("artist", TagValue("baz")));
+    const auto values = tag.values("Artist");
+    CPPUNIT_ASSERT_EQUAL(2_st, values.size());
+    CPPUNIT_ASSERT_EQUAL("baz"s, values[0]->toString());
+    CPPUNIT_ASSERT_EQUAL("bar"s, values[1]->toString());
+    CPPUNIT_ASSERT(tag.setValues(KnownField::Artist, { TagValue("foo") }));
+    CPPUNIT_ASSERT_EQUAL(1_st, tag.values(KnownField::Artist).size());
+    CPPUNIT_ASSERT_EQUAL(1u, tag.fieldCount());
+}
+
+void UtilitiesTests::testKnownFieldMapping()
+{
+    // test the mapping itself
+    constexpr FieldIdMapping<std::string_view> fieldIds[] = {
+        { "TITLE", KnownField::Title },
+        { "DATE", KnownField::RecordDate },
+        { "DATE", KnownField::Year, FieldMappingDirection::ToIdOnly },
+        { "YEAR", KnownField::RecordDate, FieldMappingDirection::ToKnownFieldOnly },
+    };
+    constexpr auto mapping = makeKnownFieldMapping<CaseInsensitiveFieldIdHash>(fieldIds);
+    static_assert(mapping.isValid());
+    static_assert(mapping.knownField("title") == KnownField::Title);
+    static_assert(mapping.knownField("year") == KnownField::RecordDate);
+    static_assert(mapping.knownField("TITLES") == KnownField::Invalid);
+    static_assert(mapping.id(KnownField::Year) == "DATE");
+    static_assert(mapping.id(KnownField::Album).empty());
+    constexpr FieldIdMapping<std::string_view> conflictingFieldIds[] = {
+        { "TITLE", KnownField::Title },
+        { "TITLE", KnownField::Album },
+    };
+    static_assert(!makeKnownFieldMapping<FieldIdHash>(conflictingFieldIds).isValid());
+
+    // test mappings of the tag formats
+    const auto vorbisComment = VorbisComment();
+    CPPUNIT_ASSERT_EQUAL("DATE"s, vorbisComment.fieldId(KnownField::Year));
+    CPPUNIT_ASSERT(vorbisComment.knownField("year") == KnownField::RecordDate);
+    CPPUNIT_ASSERT(vorbisComment.knownField(vorbisComment.fieldId(KnownField::Language)) == KnownField::Language);
+    CPPUNIT_ASSERT(vorbisComment.knownField("foo") == KnownField::Invalid);
+    const auto matroskaTag = MatroskaTag();
+    CPPUNIT_ASSERT(matroskaTag.knownField(matroskaTag.fieldId(KnownField::Genre)) == KnownField::Genre);
+    CPPUNIT_ASSERT(matroskaTag.knownField("title") == KnownField::Invalid);
+    const auto mp4Tag = Mp4Tag();
+    CPPUNIT_ASSERT(mp4Tag.knownField(Mp4TagAtomIds::PreDefinedGenre) == KnownField::Genre);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uint32_t>(Mp4TagAtomIds::Genre), mp4Tag.fieldId(KnownField::Genre));
+    CPPUNIT_ASSERT_EQUAL(0u, mp4Tag.fieldId(KnownField::Vendor));
+}
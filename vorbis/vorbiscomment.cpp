@@ -3,6 +3,8 @@
 
 #include "../ogg/oggiterator.h"
 
+#include "../knownfieldmapping.h"
+
 #include "../diagnostics.h"
 #include "../exceptions.h"
 
@@ -10,8 +12,11 @@
 #include <c++utilities/io/binarywriter.h>
 #include <c++utilities/io/copy.h>
 
-#include <map>
+#include <algorithm>
+#include <iterator>
 #include <memory>
+#include <string_view>
+#include <vector>
 
 using namespace std;
 using namespace CppUtilities;
@@ -44,88 +49,53 @@ bool VorbisComment::setValue(KnownField field, const TagValue &value)
     }
 }
 
-VorbisComment::IdentifierType VorbisComment::internallyGetFieldId(KnownField field) const
+/// \cond
+namespace {
+constexpr auto makeVorbisCommentFieldMapping()
 {
     using namespace VorbisCommentIds;
-    switch (field) {
-    case KnownField::Album:
-        return album();
-    case KnownField::Artist:
-        return artist();
-    case KnownField::Comment:
-        return comment();
-    case KnownField::Cover:
-        return cover();
-    case KnownField::RecordDate:
-    case KnownField::Year:
-        return date();
-    case KnownField::Title:
-        return title();
-    case KnownField::Genre:
-        return genre();
-    case KnownField::TrackPosition:
-        return trackNumber();
-    case KnownField::DiskPosition:
-        return diskNumber();
-    case KnownField::PartNumber:
-        return partNumber();
-    case KnownField::Composer:
-        return composer();
-    case KnownField::Encoder:
-        return encoder();
-    case KnownField::EncoderSettings:
-        return encoderSettings();
-    case KnownField::Description:
-        return description();
-    case KnownField::Grouping:
-        return grouping();
-    case KnownField::RecordLabel:
-        return label();
-    case KnownField::Performers:
-        return performer();
-    case KnownField::Language:
-        return language();
-    case KnownField::Lyricist:
-        return lyricist();
-    case KnownField::Lyrics:
-        return lyrics();
-    case KnownField::AlbumArtist:
-        return albumArtist();
-    default:
-        return string();
-    }
+    // clang-format off
+    constexpr FieldIdMapping<std::string_view> fieldIds[] = {
+        { album(), KnownField::Album },
+        { artist(), KnownField::Artist },
+        { comment(), KnownField::Comment },
+        { cover(), KnownField::Cover },
+        { date(), KnownField::RecordDate },
+        { date(), KnownField::Year, FieldMappingDirection::ToIdOnly },
+        { year(), KnownField::RecordDate, FieldMappingDirection::ToKnownFieldOnly },
+        { title(), KnownField::Title },
+        { genre(), KnownField::Genre },
+        { trackNumber(), KnownField::TrackPosition },
+        { diskNumber(), KnownField::DiskPosition },
+        { partNumber(), KnownField::PartNumber },
+        { composer(), KnownField::Composer },
+        { encoder(), KnownField::Encoder },
+        { encoderSettings(), KnownField::EncoderSettings },
+        { description(), KnownField::Description },
+        { grouping(), KnownField::Grouping },
+        { label(), KnownField::RecordLabel },
+        { performer(), KnownField::Performers },
+        { language(), KnownField::Language },
+        { lyricist(), KnownField::Lyricist },
+        { lyrics(), KnownField::Lyrics },
+        { albumArtist(), KnownField::AlbumArtist },
+    };
+    // clang-format on
+    return makeKnownFieldMapping<CaseInsensitiveFieldIdHash>(fieldIds);
+}
+constexpr auto vorbisCommentFieldMapping = makeVorbisCommentFieldMapping();
+static_assert(vorbisCommentFieldMapping.isValid(), "Vorbis comment field mapping must not contain conflicting entries");
+} // namespace
+/// \endcond
+
+VorbisComment::IdentifierType VorbisComment::internallyGetFieldId(KnownField field) const
+{
+    return IdentifierType(vorbisCommentFieldMapping.id(field));
 }
 
 KnownField VorbisComment::internallyGetKnownField(const IdentifierType &id) const
 {
-    using namespace VorbisCommentIds;
-    // clang-format off
-    static const map<string, KnownField, CaseInsensitiveStringComparer> fieldMap({
-         { album(), KnownField::Album },
-         { artist(), KnownField::Artist },
-         { comment(), KnownField::Comment },
-         { cover(), KnownField::Cover },
-         { date(), KnownField::RecordDate },
-         { year(), KnownField::RecordDate },
-         { title(), KnownField::Title },
-         { genre(), KnownField::Genre },
-         { trackNumber(), KnownField::TrackPosition },
-         { diskNumber(), KnownField::DiskPosition },
-         { partNumber(), KnownField::PartNumber },
-         { composer(), KnownField::Composer },
-         { encoder(), KnownField::Encoder },
-         { encoderSettings(), KnownField::EncoderSettings },
-         { description(), KnownField::Description },
-         { grouping(), KnownField::Grouping },
-         { label(), KnownField::RecordLabel },
-         { performer(), KnownField::Performers },
-         { lyricist(), KnownField::Lyricist },
-         { lyrics(), KnownField::Lyrics },
-         { albumArtist(), KnownField::AlbumArtist },
-    });
-    // clang-format on
-    const auto knownField(fieldMap.find(id));
-    return knownField != fieldMap.cend() ? knownField->second : KnownField::Invalid;
+    return vorbisCommentFieldMapping.knownField(id);
 }
 
 /*!
@@ -166,18 +136,26 @@ template <class StreamType> void VorbisComment::internalParse(StreamType &stream
             CHECK_MAX_SIZE(4)
             stream.read(sig, 4);
             std::uint32_t fieldCount = LE::toUInt32(sig);
+            // read fields
+            // note: The fields are inserted at once as inserting them one by one into the flat field storage takes quadratic time.
+            auto parsedFields = std::vector<std::pair<std::string, VorbisCommentField>>();
+            parsedFields.reserve(min<std::uint32_t>(fieldCount, 0x1000));
+            const auto insertParsedFields = [this, &parsedFields] {
+                fields().insert(make_move_iterator(parsedFields.begin()), make_move_iterator(parsedFields.end()));
+            };
             for (std::uint32_t i = 0; i < fieldCount; ++i) {
-                // read fields
                 VorbisCommentField field;
                 try {
                     field.parse(stream, maxSize, diag);
-                    fields().emplace(field.id(), move(field));
+                    parsedFields.emplace_back(field.id(), move(field));
                 } catch (const TruncatedDataException &) {
+                    insertParsedFields();
                     throw;
                 } catch (const Failure &) {
                     // nothing to do here since notifications will be added anyways
                 }
             }
+            insertParsedFields();
             if (!(flags & VorbisCommentFlags::NoFramingByte)) {
                 stream.ignore(); // skip framing byte
             }
@@ -187,10 +165,16 @@ template <class StreamType> void VorbisComment::internalParse(StreamType &stream
             //       MediaInfo and VLC player it is treated like "DATE" here.
             if (fields().find(VorbisCommentIds::date()) == fields().end()) {
                 const auto [first, end] = fields().equal_range(VorbisCommentIds::year());
+                auto yearFields = std::vector<VorbisCommentField>();
+                yearFields.reserve(static_cast<std::size_t>(end - first));
                 for (auto i = first; i != end; ++i) {
-                    fields().insert(std::pair(VorbisCommentIds::date(), std::move(i->second)));
+                    yearFields.emplace_back(std::move(i->second));
                 }
+                // note: Erasing before inserting as inserting invalidates iterators of the flat field storage.
                 fields().erase(first, end);
+                for (auto &yearField : yearFields) {
+                    fields().insert(std::pair(VorbisCommentIds::date(), std::move(yearField)));
+                }
             }
         } else {
             diag.emplace_back(DiagLevel::Critical, "Signature is invalid.", context);
@@ -5,6 +5,7 @@
 
 #include "../caseinsensitivecomparer.h"
 #include "../fieldbasedtag.h"
+#include "../flatfieldmap.h"
 #include "../mediaformat.h"
 
 namespace TagParser {
@@ -20,6 +21,7 @@ template <> class TAG_PARSER_EXPORT FieldMapBasedTagTraits<VorbisComment> {
 public:
     using FieldType = VorbisCommentField;
     using Compare = CaseInsensitiveStringComparer;
+    using Storage = FlatFieldMap<typename FieldType::IdentifierType, FieldType, CaseInsensitiveStringNormalizer>;
 };
 
 class TAG_PARSER_EXPORT VorbisComment : public FieldMapBasedTag<VorbisComment> {